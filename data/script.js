@@ -15,12 +15,34 @@ let currentEnrollmentId = null;
 
 // Vehicle-specific variables
 let editingVehicleRFID = null;
-let vehicleEventSource = null;
+let vehicleSocket = null;
+
+// Local copy of the vehicle list, kept current through /sync deltas
+const VEHICLE_SYNC_INTERVAL_MS = 5000;
+let vehicleCache = new Map();
+let vehiclesGen = null;
 
 // ============================================================================
 // PAGE INITIALIZATION
 // ============================================================================
 
+// The gate has no clock of its own; pass timestamps become Unix time once a
+// dashboard has told it the time
+document.addEventListener("DOMContentLoaded", function () {
+  const now = Math.floor(Date.now() / 1000);
+  fetch(`${BASE_URL}/clock?set=${now}`)
+    .then((response) => {
+      // The gate keeps its time once set; a large difference is reported,
+      // not applied (/clock?set=<time>&correct=1 overrides it)
+      if (response.status === 409) {
+        return response.json().then((clock) =>
+          console.warn(`Gate clock is ${clock.now - now} s off this browser's; not changed`)
+        );
+      }
+    })
+    .catch((error) => console.warn("Could not set the gate clock:", error));
+});
+
 document.addEventListener("DOMContentLoaded", function () {
   console.log("Page loaded, ESP32 IP:", ESP32_IP);
 
@@ -42,6 +64,7 @@ document.addEventListener("DOMContentLoaded", function () {
   // Vehicle-specific initialization
   if (window.location.pathname.includes("vehicle.html")) {
     loadVehicleList();
+    setInterval(syncVehicles, VEHICLE_SYNC_INTERVAL_MS);
 
     const addVehicleBtn = document.querySelector(".add-vehicle-btn");
     if (addVehicleBtn) {
@@ -266,18 +289,20 @@ async function startFingerprintEnrollment() {
     // Get list of existing fingerprints to find next available ID
     const response = await fetch(`${BASE_URL}/fp/list`);
     const existingFingerprints = await response.json();
+    const maxId =
+      parseInt(response.headers.get("X-Fingerprint-Max-Id"), 10) || 127;
 
     // Extract existing IDs
     const existingIds = existingFingerprints.map((fp) => fp.id);
 
-    // Find next available ID (1-127)
+    // Find next available ID (1-maxId)
     let nextId = 1;
-    while (existingIds.includes(nextId) && nextId <= 127) {
+    while (existingIds.includes(nextId) && nextId <= maxId) {
       nextId++;
     }
 
-    if (nextId > 127) {
-      showScanError("Fingerprint storage is full (max 127)");
+    if (nextId > maxId) {
+      showScanError(`Fingerprint storage is full (max ${maxId})`);
       // Re-enable start button
       if (startScanBtn) {
         startScanBtn.disabled = false;
@@ -363,6 +388,13 @@ function setupSSEConnection() {
     }
   });
 
+  // Sent on reconnect when the missed events are no longer on the ESP32
+  eventSource.addEventListener("resync", () => {
+    console.log("SSE resync: enrollment messages were missed");
+    scanStatus.className = "scan-status scanning";
+    scanText.textContent = "Reconnected, waiting for scanner...";
+  });
+
   eventSource.addEventListener("done", (e) => {
     console.log("Done:", e.data);
     scanStatus.className = "scan-status success";
@@ -388,6 +420,13 @@ function setupSSEConnection() {
       return;
     }
 
+    // The browser reconnects by itself and the ESP32 replays whatever was
+    // sent in the meantime, so a dropped connection is not an error yet
+    if (eventSource && eventSource.readyState === EventSource.CONNECTING) {
+      console.log("SSE reconnecting...");
+      return;
+    }
+
     // Only show error if we haven't completed enrollment
     if (document.getElementById("submitBtn").disabled) {
       showScanError("Connection to scanner lost. Please try again.");
@@ -732,6 +771,165 @@ document.addEventListener("DOMContentLoaded", function () {
   }
 });
 
+// ============================================================================
+// MESSAGEPACK
+// ============================================================================
+
+// The list and sync endpoints answer in MessagePack when asked with
+// ?fmt=msgpack. A list arrives as a sequence of values: the column names,
+// then one array of values per row (a row shaped differently is a map).
+const API_FORMAT = "msgpack";
+
+function apiUrl(path) {
+  return `${BASE_URL}${path}${path.includes("?") ? "&" : "?"}fmt=${API_FORMAT}`;
+}
+
+// Decodes every top-level value in buffer
+function decodeMsgPack(buffer) {
+  const bytes = new Uint8Array(buffer);
+  const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+  const text = new TextDecoder();
+  let offset = 0;
+
+  function take(size) {
+    if (offset + size > bytes.length) {
+      throw new Error("Truncated MessagePack");
+    }
+    const start = offset;
+    offset += size;
+    return start;
+  }
+
+  function uint(size) {
+    const at = take(size);
+    if (size === 1) return view.getUint8(at);
+    if (size === 2) return view.getUint16(at);
+    if (size === 4) return view.getUint32(at);
+    return Number(view.getBigUint64(at));
+  }
+
+  function int(size) {
+    const at = take(size);
+    if (size === 1) return view.getInt8(at);
+    if (size === 2) return view.getInt16(at);
+    if (size === 4) return view.getInt32(at);
+    return Number(view.getBigInt64(at));
+  }
+
+  function str(length) {
+    const at = take(length);
+    return text.decode(bytes.subarray(at, at + length));
+  }
+
+  function array(length) {
+    const items = new Array(length);
+    for (let i = 0; i < length; i++) {
+      items[i] = next();
+    }
+    return items;
+  }
+
+  function map(length) {
+    const object = {};
+    for (let i = 0; i < length; i++) {
+      const key = next();
+      object[key] = next();
+    }
+    return object;
+  }
+
+  function next() {
+    const type = bytes[take(1)];
+    if (type < 0x80) return type;
+    if (type < 0x90) return map(type & 0x0f);
+    if (type < 0xa0) return array(type & 0x0f);
+    if (type < 0xc0) return str(type & 0x1f);
+    if (type >= 0xe0) return type - 0x100;
+
+    switch (type) {
+      case 0xc0:
+        return null;
+      case 0xc2:
+        return false;
+      case 0xc3:
+        return true;
+      case 0xc4:
+        return bytes.slice(take(uint(1)), offset);
+      case 0xc5:
+        return bytes.slice(take(uint(2)), offset);
+      case 0xc6:
+        return bytes.slice(take(uint(4)), offset);
+      case 0xca:
+        return view.getFloat32(take(4));
+      case 0xcb:
+        return view.getFloat64(take(8));
+      case 0xcc:
+        return uint(1);
+      case 0xcd:
+        return uint(2);
+      case 0xce:
+        return uint(4);
+      case 0xcf:
+        return uint(8);
+      case 0xd0:
+        return int(1);
+      case 0xd1:
+        return int(2);
+      case 0xd2:
+        return int(4);
+      case 0xd3:
+        return int(8);
+      case 0xd9:
+        return str(uint(1));
+      case 0xda:
+        return str(uint(2));
+      case 0xdb:
+        return str(uint(4));
+      case 0xdc:
+        return array(uint(2));
+      case 0xdd:
+        return array(uint(4));
+      case 0xde:
+        return map(uint(2));
+      case 0xdf:
+        return map(uint(4));
+    }
+    throw new Error(`Unsupported MessagePack type 0x${type.toString(16)}`);
+  }
+
+  const values = [];
+  while (offset < bytes.length) {
+    values.push(next());
+  }
+  return values;
+}
+
+// Turns value arrays back into objects keyed by the column names
+function rowsFromColumns(columns, rows) {
+  return rows.map((row) =>
+    Array.isArray(row)
+      ? Object.fromEntries(columns.map((name, i) => [name, row[i]]))
+      : row
+  );
+}
+
+// A list endpoint's rows, whichever format the server chose
+async function readApiList(response) {
+  if (!(response.headers.get("Content-Type") || "").includes("msgpack")) {
+    return response.json();
+  }
+  const [columns = [], ...rows] = decodeMsgPack(await response.arrayBuffer());
+  return rowsFromColumns(columns, rows);
+}
+
+// A single-object body (/sync), whichever format the server chose
+async function readApiObject(response) {
+  if (!(response.headers.get("Content-Type") || "").includes("msgpack")) {
+    return response.json();
+  }
+  return decodeMsgPack(await response.arrayBuffer())[0];
+}
+
 // ============================================================================
 // VEHICLE LIST FUNCTIONS
 // ============================================================================
@@ -881,10 +1079,10 @@ function closeVehicleModal() {
   modal.classList.remove("active");
   document.body.style.overflow = "";
 
-  // Close SSE connection if active
-  if (vehicleEventSource) {
-    vehicleEventSource.close();
-    vehicleEventSource = null;
+  // Close the pass socket if open
+  if (vehicleSocket) {
+    vehicleSocket.close();
+    vehicleSocket = null;
   }
 
   editingVehicleRFID = null;
@@ -912,8 +1110,8 @@ async function startRFIDScan() {
       throw new Error("Failed to start RFID scan");
     }
 
-    // Setup SSE connection to listen for RFID events
-    setupRFIDSSEConnection();
+    // Listen for the tag on the pass socket
+    setupRFIDSocket();
   } catch (error) {
     console.error("Error starting RFID scan:", error);
     showRFIDScanError("Cannot connect to ESP32. Check WiFi connection.");
@@ -922,55 +1120,79 @@ async function startRFIDScan() {
   }
 }
 
-function setupRFIDSSEConnection() {
+// Pass frames from /ws, little-endian: type u8, plate length u8, flags u16,
+// seq u32, tag u32, timestamp u32, then the plate bytes
+const PASS_FRAME_TYPE = 1;
+const PASS_FRAME_HEADER = 16;
+const PASS_FLAG_REGISTERED = 0x0001;
+
+function decodePassFrame(buffer) {
+  const view = new DataView(buffer);
+  if (buffer.byteLength < PASS_FRAME_HEADER || view.getUint8(0) !== PASS_FRAME_TYPE) {
+    return null;
+  }
+
+  const plateLength = view.getUint8(1);
+  const flags = view.getUint16(2, true);
+  return {
+    seq: view.getUint32(4, true),
+    tag: view.getUint32(8, true).toString(16).toUpperCase().padStart(8, "0"),
+    timestamp: view.getUint32(12, true),
+    registered: (flags & PASS_FLAG_REGISTERED) !== 0,
+    plateNo: new TextDecoder().decode(
+      new Uint8Array(buffer, PASS_FRAME_HEADER, plateLength)
+    ),
+  };
+}
+
+function setupRFIDSocket() {
   const scanStatus = document.getElementById("rfidScanStatus");
   const scanText = scanStatus.querySelector(".scan-text");
 
-  if (vehicleEventSource) {
-    vehicleEventSource.close();
+  if (vehicleSocket) {
+    vehicleSocket.close();
   }
 
-  console.log("Setting up RFID SSE connection...");
-  vehicleEventSource = new EventSource(`${BASE_URL}/events`);
+  console.log("Opening pass socket...");
+  vehicleSocket = new WebSocket(`ws://${ESP32_IP}/ws`);
+  vehicleSocket.binaryType = "arraybuffer";
 
-  vehicleEventSource.addEventListener("rfid", (e) => {
-    console.log("RFID detected:", e.data);
-
-    // Extract RFID from message (format: "Vehicle detected: XXXX")
-    const rfidMatch = e.data.match(/Vehicle detected: ([A-F0-9]+)/i);
-    if (rfidMatch) {
-      const rfid = rfidMatch[1];
+  vehicleSocket.onmessage = (e) => {
+    if (typeof e.data === "string") {
+      console.log("Pass socket:", e.data);
+      return;
+    }
 
-      scanStatus.className = "scan-status success";
-      scanText.textContent = `✓ RFID Tag Detected: ${rfid}`;
+    const pass = decodePassFrame(e.data);
+    if (!pass) {
+      return;
+    }
+    console.log("RFID detected:", pass);
 
-      // Set the RFID value
-      document.getElementById("vehicleRFID").value = rfid;
+    scanStatus.className = "scan-status success";
+    scanText.textContent = `✓ RFID Tag Detected: ${pass.tag}`;
 
-      // Enable submit button
-      document.getElementById("submitVehicleBtn").disabled = false;
+    // Set the RFID value
+    document.getElementById("vehicleRFID").value = pass.tag;
 
-      // Hide start scan button
-      const startScanBtn = document.getElementById("startRFIDScanBtn");
-      if (startScanBtn) {
-        startScanBtn.style.display = "none";
-      }
+    // Enable submit button
+    document.getElementById("submitVehicleBtn").disabled = false;
 
-      // Close SSE connection
-      if (vehicleEventSource) {
-        vehicleEventSource.close();
-        vehicleEventSource = null;
-      }
+    // Hide start scan button
+    const startScanBtn = document.getElementById("startRFIDScanBtn");
+    if (startScanBtn) {
+      startScanBtn.style.display = "none";
     }
-  });
 
-  vehicleEventSource.addEventListener("rfid_status", (e) => {
-    console.log("RFID Status:", e.data);
-    scanText.textContent = e.data;
-  });
+    // Close the socket
+    if (vehicleSocket) {
+      vehicleSocket.close();
+      vehicleSocket = null;
+    }
+  };
 
-  vehicleEventSource.onerror = (error) => {
-    console.error("RFID SSE Error:", error);
+  vehicleSocket.onerror = (error) => {
+    console.error("Pass socket error:", error);
     showRFIDScanError("Connection to scanner lost. Please try again.");
   };
 }
@@ -999,11 +1221,11 @@ function showRFIDScanError(message) {
 async function submitVehicle(event) {
   event.preventDefault();
 
-  // IMPORTANT: Close any active SSE connections before saving
-  if (vehicleEventSource) {
-    console.log("Closing SSE connection before save...");
-    vehicleEventSource.close();
-    vehicleEventSource = null;
+  // IMPORTANT: Close the pass socket before saving
+  if (vehicleSocket) {
+    console.log("Closing pass socket before save...");
+    vehicleSocket.close();
+    vehicleSocket = null;
     // Wait a moment for connection to fully close
     await new Promise((resolve) => setTimeout(resolve, 300));
   }
@@ -1061,11 +1283,8 @@ async function submitVehicle(event) {
 
     closeVehicleModal();
 
-    // Wait longer before reloading to ensure ESP32 has fully processed
-    await new Promise((resolve) => setTimeout(resolve, 1000));
-
-    console.log("Reloading vehicle list...");
-    await loadVehicleList(); // Now uses retry logic
+    // The save is only acknowledged once committed, so a delta is enough
+    await syncVehicles();
 
     if (editingVehicleRFID) {
       showNotification(
@@ -1101,7 +1320,7 @@ async function loadVehicleList(retryCount = 0) {
     const controller = new AbortController();
     const timeoutId = setTimeout(() => controller.abort(), 5000); // 5 second timeout
 
-    const response = await fetch(`${BASE_URL}/vehicle/list`, {
+    const response = await fetch(apiUrl("/vehicle/list"), {
       signal: controller.signal,
     });
 
@@ -1111,64 +1330,13 @@ async function loadVehicleList(retryCount = 0) {
       throw new Error(`HTTP error! status: ${response.status}`);
     }
 
-    const vehicles = await response.json();
+    const vehicles = await readApiList(response);
     console.log("Loaded vehicles:", vehicles);
     console.log("Number of vehicles:", vehicles.length);
 
-    const tableBody = document.querySelector(".vehicle-table tbody");
-    if (!tableBody) {
-      console.error("Table body not found!");
-      return;
-    }
-
-    tableBody.innerHTML = "";
-
-    if (vehicles.length === 0) {
-      const emptyRow = document.createElement("tr");
-      emptyRow.innerHTML = `
-        <td colspan="9" style="text-align: center; color: #999; padding: 40px;">
-          No vehicles registered yet. Click the + button to add one.
-        </td>
-      `;
-      tableBody.appendChild(emptyRow);
-    } else {
-      vehicles.forEach((vehicle) => {
-        const row = document.createElement("tr");
-        row.innerHTML = `
-          <td>${vehicle.rfid || "N/A"}</td>
-          <td>${vehicle.plateNo || "N/A"}</td>
-          <td>${vehicle.type || "N/A"}</td>
-          <td>${vehicle.owner || "N/A"}</td>
-          <td>${vehicle.role || "N/A"}</td>
-          <td>${vehicle.year || "N/A"}</td>
-          <td>${vehicle.section || "N/A"}</td>
-          <td>${vehicle.course || "N/A"}</td>
-          <td class="table-action-btn">
-            <button class="edit-vehicle-btn" onclick="editVehicle('${
-              vehicle.rfid
-            }', '${vehicle.plateNo}', '${vehicle.type}', '${vehicle.owner}', '${
-          vehicle.role
-        }', '${vehicle.year}', '${vehicle.section}', '${vehicle.course}')">
-              <svg width="30" height="30" viewBox="0 0 30 30" fill="none" xmlns="http://www.w3.org/2000/svg">
-                <g clip-path="url(#clip0_44_202)">
-                  <path d="M15 30C23.2843 30 30 23.2843 30 15C30 6.71573 23.2843 0 15 0C6.71573 0 0 6.71573 0 15C0 23.2843 6.71573 30 15 30Z" fill="#26A1F4"/>
-                  <path d="M20.2236 13.9183L20.2154 13.9101L16.081 9.77283C16.081 9.77283 11.042 14.8119 8.61385 17.2904C8.3115 17.5986 8.0824 18.0275 7.94646 18.4424C7.54803 19.6605 7.21814 20.9033 6.85135 22.1338C6.75291 22.4636 6.77283 22.7543 7.03123 23.0004C7.27498 23.2347 7.5492 23.2429 7.8656 23.148C9.03748 22.7965 10.217 22.4619 11.3941 22.125C11.9994 21.9495 12.5482 21.6184 12.9855 21.1646C15.2988 18.8373 20.2236 13.9183 20.2236 13.9183Z" fill="white"/>
-                  <path d="M22.6371 8.77792L21.2232 7.36406C20.8606 7.00178 20.3691 6.79828 19.8565 6.79828C19.344 6.79828 18.8524 7.00178 18.4898 7.36406L16.8873 8.96484L21.0351 13.1139L22.6377 11.5113C22.9999 11.1487 23.2033 10.6571 23.2031 10.1445C23.203 9.63196 22.9994 9.14042 22.6371 8.77792Z" fill="white"/>
-                </g>
-              </svg>
-            </button>
-            <button class="delete-vehicle-btn" onclick="deleteVehicle('${
-              vehicle.rfid
-            }')">
-              <svg width="30" height="30" viewBox="0 0 30 30" fill="none" xmlns="http://www.w3.org/2000/svg">
-                <path fill-rule="evenodd" clip-rule="evenodd" d="M15 0C6.72902 0 0 6.72902 0 15C0 23.271 6.72885 30 15 30C23.2712 30 30 23.271 30 15C30 6.72896 23.2711 0 15 0ZM12.0749 6.69897C12.075 6.56966 12.1263 6.44564 12.2177 6.35418C12.3091 6.26273 12.4331 6.21131 12.5624 6.21123H17.4374C17.5668 6.21152 17.6908 6.26309 17.7822 6.35462C17.8736 6.44616 17.925 6.57019 17.9251 6.69955V7.90523H12.0749V6.69897ZM20.0906 23.0911C20.0781 23.2813 19.9934 23.4595 19.8539 23.5892C19.7143 23.719 19.5304 23.7905 19.3399 23.7891H10.6035C10.4131 23.7886 10.2298 23.716 10.0906 23.586C9.95144 23.456 9.86659 23.2781 9.85313 23.0881L9.10588 12.1523H20.888L20.0906 23.0911ZM22.0324 11.1621H7.96758V10.029C7.96783 9.7285 8.08729 9.44041 8.29974 9.22794C8.51218 9.01547 8.80026 8.89598 9.10072 8.8957L20.8991 8.89535C21.1996 8.89577 21.4876 9.01536 21.7001 9.22789C21.9125 9.44042 22.0319 9.72854 22.0322 10.029L22.0324 11.1621ZM12.7354 21.1821V14.2383C12.7354 14.107 12.7876 13.9811 12.8805 13.8882C12.9734 13.7954 13.0993 13.7433 13.2306 13.7433C13.362 13.7434 13.4879 13.7956 13.5807 13.8885C13.6735 13.9814 13.7256 14.1073 13.7256 14.2386V21.1821C13.7266 21.2478 13.7145 21.313 13.6901 21.3739C13.6657 21.4349 13.6294 21.4904 13.5833 21.5372C13.5372 21.584 13.4823 21.6211 13.4217 21.6465C13.3611 21.6718 13.2961 21.6849 13.2305 21.6849C13.1648 21.6849 13.0998 21.6718 13.0392 21.6465C12.9786 21.6211 12.9237 21.584 12.8776 21.5372C12.8316 21.4904 12.7953 21.4349 12.7708 21.3739C12.7464 21.313 12.7343 21.2478 12.7354 21.1821ZM16.2681 21.1821V14.2383C16.2701 14.1083 16.3232 13.9843 16.4159 13.8931C16.5086 13.8019 16.6334 13.7509 16.7634 13.7509C16.8934 13.7509 17.0182 13.8021 17.1108 13.8934C17.2034 13.9846 17.2564 14.1086 17.2583 14.2386V21.1824C17.2598 21.2483 17.248 21.3139 17.2238 21.3752C17.1995 21.4365 17.1633 21.4924 17.1172 21.5395C17.0711 21.5867 17.016 21.6241 16.9552 21.6497C16.8944 21.6752 16.8291 21.6884 16.7632 21.6884C16.6973 21.6884 16.632 21.6752 16.5712 21.6497C16.5104 21.6241 16.4553 21.5867 16.4092 21.5395C16.3631 21.4924 16.3269 21.4365 16.3026 21.3752C16.2784 21.3139 16.2667 21.248 16.2681 21.1821Z" fill="#FC0005"/>
-                <path fill-rule="evenodd" clip-rule="evenodd" d="M20.0906 23.0911C20.0781 23.2813 19.9934 23.4595 19.8539 23.5892C19.7143 23.719 19.5304 23.7905 19.3399 23.7891H10.6035C10.4131 23.7886 10.2298 23.716 10.0906 23.586C9.95144 23.456 9.86659 23.2781 9.85313 23.0881L9.10588 12.1523H20.888L20.0906 23.0911ZM12.7354 14.2383V21.1821C12.7343 21.2478 12.7464 21.313 12.7708 21.3739C12.7953 21.4349 12.8316 21.4904 12.8776 21.5372C12.9237 21.584 12.9786 21.6211 13.0392 21.6465C13.0998 21.6718 13.1648 21.6849 13.2305 21.6849C13.2961 21.6849 13.3611 21.6718 13.4217 21.6465C13.4823 21.6211 13.5372 21.584 13.5833 21.5372C13.6294 21.4904 13.6657 21.4349 13.6901 21.3739C13.7145 21.313 13.7266 21.2478 13.7256 21.1821V14.2386C13.7256 14.1073 13.6735 13.9814 13.5807 13.8885C13.4879 13.7956 13.362 13.7434 13.2306 13.7433C13.0993 13.7433 12.9734 13.7954 12.8805 13.8882C12.7876 13.9811 12.7354 14.107 12.7354 14.2383ZM16.2681 14.2383V21.1821C16.2667 21.248 16.2784 21.3139 16.3026 21.3752C16.3269 21.4365 16.3631 21.4924 16.4092 21.5395C16.4553 21.5867 16.5104 21.6241 16.5712 21.6497C16.632 21.6752 16.6973 21.6884 16.7632 21.6884C16.8291 21.6884 16.8944 21.6752 16.9552 21.6497C17.016 21.6241 17.0711 21.5867 17.1172 21.5395C17.1633 21.4924 17.1995 21.4365 17.2238 21.3752C17.248 21.3139 17.2598 21.2483 17.2583 21.1824V14.2386C17.2564 14.1086 17.2034 13.9846 17.1108 13.8934C17.0182 13.8021 16.8934 13.7509 16.7634 13.7509C16.6334 13.7509 16.5086 13.8019 16.4159 13.8931C16.3232 13.9843 16.2701 14.1083 16.2681 14.2383Z" fill="white"/>
-              </svg>
-            </button>
-          </td>`;
-        tableBody.appendChild(row);
-      });
-    }
+    vehicleCache = new Map(vehicles.map((vehicle) => [vehicle.rfid, vehicle]));
+    vehiclesGen = response.headers.get("X-Vehicles-Gen");
+    renderVehicleTable(vehicles);
   } catch (error) {
     console.error(
       `Error loading vehicle list (attempt ${retryCount + 1}):`,
@@ -1190,6 +1358,99 @@ async function loadVehicleList(retryCount = 0) {
     }
   }
 }
+// Fetches only what changed since the last load or sync. Falls back to a
+// full reload when the server says our generation is too old.
+async function syncVehicles() {
+  if (vehiclesGen === null) {
+    return loadVehicleList();
+  }
+
+  try {
+    const response = await fetch(apiUrl(`/sync?vehicles_gen=${vehiclesGen}`));
+    if (response.status === 304) {
+      return;
+    }
+    if (!response.ok) {
+      throw new Error(`HTTP error! status: ${response.status}`);
+    }
+
+    const delta = (await readApiObject(response)).vehicles;
+    if (delta.reset) {
+      return loadVehicleList();
+    }
+    if (delta.columns) {
+      delta.changed = rowsFromColumns(delta.columns, delta.changed);
+    }
+
+    delta.changed.forEach((vehicle) => vehicleCache.set(vehicle.rfid, vehicle));
+    delta.removed.forEach((rfid) => vehicleCache.delete(rfid));
+    vehiclesGen = delta.gen;
+
+    if (delta.changed.length > 0 || delta.removed.length > 0) {
+      renderVehicleTable([...vehicleCache.values()]);
+    }
+  } catch (error) {
+    console.error("Error syncing vehicle list:", error);
+  }
+}
+
+function renderVehicleTable(vehicles) {
+  const tableBody = document.querySelector(".vehicle-table tbody");
+  if (!tableBody) {
+    console.error("Table body not found!");
+    return;
+  }
+
+  tableBody.innerHTML = "";
+
+  if (vehicles.length === 0) {
+    const emptyRow = document.createElement("tr");
+    emptyRow.innerHTML = `
+      <td colspan="9" style="text-align: center; color: #999; padding: 40px;">
+        No vehicles registered yet. Click the + button to add one.
+      </td>
+    `;
+    tableBody.appendChild(emptyRow);
+  } else {
+    vehicles.forEach((vehicle) => {
+      const row = document.createElement("tr");
+      row.innerHTML = `
+        <td>${vehicle.rfid || "N/A"}</td>
+        <td>${vehicle.plateNo || "N/A"}</td>
+        <td>${vehicle.type || "N/A"}</td>
+        <td>${vehicle.owner || "N/A"}</td>
+        <td>${vehicle.role || "N/A"}</td>
+        <td>${vehicle.year || "N/A"}</td>
+        <td>${vehicle.section || "N/A"}</td>
+        <td>${vehicle.course || "N/A"}</td>
+        <td class="table-action-btn">
+          <button class="edit-vehicle-btn" onclick="editVehicle('${
+            vehicle.rfid
+          }', '${vehicle.plateNo}', '${vehicle.type}', '${vehicle.owner}', '${
+        vehicle.role
+      }', '${vehicle.year}', '${vehicle.section}', '${vehicle.course}')">
+            <svg width="30" height="30" viewBox="0 0 30 30" fill="none" xmlns="http://www.w3.org/2000/svg">
+              <g clip-path="url(#clip0_44_202)">
+                <path d="M15 30C23.2843 30 30 23.2843 30 15C30 6.71573 23.2843 0 15 0C6.71573 0 0 6.71573 0 15C0 23.2843 6.71573 30 15 30Z" fill="#26A1F4"/>
+                <path d="M20.2236 13.9183L20.2154 13.9101L16.081 9.77283C16.081 9.77283 11.042 14.8119 8.61385 17.2904C8.3115 17.5986 8.0824 18.0275 7.94646 18.4424C7.54803 19.6605 7.21814 20.9033 6.85135 22.1338C6.75291 22.4636 6.77283 22.7543 7.03123 23.0004C7.27498 23.2347 7.5492 23.2429 7.8656 23.148C9.03748 22.7965 10.217 22.4619 11.3941 22.125C11.9994 21.9495 12.5482 21.6184 12.9855 21.1646C15.2988 18.8373 20.2236 13.9183 20.2236 13.9183Z" fill="white"/>
+                <path d="M22.6371 8.77792L21.2232 7.36406C20.8606 7.00178 20.3691 6.79828 19.8565 6.79828C19.344 6.79828 18.8524 7.00178 18.4898 7.36406L16.8873 8.96484L21.0351 13.1139L22.6377 11.5113C22.9999 11.1487 23.2033 10.6571 23.2031 10.1445C23.203 9.63196 22.9994 9.14042 22.6371 8.77792Z" fill="white"/>
+              </g>
+            </svg>
+          </button>
+          <button class="delete-vehicle-btn" onclick="deleteVehicle('${
+            vehicle.rfid
+          }')">
+            <svg width="30" height="30" viewBox="0 0 30 30" fill="none" xmlns="http://www.w3.org/2000/svg">
+              <path fill-rule="evenodd" clip-rule="evenodd" d="M15 0C6.72902 0 0 6.72902 0 15C0 23.271 6.72885 30 15 30C23.2712 30 30 23.271 30 15C30 6.72896 23.2711 0 15 0ZM12.0749 6.69897C12.075 6.56966 12.1263 6.44564 12.2177 6.35418C12.3091 6.26273 12.4331 6.21131 12.5624 6.21123H17.4374C17.5668 6.21152 17.6908 6.26309 17.7822 6.35462C17.8736 6.44616 17.925 6.57019 17.9251 6.69955V7.90523H12.0749V6.69897ZM20.0906 23.0911C20.0781 23.2813 19.9934 23.4595 19.8539 23.5892C19.7143 23.719 19.5304 23.7905 19.3399 23.7891H10.6035C10.4131 23.7886 10.2298 23.716 10.0906 23.586C9.95144 23.456 9.86659 23.2781 9.85313 23.0881L9.10588 12.1523H20.888L20.0906 23.0911ZM22.0324 11.1621H7.96758V10.029C7.96783 9.7285 8.08729 9.44041 8.29974 9.22794C8.51218 9.01547 8.80026 8.89598 9.10072 8.8957L20.8991 8.89535C21.1996 8.89577 21.4876 9.01536 21.7001 9.22789C21.9125 9.44042 22.0319 9.72854 22.0322 10.029L22.0324 11.1621ZM12.7354 21.1821V14.2383C12.7354 14.107 12.7876 13.9811 12.8805 13.8882C12.9734 13.7954 13.0993 13.7433 13.2306 13.7433C13.362 13.7434 13.4879 13.7956 13.5807 13.8885C13.6735 13.9814 13.7256 14.1073 13.7256 14.2386V21.1821C13.7266 21.2478 13.7145 21.313 13.6901 21.3739C13.6657 21.4349 13.6294 21.4904 13.5833 21.5372C13.5372 21.584 13.4823 21.6211 13.4217 21.6465C13.3611 21.6718 13.2961 21.6849 13.2305 21.6849C13.1648 21.6849 13.0998 21.6718 13.0392 21.6465C12.9786 21.6211 12.9237 21.584 12.8776 21.5372C12.8316 21.4904 12.7953 21.4349 12.7708 21.3739C12.7464 21.313 12.7343 21.2478 12.7354 21.1821ZM16.2681 21.1821V14.2383C16.2701 14.1083 16.3232 13.9843 16.4159 13.8931C16.5086 13.8019 16.6334 13.7509 16.7634 13.7509C16.8934 13.7509 17.0182 13.8021 17.1108 13.8934C17.2034 13.9846 17.2564 14.1086 17.2583 14.2386V21.1824C17.2598 21.2483 17.248 21.3139 17.2238 21.3752C17.1995 21.4365 17.1633 21.4924 17.1172 21.5395C17.0711 21.5867 17.016 21.6241 16.9552 21.6497C16.8944 21.6752 16.8291 21.6884 16.7632 21.6884C16.6973 21.6884 16.632 21.6752 16.5712 21.6497C16.5104 21.6241 16.4553 21.5867 16.4092 21.5395C16.3631 21.4924 16.3269 21.4365 16.3026 21.3752C16.2784 21.3139 16.2667 21.248 16.2681 21.1821Z" fill="#FC0005"/>
+              <path fill-rule="evenodd" clip-rule="evenodd" d="M20.0906 23.0911C20.0781 23.2813 19.9934 23.4595 19.8539 23.5892C19.7143 23.719 19.5304 23.7905 19.3399 23.7891H10.6035C10.4131 23.7886 10.2298 23.716 10.0906 23.586C9.95144 23.456 9.86659 23.2781 9.85313 23.0881L9.10588 12.1523H20.888L20.0906 23.0911ZM12.7354 14.2383V21.1821C12.7343 21.2478 12.7464 21.313 12.7708 21.3739C12.7953 21.4349 12.8316 21.4904 12.8776 21.5372C12.9237 21.584 12.9786 21.6211 13.0392 21.6465C13.0998 21.6718 13.1648 21.6849 13.2305 21.6849C13.2961 21.6849 13.3611 21.6718 13.4217 21.6465C13.4823 21.6211 13.5372 21.584 13.5833 21.5372C13.6294 21.4904 13.6657 21.4349 13.6901 21.3739C13.7145 21.313 13.7266 21.2478 13.7256 21.1821V14.2386C13.7256 14.1073 13.6735 13.9814 13.5807 13.8885C13.4879 13.7956 13.362 13.7434 13.2306 13.7433C13.0993 13.7433 12.9734 13.7954 12.8805 13.8882C12.7876 13.9811 12.7354 14.107 12.7354 14.2383ZM16.2681 14.2383V21.1821C16.2667 21.248 16.2784 21.3139 16.3026 21.3752C16.3269 21.4365 16.3631 21.4924 16.4092 21.5395C16.4553 21.5867 16.5104 21.6241 16.5712 21.6497C16.632 21.6752 16.6973 21.6884 16.7632 21.6884C16.8291 21.6884 16.8944 21.6752 16.9552 21.6497C17.016 21.6241 17.0711 21.5867 17.1172 21.5395C17.1633 21.4924 17.1995 21.4365 17.2238 21.3752C17.248 21.3139 17.2598 21.2483 17.2583 21.1824V14.2386C17.2564 14.1086 17.2034 13.9846 17.1108 13.8934C17.0182 13.8021 16.8934 13.7509 16.7634 13.7509C16.6334 13.7509 16.5086 13.8019 16.4159 13.8931C16.3232 13.9843 16.2701 14.1083 16.2681 14.2383Z" fill="white"/>
+            </svg>
+          </button>
+        </td>`;
+      tableBody.appendChild(row);
+    });
+  }
+}
+
 // ============================================================================
 // EDIT VEHICLE FUNCTION
 // ============================================================================
@@ -1256,7 +1517,7 @@ async function deleteVehicle(rfid) {
         `Vehicle with RFID ${rfid} has been removed from the system.`,
         "success"
       );
-      await loadVehicleList();
+      await syncVehicles();
     } else {
       throw new Error("Failed to delete vehicle");
     }
@@ -1300,7 +1561,7 @@ async function deleteAllVehicles() {
         "All vehicles have been successfully removed from the system.",
         "success"
       );
-      await loadVehicleList();
+      await syncVehicles();
     } else {
       throw new Error("Failed to delete all vehicles");
     }
@@ -0,0 +1,70 @@
+#include "Arduino.h"
+#include "esp_timer.h"
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+
+HardwareSerial Serial;
+
+namespace
+{
+const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+std::string dataDir = "native_data";
+} // namespace
+
+unsigned long millis()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+int64_t esp_timer_get_time()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(uint32_t ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+uint32_t esp_random()
+{
+  static std::random_device device;
+  return device();
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *data, size_t len)
+{
+  size_t written = fwrite(data, 1, len, stdout);
+  if (memchr(data, '\n', len) != NULL)
+    fflush(stdout);
+  return written;
+}
+
+void HardwareSerial::flush()
+{
+  fflush(stdout);
+}
+
+void setNativeDataDir(const char *dir)
+{
+  dataDir = dir;
+}
+
+const char *nativeDataDir()
+{
+  return dataDir.c_str();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Esp.h"
+#include "Print.h"
+#include "Stream.h"
+#include "WString.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// ============================================================================
+// ARDUINO CORE (HOST)
+// ============================================================================
+//
+// What the toll-gate core takes from the ESP32 Arduino core, on Linux: the
+// clock, Serial on stdout, the hardware random number generator and the ESP
+// chip counters (Esp.h). As on the device, including Arduino.h brings in
+// the FreeRTOS API.
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+// Since the process started
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+
+uint32_t esp_random();
+
+// The console. Output goes to stdout and is flushed at every line end, so a
+// script reading the host build's output sees each line as it is printed.
+// Nothing is read from it.
+class HardwareSerial : public Stream
+{
+public:
+  void begin(unsigned long baud) {}
+  operator bool() const { return true; }
+
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *data, size_t len) override;
+  void flush() override;
+};
+
+extern HardwareSerial Serial;
+
+// Where the host build keeps its emulated flash and NVS (LittleFS.h,
+// Preferences.h). Defaults to ./native_data; set it before mounting.
+void setNativeDataDir(const char *dir);
+const char *nativeDataDir();
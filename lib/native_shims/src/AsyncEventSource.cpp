@@ -0,0 +1,169 @@
+#include "AsyncEventSource.h"
+
+#include "NativeConnection.h"
+
+namespace
+{
+const char *EVENT_STREAM_HEAD = "HTTP/1.1 200 OK\r\n"
+                                "Content-Type: text/event-stream\r\n"
+                                "Cache-Control: no-cache\r\n"
+                                "Connection: keep-alive\r\n"
+                                "\r\n";
+
+// One message in the wire format, every line of the data on its own
+// data: line
+std::string formatMessage(const char *message, const char *event, uint32_t id, uint32_t reconnect)
+{
+  std::string text;
+  if (reconnect > 0)
+    text += "retry: " + std::to_string(reconnect) + "\r\n";
+  if (id > 0)
+    text += "id: " + std::to_string(id) + "\r\n";
+  if (event != NULL)
+    text += std::string("event: ") + event + "\r\n";
+
+  const char *line = message != NULL ? message : "";
+  while (true)
+  {
+    const char *end = strchr(line, '\n');
+    if (end == NULL)
+    {
+      text += std::string("data: ") + line + "\r\n";
+      break;
+    }
+    text += "data: " + std::string(line, end - line) + "\r\n";
+    line = end + 1;
+  }
+  text += "\r\n";
+  return text;
+}
+} // namespace
+
+// ============================================================================
+// CLIENT
+// ============================================================================
+
+AsyncEventSourceClient::AsyncEventSourceClient(AsyncWebServerRequest *request, AsyncEventSource *server,
+                                               NativeConnection *connection)
+    : _server(server), _connection(connection)
+{
+  if (request->hasHeader("Last-Event-ID"))
+    _lastId = strtoul(request->header("Last-Event-ID").c_str(), NULL, 10);
+}
+
+bool AsyncEventSourceClient::send(const char *message, const char *event, uint32_t id, uint32_t reconnect)
+{
+  return _write(formatMessage(message, event, id, reconnect));
+}
+
+void AsyncEventSourceClient::close()
+{
+  _connection->closeWhenSent();
+}
+
+bool AsyncEventSourceClient::connected() const
+{
+  std::lock_guard<std::recursive_mutex> lock(_connection->server->_lock);
+  return !_connection->closed && !_connection->closing;
+}
+
+size_t AsyncEventSourceClient::packetsWaiting() const
+{
+  std::lock_guard<std::recursive_mutex> lock(_connection->server->_lock);
+  return _connection->queue.size();
+}
+
+bool AsyncEventSourceClient::_write(const std::string &message)
+{
+  return _connection->enqueue(message, SSE_MAX_QUEUED_MESSAGES);
+}
+
+void AsyncEventSourceClient::_closed()
+{
+  _server->_remove(this);
+  delete this;
+}
+
+// ============================================================================
+// SOURCE
+// ============================================================================
+
+AsyncEventSource::~AsyncEventSource()
+{
+  close();
+}
+
+AsyncEventSource::SendStatus AsyncEventSource::send(const char *message, const char *event, uint32_t id,
+                                                    uint32_t reconnect)
+{
+  std::string text = formatMessage(message, event, id, reconnect);
+
+  std::lock_guard<std::mutex> lock(_lock);
+  size_t queued = 0;
+  for (std::list<AsyncEventSourceClient *>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+  {
+    if ((*it)->_write(text))
+      queued++;
+  }
+
+  if (queued == 0)
+    return DISCARDED;
+  return queued == _clients.size() ? ENQUEUED : PARTIALLY_ENQUEUED;
+}
+
+void AsyncEventSource::close()
+{
+  std::lock_guard<std::mutex> lock(_lock);
+  for (std::list<AsyncEventSourceClient *>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+    (*it)->close();
+}
+
+size_t AsyncEventSource::count() const
+{
+  std::lock_guard<std::mutex> lock(_lock);
+  return _clients.size();
+}
+
+size_t AsyncEventSource::avgPacketsWaiting() const
+{
+  std::lock_guard<std::mutex> lock(_lock);
+  if (_clients.empty())
+    return 0;
+
+  size_t waiting = 0;
+  for (std::list<AsyncEventSourceClient *>::const_iterator it = _clients.begin(); it != _clients.end(); ++it)
+    waiting += (*it)->packetsWaiting();
+  return (waiting + _clients.size() - 1) / _clients.size();
+}
+
+bool AsyncEventSource::canHandle(AsyncWebServerRequest *request) const
+{
+  return request->method() == HTTP_GET && request->url() == _url;
+}
+
+// On the server thread. The connect handler runs under the client list
+// lock, as the library's _addClient() calls it, so a send() from another
+// task waits for it and a handler that takes its own lock sees the same
+// lock order as on the device.
+void AsyncEventSource::_adopt(AsyncWebServerRequest *request, NativeConnection *connection)
+{
+  AsyncEventSourceClient *client = new AsyncEventSourceClient(request, this, connection);
+  connection->owner = client;
+  connection->enqueue(EVENT_STREAM_HEAD, 0);
+
+  std::lock_guard<std::mutex> lock(_lock);
+  _clients.push_back(client);
+  if (_connect)
+    _connect(client);
+}
+
+void AsyncEventSource::_remove(AsyncEventSourceClient *client)
+{
+  {
+    std::lock_guard<std::mutex> lock(_lock);
+    _clients.remove(client);
+  }
+
+  if (_disconnect)
+    _disconnect(client);
+}
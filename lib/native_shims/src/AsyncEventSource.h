@@ -0,0 +1,97 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+
+#include "ESPAsyncWebServer.h"
+
+// ============================================================================
+// EVENT SOURCE (HOST)
+// ============================================================================
+//
+// Server-sent events over the host web server. A client's Last-Event-ID
+// header becomes its lastId(); each client queues at most
+// SSE_MAX_QUEUED_MESSAGES messages, and sends beyond that are dropped for
+// that client only, as in the library.
+
+#define SSE_MAX_QUEUED_MESSAGES 32
+
+class AsyncEventSource;
+class AsyncEventSourceClient;
+struct NativeConnection;
+
+typedef std::function<void(AsyncEventSourceClient *client)> ArEventHandlerFunction;
+
+class AsyncEventSourceClient : public NativeConnectionOwner
+{
+public:
+  AsyncEventSourceClient(AsyncWebServerRequest *request, AsyncEventSource *server, NativeConnection *connection);
+
+  bool send(const char *message, const char *event = NULL, uint32_t id = 0, uint32_t reconnect = 0);
+  bool send(const String &message, const char *event = NULL, uint32_t id = 0, uint32_t reconnect = 0)
+  {
+    return send(message.c_str(), event, id, reconnect);
+  }
+  void close();
+
+  bool connected() const;
+  uint32_t lastId() const { return _lastId; }
+  size_t packetsWaiting() const;
+
+  // Host internals
+  bool _write(const std::string &message);
+  void _received(const uint8_t *data, size_t len) override {}
+  void _closed() override;
+
+private:
+  AsyncEventSource *_server;
+  NativeConnection *_connection;
+  uint32_t _lastId = 0;
+};
+
+class AsyncEventSource : public AsyncWebHandler
+{
+public:
+  enum SendStatus
+  {
+    DISCARDED = 0,
+    ENQUEUED = 1,
+    PARTIALLY_ENQUEUED = 2
+  };
+
+  explicit AsyncEventSource(const String &url) : _url(url) {}
+  ~AsyncEventSource();
+
+  const char *url() const { return _url.c_str(); }
+
+  // Both run on the server thread
+  void onConnect(ArEventHandlerFunction fn) { _connect = fn; }
+  void onDisconnect(ArEventHandlerFunction fn) { _disconnect = fn; }
+
+  // To every client; safe from any task
+  SendStatus send(const char *message, const char *event = NULL, uint32_t id = 0, uint32_t reconnect = 0);
+  SendStatus send(const String &message, const char *event = NULL, uint32_t id = 0, uint32_t reconnect = 0)
+  {
+    return send(message.c_str(), event, id, reconnect);
+  }
+  void close();
+
+  size_t count() const;
+  size_t avgPacketsWaiting() const;
+
+  bool canHandle(AsyncWebServerRequest *request) const override;
+  bool _takesConnection() const override { return true; }
+  void _adopt(AsyncWebServerRequest *request, NativeConnection *connection) override;
+
+  // Host internals, for clients
+  void _remove(AsyncEventSourceClient *client);
+
+private:
+  String _url;
+  ArEventHandlerFunction _connect;
+  ArEventHandlerFunction _disconnect;
+
+  // Taken before the server lock, never after it
+  mutable std::mutex _lock;
+  std::list<AsyncEventSourceClient *> _clients;
+};
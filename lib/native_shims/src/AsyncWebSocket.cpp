@@ -0,0 +1,441 @@
+#include "AsyncWebSocket.h"
+
+#include <strings.h>
+
+#include "NativeConnection.h"
+
+namespace
+{
+const char *HANDSHAKE_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// Larger frames from a client end the connection
+const size_t MAX_FRAME = 16384;
+const uint16_t CLOSE_TOO_BIG = 1009;
+
+uint32_t rotateLeft(uint32_t value, int bits)
+{
+  return (value << bits) | (value >> (32 - bits));
+}
+
+// SHA-1, for the handshake only
+void sha1(const std::string &text, uint8_t digest[20])
+{
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+  std::string message = text;
+  uint64_t bits = (uint64_t)text.size() * 8;
+  message += (char)0x80;
+  while (message.size() % 64 != 56)
+    message += (char)0;
+  for (int i = 7; i >= 0; i--)
+    message += (char)(bits >> (i * 8));
+
+  for (size_t block = 0; block < message.size(); block += 64)
+  {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++)
+    {
+      const uint8_t *p = (const uint8_t *)message.data() + block + i * 4;
+      w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    }
+    for (int i = 16; i < 80; i++)
+      w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++)
+    {
+      uint32_t f, k;
+      if (i < 20)
+      {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      }
+      else if (i < 40)
+      {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      }
+      else if (i < 60)
+      {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      }
+      else
+      {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rotateLeft(b, 30);
+      b = a;
+      a = temp;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  for (int i = 0; i < 20; i++)
+    digest[i] = h[i / 4] >> (24 - (i % 4) * 8);
+}
+
+std::string base64(const uint8_t *data, size_t len)
+{
+  static const char *ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  std::string encoded;
+  for (size_t i = 0; i < len; i += 3)
+  {
+    uint32_t group = (uint32_t)data[i] << 16;
+    if (i + 1 < len)
+      group |= (uint32_t)data[i + 1] << 8;
+    if (i + 2 < len)
+      group |= data[i + 2];
+
+    encoded += ALPHABET[(group >> 18) & 0x3F];
+    encoded += ALPHABET[(group >> 12) & 0x3F];
+    encoded += i + 1 < len ? ALPHABET[(group >> 6) & 0x3F] : '=';
+    encoded += i + 2 < len ? ALPHABET[group & 0x3F] : '=';
+  }
+  return encoded;
+}
+
+// A server frame: final, unmasked
+std::string buildFrame(uint8_t opcode, const uint8_t *data, size_t len)
+{
+  std::string frame;
+  frame += (char)(0x80 | opcode);
+  if (len < 126)
+  {
+    frame += (char)len;
+  }
+  else if (len <= 0xFFFF)
+  {
+    frame += (char)126;
+    frame += (char)(len >> 8);
+    frame += (char)len;
+  }
+  else
+  {
+    frame += (char)127;
+    for (int i = 7; i >= 0; i--)
+      frame += (char)((uint64_t)len >> (i * 8));
+  }
+  frame.append((const char *)data, len);
+  return frame;
+}
+} // namespace
+
+// ============================================================================
+// CLIENT
+// ============================================================================
+
+AwsClientStatus AsyncWebSocketClient::status() const
+{
+  std::lock_guard<std::recursive_mutex> lock(_connection->server->_lock);
+  if (_connection->closed)
+    return WS_DISCONNECTED;
+  return _connection->closing ? WS_DISCONNECTING : WS_CONNECTED;
+}
+
+void AsyncWebSocketClient::close(uint16_t code, const char *message)
+{
+  if (_closeSent.exchange(true))
+    return;
+
+  std::string payload;
+  if (code > 0)
+  {
+    payload += (char)(code >> 8);
+    payload += (char)code;
+    if (message != NULL)
+      payload += message;
+  }
+  _connection->enqueue(buildFrame(WS_DISCONNECT, (const uint8_t *)payload.data(), payload.size()), 0);
+  _connection->closeWhenSent();
+}
+
+void AsyncWebSocketClient::ping(const uint8_t *data, size_t len)
+{
+  _connection->enqueue(buildFrame(WS_PING, data, len), 0);
+}
+
+bool AsyncWebSocketClient::queueIsFull() const
+{
+  return _connection->queueFull(WS_MAX_QUEUED_MESSAGES);
+}
+
+size_t AsyncWebSocketClient::queueLen() const
+{
+  std::lock_guard<std::recursive_mutex> lock(_connection->server->_lock);
+  return _connection->queue.size();
+}
+
+bool AsyncWebSocketClient::send(uint8_t opcode, const uint8_t *data, size_t len)
+{
+  return _connection->enqueue(buildFrame(opcode, data, len), WS_MAX_QUEUED_MESSAGES);
+}
+
+void AsyncWebSocketClient::_received(const uint8_t *data, size_t len)
+{
+  _input.append((const char *)data, len);
+
+  while (_input.size() >= 2)
+  {
+    const uint8_t *head = (const uint8_t *)_input.data();
+    bool final = head[0] & 0x80;
+    uint8_t opcode = head[0] & 0x0F;
+    bool masked = head[1] & 0x80;
+    uint64_t length = head[1] & 0x7F;
+    size_t offset = 2;
+
+    if (length == 126)
+    {
+      if (_input.size() < 4)
+        return;
+      length = (uint64_t)head[2] << 8 | head[3];
+      offset = 4;
+    }
+    else if (length == 127)
+    {
+      if (_input.size() < 10)
+        return;
+      length = 0;
+      for (int i = 0; i < 8; i++)
+        length = length << 8 | head[2 + i];
+      offset = 10;
+    }
+
+    if (length > MAX_FRAME)
+    {
+      _input.clear();
+      close(CLOSE_TOO_BIG, "Frame too large");
+      return;
+    }
+
+    uint8_t mask[4] = {0, 0, 0, 0};
+    if (masked)
+    {
+      if (_input.size() < offset + 4)
+        return;
+      memcpy(mask, head + offset, 4);
+      offset += 4;
+    }
+
+    if (_input.size() < offset + length)
+      return;
+
+    std::string payload = _input.substr(offset, length);
+    _input.erase(0, offset + length);
+    for (size_t i = 0; i < payload.size(); i++)
+      payload[i] ^= mask[i % 4];
+
+    handleFrame(final, opcode, masked ? mask : NULL, payload);
+  }
+}
+
+void AsyncWebSocketClient::handleFrame(bool final, uint8_t opcode, const uint8_t *mask, std::string &payload)
+{
+  if (opcode == WS_TEXT || opcode == WS_BINARY || opcode == WS_CONTINUATION)
+  {
+    if (opcode != WS_CONTINUATION)
+    {
+      _messageOpcode = opcode;
+      _frameNumber = 0;
+    }
+
+    AwsFrameInfo info = {};
+    info.message_opcode = _messageOpcode;
+    info.num = _frameNumber++;
+    info.final = final;
+    info.masked = mask != NULL;
+    info.opcode = opcode;
+    info.len = payload.size();
+    if (mask != NULL)
+      memcpy(info.mask, mask, 4);
+    info.index = 0;
+
+    // The payload stays NUL-terminated, as the library leaves text frames
+    _server->_event(this, WS_EVT_DATA, &info, (uint8_t *)&payload[0], payload.size());
+  }
+  else if (opcode == WS_DISCONNECT)
+  {
+    // Answer with the same status code, then hang up
+    uint16_t code = payload.size() >= 2 ? (uint8_t)payload[0] << 8 | (uint8_t)payload[1] : 0;
+    close(code);
+    _connection->closeWhenSent();
+  }
+  else if (opcode == WS_PING)
+  {
+    _connection->enqueue(buildFrame(WS_PONG, (const uint8_t *)payload.data(), payload.size()), 0);
+    _server->_event(this, WS_EVT_PING, NULL, (uint8_t *)&payload[0], payload.size());
+  }
+  else if (opcode == WS_PONG)
+  {
+    _server->_event(this, WS_EVT_PONG, NULL, (uint8_t *)&payload[0], payload.size());
+  }
+}
+
+void AsyncWebSocketClient::_closed()
+{
+  _server->_remove(this);
+  delete this;
+}
+
+// ============================================================================
+// SERVER
+// ============================================================================
+
+AsyncWebSocket::~AsyncWebSocket()
+{
+  closeAll();
+}
+
+size_t AsyncWebSocket::count() const
+{
+  std::lock_guard<std::mutex> lock(_lock);
+  size_t connected = 0;
+  for (std::list<AsyncWebSocketClient *>::const_iterator it = _clients.begin(); it != _clients.end(); ++it)
+  {
+    if ((*it)->status() == WS_CONNECTED)
+      connected++;
+  }
+  return connected;
+}
+
+bool AsyncWebSocket::hasClient(uint32_t id)
+{
+  std::lock_guard<std::mutex> lock(_lock);
+  return find(id) != NULL;
+}
+
+bool AsyncWebSocket::availableForWrite(uint32_t id)
+{
+  std::lock_guard<std::mutex> lock(_lock);
+  AsyncWebSocketClient *client = find(id);
+  return client != NULL && client->canSend();
+}
+
+void AsyncWebSocket::close(uint32_t id, uint16_t code, const char *message)
+{
+  std::lock_guard<std::mutex> lock(_lock);
+  AsyncWebSocketClient *client = find(id);
+  if (client != NULL)
+    client->close(code, message);
+}
+
+void AsyncWebSocket::closeAll(uint16_t code, const char *message)
+{
+  std::lock_guard<std::mutex> lock(_lock);
+  for (std::list<AsyncWebSocketClient *>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+    (*it)->close(code, message);
+}
+
+bool AsyncWebSocket::text(uint32_t id, const char *message)
+{
+  std::lock_guard<std::mutex> lock(_lock);
+  AsyncWebSocketClient *client = find(id);
+  return client != NULL && client->text(message);
+}
+
+bool AsyncWebSocket::binary(uint32_t id, const uint8_t *message, size_t len)
+{
+  std::lock_guard<std::mutex> lock(_lock);
+  AsyncWebSocketClient *client = find(id);
+  return client != NULL && client->binary(message, len);
+}
+
+void AsyncWebSocket::textAll(const char *message)
+{
+  std::lock_guard<std::mutex> lock(_lock);
+  for (std::list<AsyncWebSocketClient *>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+    (*it)->text(message);
+}
+
+void AsyncWebSocket::binaryAll(const uint8_t *message, size_t len)
+{
+  std::lock_guard<std::mutex> lock(_lock);
+  for (std::list<AsyncWebSocketClient *>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+    (*it)->binary(message, len);
+}
+
+void AsyncWebSocket::cleanupClients(uint16_t maxClients)
+{
+  std::lock_guard<std::mutex> lock(_lock);
+  size_t connected = 0;
+  for (std::list<AsyncWebSocketClient *>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+  {
+    if ((*it)->status() == WS_CONNECTED)
+      connected++;
+  }
+
+  // Oldest first
+  for (std::list<AsyncWebSocketClient *>::iterator it = _clients.begin();
+       it != _clients.end() && connected > maxClients; ++it)
+  {
+    if ((*it)->status() != WS_CONNECTED)
+      continue;
+    (*it)->close();
+    connected--;
+  }
+}
+
+bool AsyncWebSocket::canHandle(AsyncWebServerRequest *request) const
+{
+  return request->method() == HTTP_GET && request->url() == _url &&
+         strcasecmp(request->header("Upgrade").c_str(), "websocket") == 0 &&
+         request->hasHeader("Sec-WebSocket-Key");
+}
+
+// On the server thread, which is also the only one that removes clients,
+// so the client is safe to hand to the event handler without the lock
+void AsyncWebSocket::_adopt(AsyncWebServerRequest *request, NativeConnection *connection)
+{
+  uint8_t digest[20];
+  sha1(std::string(request->header("Sec-WebSocket-Key").c_str()) + HANDSHAKE_GUID, digest);
+  connection->enqueue("HTTP/1.1 101 Switching Protocols\r\n"
+                      "Upgrade: websocket\r\n"
+                      "Connection: Upgrade\r\n"
+                      "Sec-WebSocket-Accept: " +
+                          base64(digest, sizeof(digest)) + "\r\n\r\n",
+                      0);
+
+  AsyncWebSocketClient *client;
+  {
+    std::lock_guard<std::mutex> lock(_lock);
+    client = new AsyncWebSocketClient(this, connection, _nextId++);
+    _clients.push_back(client);
+  }
+  connection->owner = client;
+
+  _event(client, WS_EVT_CONNECT, request, NULL, 0);
+}
+
+void AsyncWebSocket::_event(AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+{
+  if (_handler)
+    _handler(this, client, type, arg, data, len);
+}
+
+void AsyncWebSocket::_remove(AsyncWebSocketClient *client)
+{
+  {
+    std::lock_guard<std::mutex> lock(_lock);
+    _clients.remove(client);
+  }
+  _event(client, WS_EVT_DISCONNECT, NULL, NULL, 0);
+}
+
+AsyncWebSocketClient *AsyncWebSocket::find(uint32_t id)
+{
+  for (std::list<AsyncWebSocketClient *>::iterator it = _clients.begin(); it != _clients.end(); ++it)
+  {
+    if ((*it)->id() == id)
+      return *it;
+  }
+  return NULL;
+}
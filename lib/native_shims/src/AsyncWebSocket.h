@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+
+#include "ESPAsyncWebServer.h"
+
+// ============================================================================
+// WEBSOCKET (HOST)
+// ============================================================================
+//
+// RFC 6455 websockets over the host web server: the handshake, masked
+// frames from the client, pings answered with pongs and the closing
+// handshake. Data frames reach the event handler whole, with index 0, as
+// the library delivers frames that fit one TCP segment. Each client queues
+// at most WS_MAX_QUEUED_MESSAGES messages; sends beyond that are dropped.
+
+#define WS_MAX_QUEUED_MESSAGES 32
+#define DEFAULT_MAX_WS_CLIENTS 8
+
+class AsyncWebSocket;
+struct NativeConnection;
+
+enum AwsEventType
+{
+  WS_EVT_CONNECT,
+  WS_EVT_DISCONNECT,
+  WS_EVT_PING,
+  WS_EVT_PONG,
+  WS_EVT_ERROR,
+  WS_EVT_DATA
+};
+
+enum AwsFrameType
+{
+  WS_CONTINUATION = 0x00,
+  WS_TEXT = 0x01,
+  WS_BINARY = 0x02,
+  WS_DISCONNECT = 0x08,
+  WS_PING = 0x09,
+  WS_PONG = 0x0A
+};
+
+enum AwsClientStatus
+{
+  WS_DISCONNECTED,
+  WS_CONNECTED,
+  WS_DISCONNECTING
+};
+
+typedef struct
+{
+  uint8_t message_opcode; // of the message this frame belongs to
+  uint32_t num;           // frame number within the message
+  uint8_t final;
+  uint8_t masked;
+  uint8_t opcode;
+  uint64_t len;
+  uint8_t mask[4];
+  uint64_t index; // of this piece within the frame
+} AwsFrameInfo;
+
+class AsyncWebSocketClient : public NativeConnectionOwner
+{
+public:
+  AsyncWebSocketClient(AsyncWebSocket *server, NativeConnection *connection, uint32_t id)
+      : _server(server), _connection(connection), _id(id) {}
+
+  uint32_t id() const { return _id; }
+  AwsClientStatus status() const;
+  AsyncWebSocket *server() { return _server; }
+
+  void close(uint16_t code = 0, const char *message = NULL);
+  void ping(const uint8_t *data = NULL, size_t len = 0);
+
+  bool queueIsFull() const;
+  size_t queueLen() const;
+  bool canSend() const { return !queueIsFull(); }
+
+  bool text(const char *message) { return text(message, strlen(message)); }
+  bool text(const char *message, size_t len) { return send(WS_TEXT, (const uint8_t *)message, len); }
+  bool text(const String &message) { return text(message.c_str(), message.length()); }
+  bool binary(const uint8_t *message, size_t len) { return send(WS_BINARY, message, len); }
+
+  // Host internals
+  void _received(const uint8_t *data, size_t len) override;
+  void _closed() override;
+
+private:
+  bool send(uint8_t opcode, const uint8_t *data, size_t len);
+  void handleFrame(bool final, uint8_t opcode, const uint8_t *mask, std::string &payload);
+
+  AsyncWebSocket *_server;
+  NativeConnection *_connection;
+  uint32_t _id;
+
+  // Server thread only
+  std::string _input;
+  uint8_t _messageOpcode = WS_TEXT;
+  uint32_t _frameNumber = 0;
+
+  std::atomic<bool> _closeSent{false};
+};
+
+typedef std::function<void(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg,
+                           uint8_t *data, size_t len)>
+    AwsEventHandler;
+
+class AsyncWebSocket : public AsyncWebHandler
+{
+public:
+  explicit AsyncWebSocket(const String &url) : _url(url) {}
+  ~AsyncWebSocket();
+
+  const char *url() const { return _url.c_str(); }
+
+  // Runs on the server thread
+  void onEvent(AwsEventHandler handler) { _handler = handler; }
+
+  // Clients are looked up by id under the lock, so these are safe from any
+  // task even while the client disconnects
+  size_t count() const;
+  bool hasClient(uint32_t id);
+  bool availableForWrite(uint32_t id);
+  void close(uint32_t id, uint16_t code = 0, const char *message = NULL);
+  void closeAll(uint16_t code = 0, const char *message = NULL);
+  bool text(uint32_t id, const char *message);
+  bool text(uint32_t id, const String &message) { return text(id, message.c_str()); }
+  bool binary(uint32_t id, const uint8_t *message, size_t len);
+  void textAll(const char *message);
+  void binaryAll(const uint8_t *message, size_t len);
+
+  // Closes the oldest clients beyond maxClients
+  void cleanupClients(uint16_t maxClients = DEFAULT_MAX_WS_CLIENTS);
+
+  bool canHandle(AsyncWebServerRequest *request) const override;
+  bool _takesConnection() const override { return true; }
+  void _adopt(AsyncWebServerRequest *request, NativeConnection *connection) override;
+
+  // Host internals, for clients
+  void _event(AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len);
+  void _remove(AsyncWebSocketClient *client);
+
+private:
+  AsyncWebSocketClient *find(uint32_t id);
+
+  String _url;
+  AwsEventHandler _handler;
+
+  // Taken before the server lock, never after it
+  mutable std::mutex _lock;
+  std::list<AsyncWebSocketClient *> _clients;
+  uint32_t _nextId = 1;
+};
@@ -0,0 +1,1012 @@
+#include "ESPAsyncWebServer.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "NativeConnection.h"
+
+namespace
+{
+// What the device's lwIP allows (CONFIG_LWIP_MAX_ACTIVE_TCP) and buffers per
+// connection (CONFIG_TCP_SND_BUF_DEFAULT)
+const size_t MAX_CONNECTIONS = 16;
+const size_t SEND_BUFFER = 5744;
+
+// Body handlers get the body in pieces of at most one TCP segment
+const size_t BODY_CHUNK = 1436;
+
+const size_t RECEIVE_BUFFER = 4096;
+const size_t HEAD_MAX = 8192;
+const size_t CHUNK_OVERHEAD = 16; // size line, CRLF and the last chunk
+const int LISTEN_BACKLOG = 16;
+
+const int IDLE_POLL_MS = 1000;
+const int RETRY_POLL_MS = 5; // a filler answered RESPONSE_TRY_AGAIN
+
+const char *reasonPhrase(int code)
+{
+  switch (code)
+  {
+  case 101: return "Switching Protocols";
+  case 200: return "OK";
+  case 204: return "No Content";
+  case 304: return "Not Modified";
+  case 400: return "Bad Request";
+  case 404: return "Not Found";
+  case 409: return "Conflict";
+  case 411: return "Length Required";
+  case 413: return "Payload Too Large";
+  case 431: return "Request Header Fields Too Large";
+  case 500: return "Internal Server Error";
+  case 501: return "Not Implemented";
+  case 503: return "Service Unavailable";
+  default: return "";
+  }
+}
+
+int hexValue(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+std::string urlDecode(const std::string &text, bool plusIsSpace)
+{
+  std::string decoded;
+  decoded.reserve(text.size());
+  for (size_t i = 0; i < text.size(); i++)
+  {
+    char c = text[i];
+    if (c == '%' && i + 2 < text.size() && hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0)
+    {
+      decoded += (char)(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2]));
+      i += 2;
+    }
+    else
+    {
+      decoded += (c == '+' && plusIsSpace) ? ' ' : c;
+    }
+  }
+  return decoded;
+}
+
+void parseParams(const std::string &query, std::vector<AsyncWebParameter> &params)
+{
+  size_t start = 0;
+  while (start < query.size())
+  {
+    size_t end = query.find('&', start);
+    if (end == std::string::npos)
+      end = query.size();
+
+    std::string field = query.substr(start, end - start);
+    if (!field.empty())
+    {
+      size_t equals = field.find('=');
+      std::string name = field.substr(0, equals);
+      std::string value = equals == std::string::npos ? "" : field.substr(equals + 1);
+      params.push_back(AsyncWebParameter(urlDecode(name, true), urlDecode(value, true)));
+    }
+    start = end + 1;
+  }
+}
+
+WebRequestMethodComposite parseMethod(const std::string &name)
+{
+  if (name == "GET")
+    return HTTP_GET;
+  if (name == "POST")
+    return HTTP_POST;
+  if (name == "DELETE")
+    return HTTP_DELETE;
+  if (name == "PUT")
+    return HTTP_PUT;
+  if (name == "PATCH")
+    return HTTP_PATCH;
+  if (name == "HEAD")
+    return HTTP_HEAD;
+  if (name == "OPTIONS")
+    return HTTP_OPTIONS;
+  return 0;
+}
+
+std::string trim(const std::string &text)
+{
+  size_t start = text.find_first_not_of(" \t");
+  if (start == std::string::npos)
+    return "";
+  size_t end = text.find_last_not_of(" \t");
+  return text.substr(start, end - start + 1);
+}
+
+// ============================================================================
+// RESPONSE TYPES
+// ============================================================================
+
+// A body held in RAM
+class BasicResponse : public AsyncWebServerResponse
+{
+public:
+  BasicResponse(int code, const char *contentType, const String &content)
+      : AsyncWebServerResponse(code, contentType), _content(content.c_str(), content.length())
+  {
+    _contentLength = _content.size();
+  }
+
+  size_t _fill(uint8_t *buffer, size_t maxLen, size_t index) override
+  {
+    size_t len = std::min(maxLen, _content.size() - index);
+    memcpy(buffer, _content.data() + index, len);
+    return len;
+  }
+
+private:
+  std::string _content;
+};
+
+// A body read in place, like the library's PROGMEM responses
+class ProgmemResponse : public AsyncWebServerResponse
+{
+public:
+  ProgmemResponse(int code, const char *contentType, const uint8_t *content, size_t len)
+      : AsyncWebServerResponse(code, contentType), _content(content)
+  {
+    _contentLength = len;
+  }
+
+  size_t _fill(uint8_t *buffer, size_t maxLen, size_t index) override
+  {
+    size_t len = std::min(maxLen, _contentLength - index);
+    memcpy(buffer, _content + index, len);
+    return len;
+  }
+
+private:
+  const uint8_t *_content;
+};
+
+// A body pulled from a filler; SIZE_MAX as the length means chunked
+class CallbackResponse : public AsyncWebServerResponse
+{
+public:
+  CallbackResponse(const char *contentType, size_t len, AwsResponseFiller filler)
+      : AsyncWebServerResponse(200, contentType), _filler(filler)
+  {
+    _contentLength = len;
+  }
+
+  size_t _fill(uint8_t *buffer, size_t maxLen, size_t index) override
+  {
+    return _filler ? _filler(buffer, maxLen, index) : 0;
+  }
+
+private:
+  AwsResponseFiller _filler;
+};
+} // namespace
+
+// ============================================================================
+// RESPONSES
+// ============================================================================
+
+AsyncWebServerResponse::AsyncWebServerResponse(int code, const char *contentType)
+    : _code(code), _contentType(contentType != NULL ? contentType : "")
+{
+}
+
+String AsyncWebServerResponse::_head(bool http11) const
+{
+  bool hasBody = _code >= 200 && _code != 204 && _code != 304;
+
+  std::string head = http11 ? "HTTP/1.1 " : "HTTP/1.0 ";
+  head += std::to_string(_code) + " " + reasonPhrase(_code) + "\r\n";
+  if (hasBody && !_contentType.isEmpty())
+    head += std::string("Content-Type: ") + _contentType.c_str() + "\r\n";
+  if (hasBody && !_chunked())
+    head += "Content-Length: " + std::to_string(_contentLength) + "\r\n";
+  else if (hasBody && http11)
+    head += "Transfer-Encoding: chunked\r\n";
+  head += "Connection: close\r\n";
+  for (size_t i = 0; i < _headers.size(); i++)
+    head += std::string(_headers[i].name().c_str()) + ": " + _headers[i].value().c_str() + "\r\n";
+  head += "\r\n";
+  return String(head);
+}
+
+AsyncResponseStream::AsyncResponseStream(const char *contentType, size_t bufferSize)
+    : AsyncWebServerResponse(200, contentType)
+{
+  _body.reserve(bufferSize);
+}
+
+size_t AsyncResponseStream::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t AsyncResponseStream::write(const uint8_t *data, size_t len)
+{
+  _body.append((const char *)data, len);
+  _contentLength = _body.size();
+  return len;
+}
+
+size_t AsyncResponseStream::_fill(uint8_t *buffer, size_t maxLen, size_t index)
+{
+  size_t len = std::min(maxLen, _body.size() - index);
+  memcpy(buffer, _body.data() + index, len);
+  return len;
+}
+
+// ============================================================================
+// REQUESTS
+// ============================================================================
+
+AsyncWebServerRequest::~AsyncWebServerRequest()
+{
+  free(_tempObject);
+  delete _response;
+}
+
+bool AsyncWebServerRequest::hasParam(const char *name, bool post, bool file) const
+{
+  return getParam(name, post, file) != NULL;
+}
+
+const AsyncWebParameter *AsyncWebServerRequest::getParam(const char *name, bool post, bool file) const
+{
+  for (size_t i = 0; i < _params.size(); i++)
+  {
+    if (_params[i].name() == name)
+      return &_params[i];
+  }
+  return NULL;
+}
+
+bool AsyncWebServerRequest::hasHeader(const char *name) const
+{
+  return getHeader(name) != NULL;
+}
+
+const AsyncWebHeader *AsyncWebServerRequest::getHeader(const char *name) const
+{
+  for (size_t i = 0; i < _headers.size(); i++)
+  {
+    if (strcasecmp(_headers[i].name().c_str(), name) == 0)
+      return &_headers[i];
+  }
+  return NULL;
+}
+
+String AsyncWebServerRequest::header(const char *name) const
+{
+  const AsyncWebHeader *found = getHeader(name);
+  return found != NULL ? found->value() : String();
+}
+
+// The first response wins; later ones, and any for a client that has gone,
+// are dropped
+void AsyncWebServerRequest::send(AsyncWebServerResponse *response)
+{
+  if (response == NULL)
+    return;
+
+  {
+    std::lock_guard<std::recursive_mutex> lock(_server->_lock);
+    if (!_sent && _connection != NULL)
+    {
+      _response = response;
+      _sent = true;
+      _server->_wake();
+      return;
+    }
+  }
+  delete response;
+}
+
+void AsyncWebServerRequest::send(int code, const char *contentType, const char *content)
+{
+  send(beginResponse(code, contentType, content));
+}
+
+void AsyncWebServerRequest::send(int code, const char *contentType, const String &content)
+{
+  send(beginResponse(code, contentType, content));
+}
+
+void AsyncWebServerRequest::send(int code, const String &contentType, const String &content)
+{
+  send(beginResponse(code, contentType.c_str(), content));
+}
+
+void AsyncWebServerRequest::send(int code, const char *contentType, const uint8_t *content, size_t len,
+                                 AwsTemplateProcessor callback)
+{
+  send(beginResponse(code, contentType, content, len, callback));
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(int code, const char *contentType, const char *content)
+{
+  return new BasicResponse(code, contentType, content);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(int code, const char *contentType, const String &content)
+{
+  return new BasicResponse(code, contentType, content);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(int code, const char *contentType, const uint8_t *content,
+                                                             size_t len, AwsTemplateProcessor callback)
+{
+  return new ProgmemResponse(code, contentType, content, len);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(const char *contentType, size_t len,
+                                                             AwsResponseFiller callback,
+                                                             AwsTemplateProcessor templateCallback)
+{
+  return new CallbackResponse(contentType, len, callback);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginChunkedResponse(const char *contentType, AwsResponseFiller callback,
+                                                                    AwsTemplateProcessor templateCallback)
+{
+  return new CallbackResponse(contentType, SIZE_MAX, callback);
+}
+
+AsyncResponseStream *AsyncWebServerRequest::beginResponseStream(const char *contentType, size_t bufferSize)
+{
+  return new AsyncResponseStream(contentType, bufferSize);
+}
+
+AsyncWebServerRequestPtr AsyncWebServerRequest::pause()
+{
+  std::lock_guard<std::recursive_mutex> lock(_server->_lock);
+  _paused = true;
+  return _self;
+}
+
+// ============================================================================
+// HANDLERS
+// ============================================================================
+
+bool AsyncCallbackWebHandler::canHandle(AsyncWebServerRequest *request) const
+{
+  if (!(_method & request->method()))
+    return false;
+
+  if (_uri.endsWith("*"))
+    return request->url().startsWith(_uri.substring(0, _uri.length() - 1));
+  return request->url() == _uri || request->url().startsWith(_uri + "/");
+}
+
+void AsyncCallbackWebHandler::handleRequest(AsyncWebServerRequest *request)
+{
+  if (_onRequest)
+    _onRequest(request);
+  else
+    request->send(500);
+}
+
+void AsyncCallbackWebHandler::handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index,
+                                         size_t total)
+{
+  if (_onBody)
+    _onBody(request, data, len, index, total);
+}
+
+// ============================================================================
+// CONNECTIONS
+// ============================================================================
+
+bool NativeConnection::enqueue(const std::string &message, size_t limit)
+{
+  std::lock_guard<std::recursive_mutex> lock(server->_lock);
+  if (closed || closing || (limit > 0 && queue.size() >= limit))
+    return false;
+
+  queue.push_back(message);
+  queuedBytes += message.size();
+  server->_wake();
+  return true;
+}
+
+bool NativeConnection::queueFull(size_t limit)
+{
+  std::lock_guard<std::recursive_mutex> lock(server->_lock);
+  return closed || closing || queue.size() >= limit;
+}
+
+void NativeConnection::closeWhenSent()
+{
+  std::lock_guard<std::recursive_mutex> lock(server->_lock);
+  closing = true;
+  server->_wake();
+}
+
+// ============================================================================
+// SERVER
+// ============================================================================
+
+AsyncWebServer::~AsyncWebServer()
+{
+  end();
+}
+
+void AsyncWebServer::begin()
+{
+  if (_running)
+    return;
+
+  // Loopback only: the host build is for tests, not for the network
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(_port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  int listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int reuse = 1;
+  int wake[2];
+  if (listener < 0 || setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+      bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, LISTEN_BACKLOG) != 0 ||
+      pipe2(wake, O_NONBLOCK | O_CLOEXEC) != 0)
+  {
+    Serial.printf("ERROR: Web server cannot listen on port %u: %s\n", (unsigned)_port, strerror(errno));
+    if (listener >= 0)
+      ::close(listener);
+    return;
+  }
+
+  _listener = listener;
+  _wakeRead = wake[0];
+  _wakeWrite = wake[1];
+  _running = true;
+  _thread = std::thread(&AsyncWebServer::run, this);
+}
+
+void AsyncWebServer::end()
+{
+  if (!_running)
+    return;
+
+  _running = false;
+  _wake();
+  _thread.join();
+
+  while (!_connections.empty())
+    close(_connections.front());
+
+  ::close(_listener);
+  ::close(_wakeRead);
+  ::close(_wakeWrite);
+  _listener = -1;
+  _wakeRead = -1;
+  _wakeWrite = -1;
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest)
+{
+  return on(uri, method, onRequest, NULL, NULL);
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload)
+{
+  return on(uri, method, onRequest, onUpload, NULL);
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload,
+                                            ArBodyHandlerFunction onBody)
+{
+  AsyncCallbackWebHandler *handler = new AsyncCallbackWebHandler(uri, method);
+  handler->onRequest(onRequest);
+  handler->onUpload(onUpload);
+  handler->onBody(onBody);
+  _callbackHandlers.push_back(std::unique_ptr<AsyncCallbackWebHandler>(handler));
+  addHandler(handler);
+  return *handler;
+}
+
+AsyncWebHandler &AsyncWebServer::addHandler(AsyncWebHandler *handler)
+{
+  _handlers.push_back(handler);
+  return *handler;
+}
+
+NativeServerStats AsyncWebServer::stats()
+{
+  std::lock_guard<std::recursive_mutex> lock(_lock);
+  return _stats;
+}
+
+void AsyncWebServer::_wake()
+{
+  if (_wakeWrite < 0)
+    return;
+
+  // A full pipe already holds a wake-up
+  char c = 0;
+  ssize_t written = write(_wakeWrite, &c, 1);
+  (void)written;
+}
+
+// ============================================================================
+// SERVER THREAD
+// ============================================================================
+
+// Plays AsyncTCP's task: everything below runs on the server thread, which
+// alone adds and removes connections
+void AsyncWebServer::run()
+{
+  std::vector<pollfd> fds;
+  std::vector<NativeConnection *> polled;
+
+  while (_running)
+  {
+    // Answers sent from other tasks, response bodies and queued messages
+    bool retry = false;
+    std::vector<NativeConnection *> connections(_connections.begin(), _connections.end());
+    for (size_t i = 0; i < connections.size(); i++)
+    {
+      if (pump(connections[i]))
+        retry = true;
+    }
+    measure();
+
+    fds.clear();
+    polled.clear();
+    fds.push_back({_listener, POLLIN, 0});
+    fds.push_back({_wakeRead, POLLIN, 0});
+    {
+      std::lock_guard<std::recursive_mutex> lock(_lock);
+      for (std::list<NativeConnection *>::iterator it = _connections.begin(); it != _connections.end(); ++it)
+      {
+        NativeConnection *connection = *it;
+        short events = POLLIN;
+        if (!connection->out.empty())
+          events |= POLLOUT;
+        fds.push_back({connection->fd, events, 0});
+        polled.push_back(connection);
+      }
+    }
+
+    if (poll(fds.data(), fds.size(), retry ? RETRY_POLL_MS : IDLE_POLL_MS) <= 0)
+      continue;
+
+    if (fds[1].revents & POLLIN)
+    {
+      char drain[64];
+      while (read(_wakeRead, drain, sizeof(drain)) > 0)
+      {
+      }
+    }
+
+    for (size_t i = 0; i < polled.size(); i++)
+    {
+      if (fds[i + 2].revents != 0)
+        service(polled[i], fds[i + 2].revents);
+    }
+
+    if (fds[0].revents & POLLIN)
+      accept();
+  }
+}
+
+void AsyncWebServer::accept()
+{
+  while (true)
+  {
+    int fd = accept4(_listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;
+
+    if (_connections.size() >= MAX_CONNECTIONS)
+    {
+      ::close(fd);
+      std::lock_guard<std::recursive_mutex> lock(_lock);
+      _stats.refused++;
+      continue;
+    }
+
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    std::lock_guard<std::recursive_mutex> lock(_lock);
+    _connections.push_back(new NativeConnection(this, fd));
+    _stats.connections = _connections.size();
+    if (_stats.connections > _stats.peakConnections)
+      _stats.peakConnections = _stats.connections;
+  }
+}
+
+void AsyncWebServer::service(NativeConnection *connection, short events)
+{
+  if (events & (POLLERR | POLLNVAL))
+  {
+    close(connection);
+    return;
+  }
+
+  if (events & (POLLIN | POLLHUP))
+  {
+    uint8_t buffer[RECEIVE_BUFFER];
+    ssize_t received = recv(connection->fd, buffer, sizeof(buffer), 0);
+    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+    {
+      close(connection);
+      return;
+    }
+
+    if (received > 0)
+    {
+      if (connection->state == NativeConnection::KEPT)
+      {
+        if (connection->owner != NULL)
+          connection->owner->_received(buffer, received);
+      }
+      else if (connection->state == NativeConnection::READING_HEAD ||
+               connection->state == NativeConnection::READING_BODY)
+      {
+        connection->in.append((const char *)buffer, received);
+        parse(connection);
+      }
+      // Anything after the request is ignored; the connection closes after
+      // the response
+    }
+  }
+
+  if ((events & POLLOUT) && !flush(connection))
+    close(connection);
+}
+
+void AsyncWebServer::parse(NativeConnection *connection)
+{
+  if (connection->state == NativeConnection::READING_HEAD)
+  {
+    size_t end = connection->in.find("\r\n\r\n");
+    if (end == std::string::npos)
+    {
+      if (connection->in.size() > HEAD_MAX)
+        reject(connection, 431);
+      return;
+    }
+
+    std::string head = connection->in.substr(0, end);
+    connection->in.erase(0, end + 4);
+    if (!readHead(connection, head))
+      return;
+  }
+
+  if (connection->state != NativeConnection::READING_BODY)
+    return;
+
+  AsyncWebServerRequest *request = connection->request.get();
+  size_t total = request->_contentLength;
+  while (!connection->in.empty() && connection->bodyIndex < total)
+  {
+    size_t len = std::min(std::min(connection->in.size(), BODY_CHUNK), total - connection->bodyIndex);
+    std::string chunk = connection->in.substr(0, len);
+    connection->in.erase(0, len);
+
+    if (connection->form)
+      connection->formBody += chunk;
+    else if (connection->handler != NULL)
+      connection->handler->handleBody(request, (uint8_t *)&chunk[0], len, connection->bodyIndex, total);
+    connection->bodyIndex += len;
+  }
+
+  if (connection->bodyIndex == total)
+  {
+    if (connection->form)
+      parseParams(connection->formBody, request->_params);
+    dispatch(connection);
+  }
+}
+
+// Builds the request from its head and picks its handler. False if the
+// request was rejected or handed to a handler that keeps the connection.
+bool AsyncWebServer::readHead(NativeConnection *connection, const std::string &head)
+{
+  AsyncWebServerRequestSharedPtr request(new AsyncWebServerRequest());
+  request->_self = request;
+  request->_server = this;
+  request->_connection = connection;
+  connection->request = request;
+
+  size_t lineEnd = head.find("\r\n");
+  std::string requestLine = head.substr(0, lineEnd);
+  size_t methodEnd = requestLine.find(' ');
+  size_t targetEnd = requestLine.rfind(' ');
+  if (methodEnd == std::string::npos || targetEnd <= methodEnd)
+  {
+    reject(connection, 400);
+    return false;
+  }
+
+  std::string version = requestLine.substr(targetEnd + 1);
+  request->_http11 = version != "HTTP/1.0";
+  request->_method = parseMethod(requestLine.substr(0, methodEnd));
+  if (request->_method == 0)
+  {
+    reject(connection, 501);
+    return false;
+  }
+
+  std::string target = requestLine.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+  size_t query = target.find('?');
+  request->_url = urlDecode(target.substr(0, query), false);
+  if (query != std::string::npos)
+    parseParams(target.substr(query + 1), request->_params);
+
+  while (lineEnd != std::string::npos)
+  {
+    size_t start = lineEnd + 2;
+    lineEnd = head.find("\r\n", start);
+    std::string line = head.substr(start, lineEnd == std::string::npos ? std::string::npos : lineEnd - start);
+    size_t colon = line.find(':');
+    if (colon == std::string::npos)
+      continue;
+    request->_headers.push_back(AsyncWebHeader(trim(line.substr(0, colon)), trim(line.substr(colon + 1))));
+  }
+
+  if (request->hasHeader("Transfer-Encoding"))
+  {
+    reject(connection, 411);
+    return false;
+  }
+  request->_contentType = request->header("Content-Type");
+  request->_contentLength = strtoul(request->header("Content-Length").c_str(), NULL, 10);
+
+  for (size_t i = 0; i < _handlers.size() && connection->handler == NULL; i++)
+  {
+    if (_handlers[i]->canHandle(request.get()))
+      connection->handler = _handlers[i];
+  }
+
+  if (connection->handler != NULL && connection->handler->_takesConnection())
+  {
+    {
+      std::lock_guard<std::recursive_mutex> lock(_lock);
+      _stats.requests++;
+    }
+    connection->state = NativeConnection::KEPT;
+    connection->in.clear();
+    connection->handler->_adopt(request.get(), connection);
+    return false;
+  }
+
+  connection->form = request->_contentType.startsWith("application/x-www-form-urlencoded");
+  if (request->_contentLength > 0)
+  {
+    connection->state = NativeConnection::READING_BODY;
+    return true;
+  }
+
+  dispatch(connection);
+  return false;
+}
+
+void AsyncWebServer::dispatch(NativeConnection *connection)
+{
+  AsyncWebServerRequest *request = connection->request.get();
+  if (connection->handler != NULL)
+    connection->handler->handleRequest(request);
+  else if (_notFound)
+    _notFound(request);
+  else
+    request->send(404);
+
+  AsyncWebServerResponse *response;
+  bool paused;
+  {
+    std::lock_guard<std::recursive_mutex> lock(_lock);
+    _stats.requests++;
+    response = request->_response;
+    request->_response = NULL;
+    paused = request->_paused;
+
+    // Neither answered nor paused: later sends are dropped
+    if (response == NULL && !paused)
+      request->_sent = true;
+  }
+
+  if (response != NULL)
+    respond(connection, response);
+  else if (paused)
+    connection->state = NativeConnection::WAITING;
+  else
+    reject(connection, 500);
+}
+
+void AsyncWebServer::respond(NativeConnection *connection, AsyncWebServerResponse *response)
+{
+  AsyncWebServerRequest *request = connection->request.get();
+  int code = response->code();
+
+  connection->response = response;
+  connection->out += response->_head(request->_http11).c_str();
+  connection->fillIndex = 0;
+  connection->bodyDone = request->_method == HTTP_HEAD || code < 200 || code == 204 || code == 304;
+  connection->state = NativeConnection::WRITING;
+}
+
+void AsyncWebServer::reject(NativeConnection *connection, int code)
+{
+  if (!connection->request)
+  {
+    connection->request.reset(new AsyncWebServerRequest());
+    connection->request->_server = this;
+  }
+  respond(connection, new BasicResponse(code, "text/plain", reasonPhrase(code)));
+}
+
+// Moves whatever is ready towards the socket and closes finished
+// connections. True if a filler asked to be called again.
+bool AsyncWebServer::pump(NativeConnection *connection)
+{
+  if (connection->state == NativeConnection::WAITING)
+  {
+    AsyncWebServerResponse *response;
+    {
+      std::lock_guard<std::recursive_mutex> lock(_lock);
+      response = connection->request->_response;
+      connection->request->_response = NULL;
+    }
+    if (response != NULL)
+      respond(connection, response);
+  }
+
+  // Refills as long as the socket takes everything, so a long body or a
+  // backlog of messages doesn't wait a poll timeout per buffer
+  bool retry = false;
+  bool finished = false;
+  bool more = false;
+  do
+  {
+    if (connection->state == NativeConnection::WRITING)
+    {
+      retry = fill(connection);
+      finished = connection->bodyDone;
+      more = !finished && !retry;
+    }
+    else if (connection->state == NativeConnection::KEPT)
+    {
+      std::lock_guard<std::recursive_mutex> lock(_lock);
+      while (!connection->queue.empty() && connection->out.size() < SEND_BUFFER)
+      {
+        connection->out += connection->queue.front();
+        connection->queuedBytes -= connection->queue.front().size();
+        connection->queue.pop_front();
+      }
+      finished = connection->closing && connection->queue.empty();
+      more = !connection->queue.empty();
+    }
+
+    if (!flush(connection) || (finished && connection->out.empty()))
+    {
+      close(connection);
+      return false;
+    }
+  } while (more && connection->out.empty());
+  return retry;
+}
+
+// Pulls the response body until the send buffer is full
+bool AsyncWebServer::fill(NativeConnection *connection)
+{
+  static thread_local uint8_t buffer[SEND_BUFFER];
+
+  AsyncWebServerResponse *response = connection->response;
+  bool chunked = response->_chunked();
+  bool framed = chunked && connection->request->_http11;
+
+  while (!connection->bodyDone && connection->out.size() < SEND_BUFFER)
+  {
+    if (!chunked && connection->fillIndex >= response->_length())
+    {
+      connection->bodyDone = true;
+      break;
+    }
+
+    size_t room = SEND_BUFFER - connection->out.size();
+    if (framed)
+    {
+      if (room <= CHUNK_OVERHEAD)
+        break;
+      room -= CHUNK_OVERHEAD;
+    }
+    if (!chunked)
+      room = std::min(room, response->_length() - connection->fillIndex);
+
+    size_t len = response->_fill(buffer, room, connection->fillIndex);
+    if (len == RESPONSE_TRY_AGAIN)
+      return true;
+    len = std::min(len, room);
+
+    if (len == 0)
+    {
+      // A short fixed-length body ends with the connection
+      if (framed)
+        connection->out += "0\r\n\r\n";
+      connection->bodyDone = true;
+      break;
+    }
+
+    if (framed)
+    {
+      char size[24];
+      snprintf(size, sizeof(size), "%zx\r\n", len);
+      connection->out += size;
+      connection->out.append((const char *)buffer, len);
+      connection->out += "\r\n";
+    }
+    else
+    {
+      connection->out.append((const char *)buffer, len);
+    }
+    connection->fillIndex += len;
+  }
+  return false;
+}
+
+// False if the connection failed
+bool AsyncWebServer::flush(NativeConnection *connection)
+{
+  if (connection->out.empty())
+    return true;
+
+  ssize_t sent = send(connection->fd, connection->out.data(), connection->out.size(), MSG_NOSIGNAL);
+  if (sent < 0)
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+  connection->out.erase(0, sent);
+  return true;
+}
+
+void AsyncWebServer::close(NativeConnection *connection)
+{
+  {
+    std::lock_guard<std::recursive_mutex> lock(_lock);
+    _connections.remove(connection);
+    _stats.connections = _connections.size();
+    connection->closed = true;
+    if (connection->request)
+      connection->request->_connection = NULL;
+  }
+  ::close(connection->fd);
+
+  // Outside the lock: both may call back into other tasks' code
+  if (connection->owner != NULL)
+    connection->owner->_closed();
+  if (connection->request && connection->request->_onDisconnect)
+    connection->request->_onDisconnect();
+
+  delete connection->response;
+  delete connection;
+}
+
+void AsyncWebServer::measure()
+{
+  std::lock_guard<std::recursive_mutex> lock(_lock);
+  size_t buffered = 0;
+  for (std::list<NativeConnection *>::iterator it = _connections.begin(); it != _connections.end(); ++it)
+    buffered += (*it)->out.size() + (*it)->queuedBytes;
+
+  _stats.bufferedBytes = buffered;
+  if (buffered > _stats.peakBufferedBytes)
+    _stats.peakBufferedBytes = buffered;
+}
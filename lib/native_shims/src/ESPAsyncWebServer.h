@@ -0,0 +1,339 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// ESPASYNCWEBSERVER (HOST)
+// ============================================================================
+//
+// The part of ESPAsyncWebServer 3.x the gate uses, over POSIX sockets, so
+// setupServerRoutes() runs unchanged on the host. One thread plays the
+// async TCP task: it accepts, parses requests, calls the handlers and pulls
+// response bodies, like AsyncTCP's task on the device. Nothing user-supplied
+// runs under the server's lock, so other tasks may send on paused requests,
+// events and websockets at any time, as they do on the device.
+//
+// Behaviour follows the library where the gate can observe it: every
+// response closes its connection, bodies are pulled from fillers as the
+// socket drains (up to the ESP32's TCP send buffer at a time), and event
+// source and websocket clients queue at most 32 messages each.
+//
+// setPort(), listening() and stats() exist on the host only.
+
+class AsyncWebServer;
+class AsyncWebServerRequest;
+struct NativeConnection;
+
+enum WebRequestMethod
+{
+  HTTP_GET = 0b00000001,
+  HTTP_POST = 0b00000010,
+  HTTP_DELETE = 0b00000100,
+  HTTP_PUT = 0b00001000,
+  HTTP_PATCH = 0b00010000,
+  HTTP_HEAD = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY = 0b01111111
+};
+typedef uint8_t WebRequestMethodComposite;
+
+// A filler's way of saying "nothing yet, ask again"
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+typedef std::function<String(const String &)> AwsTemplateProcessor;
+
+typedef std::shared_ptr<AsyncWebServerRequest> AsyncWebServerRequestSharedPtr;
+typedef std::weak_ptr<AsyncWebServerRequest> AsyncWebServerRequestPtr;
+
+class AsyncWebParameter
+{
+public:
+  AsyncWebParameter(const String &name, const String &value) : _name(name), _value(value) {}
+  const String &name() const { return _name; }
+  const String &value() const { return _value; }
+
+private:
+  String _name;
+  String _value;
+};
+
+class AsyncWebHeader
+{
+public:
+  AsyncWebHeader(const String &name, const String &value) : _name(name), _value(value) {}
+  const String &name() const { return _name; }
+  const String &value() const { return _value; }
+
+private:
+  String _name;
+  String _value;
+};
+
+// ============================================================================
+// RESPONSES
+// ============================================================================
+
+class AsyncWebServerResponse
+{
+public:
+  AsyncWebServerResponse(int code, const char *contentType);
+  virtual ~AsyncWebServerResponse() {}
+
+  int code() const { return _code; }
+  void setCode(int code) { _code = code; }
+  void setContentType(const char *type) { _contentType = type; }
+  void setContentLength(size_t length) { _contentLength = length; }
+  void addHeader(const char *name, const char *value) { _headers.push_back(AsyncWebHeader(name, value)); }
+  void addHeader(const char *name, const String &value) { _headers.push_back(AsyncWebHeader(name, value)); }
+
+  // Host internals: the status line and headers, then the body piece by
+  // piece (0 once it is complete)
+  String _head(bool http11) const;
+  virtual size_t _fill(uint8_t *buffer, size_t maxLen, size_t index) = 0;
+  size_t _length() const { return _contentLength; }
+  bool _chunked() const { return _contentLength == SIZE_MAX; }
+
+protected:
+  int _code;
+  String _contentType;
+  size_t _contentLength = 0;
+  std::vector<AsyncWebHeader> _headers;
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse, public Print
+{
+public:
+  AsyncResponseStream(const char *contentType, size_t bufferSize);
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *data, size_t len) override;
+  using Print::write;
+
+  size_t _fill(uint8_t *buffer, size_t maxLen, size_t index) override;
+
+private:
+  std::string _body;
+};
+
+// ============================================================================
+// REQUESTS
+// ============================================================================
+
+class AsyncWebServerRequest
+{
+public:
+  ~AsyncWebServerRequest();
+
+  WebRequestMethodComposite method() const { return _method; }
+  const String &url() const { return _url; }
+  const String &contentType() const { return _contentType; }
+  size_t contentLength() const { return _contentLength; }
+  uint8_t version() const { return _http11 ? 1 : 0; }
+
+  // Query string and urlencoded form fields; post and file are ignored
+  bool hasParam(const char *name, bool post = false, bool file = false) const;
+  const AsyncWebParameter *getParam(const char *name, bool post = false, bool file = false) const;
+  size_t params() const { return _params.size(); }
+
+  // Case-insensitive, as in HTTP
+  bool hasHeader(const char *name) const;
+  const AsyncWebHeader *getHeader(const char *name) const;
+  String header(const char *name) const;
+
+  void send(AsyncWebServerResponse *response);
+  void send(int code, const char *contentType = "", const char *content = "");
+  void send(int code, const char *contentType, const String &content);
+  void send(int code, const String &contentType, const String &content);
+  void send(int code, const char *contentType, const uint8_t *content, size_t len,
+            AwsTemplateProcessor callback = nullptr);
+
+  AsyncWebServerResponse *beginResponse(int code, const char *contentType = "", const char *content = "");
+  AsyncWebServerResponse *beginResponse(int code, const char *contentType, const String &content);
+  AsyncWebServerResponse *beginResponse(int code, const char *contentType, const uint8_t *content, size_t len,
+                                        AwsTemplateProcessor callback = nullptr);
+  AsyncWebServerResponse *beginResponse(const char *contentType, size_t len, AwsResponseFiller callback,
+                                        AwsTemplateProcessor templateCallback = nullptr);
+  AsyncWebServerResponse *beginChunkedResponse(const char *contentType, AwsResponseFiller callback,
+                                               AwsTemplateProcessor templateCallback = nullptr);
+  AsyncResponseStream *beginResponseStream(const char *contentType, size_t bufferSize = 1460);
+
+  // Holds the answer back until send() is called, from any task. The
+  // pointer expires if the client goes away first.
+  AsyncWebServerRequestPtr pause();
+  bool isPaused() const { return _paused; }
+
+  // Runs when the connection closes, however that happens
+  void onDisconnect(std::function<void()> fn) { _onDisconnect = fn; }
+
+  // Freed with free() when the request ends
+  void *_tempObject = NULL;
+
+private:
+  friend class AsyncWebServer;
+  friend struct NativeConnection;
+
+  AsyncWebServerRequest() {}
+
+  WebRequestMethodComposite _method = 0;
+  String _url;
+  String _contentType;
+  size_t _contentLength = 0;
+  bool _http11 = true;
+  std::vector<AsyncWebParameter> _params;
+  std::vector<AsyncWebHeader> _headers;
+
+  AsyncWebServer *_server = NULL;
+  std::weak_ptr<AsyncWebServerRequest> _self;
+
+  // Guarded by the server lock
+  NativeConnection *_connection = NULL; // NULL once closed
+  AsyncWebServerResponse *_response = NULL;
+  bool _sent = false;
+  bool _paused = false;
+  std::function<void()> _onDisconnect;
+};
+
+// ============================================================================
+// HANDLERS
+// ============================================================================
+
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data,
+                           size_t len, bool final)>
+    ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)>
+    ArBodyHandlerFunction;
+
+class AsyncWebHandler
+{
+public:
+  virtual ~AsyncWebHandler() {}
+  virtual bool canHandle(AsyncWebServerRequest *request) const { return false; }
+  virtual void handleRequest(AsyncWebServerRequest *request) {}
+  virtual void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {}
+  virtual bool isRequestHandlerTrivial() const { return true; }
+
+  // Host internals: handlers that keep the connection (event source,
+  // websocket) take it over here instead of answering
+  virtual bool _takesConnection() const { return false; }
+  virtual void _adopt(AsyncWebServerRequest *request, NativeConnection *connection) {}
+};
+
+// What an event source or websocket client implements to own a connection
+class NativeConnectionOwner
+{
+public:
+  virtual ~NativeConnectionOwner() {}
+
+  // Bytes from the peer. Runs on the server thread, without locks.
+  virtual void _received(const uint8_t *data, size_t len) = 0;
+
+  // The connection is gone. Runs once on the server thread, without locks;
+  // afterwards the owner must not use the connection again.
+  virtual void _closed() = 0;
+};
+
+class AsyncCallbackWebHandler : public AsyncWebHandler
+{
+public:
+  AsyncCallbackWebHandler(const char *uri, WebRequestMethodComposite method) : _uri(uri), _method(method) {}
+
+  void onRequest(ArRequestHandlerFunction fn) { _onRequest = fn; }
+  void onUpload(ArUploadHandlerFunction fn) { _onUpload = fn; }
+  void onBody(ArBodyHandlerFunction fn) { _onBody = fn; }
+
+  bool canHandle(AsyncWebServerRequest *request) const override;
+  void handleRequest(AsyncWebServerRequest *request) override;
+  void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) override;
+  bool isRequestHandlerTrivial() const override { return !_onBody; }
+
+private:
+  String _uri;
+  WebRequestMethodComposite _method;
+  ArRequestHandlerFunction _onRequest;
+  ArUploadHandlerFunction _onUpload;
+  ArBodyHandlerFunction _onBody;
+};
+
+// ============================================================================
+// SERVER
+// ============================================================================
+
+struct NativeServerStats
+{
+  uint32_t requests;
+  uint32_t connections;     // open now, including event and websocket clients
+  uint32_t peakConnections;
+  uint32_t refused;         // over the connection limit
+  size_t bufferedBytes;     // waiting in connection send buffers
+  size_t peakBufferedBytes;
+};
+
+class AsyncWebServer
+{
+public:
+  explicit AsyncWebServer(uint16_t port) : _port(port) {}
+  ~AsyncWebServer();
+
+  void begin();
+  void end();
+
+  AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest);
+  AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                              ArUploadHandlerFunction onUpload);
+  AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                              ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody);
+  AsyncWebHandler &addHandler(AsyncWebHandler *handler);
+  void onNotFound(ArRequestHandlerFunction fn) { _notFound = fn; }
+
+  // Host build only: the port begin() listens on, whether it could, and
+  // connection and buffer counters for load tests
+  void setPort(uint16_t port) { _port = port; }
+  bool listening() const { return _listener >= 0; }
+  NativeServerStats stats();
+
+  // Host internals, for requests and connection handlers
+  std::recursive_mutex _lock;
+  void _wake();
+
+private:
+  void run();
+  void accept();
+  void service(NativeConnection *connection, short events);
+  void parse(NativeConnection *connection);
+  bool readHead(NativeConnection *connection, const std::string &head);
+  void dispatch(NativeConnection *connection);
+  void respond(NativeConnection *connection, AsyncWebServerResponse *response);
+  void reject(NativeConnection *connection, int code);
+  bool pump(NativeConnection *connection);
+  bool fill(NativeConnection *connection);
+  bool flush(NativeConnection *connection);
+  void close(NativeConnection *connection);
+  void measure();
+
+  uint16_t _port;
+  int _listener = -1;
+  int _wakeRead = -1;
+  int _wakeWrite = -1;
+  std::atomic<bool> _running{false};
+  std::thread _thread;
+
+  std::vector<AsyncWebHandler *> _handlers;
+  std::list<std::unique_ptr<AsyncCallbackWebHandler>> _callbackHandlers;
+  ArRequestHandlerFunction _notFound;
+  std::list<NativeConnection *> _connections;
+
+  NativeServerStats _stats = {};
+};
+
+#include "AsyncEventSource.h"
+#include "AsyncWebSocket.h"
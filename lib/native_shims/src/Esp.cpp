@@ -0,0 +1,90 @@
+#include "Esp.h"
+
+#include <malloc.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+EspClass ESP;
+
+namespace
+{
+size_t allocatedNow()
+{
+  return mallinfo2().uordblks;
+}
+
+// Taken before main(), so the C++ runtime's own allocations do not count
+const size_t startAllocated = allocatedNow();
+
+std::atomic<size_t> peakUsed(0);
+std::once_flag samplerStarted;
+
+size_t sample()
+{
+  size_t allocated = allocatedNow();
+  size_t used = allocated > startAllocated ? allocated - startAllocated : 0;
+
+  size_t peak = peakUsed.load();
+  while (used > peak && !peakUsed.compare_exchange_weak(peak, used))
+  {
+  }
+  return used;
+}
+
+void sampleForever()
+{
+  while (true)
+  {
+    sample();
+    std::this_thread::sleep_for(std::chrono::milliseconds(ESP_HEAP_SAMPLE_MS));
+  }
+}
+
+void startSampler()
+{
+  std::call_once(samplerStarted, []()
+                 { std::thread(sampleForever).detach(); });
+}
+
+uint32_t freeOf(size_t used)
+{
+  return used < ESP_HEAP_SIZE ? ESP_HEAP_SIZE - used : 0;
+}
+} // namespace
+
+uint32_t EspClass::getHeapSize()
+{
+  return ESP_HEAP_SIZE;
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+  return freeOf(heapUsed());
+}
+
+uint32_t EspClass::getMinFreeHeap()
+{
+  return freeOf(peakHeapUsed());
+}
+
+size_t EspClass::heapUsed()
+{
+  startSampler();
+  return sample();
+}
+
+size_t EspClass::peakHeapUsed()
+{
+  startSampler();
+  sample();
+  return peakUsed.load();
+}
+
+uint32_t EspClass::getCycleCount()
+{
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  return (uint32_t)(ns * ESP_CPU_FREQ_MHZ / 1000);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// ESP (HOST)
+// ============================================================================
+//
+// The chip counters the gate reports, for a Linux process. The heap is a
+// notional ESP32 heap of ESP_HEAP_SIZE bytes, of which whatever this process
+// has allocated since it started is taken (glibc's mallinfo2()). The
+// minimum free heap is sampled: on every query and every
+// ESP_HEAP_SAMPLE_MS by a thread started at the first query, so a peak
+// shorter than that can be missed. The cycle counter runs at a notional
+// 240 MHz from the steady clock.
+
+const size_t ESP_HEAP_SIZE = 320 * 1024;
+const uint32_t ESP_HEAP_SAMPLE_MS = 5;
+const uint32_t ESP_CPU_FREQ_MHZ = 240;
+
+class EspClass
+{
+public:
+  uint32_t getHeapSize();
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+
+  // Bytes allocated since the process started, and the most seen at once;
+  // unlike the free heap these do not stop at the notional heap size
+  size_t heapUsed();
+  size_t peakHeapUsed();
+
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return ESP_CPU_FREQ_MHZ; }
+};
+
+extern EspClass ESP;
@@ -0,0 +1,226 @@
+#include "FS.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs
+{
+
+struct FileImpl
+{
+  FILE *file = NULL;
+  DIR *dir = NULL;
+  std::string hostPath;
+  std::string path; // within the file system
+
+  ~FileImpl()
+  {
+    if (file != NULL)
+      fclose(file);
+    if (dir != NULL)
+      closedir(dir);
+  }
+};
+
+namespace
+{
+// Arduino modes to stdio ones; binary is the only kind there is
+const char *stdioMode(const char *mode)
+{
+  if (strcmp(mode, "w") == 0)
+    return "wb";
+  if (strcmp(mode, "a") == 0)
+    return "ab";
+  if (strcmp(mode, "r+") == 0)
+    return "r+b";
+  if (strcmp(mode, "w+") == 0)
+    return "w+b";
+  if (strcmp(mode, "a+") == 0)
+    return "a+b";
+  return "rb";
+}
+} // namespace
+
+// ============================================================================
+// FILE
+// ============================================================================
+
+File::operator bool() const
+{
+  return _impl && (_impl->file != NULL || _impl->dir != NULL);
+}
+
+size_t File::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *data, size_t len)
+{
+  if (!_impl || _impl->file == NULL)
+    return 0;
+  return fwrite(data, 1, len, _impl->file);
+}
+
+int File::read()
+{
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t *buffer, size_t size)
+{
+  if (!_impl || _impl->file == NULL)
+    return 0;
+  return fread(buffer, 1, size, _impl->file);
+}
+
+int File::available()
+{
+  return (int)(size() - position());
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+  if (!_impl || _impl->file == NULL)
+    return false;
+  int whence = mode == SeekCur ? SEEK_CUR : mode == SeekEnd ? SEEK_END : SEEK_SET;
+  return fseek(_impl->file, pos, whence) == 0;
+}
+
+size_t File::position() const
+{
+  if (!_impl || _impl->file == NULL)
+    return 0;
+  long pos = ftell(_impl->file);
+  return pos < 0 ? 0 : pos;
+}
+
+size_t File::size() const
+{
+  if (!_impl || _impl->file == NULL)
+    return 0;
+  fflush(_impl->file);
+  struct stat info;
+  return fstat(fileno(_impl->file), &info) == 0 ? info.st_size : 0;
+}
+
+void File::flush()
+{
+  if (_impl && _impl->file != NULL)
+    fflush(_impl->file);
+}
+
+void File::close()
+{
+  _impl.reset();
+}
+
+const char *File::name() const
+{
+  if (!_impl)
+    return "";
+  size_t slash = _impl->path.rfind('/');
+  return _impl->path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+const char *File::path() const
+{
+  return _impl ? _impl->path.c_str() : "";
+}
+
+bool File::isDirectory() const
+{
+  return _impl && _impl->dir != NULL;
+}
+
+File File::openNextFile(const char *mode)
+{
+  if (!_impl || _impl->dir == NULL)
+    return File();
+
+  struct dirent *entry;
+  while ((entry = readdir(_impl->dir)) != NULL)
+  {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+      continue;
+
+    std::string path = _impl->path;
+    if (path.empty() || path[path.size() - 1] != '/')
+      path += '/';
+    path += entry->d_name;
+
+    std::shared_ptr<FileImpl> impl(new FileImpl());
+    impl->path = path;
+    impl->hostPath = _impl->hostPath + "/" + entry->d_name;
+
+    struct stat info;
+    if (stat(impl->hostPath.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+      impl->dir = opendir(impl->hostPath.c_str());
+    else
+      impl->file = fopen(impl->hostPath.c_str(), stdioMode(mode));
+    return File(impl);
+  }
+  return File();
+}
+
+// ============================================================================
+// FILE SYSTEM
+// ============================================================================
+
+std::string FS::hostPath(const char *path) const
+{
+  std::string result = _root;
+  if (path[0] != '/')
+    result += '/';
+  result += path;
+  return result;
+}
+
+File FS::open(const char *path, const char *mode, bool create)
+{
+  std::shared_ptr<FileImpl> impl(new FileImpl());
+  impl->path = path;
+  impl->hostPath = hostPath(path);
+
+  struct stat info;
+  if (stat(impl->hostPath.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+    impl->dir = opendir(impl->hostPath.c_str());
+  else
+    impl->file = fopen(impl->hostPath.c_str(), stdioMode(mode));
+
+  if (impl->file == NULL && impl->dir == NULL)
+    return File();
+  return File(impl);
+}
+
+bool FS::exists(const char *path)
+{
+  struct stat info;
+  return stat(hostPath(path).c_str(), &info) == 0;
+}
+
+bool FS::remove(const char *path)
+{
+  return unlink(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *from, const char *to)
+{
+  return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char *path)
+{
+  return ::mkdir(hostPath(path).c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool FS::rmdir(const char *path)
+{
+  return ::rmdir(hostPath(path).c_str()) == 0;
+}
+
+} // namespace fs
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Arduino.h>
+#include <memory>
+#include <string>
+
+// ============================================================================
+// FS (HOST)
+// ============================================================================
+//
+// Arduino's fs::FS and fs::File over POSIX files under a host directory.
+// Paths are absolute within the file system ("/passlog/00000001.seg") and
+// are resolved against the root given at mount time.
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs
+{
+
+enum SeekMode
+{
+  SeekSet = 0,
+  SeekCur = 1,
+  SeekEnd = 2
+};
+
+struct FileImpl;
+
+class File : public Print
+{
+public:
+  File() {}
+  explicit File(std::shared_ptr<FileImpl> impl) : _impl(impl) {}
+
+  operator bool() const;
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *data, size_t len) override;
+  using Print::write;
+
+  int read();
+  size_t read(uint8_t *buffer, size_t size);
+  int available();
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void flush() override;
+  void close();
+
+  // Base name, as in the ESP32 core 2.x
+  const char *name() const;
+  const char *path() const;
+
+  bool isDirectory() const;
+  File openNextFile(const char *mode = FILE_READ);
+
+private:
+  std::shared_ptr<FileImpl> _impl;
+};
+
+class FS
+{
+public:
+  explicit FS(const std::string &root = "") : _root(root) {}
+
+  File open(const char *path, const char *mode = FILE_READ, bool create = false);
+  File open(const String &path, const char *mode = FILE_READ, bool create = false) { return open(path.c_str(), mode, create); }
+
+  bool exists(const char *path);
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path);
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *from, const char *to);
+  bool rename(const String &from, const String &to) { return rename(from.c_str(), to.c_str()); }
+  bool mkdir(const char *path);
+  bool mkdir(const String &path) { return mkdir(path.c_str()); }
+  bool rmdir(const char *path);
+  bool rmdir(const String &path) { return rmdir(path.c_str()); }
+
+protected:
+  std::string hostPath(const char *path) const;
+
+  std::string _root;
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekMode;
+using fs::SeekSet;
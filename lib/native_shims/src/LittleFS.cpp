@@ -0,0 +1,26 @@
+#include "LittleFS.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+
+LittleFSFS LittleFS;
+
+namespace
+{
+bool makeDir(const std::string &path)
+{
+  return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+} // namespace
+
+bool LittleFSFS::begin(bool formatOnFail, const char *basePath, uint8_t maxOpenFiles, const char *partitionLabel)
+{
+  _root = std::string(nativeDataDir()) + "/littlefs";
+
+  struct stat info;
+  if (stat(_root.c_str(), &info) == 0)
+    return S_ISDIR(info.st_mode);
+  if (!formatOnFail)
+    return false;
+  return makeDir(nativeDataDir()) && makeDir(_root);
+}
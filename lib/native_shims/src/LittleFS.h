@@ -0,0 +1,20 @@
+#pragma once
+
+#include <FS.h>
+
+// ============================================================================
+// LITTLEFS (HOST)
+// ============================================================================
+//
+// The flash partition is a directory: <native data dir>/littlefs.
+
+class LittleFSFS : public fs::FS
+{
+public:
+  // Creates the directory when formatOnFail is set and it does not exist
+  bool begin(bool formatOnFail = false, const char *basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+             const char *partitionLabel = NULL);
+  void end() {}
+};
+
+extern LittleFSFS LittleFS;
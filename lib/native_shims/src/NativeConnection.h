@@ -0,0 +1,63 @@
+#pragma once
+
+#include <deque>
+#include <string>
+
+#include "ESPAsyncWebServer.h"
+
+// ============================================================================
+// NATIVE CONNECTION
+// ============================================================================
+//
+// One accepted socket of the host web server. Everything but the kept-
+// connection fields belongs to the server thread. A connection is either
+// answering one request (read the request, run the handler, write the
+// response, close) or has been taken over by an event source or websocket
+// client, its owner, which then sends messages through enqueue().
+
+struct NativeConnection
+{
+  enum State
+  {
+    READING_HEAD,
+    READING_BODY,
+    WAITING,  // handled, the request is paused
+    WRITING,
+    KEPT      // owned by an event source or websocket client
+  };
+
+  NativeConnection(AsyncWebServer *server, int fd) : server(server), fd(fd) {}
+
+  // Queues a message for a kept connection and wakes the server. False if
+  // the connection is closing or already holds `limit` messages (0: no
+  // limit). Safe from any thread.
+  bool enqueue(const std::string &message, size_t limit);
+  bool queueFull(size_t limit);
+
+  // Closes once everything queued has been sent. Safe from any thread.
+  void closeWhenSent();
+
+  AsyncWebServer *server;
+  int fd;
+  State state = READING_HEAD;
+
+  std::string in;  // received, not parsed yet
+  std::string out; // waiting for the socket
+
+  AsyncWebServerRequestSharedPtr request;
+  AsyncWebHandler *handler = NULL;
+  bool form = false; // urlencoded body, parsed into params
+  std::string formBody;
+  size_t bodyIndex = 0;
+
+  AsyncWebServerResponse *response = NULL;
+  size_t fillIndex = 0;
+  bool bodyDone = false;
+
+  // Kept connections; guarded by the server lock
+  NativeConnectionOwner *owner = NULL;
+  std::deque<std::string> queue;
+  size_t queuedBytes = 0;
+  bool closing = false;
+  bool closed = false;
+};
@@ -0,0 +1,180 @@
+#include "Preferences.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+
+namespace
+{
+const size_t NVS_KEY_MAX = 15;
+
+bool makeDir(const std::string &path)
+{
+  return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+std::string escape(const std::string &value)
+{
+  std::string result;
+  for (size_t i = 0; i < value.size(); i++)
+  {
+    char c = value[i];
+    if (c == '\\')
+      result += "\\\\";
+    else if (c == '\n')
+      result += "\\n";
+    else if (c == '\r')
+      result += "\\r";
+    else
+      result += c;
+  }
+  return result;
+}
+
+std::string unescape(const std::string &value)
+{
+  std::string result;
+  for (size_t i = 0; i < value.size(); i++)
+  {
+    char c = value[i];
+    if (c == '\\' && i + 1 < value.size())
+    {
+      c = value[++i];
+      if (c == 'n')
+        c = '\n';
+      else if (c == 'r')
+        c = '\r';
+    }
+    result += c;
+  }
+  return result;
+}
+
+bool validKey(const char *key)
+{
+  return key != NULL && key[0] != '\0' && strlen(key) <= NVS_KEY_MAX && strchr(key, '=') == NULL;
+}
+} // namespace
+
+bool Preferences::begin(const char *name, bool readOnly, const char *partitionLabel)
+{
+  std::string dir = std::string(nativeDataDir()) + "/nvs";
+  if (!makeDir(nativeDataDir()) || !makeDir(dir))
+    return false;
+
+  _path = dir + "/" + name;
+  _readOnly = readOnly;
+  _open = load();
+  return _open;
+}
+
+void Preferences::end()
+{
+  _values.clear();
+  _open = false;
+}
+
+bool Preferences::clear()
+{
+  if (!writable())
+    return false;
+  _values.clear();
+  return save();
+}
+
+bool Preferences::remove(const char *key)
+{
+  if (!writable() || _values.erase(key) == 0)
+    return false;
+  return save();
+}
+
+bool Preferences::isKey(const char *key)
+{
+  return _open && _values.count(key) > 0;
+}
+
+size_t Preferences::putString(const char *key, const char *value)
+{
+  if (!writable() || !validKey(key) || value == NULL)
+    return 0;
+  _values[key] = value;
+  return save() ? strlen(value) : 0;
+}
+
+size_t Preferences::getString(const char *key, char *value, size_t maxLen)
+{
+  if (!_open)
+    return 0;
+  std::map<std::string, std::string>::const_iterator found = _values.find(key);
+  if (found == _values.end() || found->second.size() + 1 > maxLen)
+    return 0;
+  memcpy(value, found->second.c_str(), found->second.size() + 1);
+  return found->second.size() + 1;
+}
+
+String Preferences::getString(const char *key, const String &defaultValue)
+{
+  if (!_open)
+    return defaultValue;
+  std::map<std::string, std::string>::const_iterator found = _values.find(key);
+  return found == _values.end() ? defaultValue : String(found->second);
+}
+
+size_t Preferences::putUInt(const char *key, uint32_t value)
+{
+  if (!writable() || !validKey(key))
+    return 0;
+  _values[key] = String((unsigned long)value).c_str();
+  return save() ? sizeof(value) : 0;
+}
+
+uint32_t Preferences::getUInt(const char *key, uint32_t defaultValue)
+{
+  if (!_open)
+    return defaultValue;
+  std::map<std::string, std::string>::const_iterator found = _values.find(key);
+  return found == _values.end() ? defaultValue : (uint32_t)strtoul(found->second.c_str(), NULL, 10);
+}
+
+// A missing file is an empty namespace
+bool Preferences::load()
+{
+  _values.clear();
+  FILE *file = fopen(_path.c_str(), "r");
+  if (file == NULL)
+    return errno == ENOENT;
+
+  std::string line;
+  int c;
+  while ((c = fgetc(file)) != EOF)
+  {
+    if (c != '\n')
+    {
+      line += (char)c;
+      continue;
+    }
+    size_t equals = line.find('=');
+    if (equals != std::string::npos)
+      _values[line.substr(0, equals)] = unescape(line.substr(equals + 1));
+    line.clear();
+  }
+  fclose(file);
+  return true;
+}
+
+bool Preferences::save()
+{
+  std::string tempPath = _path + ".tmp";
+  FILE *file = fopen(tempPath.c_str(), "w");
+  if (file == NULL)
+    return false;
+
+  bool ok = true;
+  for (std::map<std::string, std::string>::const_iterator entry = _values.begin(); entry != _values.end(); ++entry)
+  {
+    std::string line = entry->first + "=" + escape(entry->second) + "\n";
+    ok = ok && fwrite(line.data(), 1, line.size(), file) == line.size();
+  }
+  ok = fclose(file) == 0 && ok;
+  return ok && rename(tempPath.c_str(), _path.c_str()) == 0;
+}
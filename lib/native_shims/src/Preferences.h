@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+
+// ============================================================================
+// PREFERENCES (HOST)
+// ============================================================================
+//
+// NVS namespaces as text files, <native data dir>/nvs/<namespace>, one
+// key=value line per entry (backslash escapes for newlines). Each write
+// rewrites the file through a rename, so an interrupted run never leaves it
+// half written. Only string and integer values are kept.
+
+class Preferences
+{
+public:
+  bool begin(const char *name, bool readOnly = false, const char *partitionLabel = NULL);
+  void end();
+
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+
+  size_t putString(const char *key, const char *value);
+  size_t putString(const char *key, const String &value) { return putString(key, value.c_str()); }
+  // As NVS: the length including the terminator, or 0 if the key is missing
+  // or the value does not fit in maxLen
+  size_t getString(const char *key, char *value, size_t maxLen);
+  String getString(const char *key, const String &defaultValue = String());
+
+  size_t putUInt(const char *key, uint32_t value);
+  uint32_t getUInt(const char *key, uint32_t defaultValue = 0);
+  size_t putBool(const char *key, bool value) { return putUInt(key, value ? 1 : 0) > 0 ? 1 : 0; }
+  bool getBool(const char *key, bool defaultValue = false) { return getUInt(key, defaultValue ? 1 : 0) != 0; }
+
+private:
+  bool load();
+  bool save();
+  bool writable() const { return _open && !_readOnly; }
+
+  std::string _path;
+  std::map<std::string, std::string> _values;
+  bool _open = false;
+  bool _readOnly = false;
+};
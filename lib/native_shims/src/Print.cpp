@@ -0,0 +1,32 @@
+#include "Print.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <vector>
+
+size_t Print::write(const uint8_t *data, size_t len)
+{
+  size_t written = 0;
+  while (written < len && write(data[written]) == 1)
+    written++;
+  return written;
+}
+
+size_t Print::printf(const char *format, ...)
+{
+  char small[128];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(small, sizeof(small), format, args);
+  va_end(args);
+  if (length < 0)
+    return 0;
+  if ((size_t)length < sizeof(small))
+    return write((const uint8_t *)small, length);
+
+  std::vector<char> large(length + 1);
+  va_start(args, format);
+  vsnprintf(large.data(), large.size(), format, args);
+  va_end(args);
+  return write((const uint8_t *)large.data(), length);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "WString.h"
+
+// ============================================================================
+// PRINT
+// ============================================================================
+//
+// Arduino's byte sink: subclasses provide write(), the rest formats onto it.
+
+class Print
+{
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *data, size_t len);
+  size_t write(const char *text) { return text != NULL ? write((const uint8_t *)text, strlen(text)) : 0; }
+
+  size_t print(const char *text) { return write(text); }
+  size_t print(const String &text) { return write(text.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value, int base = 10) { return print(String(value, base)); }
+  size_t print(unsigned int value, int base = 10) { return print(String(value, base)); }
+  size_t print(long value, int base = 10) { return print(String(value, base)); }
+  size_t print(unsigned long value, int base = 10) { return print(String(value, base)); }
+  size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T &value)
+  {
+    size_t n = print(value);
+    return n + println();
+  }
+  template <typename T>
+  size_t println(const T &value, int format)
+  {
+    size_t n = print(value, format);
+    return n + println();
+  }
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  virtual void flush() {}
+};
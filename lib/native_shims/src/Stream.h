@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Print.h"
+
+// ============================================================================
+// STREAM
+// ============================================================================
+//
+// Arduino's byte source: a Print that can also be read, one byte at a time
+// and without blocking. Drivers written against Stream (the fingerprint
+// library) take any port that implements these three.
+
+class Stream : public Print
+{
+public:
+  // Bytes that can be read now
+  virtual int available() = 0;
+
+  // Next byte, or -1 if there is none yet
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
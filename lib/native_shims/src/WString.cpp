@@ -0,0 +1,198 @@
+#include "WString.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+std::string formatUnsigned(unsigned long value, unsigned char base)
+{
+  if (base < 2 || base > 36)
+    base = 10;
+
+  char digits[8 * sizeof(value) + 1];
+  char *out = digits + sizeof(digits);
+  *--out = '\0';
+  do
+  {
+    unsigned digit = value % base;
+    *--out = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value != 0);
+  return out;
+}
+
+std::string formatSigned(long value, unsigned char base)
+{
+  if (value < 0 && base == 10)
+    return "-" + formatUnsigned(-(unsigned long)value, base);
+  return formatUnsigned((unsigned long)value, base);
+}
+} // namespace
+
+String::String(int value, unsigned char base) : _value(formatSigned(value, base)) {}
+String::String(unsigned int value, unsigned char base) : _value(formatUnsigned(value, base)) {}
+String::String(long value, unsigned char base) : _value(formatSigned(value, base)) {}
+String::String(unsigned long value, unsigned char base) : _value(formatUnsigned(value, base)) {}
+
+String::String(double value, unsigned int decimals)
+{
+  char text[64];
+  snprintf(text, sizeof(text), "%.*f", (int)decimals, value);
+  _value = text;
+}
+
+bool String::reserve(unsigned int size)
+{
+  _value.reserve(size);
+  return true;
+}
+
+bool String::concat(const String &value)
+{
+  _value += value._value;
+  return true;
+}
+
+bool String::concat(const char *value)
+{
+  if (value == NULL)
+    return false;
+  _value += value;
+  return true;
+}
+
+bool String::concat(char c)
+{
+  _value += c;
+  return true;
+}
+
+String &String::operator+=(const String &value)
+{
+  concat(value);
+  return *this;
+}
+
+String &String::operator+=(const char *value)
+{
+  concat(value);
+  return *this;
+}
+
+String &String::operator+=(char c)
+{
+  concat(c);
+  return *this;
+}
+
+bool String::startsWith(const String &prefix) const
+{
+  return _value.compare(0, prefix._value.size(), prefix._value) == 0;
+}
+
+bool String::endsWith(const String &suffix) const
+{
+  return _value.size() >= suffix._value.size() &&
+         _value.compare(_value.size() - suffix._value.size(), suffix._value.size(), suffix._value) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+  size_t found = _value.find(c, from);
+  return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::indexOf(const String &value, unsigned int from) const
+{
+  size_t found = _value.find(value._value, from);
+  return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::lastIndexOf(char c) const
+{
+  size_t found = _value.rfind(c);
+  return found == std::string::npos ? -1 : (int)found;
+}
+
+String String::substring(unsigned int from) const
+{
+  return substring(from, _value.size());
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+  if (from > to)
+  {
+    unsigned int swap = from;
+    from = to;
+    to = swap;
+  }
+  if (from >= _value.size())
+    return String();
+  return String(_value.substr(from, to - from));
+}
+
+void String::trim()
+{
+  size_t first = 0;
+  while (first < _value.size() && isspace((unsigned char)_value[first]))
+    first++;
+  size_t last = _value.size();
+  while (last > first && isspace((unsigned char)_value[last - 1]))
+    last--;
+  _value = _value.substr(first, last - first);
+}
+
+void String::toLowerCase()
+{
+  for (size_t i = 0; i < _value.size(); i++)
+    _value[i] = tolower((unsigned char)_value[i]);
+}
+
+void String::toUpperCase()
+{
+  for (size_t i = 0; i < _value.size(); i++)
+    _value[i] = toupper((unsigned char)_value[i]);
+}
+
+long String::toInt() const
+{
+  return strtol(_value.c_str(), NULL, 10);
+}
+
+bool operator==(const String &a, const String &b) { return a.equals(b); }
+bool operator==(const String &a, const char *b) { return a.equals(b); }
+bool operator!=(const String &a, const String &b) { return !a.equals(b); }
+bool operator!=(const String &a, const char *b) { return !a.equals(b); }
+bool operator<(const String &a, const String &b) { return strcmp(a.c_str(), b.c_str()) < 0; }
+
+String operator+(const String &a, const String &b)
+{
+  String result(a);
+  result += b;
+  return result;
+}
+
+String operator+(const String &a, const char *b)
+{
+  String result(a);
+  result += b;
+  return result;
+}
+
+String operator+(const char *a, const String &b)
+{
+  String result(a);
+  result += b;
+  return result;
+}
+
+String operator+(const String &a, char b)
+{
+  String result(a);
+  result += b;
+  return result;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+// ============================================================================
+// STRING
+// ============================================================================
+//
+// The part of Arduino's String the toll-gate code uses, over std::string.
+
+class String
+{
+public:
+  String() {}
+  String(const char *value) : _value(value != NULL ? value : "") {}
+  String(const std::string &value) : _value(value) {}
+  explicit String(char c) : _value(1, c) {}
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(double value, unsigned int decimals = 2);
+
+  const char *c_str() const { return _value.c_str(); }
+  unsigned int length() const { return _value.size(); }
+  bool isEmpty() const { return _value.empty(); }
+  bool reserve(unsigned int size);
+
+  bool concat(const String &value);
+  bool concat(const char *value);
+  bool concat(char c);
+  String &operator+=(const String &value);
+  String &operator+=(const char *value);
+  String &operator+=(char c);
+
+  bool equals(const String &other) const { return _value == other._value; }
+  bool equals(const char *other) const { return _value == (other != NULL ? other : ""); }
+  bool startsWith(const String &prefix) const;
+  bool endsWith(const String &suffix) const;
+
+  char charAt(unsigned int index) const { return index < _value.size() ? _value[index] : '\0'; }
+  char operator[](unsigned int index) const { return charAt(index); }
+
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const String &value, unsigned int from = 0) const;
+  int lastIndexOf(char c) const;
+  String substring(unsigned int from) const;
+  String substring(unsigned int from, unsigned int to) const;
+
+  void trim();
+  void toLowerCase();
+  void toUpperCase();
+  long toInt() const;
+
+private:
+  std::string _value;
+};
+
+bool operator==(const String &a, const String &b);
+bool operator==(const String &a, const char *b);
+bool operator!=(const String &a, const String &b);
+bool operator!=(const String &a, const char *b);
+bool operator<(const String &a, const String &b);
+
+String operator+(const String &a, const String &b);
+String operator+(const String &a, const char *b);
+String operator+(const char *a, const String &b);
+String operator+(const String &a, char b);
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+
+// ============================================================================
+// ESP TIMER (HOST)
+// ============================================================================
+//
+// The ESP-IDF high-resolution timer: microseconds since the process
+// started, 64 bits wide so it never wraps.
+
+int64_t esp_timer_get_time();
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+
+// ============================================================================
+// FREERTOS (HOST)
+// ============================================================================
+//
+// The FreeRTOS calls the toll-gate core makes, over std::thread and
+// std::mutex. One tick is one millisecond. Task priorities and core
+// affinity are accepted and ignored: the host scheduler decides.
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFF)
+#define portTICK_PERIOD_MS ((TickType_t)1)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+// ESP-IDF spinlock critical sections become a plain mutex
+struct portMUX_TYPE
+{
+  std::mutex mutex;
+};
+
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) (mux)->mutex.lock()
+#define portEXIT_CRITICAL(mux) (mux)->mutex.unlock()
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
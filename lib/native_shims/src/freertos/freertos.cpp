@@ -0,0 +1,233 @@
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+#include "task.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+struct NativeTask
+{
+  TaskFunction_t code;
+  void *param;
+
+  std::mutex mutex;
+  std::condition_variable notified;
+  uint32_t notifications = 0;
+};
+
+struct NativeQueue
+{
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::vector<uint8_t> items;
+  size_t itemSize;
+  size_t length;
+  size_t head = 0;
+  size_t count = 0;
+};
+
+struct NativeMutex
+{
+  std::recursive_timed_mutex mutex;
+};
+
+namespace
+{
+thread_local TaskHandle_t currentTask = NULL;
+
+std::chrono::steady_clock::time_point deadlineAfter(TickType_t wait)
+{
+  return std::chrono::steady_clock::now() + std::chrono::milliseconds(wait);
+}
+
+// Waits on queue->changed until ready() holds or wait runs out
+template <typename Ready>
+bool waitFor(NativeQueue *queue, std::unique_lock<std::mutex> &lock, TickType_t wait, Ready ready)
+{
+  if (wait == portMAX_DELAY)
+  {
+    queue->changed.wait(lock, ready);
+    return true;
+  }
+  return queue->changed.wait_until(lock, deadlineAfter(wait), ready);
+}
+} // namespace
+
+// ============================================================================
+// TASKS
+// ============================================================================
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth, void *param,
+                       UBaseType_t priority, TaskHandle_t *created)
+{
+  NativeTask *task = new NativeTask();
+  task->code = code;
+  task->param = param;
+  std::thread([task]()
+              {
+                currentTask = task;
+                task->code(task->param); })
+      .detach();
+
+  if (created != NULL)
+    *created = task;
+  return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stackDepth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *created, BaseType_t core)
+{
+  return xTaskCreate(code, name, stackDepth, param, priority, created);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+  return currentTask;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount()
+{
+  static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+  std::lock_guard<std::mutex> lock(task->mutex);
+  task->notifications++;
+  task->notified.notify_all();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait)
+{
+  NativeTask *task = currentTask;
+  std::unique_lock<std::mutex> lock(task->mutex);
+  auto ready = [task]()
+  { return task->notifications > 0; };
+  if (wait == portMAX_DELAY)
+    task->notified.wait(lock, ready);
+  else
+    task->notified.wait_until(lock, deadlineAfter(wait), ready);
+
+  uint32_t count = task->notifications;
+  if (count > 0)
+    task->notifications = clearOnExit ? 0 : count - 1;
+  return count;
+}
+
+// ============================================================================
+// QUEUES
+// ============================================================================
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+  NativeQueue *queue = new NativeQueue();
+  queue->items.resize(length * itemSize);
+  queue->itemSize = itemSize;
+  queue->length = length;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+  delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!waitFor(queue, lock, wait, [queue]()
+               { return queue->count < queue->length; }))
+    return pdFALSE;
+
+  size_t slot = (queue->head + queue->count) % queue->length;
+  memcpy(&queue->items[slot * queue->itemSize], item, queue->itemSize);
+  queue->count++;
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+  return xQueueSend(queue, item, wait);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!waitFor(queue, lock, wait, [queue]()
+               { return queue->count > 0; }))
+    return pdFALSE;
+
+  memcpy(item, &queue->items[queue->head * queue->itemSize], queue->itemSize);
+  queue->head = (queue->head + 1) % queue->length;
+  queue->count--;
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  queue->head = 0;
+  queue->count = 0;
+  queue->changed.notify_all();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return queue->length - queue->count;
+}
+
+// ============================================================================
+// MUTEXES
+// ============================================================================
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+  return new NativeMutex();
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()
+{
+  return new NativeMutex();
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t mutex)
+{
+  delete mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t wait)
+{
+  if (wait == portMAX_DELAY)
+  {
+    mutex->mutex.lock();
+    return pdTRUE;
+  }
+  return mutex->mutex.try_lock_for(std::chrono::milliseconds(wait)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+  mutex->mutex.unlock();
+  return pdTRUE;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+// Items are copied in and out by value, as in FreeRTOS
+typedef struct NativeQueue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+void vQueueDelete(QueueHandle_t queue);
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+BaseType_t xQueueReset(QueueHandle_t queue);
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+// Mutexes only; both kinds are recursive on the host
+typedef struct NativeMutex *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+void vSemaphoreDelete(SemaphoreHandle_t mutex);
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex);
+
+#define xSemaphoreTakeRecursive(mutex, wait) xSemaphoreTake(mutex, wait)
+#define xSemaphoreGiveRecursive(mutex) xSemaphoreGive(mutex)
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct NativeTask *TaskHandle_t;
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth, void *param,
+                       UBaseType_t priority, TaskHandle_t *created);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stackDepth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *created, BaseType_t core);
+
+TaskHandle_t xTaskGetCurrentTaskHandle();
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+
+// Direct-to-task notifications, as a counting semaphore per task
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait);
@@ -0,0 +1,59 @@
+#include "alloc_audit.h"
+
+#if ALLOC_AUDIT
+
+namespace
+{
+volatile TaskHandle_t auditedTask = NULL;
+volatile uint32_t auditedAllocations = 0;
+
+inline void noteAllocation()
+{
+  if (auditedTask != NULL && xTaskGetCurrentTaskHandle() == auditedTask)
+    auditedAllocations++;
+}
+} // namespace
+
+extern "C"
+{
+  void *__real_malloc(size_t size);
+  void *__real_calloc(size_t count, size_t size);
+  void *__real_realloc(void *ptr, size_t size);
+
+  void *__wrap_malloc(size_t size)
+  {
+    noteAllocation();
+    return __real_malloc(size);
+  }
+
+  void *__wrap_calloc(size_t count, size_t size)
+  {
+    noteAllocation();
+    return __real_calloc(count, size);
+  }
+
+  void *__wrap_realloc(void *ptr, size_t size)
+  {
+    noteAllocation();
+    return __real_realloc(ptr, size);
+  }
+}
+
+void allocAuditArm()
+{
+  auditedAllocations = 0;
+  auditedTask = xTaskGetCurrentTaskHandle();
+}
+
+uint32_t allocAuditDisarm()
+{
+  auditedTask = NULL;
+  return auditedAllocations;
+}
+
+#else
+
+void allocAuditArm() {}
+uint32_t allocAuditDisarm() { return 0; }
+
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Arduino.h>
+
+// ============================================================================
+// ALLOCATION AUDIT
+// ============================================================================
+//
+// Counts heap allocations made by the calling task between arm and disarm.
+// Only builds with ALLOC_AUDIT=1 (env:esp32dev-alloc-audit) count anything:
+// they wrap malloc/calloc/realloc at link time. In normal builds both calls
+// are no-ops and allocAuditEnabled() is false.
+
+#ifndef ALLOC_AUDIT
+#define ALLOC_AUDIT 0
+#endif
+
+inline bool allocAuditEnabled() { return ALLOC_AUDIT != 0; }
+
+void allocAuditArm();
+uint32_t allocAuditDisarm();
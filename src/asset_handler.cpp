@@ -0,0 +1,59 @@
+#include "asset_handler.h"
+
+namespace
+{
+const char *CACHE_IMMUTABLE = "public, max-age=31536000, immutable";
+const char *CACHE_REVALIDATE = "no-cache";
+} // namespace
+
+size_t AssetHandler::totalBytes() const
+{
+  size_t total = 0;
+  for (size_t i = 0; i < WEB_ASSET_COUNT; i++)
+    total += WEB_ASSETS[i].length;
+  return total;
+}
+
+bool AssetHandler::canHandle(AsyncWebServerRequest *request) const
+{
+  return request->method() == HTTP_GET && find(request->url()) != NULL;
+}
+
+void AssetHandler::handleRequest(AsyncWebServerRequest *request)
+{
+  const WebAsset *asset = find(request->url());
+  if (asset == NULL)
+  {
+    request->send(404, "text/plain", "Not Found");
+    return;
+  }
+
+  const char *cacheControl = asset->immutable ? CACHE_IMMUTABLE : CACHE_REVALIDATE;
+
+  if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == asset->etag)
+  {
+    AsyncWebServerResponse *response = request->beginResponse(304);
+    response->addHeader("ETag", asset->etag);
+    response->addHeader("Cache-Control", cacheControl);
+    request->send(response);
+    return;
+  }
+
+  // Bodies are stored gzipped only; every browser the dashboard targets
+  // accepts gzip. The response reads from the flash array as it sends.
+  AsyncWebServerResponse *response = request->beginResponse(200, asset->contentType, asset->body, asset->length);
+  response->addHeader("Content-Encoding", "gzip");
+  response->addHeader("Cache-Control", cacheControl);
+  response->addHeader("ETag", asset->etag);
+  request->send(response);
+}
+
+const WebAsset *AssetHandler::find(const String &url)
+{
+  for (size_t i = 0; i < WEB_ASSET_COUNT; i++)
+  {
+    if (url == WEB_ASSETS[i].url)
+      return &WEB_ASSETS[i];
+  }
+  return NULL;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "web_assets.h"
+
+// ============================================================================
+// STATIC ASSETS
+// ============================================================================
+//
+// Serves the dashboard from the table in web_assets.h. Bodies are sent
+// straight out of flash, already gzipped, so a request costs a table lookup
+// and no filesystem access; the UI works even with an empty LittleFS.
+//
+// Hashed files never change behind their URL and are cached by the browser
+// for a year. Pages keep their names and are revalidated on every visit; as
+// long as the ETag matches they are answered with a bodiless 304.
+
+class AssetHandler : public AsyncWebHandler
+{
+public:
+  size_t count() const { return WEB_ASSET_COUNT; }
+  size_t totalBytes() const;
+
+  bool canHandle(AsyncWebServerRequest *request) const override;
+  void handleRequest(AsyncWebServerRequest *request) override;
+
+private:
+  static const WebAsset *find(const String &url);
+};
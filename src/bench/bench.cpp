@@ -0,0 +1,98 @@
+#include "bench.h"
+
+#if !defined(ARDUINO_ARCH_ESP32)
+#include <chrono>
+#endif
+
+namespace
+{
+#if defined(ARDUINO_ARCH_ESP32)
+const char *BENCH_PLATFORM = "esp32";
+#else
+const char *BENCH_PLATFORM = "native";
+#endif
+} // namespace
+
+// ============================================================================
+// TIMER
+// ============================================================================
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+// 32-bit cycle counter: rounds must stay under 2^32 cycles (~17 s at 240 MHz)
+void BenchTimer::start()
+{
+  _start = ESP.getCycleCount();
+}
+
+void BenchTimer::stop(uint64_t &ns, uint64_t &cycles)
+{
+  cycles = (uint32_t)(ESP.getCycleCount() - (uint32_t)_start);
+  ns = cycles * 1000 / getCpuFrequencyMhz();
+}
+
+#else
+
+void BenchTimer::start()
+{
+  _start = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void BenchTimer::stop(uint64_t &ns, uint64_t &cycles)
+{
+  uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  ns = now - _start;
+  cycles = 0;
+}
+
+#endif
+
+// ============================================================================
+// RESULTS
+// ============================================================================
+
+void BenchRunner::begin(const char *version)
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  uint32_t cpuMHz = getCpuFrequencyMhz();
+#else
+  uint32_t cpuMHz = 0;
+#endif
+  _out.printf("{\"suite\":\"toll-gate\",\"version\":\"%s\",\"platform\":\"%s\",\"cpuMHz\":%lu,\"rounds\":%lu}\n",
+              version, BENCH_PLATFORM, (unsigned long)cpuMHz, (unsigned long)BENCH_ROUNDS);
+}
+
+void BenchRunner::end()
+{
+  _out.printf("{\"done\":true}\n");
+}
+
+void BenchRunner::skip(const char *name, uint32_t n, const char *reason)
+{
+  _out.printf("{\"bench\":\"%s\",\"n\":%lu,\"skipped\":\"%s\"}\n", name, (unsigned long)n, reason);
+}
+
+void BenchRunner::addRound(Totals &totals, uint64_t ns, uint64_t cycles, uint32_t ops)
+{
+  double nsPerOp = (double)ns / ops;
+  if (totals.ops == 0 || nsPerOp < totals.minNsPerOp)
+    totals.minNsPerOp = nsPerOp;
+  if (totals.ops == 0 || nsPerOp > totals.maxNsPerOp)
+    totals.maxNsPerOp = nsPerOp;
+
+  totals.ns += ns;
+  totals.cycles += cycles;
+  totals.ops += ops;
+}
+
+void BenchRunner::report(const char *name, uint32_t n, const Totals &totals, uint32_t bytes)
+{
+  _out.printf("{\"bench\":\"%s\",\"n\":%lu,\"ops\":%lu,\"nsPerOp\":%.1f,\"minNsPerOp\":%.1f,\"maxNsPerOp\":%.1f",
+              name, (unsigned long)n, (unsigned long)totals.ops, (double)totals.ns / totals.ops,
+              totals.minNsPerOp, totals.maxNsPerOp);
+  if (totals.cycles > 0)
+    _out.printf(",\"cyclesPerOp\":%.1f", (double)totals.cycles / totals.ops);
+  if (bytes > 0)
+    _out.printf(",\"bytes\":%lu", (unsigned long)bytes);
+  _out.printf("}\n");
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <Arduino.h>
+
+// ============================================================================
+// BENCHMARK RUNNER
+// ============================================================================
+//
+// Times an operation over BENCH_ROUNDS rounds of a fixed number of calls and
+// prints one JSON object per line, so a run can be saved and compared with
+// another (tools/bench_compare.py):
+//
+//   {"bench":"tag.lookup","n":1000,"ops":5000,"nsPerOp":412.6,
+//    "minNsPerOp":405.1,"maxNsPerOp":430.0,"cyclesPerOp":99.0}
+//
+// n is the size of the data set the operation ran against (0 if none).
+// On the ESP32 rounds are timed with the CPU cycle counter and cyclesPerOp
+// is reported; the host build times them with a nanosecond clock and leaves
+// it out. minNsPerOp/maxNsPerOp are the fastest and slowest round.
+
+const uint32_t BENCH_ROUNDS = 5;
+
+class BenchTimer
+{
+public:
+  void start();
+  // Elapsed since start(); cycles stay 0 where there is no cycle counter
+  void stop(uint64_t &ns, uint64_t &cycles);
+
+private:
+  uint64_t _start = 0;
+};
+
+class BenchRunner
+{
+public:
+  explicit BenchRunner(Print &out) : _out(out) {}
+
+  // First line of a run: which build, on what
+  void begin(const char *version);
+  void end();
+
+  // Calls op(i) batch times per round, i counting on across rounds, after
+  // one untimed call. bytes, if given, is reported with the result.
+  template <typename Op>
+  void run(const char *name, uint32_t n, uint32_t batch, Op op, uint32_t bytes = 0)
+  {
+    op(0);
+
+    Totals totals = {};
+    uint32_t i = 0;
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++)
+    {
+      BenchTimer timer;
+      timer.start();
+      for (uint32_t call = 0; call < batch; call++)
+        op(i++);
+
+      uint64_t ns, cycles;
+      timer.stop(ns, cycles);
+      addRound(totals, ns, cycles, batch);
+    }
+    report(name, n, totals, bytes);
+  }
+
+  // A benchmark that could not run here, with why
+  void skip(const char *name, uint32_t n, const char *reason);
+
+private:
+  struct Totals
+  {
+    uint64_t ns;
+    uint64_t cycles;
+    uint32_t ops;
+    double minNsPerOp;
+    double maxNsPerOp;
+  };
+
+  static void addRound(Totals &totals, uint64_t ns, uint64_t cycles, uint32_t ops);
+  void report(const char *name, uint32_t n, const Totals &totals, uint32_t bytes);
+
+  Print &_out;
+};
@@ -0,0 +1,474 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+
+#include "bench.h"
+#include "json_stream.h"
+#include "pass_log.h"
+#include "pass_writer.h"
+#include "record_schema.h"
+#include "rfid_framer.h"
+#include "tag_id.h"
+#include "tag_table.h"
+#include "vehicle_registry.h"
+
+#if !defined(ARDUINO_ARCH_ESP32)
+#include <unistd.h>
+#endif
+
+// ============================================================================
+// BENCHMARK SUITE
+// ============================================================================
+//
+// The detection and storage hot paths on synthetic vehicles:
+//
+//   rfid.decode          pack and validate one 4-byte frame
+//   rfid.frame           one frame through the framer (framing and dedupe)
+//   detect.pass          one pass from its first byte to the queued log
+//                        entry, flash excluded: three frames, tag lookup,
+//                        entry CRC and the pass writer's queue
+//   tag.lookup           RAM tag table hit, n vehicles registered
+//   registry.get         registry lookup on flash, n vehicles registered
+//   pass.append          one pass appended and flushed
+//   pass.batch           PASS_FLUSH_BATCH passes written with one flush
+//   list.json            the whole /vehicle/list body for n vehicles,
+//   list.msgpack           streamed in web-server-sized chunks
+//   list.registry        list.json with the rows read from the registry
+//   record.json.encode   one vehicle to and from its JSON row text
+//   record.json.decode
+//   record.csv.encode    one vehicle to and from its CSV line
+//   record.csv.decode
+//
+// env:esp32dev-bench runs the suite once at boot and prints the results on
+// the serial port; env:native-bench is the same suite as a host program
+// (-d sets the data directory). Registry and pass-log files are created
+// under /bench* and removed afterwards. The registry and the tag table
+// hold at most REGISTRY_MAX_VEHICLES, so their benchmarks skip the larger
+// sizes.
+
+#ifndef BENCH_VERSION
+#define BENCH_VERSION "unknown"
+#endif
+
+namespace
+{
+const uint32_t BENCH_SIZES[] = {100, 1000, 5000};
+const size_t BENCH_POOL = 64;      // distinct vehicles the list rows cycle through
+const size_t BENCH_TEXT_POOL = 16; // pre-encoded rows for the decode benchmarks
+const size_t BENCH_CHUNK = 1024;   // what the web server asks a stream for
+const size_t BENCH_JSON_ROW = 256;
+const size_t BENCH_CSV_LINE = recordMaxLineLength<VehicleRecord>();
+
+// Calls per round for in-RAM work, and for anything that writes flash
+const uint32_t RAM_BATCH = 2000;
+const uint32_t LIST_BATCH = 4;
+const uint32_t FLASH_BATCH = 20;
+
+const char *BENCH_REGISTRY = "/bench_vehicles.db";
+const char *BENCH_PASSLOG = "/bench_passlog";
+
+VehicleRecord pool[BENCH_POOL];
+char poolJson[BENCH_TEXT_POOL][BENCH_JSON_ROW];
+char poolCsv[BENCH_TEXT_POOL][BENCH_CSV_LINE];
+
+// Grows to the largest size run; TagTable never frees
+TagTable tagTable;
+
+StaticJsonDocument<JSON_STREAM_ROW_SIZE> recordDoc;
+
+// Results go here so the compiler cannot drop the work
+volatile uint32_t sink = 0;
+
+// Distinct and valid for every index the suite uses
+uint32_t benchTag(uint32_t i)
+{
+  return 0xA0000000u ^ (i * 2654435761u);
+}
+
+void unpackTag(uint32_t tag, uint8_t *bytes)
+{
+  bytes[0] = tag >> 24;
+  bytes[1] = tag >> 16;
+  bytes[2] = tag >> 8;
+  bytes[3] = tag;
+}
+
+void makeVehicle(uint32_t i, VehicleRecord &record)
+{
+  record = VehicleRecord();
+  record.tag = benchTag(i);
+  snprintf(record.plateNo, sizeof(record.plateNo), "BNC %04lu", (unsigned long)i);
+  snprintf(record.type, sizeof(record.type), "Car");
+  snprintf(record.owner, sizeof(record.owner), "Bench Owner %lu", (unsigned long)i);
+  snprintf(record.role, sizeof(record.role), "Student");
+  snprintf(record.year, sizeof(record.year), "%lu", (unsigned long)(i % 4 + 1));
+  snprintf(record.section, sizeof(record.section), "Section %c", (char)('A' + i % 6));
+  snprintf(record.course, sizeof(record.course), "Computer Science, Year %lu", (unsigned long)(i % 4 + 1));
+}
+
+void preparePool()
+{
+  for (size_t i = 0; i < BENCH_POOL; i++)
+    makeVehicle(i, pool[i]);
+
+  for (size_t i = 0; i < BENCH_TEXT_POOL; i++)
+  {
+    recordDoc.clear();
+    recordToJson(recordDoc.to<JsonObject>(), pool[i]);
+    serializeJson(recordDoc, poolJson[i], sizeof(poolJson[i]));
+    recordToLine(pool[i], ',', true, poolCsv[i], sizeof(poolCsv[i]));
+  }
+}
+
+// Rows for the first n vehicles, cycling through the pool
+JsonRowSource poolRows(uint32_t n)
+{
+  uint32_t next = 0;
+  return [next, n](JsonObject row) mutable
+  {
+    if (next >= n)
+      return JSON_ROW_END;
+    recordToJson(row, pool[next++ % BENCH_POOL]);
+    return JSON_ROW_READY;
+  };
+}
+
+JsonRowSource registryRows(VehicleRegistry &registry)
+{
+  uint16_t cursor = 0;
+  return [&registry, cursor](JsonObject row) mutable
+  {
+    VehicleRecord record;
+    if (!registry.next(cursor, record))
+      return JSON_ROW_END;
+    recordToJson(row, record);
+    return JSON_ROW_READY;
+  };
+}
+
+// Drains a list stream the way a response would; returns the body size
+size_t streamList(JsonRowSource rows, WireFormat format)
+{
+  JsonArrayStream stream(rows, format);
+  uint8_t chunk[BENCH_CHUNK];
+  size_t total = 0;
+  size_t written;
+  while ((written = stream.fill(chunk, sizeof(chunk))) > 0)
+    total += written;
+  return total;
+}
+
+void removeBenchFiles()
+{
+  LittleFS.remove(BENCH_REGISTRY);
+
+  File dir = LittleFS.open(BENCH_PASSLOG);
+  if (!dir)
+    return;
+
+  File file = dir.openNextFile();
+  while (file)
+  {
+    String path = String(BENCH_PASSLOG) + "/" + file.name();
+    file.close();
+    LittleFS.remove(path.c_str());
+    file = dir.openNextFile();
+  }
+  dir.close();
+  LittleFS.rmdir(BENCH_PASSLOG);
+}
+
+// ============================================================================
+// DETECTION
+// ============================================================================
+
+void benchDecode(BenchRunner &bench)
+{
+  uint8_t frames[BENCH_POOL][EXPECTED_BYTES];
+  for (size_t i = 0; i < BENCH_POOL; i++)
+    unpackTag(i % 8 == 0 ? 0 : benchTag(i), frames[i]); // some noise frames
+
+  bench.run("rfid.decode", 0, RAM_BATCH, [&frames](uint32_t i)
+            {
+              uint32_t tag = packTag(frames[i % BENCH_POOL]);
+              sink += isValidTag(tag); });
+}
+
+// Clock is simulated: every frame is followed by the gap that ends it
+void benchFramer(BenchRunner &bench)
+{
+  RfidFramer framer;
+  unsigned long now = 0;
+
+  bench.run("rfid.frame", 0, RAM_BATCH, [&framer, &now](uint32_t i)
+            {
+              uint8_t frame[EXPECTED_BYTES];
+              unpackTag(benchTag(i / MIN_CONSECUTIVE_READS), frame);
+              framer.feed(frame, sizeof(frame), now);
+              now += FRAME_GAP_MS + 1;
+
+              uint32_t tag;
+              if (framer.update(now, tag))
+                sink += tag; });
+}
+
+void benchDetection(BenchRunner &bench, uint32_t n)
+{
+  RfidFramer framer;
+  unsigned long now = 0;
+  QueueHandle_t queue = xQueueCreate(PASS_QUEUE_DEPTH, sizeof(PassEntry));
+
+  bench.run("detect.pass", n, RAM_BATCH / MIN_CONSECUTIVE_READS, [&framer, &now, queue, n](uint32_t i)
+            {
+              uint8_t frame[EXPECTED_BYTES];
+              unpackTag(benchTag(i % n), frame);
+
+              uint32_t tag = 0;
+              bool confirmed = false;
+              for (int read = 0; read < MIN_CONSECUTIVE_READS; read++)
+              {
+                framer.feed(frame, sizeof(frame), now);
+                now += FRAME_GAP_MS + 1;
+                confirmed = framer.update(now, tag);
+              }
+              if (!confirmed)
+                return;
+
+              TagInfo info;
+              PassEntry entry = {i + 1, tag, (uint32_t)now, 0, 0};
+              if (tagTable.lookup(tag, info))
+                entry.flags |= PASS_FLAG_REGISTERED;
+              entry.crc = PassLog::checksum(entry);
+
+              // The writer task's side, so the queue never fills
+              xQueueSend(queue, &entry, 0);
+              xQueueReceive(queue, &entry, 0);
+              sink += entry.crc; });
+
+  vQueueDelete(queue);
+}
+
+bool loadTagTable(uint32_t n)
+{
+  tagTable.clear();
+  for (uint32_t i = 0; i < n; i++)
+  {
+    VehicleRecord record = pool[i % BENCH_POOL];
+    record.tag = benchTag(i);
+    if (!tagTable.put(record))
+      return false;
+  }
+  return true;
+}
+
+void skipTagTable(BenchRunner &bench, uint32_t n, const char *reason)
+{
+  bench.skip("tag.lookup", n, reason);
+  bench.skip("detect.pass", n, reason);
+}
+
+void benchTagLookup(BenchRunner &bench, uint32_t n)
+{
+  bench.run("tag.lookup", n, RAM_BATCH, [n](uint32_t i)
+            {
+              TagInfo info;
+              sink += tagTable.lookup(benchTag(i % n), info); });
+}
+
+// ============================================================================
+// STORAGE
+// ============================================================================
+
+void skipRegistry(BenchRunner &bench, uint32_t n, const char *reason)
+{
+  bench.skip("registry.get", n, reason);
+  bench.skip("list.registry", n, reason);
+}
+
+void benchRegistry(BenchRunner &bench, uint32_t n)
+{
+  if (n > REGISTRY_MAX_VEHICLES)
+  {
+    skipRegistry(bench, n, "registry holds at most REGISTRY_MAX_VEHICLES");
+    return;
+  }
+
+  LittleFS.remove(BENCH_REGISTRY);
+  VehicleRegistry registry;
+  if (!registry.begin(LittleFS, BENCH_REGISTRY))
+  {
+    skipRegistry(bench, n, "registry file could not be created");
+    return;
+  }
+
+  for (uint32_t i = 0; i < n; i++)
+  {
+    VehicleRecord record = pool[i % BENCH_POOL];
+    record.tag = benchTag(i);
+    registry.put(record);
+  }
+  registry.sync();
+
+  bench.run("registry.get", n, RAM_BATCH / 10, [&registry, n](uint32_t i)
+            {
+              VehicleRecord record;
+              sink += registry.get(benchTag(i * 7919 % n), record); });
+
+  size_t bytes = streamList(registryRows(registry), WIRE_FORMAT_JSON);
+  bench.run("list.registry", n, LIST_BATCH, [&registry](uint32_t i)
+            { sink += streamList(registryRows(registry), WIRE_FORMAT_JSON); }, bytes);
+}
+
+void benchPassLog(BenchRunner &bench)
+{
+  removeBenchFiles();
+  PassLog log;
+  if (!log.begin(LittleFS, BENCH_PASSLOG))
+  {
+    bench.skip("pass.append", 0, "pass log could not be created");
+    bench.skip("pass.batch", PASS_FLUSH_BATCH, "pass log could not be created");
+    return;
+  }
+
+  // Timestamps keep rising across both benchmarks, as the log requires
+  bench.run("pass.append", 0, FLASH_BATCH, [&log](uint32_t i)
+            { sink += log.append(benchTag(i), log.lastTimestamp() + 1, 0); });
+
+  bench.run("pass.batch", PASS_FLUSH_BATCH, FLASH_BATCH, [&log](uint32_t i)
+            {
+              PassEntry batch[PASS_FLUSH_BATCH];
+              uint32_t timestamp = log.lastTimestamp() + 1;
+              for (size_t k = 0; k < PASS_FLUSH_BATCH; k++)
+                batch[k] = log.prepare(benchTag(i + k), timestamp, 0);
+              sink += log.write(batch, PASS_FLUSH_BATCH); });
+}
+
+// ============================================================================
+// ENCODING
+// ============================================================================
+
+void benchList(BenchRunner &bench, uint32_t n)
+{
+  size_t jsonBytes = streamList(poolRows(n), WIRE_FORMAT_JSON);
+  bench.run("list.json", n, LIST_BATCH, [n](uint32_t i)
+            { sink += streamList(poolRows(n), WIRE_FORMAT_JSON); }, jsonBytes);
+
+  size_t msgPackBytes = streamList(poolRows(n), WIRE_FORMAT_MSGPACK);
+  bench.run("list.msgpack", n, LIST_BATCH, [n](uint32_t i)
+            { sink += streamList(poolRows(n), WIRE_FORMAT_MSGPACK); }, msgPackBytes);
+}
+
+void benchRecords(BenchRunner &bench)
+{
+  bench.run("record.json.encode", 0, RAM_BATCH, [](uint32_t i)
+            {
+              char text[BENCH_JSON_ROW];
+              recordDoc.clear();
+              recordToJson(recordDoc.to<JsonObject>(), pool[i % BENCH_POOL]);
+              sink += serializeJson(recordDoc, text, sizeof(text)); });
+
+  bench.run("record.json.decode", 0, RAM_BATCH, [](uint32_t i)
+            {
+              VehicleRecord record;
+              const char *text = poolJson[i % BENCH_TEXT_POOL];
+              if (!deserializeJson(recordDoc, text) &&
+                  recordFromJson(recordDoc.as<JsonObjectConst>(), record) == NULL)
+                sink += record.tag; });
+
+  bench.run("record.csv.encode", 0, RAM_BATCH, [](uint32_t i)
+            {
+              char line[BENCH_CSV_LINE];
+              sink += recordToLine(pool[i % BENCH_POOL], ',', true, line, sizeof(line)); });
+
+  // Includes copying the line, which the parser splits in place
+  bench.run("record.csv.decode", 0, RAM_BATCH, [](uint32_t i)
+            {
+              char line[BENCH_CSV_LINE];
+              memcpy(line, poolCsv[i % BENCH_TEXT_POOL], sizeof(line));
+              VehicleRecord record;
+              if (recordFromLine(line, ',', true, record) == NULL)
+                sink += record.tag; });
+}
+
+void runSuite()
+{
+  BenchRunner bench(Serial);
+  bench.begin(BENCH_VERSION);
+  preparePool();
+
+  benchDecode(bench);
+  benchFramer(bench);
+  benchRecords(bench);
+
+  for (uint32_t n : BENCH_SIZES)
+  {
+    if (n > REGISTRY_MAX_VEHICLES)
+      skipTagTable(bench, n, "tag table holds at most REGISTRY_MAX_VEHICLES");
+    else if (!loadTagTable(n))
+      skipTagTable(bench, n, "not enough memory for the tag table");
+    else
+    {
+      benchTagLookup(bench, n);
+      benchDetection(bench, n);
+    }
+
+    benchList(bench, n);
+    benchRegistry(bench, n);
+  }
+
+  benchPassLog(bench);
+  removeBenchFiles();
+
+  bench.end();
+}
+} // namespace
+
+// ============================================================================
+// ENTRY POINTS
+// ============================================================================
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+void setup()
+{
+  Serial.begin(115200);
+  delay(1000);
+
+  if (!LittleFS.begin(true))
+  {
+    Serial.println("ERROR: LittleFS Mount Failed!");
+    return;
+  }
+  runSuite();
+}
+
+void loop()
+{
+  delay(1000);
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+  int option;
+  while ((option = getopt(argc, argv, "d:")) != -1)
+  {
+    if (option != 'd')
+    {
+      fprintf(stderr, "usage: %s [-d data-dir]\n", argv[0]);
+      return 2;
+    }
+    setNativeDataDir(optarg);
+  }
+
+  if (!LittleFS.begin(true))
+  {
+    Serial.println("ERROR: Cannot use data directory " + String(nativeDataDir()));
+    return 1;
+  }
+  runSuite();
+  return 0;
+}
+
+#endif
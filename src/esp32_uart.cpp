@@ -0,0 +1,72 @@
+#include "esp32_uart.h"
+
+namespace
+{
+const int UART_RX_BUFFER = 256;
+const int UART_EVENT_QUEUE = 16;
+const uint8_t UART_RX_TIMEOUT_SYMBOLS = 3; // ~3 ms at 9600 baud
+} // namespace
+
+bool Esp32Uart::begin(uart_port_t port, int rxPin, int txPin, uint32_t baud)
+{
+  _port = port;
+
+  uart_config_t config = {};
+  config.baud_rate = baud;
+  config.data_bits = UART_DATA_8_BITS;
+  config.parity = UART_PARITY_DISABLE;
+  config.stop_bits = UART_STOP_BITS_1;
+  config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+  config.source_clk = UART_SCLK_APB;
+
+  if (uart_driver_install(_port, UART_RX_BUFFER, 0, UART_EVENT_QUEUE, &_events, 0) != ESP_OK ||
+      uart_param_config(_port, &config) != ESP_OK ||
+      uart_set_pin(_port, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK)
+    return false;
+
+  // Raise a data event a few byte-times after the line goes quiet, so a
+  // 4-byte frame arrives as one event rather than waiting for the FIFO
+  // threshold.
+  uart_set_rx_timeout(_port, UART_RX_TIMEOUT_SYMBOLS);
+  return true;
+}
+
+int Esp32Uart::read(uint8_t *buffer, size_t size, uint32_t timeoutMs)
+{
+  TickType_t wait = timeoutMs == UART_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+  uart_event_t event;
+  if (xQueueReceive(_events, &event, wait) != pdTRUE)
+    return 0;
+
+  switch (event.type)
+  {
+  case UART_DATA:
+  {
+    // Drain whatever the driver holds, not only this event's share, so the
+    // rest of a burst doesn't wait a frame for the next event. Later events
+    // for bytes taken here find less or nothing and return early.
+    size_t total = 0;
+    size_t buffered = event.size;
+    while (buffered > 0 && total < size)
+    {
+      size_t length = buffered < size - total ? buffered : size - total;
+      int read = uart_read_bytes(_port, buffer + total, length, 0);
+      if (read <= 0)
+        break;
+      total += read;
+      if (uart_get_buffered_data_len(_port, &buffered) != ESP_OK)
+        break;
+    }
+    return (int)total;
+  }
+
+  case UART_FIFO_OVF:
+  case UART_BUFFER_FULL:
+    uart_flush_input(_port);
+    xQueueReset(_events);
+    return UART_READ_OVERFLOW;
+
+  default:
+    return 0;
+  }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/uart.h>
+
+#include "uart_port.h"
+
+// ============================================================================
+// ESP32 UART
+// ============================================================================
+//
+// UartPort over the ESP-IDF driver. read() sleeps on the driver's event
+// queue, so bytes are handed over as soon as the RX timeout fires rather than
+// when the FIFO threshold is reached.
+
+class Esp32Uart : public UartPort
+{
+public:
+  bool begin(uart_port_t port, int rxPin, int txPin, uint32_t baud);
+
+  int read(uint8_t *buffer, size_t size, uint32_t timeoutMs) override;
+
+private:
+  uart_port_t _port = UART_NUM_1;
+  QueueHandle_t _events = NULL;
+};
@@ -0,0 +1,138 @@
+#include "event_ring.h"
+
+namespace
+{
+class RingLock
+{
+public:
+  explicit RingLock(SemaphoreHandle_t mutex) : _mutex(mutex) { xSemaphoreTake(_mutex, portMAX_DELAY); }
+  ~RingLock() { xSemaphoreGive(_mutex); }
+
+private:
+  SemaphoreHandle_t _mutex;
+};
+} // namespace
+
+bool EventRing::begin(AsyncEventSource &source)
+{
+  _source = &source;
+  _lastId = esp_random();
+  if (_lastId == 0)
+    _lastId = 1; // 0 means "no ID" on the wire
+
+  _mutex = xSemaphoreCreateMutex();
+  _sendMutex = xSemaphoreCreateMutex();
+  if (_mutex == NULL || _sendMutex == NULL)
+    return false;
+
+  _source->onConnect([this](AsyncEventSourceClient *client)
+                     { onConnect(client); });
+  return true;
+}
+
+// The library calls onConnect() holding its client lock, which send() on
+// the source takes too, so the ring lock is never held across a send:
+// the record is stored under it and broadcast after. _sendMutex only
+// keeps broadcasts in ID order; onConnect() never takes it.
+void EventRing::send(const char *message, const char *event)
+{
+  if (_source == NULL)
+    return;
+
+  RingLock sendLock(_sendMutex);
+
+  Record record;
+  {
+    RingLock lock(_mutex);
+
+    uint32_t id = _lastId + 1;
+    if (id == 0)
+      id = 1;
+
+    record.id = id;
+    strncpy(record.event, event != NULL ? event : "", sizeof(record.event) - 1);
+    record.event[sizeof(record.event) - 1] = '\0';
+    strncpy(record.data, message, sizeof(record.data) - 1);
+    record.data[sizeof(record.data) - 1] = '\0';
+
+    _records[id % EVENT_RING_SIZE] = record;
+    if (_count < EVENT_RING_SIZE)
+      _count++;
+    _lastId = id;
+  }
+
+  _source->send(record.data, event, record.id);
+  _sent++;
+}
+
+void EventRing::keepAlive()
+{
+  if (_source != NULL)
+    _source->send("ping", NULL, 0);
+}
+
+EventRingStats EventRing::stats() const
+{
+  EventRingStats stats;
+  stats.lastId = _lastId;
+  stats.sent = _sent;
+  stats.replayed = _replayed;
+  stats.resyncs = _resyncs;
+  return stats;
+}
+
+// Runs on the async TCP task when a browser (re)connects, inside the
+// library's client lock. Records are copied out one at a time under the
+// ring lock and sent after it is released. An event stored but not yet
+// broadcast when the client joined reaches it twice, once here and once
+// live; that is preferred to losing it.
+void EventRing::onConnect(AsyncEventSourceClient *client)
+{
+  uint32_t since = client->lastId();
+  if (since == 0)
+    return; // first connection, nothing was missed
+
+  uint32_t last;
+  bool inRing;
+  {
+    RingLock lock(_mutex);
+    last = _lastId;
+    // Unsigned distances, so IDs may wrap
+    inRing = last - since <= _count;
+  }
+
+  if (last == since)
+    return;
+
+  if (!inRing)
+  {
+    // The gap is gone from the ring (or the ID predates a reboot). The ID on
+    // the resync moves the client's resume point up to now.
+    client->send("", "resync", last);
+    _resyncs++;
+    return;
+  }
+
+  for (uint32_t id = since + 1; id != last + 1; id++)
+  {
+    if (id == 0)
+      continue;
+
+    Record record;
+    {
+      RingLock lock(_mutex);
+      record = _records[id % EVENT_RING_SIZE];
+    }
+
+    // Overwritten by newer events while replaying
+    if (record.id != id)
+    {
+      client->send("", "resync", last);
+      _resyncs++;
+      return;
+    }
+
+    client->send(record.data, record.event[0] != '\0' ? record.event : NULL, record.id);
+    _replayed++;
+  }
+}
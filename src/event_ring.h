@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+// ============================================================================
+// SSE REPLAY RING
+// ============================================================================
+//
+// Front end for the /events source. Every event gets the next ID and is kept
+// in a small RAM ring, so a browser that reconnects with Last-Event-ID is
+// sent just the events it missed. If the gap has already fallen out of the
+// ring (or the ID is from before a reboot) it gets a single "resync" event
+// instead and should reload whatever it shows.
+//
+// IDs start from a random value at boot, so an ID from before a reboot never
+// looks like a recent one. Keep-alives carry no ID and are not kept, so they
+// never move a client's resume point.
+
+const size_t EVENT_RING_SIZE = 32;
+const size_t EVENT_NAME_MAX = 16;
+const size_t EVENT_DATA_MAX = 96; // longer messages are cut
+
+struct EventRingStats
+{
+  uint32_t lastId;
+  uint32_t sent;
+  uint32_t replayed;
+  uint32_t resyncs;
+};
+
+class EventRing
+{
+public:
+  bool begin(AsyncEventSource &source);
+
+  // Safe to call from any task
+  void send(const char *message, const char *event);
+  void keepAlive();
+
+  EventRingStats stats() const;
+
+private:
+  struct Record
+  {
+    uint32_t id;
+    char event[EVENT_NAME_MAX];
+    char data[EVENT_DATA_MAX];
+  };
+
+  void onConnect(AsyncEventSourceClient *client);
+
+  AsyncEventSource *_source = NULL;
+  SemaphoreHandle_t _mutex = NULL;
+  SemaphoreHandle_t _sendMutex = NULL; // orders broadcasts by ID
+
+  // Holds the events with IDs after _lastId - _count; guarded by _mutex
+  Record _records[EVENT_RING_SIZE];
+  size_t _count = 0;
+  volatile uint32_t _lastId = 0;
+
+  volatile uint32_t _sent = 0;
+  volatile uint32_t _replayed = 0;
+  volatile uint32_t _resyncs = 0;
+};
@@ -0,0 +1,16 @@
+#include "fingerprint_sensor.h"
+
+uint8_t FingerprintSensor::readIndexTable(uint8_t page, uint8_t *table)
+{
+  uint8_t command[] = {FINGERPRINT_READINDEXTABLE, page};
+  Adafruit_Fingerprint_Packet packet(FINGERPRINT_COMMANDPACKET, sizeof(command), command);
+  writeStructuredPacket(packet);
+
+  if (getStructuredPacket(&packet) != FINGERPRINT_OK || packet.type != FINGERPRINT_ACKPACKET)
+    return FINGERPRINT_PACKETRECIEVEERR;
+
+  // Confirmation code followed by the page bitmap
+  if (packet.data[0] == FINGERPRINT_OK)
+    memcpy(table, &packet.data[1], FINGERPRINT_INDEX_PAGE_BYTES);
+  return packet.data[0];
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_Fingerprint.h>
+
+// ============================================================================
+// FINGERPRINT SENSOR DRIVER
+// ============================================================================
+//
+// Adafruit_Fingerprint plus the commands the library does not wrap. The
+// index table is the sensor's own occupancy bitmap: each page covers 256
+// template slots in 32 bytes, least significant bit first, so the whole
+// library is read in one or a few packets instead of one loadModel() per slot.
+
+#ifndef FINGERPRINT_READINDEXTABLE
+#define FINGERPRINT_READINDEXTABLE 0x1F
+#endif
+
+const uint16_t FINGERPRINT_INDEX_PAGE_SLOTS = 256;
+const size_t FINGERPRINT_INDEX_PAGE_BYTES = FINGERPRINT_INDEX_PAGE_SLOTS / 8;
+
+class FingerprintSensor : public Adafruit_Fingerprint
+{
+public:
+  explicit FingerprintSensor(HardwareSerial *serial) : Adafruit_Fingerprint(serial) {}
+
+  // Any other byte stream, such as the host build's serial device
+  explicit FingerprintSensor(Stream *serial) : Adafruit_Fingerprint(serial) {}
+
+  // Reads one page of the template index into table (32 bytes). Returns the
+  // sensor's confirmation code.
+  uint8_t readIndexTable(uint8_t page, uint8_t *table);
+};
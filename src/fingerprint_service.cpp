@@ -0,0 +1,365 @@
+#include "fingerprint_service.h"
+
+namespace
+{
+const uint32_t FINGERPRINT_STACK_SIZE = 4096;
+const UBaseType_t FINGERPRINT_PRIORITY = 3; // above storage, below the web server
+const uint32_t ENROLL_POLL_MS = 20;
+const unsigned long ENROLL_TIMEOUT_MS = 10000;
+const unsigned long PROMPT_DELAY_MS = 1000;
+} // namespace
+
+bool FingerprintService::begin(FingerprintSensor &finger, FingerprintEventHandler onEvent)
+{
+  _finger = &finger;
+  _onEvent = onEvent;
+
+  if (_finger->getParameters() == FINGERPRINT_OK && _finger->capacity > 0)
+    _capacity = _finger->capacity < FINGERPRINT_MAX_SLOTS ? _finger->capacity : FINGERPRINT_MAX_SLOTS;
+
+  if (!loadIndex())
+    Serial.println("⚠ Fingerprint index table unreadable, list starts empty");
+
+  _urgent = xQueueCreate(1, sizeof(Command *));
+  _admin = xQueueCreate(FINGERPRINT_QUEUE_DEPTH, sizeof(Command *));
+  if (_urgent == NULL || _admin == NULL)
+    return false;
+
+  return xTaskCreate(taskEntry, "fingerprint", FINGERPRINT_STACK_SIZE, this,
+                     FINGERPRINT_PRIORITY, &_task) == pdPASS;
+}
+
+// ============================================================================
+// REQUESTS
+// ============================================================================
+
+bool FingerprintService::startEnrollment(int id)
+{
+  // Claim the enrollment slot first so two requests cannot both start one
+  portENTER_CRITICAL(&_lock);
+  bool busy = _enrolling;
+  _enrolling = true;
+  portEXIT_CRITICAL(&_lock);
+  if (busy)
+    return false;
+
+  Command *command = new Command();
+  command->type = CMD_ENROLL;
+  command->id = id;
+  if (!submit(_urgent, command))
+  {
+    _enrolling = false;
+    return false;
+  }
+  return true;
+}
+
+FingerprintSet FingerprintService::enrolledTemplates()
+{
+  portENTER_CRITICAL(&_lock);
+  FingerprintSet enrolled = _enrolled;
+  portEXIT_CRITICAL(&_lock);
+  return enrolled;
+}
+
+bool FingerprintService::deleteTemplate(int id, FingerprintCallback done)
+{
+  Command *command = new Command();
+  command->type = CMD_DELETE;
+  command->id = id;
+  command->done = done;
+  return submit(_admin, command);
+}
+
+bool FingerprintService::deleteAllTemplates(FingerprintCallback done)
+{
+  Command *command = new Command();
+  command->type = CMD_DELETE_ALL;
+  command->done = done;
+  return submit(_admin, command);
+}
+
+bool FingerprintService::submit(QueueHandle_t queue, Command *command)
+{
+  if (queue == NULL || xQueueSend(queue, &command, 0) != pdTRUE)
+  {
+    delete command;
+    return false;
+  }
+
+  xTaskNotifyGive(_task);
+  return true;
+}
+
+// ============================================================================
+// FINGERPRINT TASK
+// ============================================================================
+
+void FingerprintService::taskEntry(void *param)
+{
+  static_cast<FingerprintService *>(param)->run();
+}
+
+// Each pass issues at most one enrollment step and one admin command, so the
+// two take turns on the UART.
+void FingerprintService::run()
+{
+  while (true)
+  {
+    Command *command;
+    if (xQueueReceive(_urgent, &command, 0) == pdTRUE)
+    {
+      _enrollId = command->id;
+      _enrollStage = 0;
+      delete command;
+
+      Serial.println("\n--- Starting Enrollment for ID " + String(_enrollId) + " ---");
+      _onEvent("Starting enrollment process...", "status");
+      stepEnrollment();
+    }
+    else if (_enrolling && _enrollId > 0)
+    {
+      stepEnrollment();
+    }
+
+    bool more = false;
+    if (xQueueReceive(_admin, &command, 0) == pdTRUE)
+    {
+      runAdmin(*command);
+      if (command->done)
+        command->done(command->result);
+      delete command;
+      more = uxQueueMessagesWaiting(_admin) > 0;
+    }
+
+    TickType_t wait = portMAX_DELAY;
+    if (more)
+      wait = 0;
+    else if (_enrolling)
+      wait = pdMS_TO_TICKS(ENROLL_POLL_MS);
+    ulTaskNotifyTake(pdTRUE, wait);
+  }
+}
+
+void FingerprintService::runAdmin(Command &command)
+{
+  FingerprintResult &result = command.result;
+
+  switch (command.type)
+  {
+  case CMD_DELETE:
+    result.code = _finger->deleteModel(command.id);
+    if (result.code == FINGERPRINT_OK)
+      markEnrolled(command.id, false);
+    break;
+
+  case CMD_DELETE_ALL:
+    // One empty-library command instead of a delete per slot
+    result.ids = enrolledTemplates();
+    for (int id = 0; id < _capacity; id++)
+    {
+      if (result.ids.has(id))
+        result.deleted++;
+    }
+
+    result.code = _finger->emptyDatabase();
+    if (result.code == FINGERPRINT_OK)
+    {
+      portENTER_CRITICAL(&_lock);
+      memset(&_enrolled, 0, sizeof(_enrolled));
+      portEXIT_CRITICAL(&_lock);
+    }
+    else
+    {
+      result.failed = result.deleted;
+      result.deleted = 0;
+      memset(&result.ids, 0, sizeof(result.ids));
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+// ============================================================================
+// OCCUPANCY INDEX
+// ============================================================================
+
+bool FingerprintService::loadIndex()
+{
+  FingerprintSet enrolled = {};
+  uint8_t table[FINGERPRINT_INDEX_PAGE_BYTES];
+
+  for (int first = 0; first < _capacity; first += FINGERPRINT_INDEX_PAGE_SLOTS)
+  {
+    if (_finger->readIndexTable(first / FINGERPRINT_INDEX_PAGE_SLOTS, table) != FINGERPRINT_OK)
+      return false;
+
+    for (int slot = 0; slot < FINGERPRINT_INDEX_PAGE_SLOTS && first + slot < _capacity; slot++)
+    {
+      if (table[slot >> 3] & (1 << (slot & 7)))
+        enrolled.add(first + slot);
+    }
+  }
+
+  portENTER_CRITICAL(&_lock);
+  _enrolled = enrolled;
+  portEXIT_CRITICAL(&_lock);
+  return true;
+}
+
+void FingerprintService::markEnrolled(int id, bool enrolled)
+{
+  if (id < 0 || id >= _capacity)
+    return;
+
+  portENTER_CRITICAL(&_lock);
+  if (enrolled)
+    _enrolled.add(id);
+  else
+    _enrolled.remove(id);
+  portEXIT_CRITICAL(&_lock);
+}
+
+// ============================================================================
+// ENROLLMENT
+// ============================================================================
+
+void FingerprintService::endEnrollment()
+{
+  _enrollStage = 0;
+  _enrollId = -1;
+  _enrolling = false;
+}
+
+void FingerprintService::stepEnrollment()
+{
+  // Initialize stage timing
+  if (_enrollStage == 0)
+  {
+    _enrollStage = 1;
+    _stageStartTime = millis();
+    _onEvent("Place your finger on the sensor", "prompt");
+    Serial.println("Stage 1: Waiting for finger...");
+    return;
+  }
+
+  // Stage 1: Get first image
+  if (_enrollStage == 1)
+  {
+    int result = _finger->getImage();
+
+    if (result == FINGERPRINT_OK)
+    {
+      Serial.println("✓ Image captured");
+      _onEvent("Image captured, processing...", "status");
+
+      result = _finger->image2Tz(1);
+      if (result == FINGERPRINT_OK)
+      {
+        Serial.println("✓ Image converted");
+        _enrollStage = 2;
+        _stageStartTime = millis();
+        _onEvent("Remove your finger", "prompt");
+        Serial.println("Stage 2: Waiting for finger removal...");
+      }
+      else
+      {
+        Serial.println("✗ Image conversion failed");
+        _onEvent("Image quality too low, please try again", "error");
+        endEnrollment();
+      }
+    }
+    else if (result == FINGERPRINT_NOFINGER)
+    {
+      // Still waiting for finger
+      if (millis() - _stageStartTime > ENROLL_TIMEOUT_MS)
+      {
+        _onEvent("Timeout - please try again", "error");
+        endEnrollment();
+      }
+    }
+    else
+    {
+      Serial.println("✗ Error getting image: " + String(result));
+      _onEvent("Sensor error, please try again", "error");
+      endEnrollment();
+    }
+  }
+
+  // Stage 2: Wait for finger removal
+  else if (_enrollStage == 2)
+  {
+    if (_finger->getImage() == FINGERPRINT_NOFINGER)
+    {
+      _enrollStage = 3;
+      _stageStartTime = millis();
+      _onEvent("Place the SAME finger again", "prompt");
+      Serial.println("Stage 3: Waiting for same finger again...");
+    }
+  }
+
+  // Stage 3: Get second image, after giving the user time to see the prompt
+  else if (_enrollStage == 3 && millis() - _stageStartTime > PROMPT_DELAY_MS)
+  {
+    int result = _finger->getImage();
+
+    if (result == FINGERPRINT_OK)
+    {
+      Serial.println("✓ Second image captured");
+      _onEvent("Image captured, processing...", "status");
+
+      result = _finger->image2Tz(2);
+      if (result != FINGERPRINT_OK)
+      {
+        Serial.println("✗ Second image conversion failed");
+        _onEvent("Image quality too low, please try again", "error");
+        endEnrollment();
+        return;
+      }
+      Serial.println("✓ Second image converted");
+
+      // Create model
+      result = _finger->createModel();
+      if (result == FINGERPRINT_ENROLLMISMATCH)
+      {
+        Serial.println("✗ Fingerprints do not match");
+        _onEvent("Fingerprints did not match, please try again", "error");
+        endEnrollment();
+        return;
+      }
+      if (result != FINGERPRINT_OK)
+      {
+        Serial.println("✗ Failed to create model: " + String(result));
+        _onEvent("Failed to process fingerprint", "error");
+        endEnrollment();
+        return;
+      }
+      Serial.println("✓ Fingerprint model created");
+
+      // Store model
+      if (_finger->storeModel(_enrollId) == FINGERPRINT_OK)
+      {
+        markEnrolled(_enrollId, true);
+        Serial.println("✓ Fingerprint stored at ID " + String(_enrollId));
+        _onEvent("Fingerprint enrolled successfully! ID: " + String(_enrollId), "done");
+      }
+      else
+      {
+        Serial.println("✗ Failed to store model");
+        _onEvent("Failed to save fingerprint", "error");
+      }
+      endEnrollment();
+    }
+    else if (result == FINGERPRINT_NOFINGER)
+    {
+      // Still waiting
+      if (millis() - _stageStartTime > ENROLL_TIMEOUT_MS)
+      {
+        _onEvent("Timeout - please try again", "error");
+        endEnrollment();
+      }
+    }
+  }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+
+#include "fingerprint_sensor.h"
+#include "fingerprint_set.h"
+
+// ============================================================================
+// FINGERPRINT SERVICE
+// ============================================================================
+//
+// Single owner of the fingerprint sensor UART. Every sensor command runs on
+// one task, so packets from the web server and from enrollment can no longer
+// interleave on the wire, and no caller ever waits on a 57600-baud round trip.
+//
+// Commands come in two priorities. Enrollment is urgent and, once started,
+// runs as a sequence of single round-trip steps. Admin commands (deleting
+// templates) are taken one at a time between enrollment steps. Results are
+// delivered through callbacks that run on the fingerprint task.
+//
+// Which slots hold a template is read once from the sensor's index table and
+// then kept in RAM, updated on every store and delete, so listing enrolled
+// fingerprints never touches the UART.
+
+const int FINGERPRINT_DEFAULT_CAPACITY = 128;
+const size_t FINGERPRINT_QUEUE_DEPTH = 8;
+
+struct FingerprintResult
+{
+  uint8_t code;       // sensor status of a single-template command
+  FingerprintSet ids; // delete all: slots cleared
+  int deleted;
+  int failed;
+};
+
+typedef std::function<void(const FingerprintResult &)> FingerprintCallback;
+
+// Enrollment progress for the dashboard: message plus SSE event name
+typedef std::function<void(const String &message, const char *event)> FingerprintEventHandler;
+
+class FingerprintService
+{
+public:
+  // Reads the sensor's index table before the task starts, so the
+  // occupancy bitmap is valid from the first request.
+  bool begin(FingerprintSensor &finger, FingerprintEventHandler onEvent);
+
+  // Returns false if an enrollment is already running or the queue is full.
+  bool startEnrollment(int id);
+  bool enrolling() const { return _enrolling; }
+
+  // Valid IDs are 1..maxId(), following the sensor's reported capacity
+  int maxId() const { return _capacity - 1; }
+  FingerprintSet enrolledTemplates();
+
+  bool deleteTemplate(int id, FingerprintCallback done);
+  bool deleteAllTemplates(FingerprintCallback done);
+
+private:
+  enum CommandType
+  {
+    CMD_ENROLL,
+    CMD_DELETE,
+    CMD_DELETE_ALL
+  };
+
+  struct Command
+  {
+    CommandType type;
+    int id;
+    FingerprintCallback done;
+    FingerprintResult result;
+  };
+
+  bool submit(QueueHandle_t queue, Command *command);
+  static void taskEntry(void *param);
+  void run();
+
+  void stepEnrollment();
+  void endEnrollment();
+  void runAdmin(Command &command);
+  bool loadIndex();
+  void markEnrolled(int id, bool enrolled);
+
+  FingerprintSensor *_finger = NULL;
+  FingerprintEventHandler _onEvent;
+
+  QueueHandle_t _urgent = NULL;
+  QueueHandle_t _admin = NULL;
+  TaskHandle_t _task = NULL;
+  portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+
+  int _capacity = FINGERPRINT_DEFAULT_CAPACITY;
+  FingerprintSet _enrolled = {};
+
+  volatile bool _enrolling = false;
+  int _enrollId = -1;
+  int _enrollStage = 0;
+  unsigned long _stageStartTime = 0;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// ============================================================================
+// FINGERPRINT SLOTS
+// ============================================================================
+//
+// Which sensor template slots are in use. Kept apart from the fingerprint
+// service so storage can name slots without pulling in the sensor driver.
+
+const int FINGERPRINT_MAX_SLOTS = 1024; // largest library among supported sensors
+
+// Template slots as a bitmap
+struct FingerprintSet
+{
+  uint32_t bits[FINGERPRINT_MAX_SLOTS / 32];
+
+  void add(int id) { bits[id >> 5] |= 1u << (id & 31); }
+  void remove(int id) { bits[id >> 5] &= ~(1u << (id & 31)); }
+  bool has(int id) const { return (bits[id >> 5] >> (id & 31)) & 1; }
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "asset_handler.h"
+#include "event_ring.h"
+#include "fingerprint_service.h"
+#include "list_cache.h"
+#include "pass_channel.h"
+#include "pass_log.h"
+#include "pass_writer.h"
+#include "rfid_reader.h"
+#include "storage_service.h"
+#include "tag_table.h"
+#include "vehicle_registry.h"
+#include "vehicle_transfer.h"
+
+// ============================================================================
+// GATE
+// ============================================================================
+//
+// What the web routes (web_routes.cpp) and the pass handling
+// (gate_passes.cpp) share. main.cpp defines the objects on the device and
+// native/host_main.cpp on the host, so both builds serve the same routes
+// and log passes the same way.
+
+// Room for the vehicle list of a full registry at about 64 bytes of
+// MessagePack a row: a plate, a name and a few short codes. A list of
+// longer rows still streams, it is just not kept.
+const size_t VEHICLE_LIST_CACHE_ROW_BYTES = 64;
+const size_t VEHICLE_LIST_CACHE_BYTES = REGISTRY_MAX_VEHICLES * VEHICLE_LIST_CACHE_ROW_BYTES;
+
+extern AsyncWebServer server;
+extern AsyncEventSource events;
+extern EventRing eventRing;
+extern AssetHandler assets;
+extern PassChannel passChannel;
+extern VehicleRegistry registry;
+extern TagTable tagTable;
+extern PassLog passLog;
+extern PassWriter passWriter;
+extern RfidReader rfidReader;
+extern StorageService storage;
+extern ListCache vehicleListCache;
+extern VehicleImporter vehicleImporter;
+extern FingerprintService fingerprint;
+
+// Pass counters, defined in gate_passes.cpp
+extern int vehicleCount;
+extern unsigned long sessionStart;
+extern uint32_t tagLookups;
+extern uint32_t tagLookupCycles;
+extern uint32_t tagLookupMaxCycles;
+
+// The gate clock that timestamps passes, in seconds. It starts from the last
+// logged pass, so it never goes back across reboots, and becomes Unix time
+// once a dashboard sets it (/clock). Without a set it counts seconds of
+// operation.
+//
+// setGateClock() only moves the clock forward. Once it has been set since
+// boot, it also refuses a time more than GATE_CLOCK_MAX_SKEW away from the
+// gate's, so one client with a wrong clock cannot push every later pass
+// into the future. It returns false for a time it refused.
+//
+// correctGateClock() sets any time, earlier ones included, and lets the pass
+// log carry on from it. It is for undoing a bad set.
+const uint32_t GATE_CLOCK_MAX_SKEW = 600;
+
+void startGateClock(uint32_t lastTimestamp);
+uint32_t gateTime();
+bool setGateClock(uint32_t unixTime);
+bool correctGateClock(uint32_t unixTime);
+bool gateClockSynced();
+
+// Moves a pass log with millisecond timestamps from dir into passLog
+void migrateMillisecondPassLog(fs::FS &fs, const char *dir);
+
+// Every route of the dashboard; the caller adds the event source and the
+// pass channel and starts the server
+void setupServerRoutes();
+
+// Logs, publishes and announces the passes the RFID reader task has
+// confirmed. Call from loop().
+void handleRFIDDetections();
+PassEntry handleRFIDDetection(const RfidDetection &detection);
@@ -0,0 +1,258 @@
+#include "gate.h"
+
+#include <esp_timer.h>
+
+#include "tag_id.h"
+
+namespace
+{
+// setGateClock() takes nothing earlier as Unix time (2020-01-01)
+const uint32_t GATE_CLOCK_MIN_UNIX = 1577836800;
+
+// Gate time at clockBaseMicros; set from any task, read by the pass path
+portMUX_TYPE clockLock = portMUX_INITIALIZER_UNLOCKED;
+uint32_t clockBase = 0;
+int64_t clockBaseMicros = 0;
+bool clockSynced = false;
+} // namespace
+
+// ============================================================================
+// PASS STATE
+// ============================================================================
+
+int vehicleCount = 0;
+unsigned long sessionStart = 0;
+
+// Tag lookup timing, reported by /stats
+uint32_t tagLookups = 0;
+uint32_t tagLookupCycles = 0;
+uint32_t tagLookupMaxCycles = 0;
+
+bool lookupTag(uint32_t tag, TagInfo &info);
+PassEntry logVehiclePass(uint32_t tag, uint32_t seenAt);
+
+// ============================================================================
+// GATE CLOCK
+// ============================================================================
+
+void startGateClock(uint32_t lastTimestamp)
+{
+  portENTER_CRITICAL(&clockLock);
+  clockBase = lastTimestamp;
+  clockBaseMicros = esp_timer_get_time();
+  portEXIT_CRITICAL(&clockLock);
+}
+
+// The 64-bit timer keeps this exact however long the gate stays up
+uint32_t gateTime()
+{
+  portENTER_CRITICAL(&clockLock);
+  uint32_t now = clockBase + (uint32_t)((esp_timer_get_time() - clockBaseMicros) / 1000000);
+  portEXIT_CRITICAL(&clockLock);
+  return now;
+}
+
+bool setGateClock(uint32_t unixTime)
+{
+  if (unixTime < GATE_CLOCK_MIN_UNIX)
+    return false;
+
+  portENTER_CRITICAL(&clockLock);
+  int64_t micros = esp_timer_get_time();
+  uint32_t now = clockBase + (uint32_t)((micros - clockBaseMicros) / 1000000);
+  uint32_t skew = unixTime >= now ? unixTime - now : now - unixTime;
+
+  // Before the first set the gate may have been off for any length of
+  // time; after it, it keeps time well enough to doubt a large jump. A time
+  // a little behind is the same time, and only confirms the clock.
+  bool accepted = unixTime >= now ? !clockSynced || skew <= GATE_CLOCK_MAX_SKEW : skew <= GATE_CLOCK_MAX_SKEW;
+  if (accepted)
+  {
+    if (unixTime > now)
+    {
+      clockBase = unixTime;
+      clockBaseMicros = micros;
+    }
+    clockSynced = true;
+  }
+  portEXIT_CRITICAL(&clockLock);
+  return accepted;
+}
+
+bool correctGateClock(uint32_t unixTime)
+{
+  if (unixTime < GATE_CLOCK_MIN_UNIX)
+    return false;
+
+  // Before the clock moves, so no pass is held at the old time after it
+  passLog.rebase(unixTime);
+
+  portENTER_CRITICAL(&clockLock);
+  clockBase = unixTime;
+  clockBaseMicros = esp_timer_get_time();
+  clockSynced = true;
+  portEXIT_CRITICAL(&clockLock);
+
+  Serial.println("⚠ Gate clock corrected to " + String(unixTime));
+  return true;
+}
+
+bool gateClockSynced()
+{
+  portENTER_CRITICAL(&clockLock);
+  bool synced = clockSynced;
+  portEXIT_CRITICAL(&clockLock);
+  return synced;
+}
+
+// ============================================================================
+// PASS LOG MIGRATION
+// ============================================================================
+
+// Until the gate clock, pass timestamps were milliseconds of total uptime,
+// which wrap after 49.7 days, and the log lived in dir. Copies its entries
+// into passLog as seconds and removes it; the copies get new sequence
+// numbers.
+void migrateMillisecondPassLog(fs::FS &fs, const char *dir)
+{
+  if (!fs.exists(dir))
+    return;
+
+  Serial.println("\n--- Migrating pass log to gate clock seconds ---");
+
+  uint32_t migrated = 0;
+  {
+    PassLog old;
+    if (old.begin(fs, dir))
+    {
+      PassEntry entry;
+      uint32_t cursor = old.firstSeq();
+      while (old.next(cursor, entry))
+      {
+        if (passLog.append(entry.tag, entry.timestamp / 1000, entry.flags))
+          migrated++;
+      }
+    }
+  }
+
+  // One file at a time, reopening the directory after each removal
+  while (true)
+  {
+    fs::File root = fs.open(dir);
+    fs::File file = root ? root.openNextFile() : fs::File();
+    if (!file)
+      break;
+    String path = String(dir) + "/" + file.name();
+    file.close();
+    root.close();
+    if (!fs.remove(path.c_str()))
+      break;
+  }
+  fs.rmdir(dir);
+
+  Serial.println("✓ Migrated " + String((unsigned long)migrated) + " passes");
+  Serial.println("---------------------------------------\n");
+}
+
+// ============================================================================
+// RFID FUNCTIONS
+// ============================================================================
+
+// ===============================
+// HANDLE RFID DETECTIONS
+// ===============================
+// Framing and dedupe run in the RFID reader task; this only drains the passes
+// it has confirmed.
+void handleRFIDDetections()
+{
+  RfidDetection detection;
+
+  while (rfidReader.poll(detection))
+    handleRFIDDetection(detection);
+}
+
+PassEntry handleRFIDDetection(const RfidDetection &detection)
+{
+  vehicleCount++;
+  PassEntry entry = logVehiclePass(detection.tag, detection.seenAt);
+
+  // Send SSE notification
+  char message[32] = "Vehicle detected: ";
+  formatTagHex(detection.tag, message + strlen(message));
+  eventRing.send(message, "rfid");
+  return entry;
+}
+
+// Resolves a tag against the RAM table; never touches flash
+bool lookupTag(uint32_t tag, TagInfo &info)
+{
+  uint32_t start = ESP.getCycleCount();
+  bool found = tagTable.lookup(tag, info);
+  uint32_t cycles = ESP.getCycleCount() - start;
+
+  tagLookups++;
+  tagLookupCycles += cycles;
+  if (cycles > tagLookupMaxCycles)
+    tagLookupMaxCycles = cycles;
+
+  return found;
+}
+
+// ===============================
+// LOG VEHICLE PASS
+// ===============================
+// Returns the pass as queued for the log (seq 0 if the queue was full)
+PassEntry logVehiclePass(uint32_t tag, uint32_t seenAt)
+{
+  unsigned long sessionTime = seenAt - sessionStart;
+  char tagHex[TAG_HEX_LENGTH + 1];
+  formatTagHex(tag, tagHex);
+
+  Serial.println("\n--- VEHICLE DETECTED ---");
+  Serial.print("Vehicle #");
+  Serial.println(vehicleCount);
+  Serial.print("Tag ID: ");
+  Serial.println(tagHex);
+  Serial.print("Time: ");
+  Serial.print(sessionTime / 1000);
+  Serial.println("s");
+
+  // Check if this vehicle is registered
+  TagInfo vehicle;
+  uint16_t flags = 0;
+
+  if (lookupTag(tag, vehicle))
+  {
+    flags |= PASS_FLAG_REGISTERED;
+    Serial.println("  Registered Vehicle:");
+    Serial.print("  Plate: ");
+    Serial.println(vehicle.plateNo);
+    Serial.print("  Owner: ");
+    Serial.println(vehicle.owner);
+    Serial.print("  Role: ");
+    Serial.println(vehicle.role);
+  }
+  else
+  {
+    Serial.println("  ⚠ Unregistered vehicle!");
+  }
+
+  Serial.println("------------------------\n");
+
+  // Queue the pass event; the writer task batches it to flash
+  PassEntry entry;
+  uint32_t timestamp = gateTime();
+  if (!passWriter.submit(tag, timestamp, flags, &entry))
+  {
+    Serial.println("✗ Pass queue full, event dropped");
+
+    // Still shown live, just without a log sequence number
+    entry.seq = 0;
+    entry.tag = tag;
+    entry.timestamp = timestamp;
+    entry.flags = flags;
+  }
+
+  passChannel.publish(entry, (flags & PASS_FLAG_REGISTERED) ? vehicle.plateNo : NULL);
+  return entry;
+}
@@ -0,0 +1,100 @@
+#include "json_stream.h"
+
+size_t JsonArrayStream::fill(uint8_t *buffer, size_t maxLen)
+{
+  size_t written = 0;
+
+  while (written < maxLen)
+  {
+    if (_pendingSent == _pendingLength)
+    {
+      JsonRowStatus status = refill();
+      if (status == JSON_ROW_BUSY && written == 0)
+        return JSON_STREAM_BUSY;
+      if (status != JSON_ROW_READY)
+        break;
+    }
+
+    size_t chunk = _pendingLength - _pendingSent;
+    if (chunk > maxLen - written)
+      chunk = maxLen - written;
+    memcpy(buffer + written, _pending + _pendingSent, chunk);
+    _pendingSent += chunk;
+    written += chunk;
+  }
+  return written;
+}
+
+// Loads the next piece of output (opening bracket, one row, or the closing
+// bracket; MessagePack has only rows) into the pending buffer. Returns
+// JSON_ROW_END when everything is sent, or JSON_ROW_BUSY, with nothing
+// pending, if the row source was.
+JsonRowStatus JsonArrayStream::refill()
+{
+  _pendingLength = 0;
+  _pendingSent = 0;
+
+  if (!_started && _format == WIRE_FORMAT_JSON)
+  {
+    _started = true;
+    _pending[_pendingLength++] = '[';
+    return JSON_ROW_READY;
+  }
+
+  if (_finished)
+    return JSON_ROW_END;
+
+  while (true)
+  {
+    _row.clear();
+    JsonRowStatus status = _next(_row.to<JsonObject>());
+    if (status == JSON_ROW_BUSY)
+      return JSON_ROW_BUSY;
+    if (status == JSON_ROW_END)
+    {
+      _finished = true;
+      if (_format != WIRE_FORMAT_JSON)
+        return JSON_ROW_END;
+      _pending[_pendingLength++] = ']';
+      return JSON_ROW_READY;
+    }
+
+    if (encodeRow())
+      return JSON_ROW_READY;
+
+    Serial.println("✗ List row too long to stream, skipped");
+  }
+}
+
+// Encodes _row into the pending buffer. Returns false, leaving it empty, if
+// the row does not fit.
+bool JsonArrayStream::encodeRow()
+{
+  if (_format == WIRE_FORMAT_MSGPACK)
+  {
+    BufferPrint out((uint8_t *)_pending, sizeof(_pending));
+    MsgPackWriter writer(out);
+    JsonObjectConst row = _row.as<JsonObjectConst>();
+    uint32_t shape = _rows == 0 ? rowShape(row) : _shape;
+    if (_rows == 0)
+      writer.columns(row);
+    writer.row(row, shape);
+    if (out.overflowed())
+      return false;
+
+    _shape = shape;
+    _rows++;
+    _pendingLength = out.length();
+    return true;
+  }
+
+  size_t separator = _rows > 0 ? 1 : 0;
+  if (separator + measureJson(_row) >= sizeof(_pending))
+    return false;
+
+  if (separator)
+    _pending[_pendingLength++] = ',';
+  _pendingLength += serializeJson(_row, _pending + _pendingLength, sizeof(_pending) - _pendingLength);
+  _rows++;
+  return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+
+#include "wire_format.h"
+
+// ============================================================================
+// JSON ARRAY STREAM
+// ============================================================================
+//
+// Serializes a JSON array one row at a time into the chunks the web server
+// asks for, so a list response costs one row of RAM however long it is and is
+// never truncated. The row source fills in the next row and returns
+// JSON_ROW_READY, or JSON_ROW_END once there are no more; it runs on the
+// async_tcp task between chunks, so one whose data is locked by a commit
+// returns JSON_ROW_BUSY instead of waiting, and fill() then reports
+// JSON_STREAM_BUSY for the response to ask again later. In MessagePack the
+// same rows come out as the column-name sequence described in wire_format.h.
+
+const size_t JSON_STREAM_ROW_SIZE = 512;
+
+// Room for the longest row any list streams, serialized with every text
+// character escaped. The row builders check theirs against it; a row that
+// still does not fit is left out and logged rather than cut short.
+const size_t JSON_STREAM_TEXT_SIZE = 1024;
+
+enum JsonRowStatus
+{
+  JSON_ROW_END,
+  JSON_ROW_READY,
+  JSON_ROW_BUSY
+};
+
+typedef std::function<JsonRowStatus(JsonObject row)> JsonRowSource;
+
+// fill(): nothing can be written until the row source is free again
+const size_t JSON_STREAM_BUSY = (size_t)-1;
+
+class JsonArrayStream
+{
+public:
+  explicit JsonArrayStream(JsonRowSource next, WireFormat format = WIRE_FORMAT_JSON) : _next(next), _format(format) {}
+
+  // Writes up to maxLen bytes; returns 0 once the last row is out, or
+  // JSON_STREAM_BUSY if the row source was busy before anything was written.
+  size_t fill(uint8_t *buffer, size_t maxLen);
+
+private:
+  JsonRowStatus refill();
+  bool encodeRow();
+
+  JsonRowSource _next;
+  WireFormat _format;
+  uint32_t _shape = 0;
+  StaticJsonDocument<JSON_STREAM_ROW_SIZE> _row;
+  char _pending[JSON_STREAM_TEXT_SIZE + 2]; // with the comma and terminator
+  size_t _pendingLength = 0;
+  size_t _pendingSent = 0;
+  size_t _rows = 0;
+  bool _started = false;
+  bool _finished = false;
+};
@@ -0,0 +1,290 @@
+#include "list_cache.h"
+
+#include "wire_response.h"
+
+namespace
+{
+// Print that appends to a vector up to a cap; a write past it is dropped
+// and flagged
+class CappedPrint : public Print
+{
+public:
+  CappedPrint(std::vector<uint8_t> &bytes, size_t cap) : _bytes(bytes), _cap(cap) {}
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *data, size_t len) override
+  {
+    if (_overflowed || len > _cap - _bytes.size())
+    {
+      _overflowed = true;
+      return 0;
+    }
+    _bytes.insert(_bytes.end(), data, data + len);
+    return len;
+  }
+
+  bool overflowed() const { return _overflowed; }
+
+private:
+  std::vector<uint8_t> &_bytes;
+  size_t _cap;
+  bool _overflowed = false;
+};
+
+// Row source over a cached body, for JSON clients. Names and values are
+// copied, terminated, into text and only pointed at from the row, which
+// the stream serializes before asking for the next one.
+struct BodyReader
+{
+  explicit BodyReader(const std::vector<uint8_t> &bytes) : reader(bytes.data(), bytes.size()) {}
+
+  bool readColumns();
+  bool readRow(JsonObject row);
+  const char *copy(const MsgPackToken &token);
+  bool readValue(JsonObject row, const char *key);
+
+  MsgPackReader reader;
+  std::vector<char> names;      // column names, each terminated
+  std::vector<size_t> columns; // where each starts in names
+  bool started = false;
+  char text[JSON_STREAM_TEXT_SIZE];
+  size_t textUsed = 0;
+};
+
+bool BodyReader::readColumns()
+{
+  MsgPackToken token;
+  if (!reader.next(token) || token.type != MSGPACK_ARRAY)
+    return false;
+
+  for (uint32_t i = 0; i < token.value; i++)
+  {
+    MsgPackToken name;
+    if (!reader.next(name) || name.type != MSGPACK_STRING)
+      return false;
+    columns.push_back(names.size());
+    names.insert(names.end(), name.text, name.text + name.value);
+    names.push_back('\0');
+  }
+  return true;
+}
+
+bool BodyReader::readRow(JsonObject row)
+{
+  MsgPackToken token;
+  if (!reader.next(token))
+    return false;
+  textUsed = 0;
+
+  // The values alone, in column order
+  if (token.type == MSGPACK_ARRAY)
+  {
+    if (token.value != columns.size())
+      return false;
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+      if (!readValue(row, names.data() + columns[i]))
+        return false;
+    }
+    return true;
+  }
+
+  // A row of another shape, sent whole
+  if (token.type != MSGPACK_MAP)
+    return false;
+  for (uint32_t i = 0; i < token.value; i++)
+  {
+    MsgPackToken name;
+    const char *key;
+    if (!reader.next(name) || name.type != MSGPACK_STRING || (key = copy(name)) == NULL)
+      return false;
+    if (!readValue(row, key))
+      return false;
+  }
+  return true;
+}
+
+const char *BodyReader::copy(const MsgPackToken &token)
+{
+  if (token.value >= sizeof(text) - textUsed)
+    return NULL;
+
+  char *out = text + textUsed;
+  memcpy(out, token.text, token.value);
+  out[token.value] = '\0';
+  textUsed += token.value + 1;
+  return out;
+}
+
+// Rows hold no nested values
+bool BodyReader::readValue(JsonObject row, const char *key)
+{
+  MsgPackToken token;
+  if (!reader.next(token))
+    return false;
+
+  switch (token.type)
+  {
+  case MSGPACK_NIL:
+    row[key] = (const char *)NULL;
+    return true;
+  case MSGPACK_BOOL:
+    row[key] = token.value != 0;
+    return true;
+  case MSGPACK_UINT:
+    row[key] = token.value;
+    return true;
+  case MSGPACK_STRING:
+  {
+    const char *copied = copy(token);
+    if (copied == NULL)
+      return false;
+    row[key] = copied;
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+} // namespace
+
+// A streamed response that encodes each row it sends into the body as well
+struct ListCache::Recording
+{
+  Recording(JsonRowSource rows, uint32_t version, WireFormat format, ListVersionSource currentVersion, size_t cap)
+      : stream([this](JsonObject row)
+               { return nextRow(row); },
+               format),
+        rows(rows), currentVersion(currentVersion), body(new Body()), print(body->bytes, cap)
+  {
+    body->version = version;
+  }
+
+  JsonRowStatus nextRow(JsonObject row)
+  {
+    JsonRowStatus status = rows(row);
+    if (status != JSON_ROW_READY)
+      return status;
+
+    if (!print.overflowed())
+    {
+      JsonObjectConst recorded = row;
+      MsgPackWriter writer(print);
+      if (rowCount++ == 0)
+      {
+        shape = rowShape(recorded);
+        writer.columns(recorded);
+      }
+      writer.row(recorded, shape);
+      if (print.overflowed())
+        std::vector<uint8_t>().swap(body->bytes);
+    }
+    return JSON_ROW_READY;
+  }
+
+  JsonArrayStream stream;
+  JsonRowSource rows;
+  ListVersionSource currentVersion;
+  std::shared_ptr<Body> body;
+  CappedPrint print;
+  uint32_t rowCount = 0;
+  uint32_t shape = 0;
+  bool finished = false;
+};
+
+AsyncWebServerResponse *ListCache::respond(AsyncWebServerRequest *request, uint32_t version, WireFormat format,
+                                           JsonRowSource rows, ListVersionSource currentVersion)
+{
+  if (_body && _body->version == version)
+  {
+    _hits++;
+    std::shared_ptr<Body> body = _body;
+    if (format != WIRE_FORMAT_MSGPACK)
+      return beginJsonArrayResponse(request, bodyRows(body), format);
+
+    return request->beginResponse(wireContentType(format), body->bytes.size(), [body](uint8_t *buffer, size_t maxLen, size_t index)
+                                  {
+      size_t length = body->bytes.size() - index;
+      if (length > maxLen)
+        length = maxLen;
+      memcpy(buffer, body->bytes.data() + index, length);
+      return length; });
+  }
+
+  // Stale either way; no reason to hold it while the new one records
+  _misses++;
+  _body.reset();
+
+  std::shared_ptr<Recording> recording(new Recording(rows, version, format, currentVersion, _maxBytes));
+  return request->beginChunkedResponse(wireContentType(format), [this, recording](uint8_t *buffer, size_t maxLen, size_t index)
+                                       {
+    size_t written = recording->stream.fill(buffer, maxLen);
+    if (written == 0 && !recording->finished)
+    {
+      recording->finished = true;
+      finish(*recording);
+    }
+    return wireFillResult(written); });
+}
+
+// Rows of body, decoded again; the body is held until the response is done
+JsonRowSource ListCache::bodyRows(std::shared_ptr<Body> body)
+{
+  std::shared_ptr<BodyReader> reader(new BodyReader(body->bytes));
+  return [body, reader](JsonObject row)
+  {
+    if (reader->reader.atEnd())
+      return JSON_ROW_END;
+
+    if (!reader->started)
+    {
+      reader->started = true;
+      if (!reader->readColumns())
+      {
+        Serial.println("✗ Cached list body unreadable");
+        return JSON_ROW_END;
+      }
+      if (reader->reader.atEnd())
+        return JSON_ROW_END;
+    }
+
+    if (reader->readRow(row))
+      return JSON_ROW_READY;
+
+    Serial.println("✗ Cached list body unreadable");
+    return JSON_ROW_END;
+  };
+}
+
+void ListCache::finish(Recording &recording)
+{
+  if (recording.print.overflowed())
+  {
+    _oversize++;
+    return;
+  }
+
+  // A change while streaming means the rows may mix versions
+  if (recording.currentVersion() != recording.body->version)
+    return;
+
+  recording.body->bytes.shrink_to_fit();
+  _body = recording.body;
+  _builds++;
+}
+
+void ListCache::invalidate()
+{
+  _body.reset();
+}
+
+ListCacheStats ListCache::stats() const
+{
+  ListCacheStats stats;
+  stats.hits = _hits;
+  stats.misses = _misses;
+  stats.builds = _builds;
+  stats.oversize = _oversize;
+  stats.bytes = _body ? _body->bytes.size() : 0;
+  return stats;
+}
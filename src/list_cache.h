@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "json_stream.h"
+
+// ============================================================================
+// LIST CACHE
+// ============================================================================
+//
+// Keeps the rows of one list endpoint in RAM as a MessagePack body, tagged
+// with the data version it was built from. A GET for the same version is
+// answered from the buffer: MessagePack clients get it as it is, with a
+// Content-Length, and JSON clients get it re-encoded row by row, which
+// costs no flash reads. A GET for any other version streams the rows as
+// before and records them on the way, so building the cache costs no extra
+// pass over the data.
+//
+// MessagePack is kept rather than the JSON body because it is a fraction of
+// the size: the field names are stored once, not on every row, and nothing
+// is escaped. A recording is only kept if the version did not move while it
+// streamed, so the cache never holds a body mixing two versions, and bodies
+// over the size cap are not kept at all. All calls, and the response
+// fillers, run on the async TCP task, so the cache needs no lock; responses
+// share the buffer, and a body dropped by invalidate() lives until the last
+// of them is done.
+
+typedef std::function<uint32_t()> ListVersionSource;
+
+struct ListCacheStats
+{
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t builds;
+  uint32_t oversize;
+  uint32_t bytes;
+};
+
+class ListCache
+{
+public:
+  explicit ListCache(size_t maxBytes) : _maxBytes(maxBytes) {}
+
+  // Cached body for version, or a streamed one that fills the cache. Send
+  // the result like any other response.
+  AsyncWebServerResponse *respond(AsyncWebServerRequest *request, uint32_t version, WireFormat format,
+                                  JsonRowSource rows, ListVersionSource currentVersion);
+
+  void invalidate();
+
+  ListCacheStats stats() const;
+
+private:
+  struct Body
+  {
+    uint32_t version;
+    std::vector<uint8_t> bytes;
+  };
+
+  struct Recording;
+
+  static JsonRowSource bodyRows(std::shared_ptr<Body> body);
+  void finish(Recording &recording);
+
+  size_t _maxBytes;
+  std::shared_ptr<Body> _body;
+
+  uint32_t _hits = 0;
+  uint32_t _misses = 0;
+  uint32_t _builds = 0;
+  uint32_t _oversize = 0;
+};
@@ -0,0 +1,444 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "fingerprint_sensor.h"
+#include "gate.h"
+#include "pty_uart.h"
+#include "tag_id.h"
+#include "tty_stream.h"
+
+// ============================================================================
+// HOST BUILD (env:native)
+// ============================================================================
+//
+// The toll-gate core as a Linux process: the RFID reader task, tag lookup,
+// the pass writer and the storage task run as on the device, over the shims
+// in lib/native_shims. The RFID UART is a pseudo-terminal whose path is
+// printed at startup; flash and NVS live under the data directory.
+//
+//   .pio/build/native/program [-d data-dir] [-l pty-link] [-i vehicles.csv]
+//                             [-f fingerprint-device] [-p port]
+//
+// -i imports a /vehicle/export CSV file before reading starts. Each
+// confirmed pass is logged and published as on the device and printed as
+// one line:
+//
+//   PASS seq=<n> tag=<hex> seenAt=<ms> registered=<0|1> plate=<plate>
+//
+// -f runs the fingerprint task against a sensor on that serial device,
+// usually the pty of tools/fingerprint_emulator.py. Commands are then read
+// from stdin, one per line: "enroll <id>", "delete <id>", "delete-all" and
+// "list". Enrollment progress and results are printed as FP lines:
+//
+//   FP <event> <message>                    (the dashboard's SSE events)
+//   FP delete id=<n> code=<hex>
+//   FP delete-all deleted=<n> failed=<n> code=<hex>
+//   FP list count=<n> ids=<id>,<id>,...
+//
+// -p serves the dashboard and every route of setupServerRoutes() on
+// 127.0.0.1:<port>, with the /events source and the /ws pass channel, for
+// a browser or tools/http_load.py. Without -f the fingerprint routes answer
+// 503. One route exists only here: /host/stats, the process's allocations
+// and resident memory and the web server's connection and buffer counters.
+
+// Shared with the routes and the pass handling (gate.h)
+AsyncWebServer server(80); // -p picks the port
+AsyncEventSource events("/events");
+EventRing eventRing;
+AssetHandler assets;
+PassChannel passChannel;
+VehicleRegistry registry;
+TagTable tagTable;
+PassLog passLog;
+PassWriter passWriter;
+RfidReader rfidReader;
+StorageService storage;
+ListCache vehicleListCache(VEHICLE_LIST_CACHE_BYTES);
+VehicleImporter vehicleImporter;
+FingerprintService fingerprint;
+
+// pio test -e native links the objects above into each test under test/,
+// which brings its own main()
+#ifndef PIO_UNIT_TESTING
+
+namespace
+{
+const size_t IMPORT_LINE_MAX = 512;
+const size_t IMPORT_BATCH = 16;
+const uint32_t POLL_INTERVAL_MS = 1;
+const uint32_t FINGERPRINT_BAUD = 57600;
+const size_t COMMAND_LINE_MAX = 64;
+const uint32_t KEEP_ALIVE_INTERVAL_MS = 1000;
+
+Preferences preferences;
+PtyUart rfidUart;
+TtyStream fingerprintPort;
+FingerprintSensor finger(&fingerprintPort);
+
+unsigned long lastKeepAlive = 0;
+
+// Waits for the storage task to commit the batch
+bool submitImport(const std::vector<VehicleRecord> &batch)
+{
+  QueueHandle_t done = xQueueCreate(1, sizeof(bool));
+  bool queued = storage.importVehicles(batch.data(), batch.size(), [done](const StorageResult &result)
+                                       { xQueueSend(done, &result.ok, portMAX_DELAY); },
+                                       portMAX_DELAY);
+
+  bool ok = false;
+  if (queued)
+    xQueueReceive(done, &ok, portMAX_DELAY);
+  vQueueDelete(done);
+  return ok;
+}
+
+// Same CSV as /vehicle/import: a header row, then one vehicle per line
+bool importVehicles(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  if (file == NULL)
+  {
+    Serial.println("ERROR: Cannot open " + String(path));
+    return false;
+  }
+
+  std::vector<VehicleRecord> batch;
+  char line[IMPORT_LINE_MAX];
+  size_t lineNo = 0;
+  size_t imported = 0;
+  bool ok = true;
+
+  while (ok && fgets(line, sizeof(line), file) != NULL)
+  {
+    lineNo++;
+    line[strcspn(line, "\r\n")] = '\0';
+    if (lineNo == 1 || line[0] == '\0')
+      continue;
+
+    VehicleRecord record;
+    if (recordFromLine(line, ',', true, record) != NULL)
+    {
+      Serial.println("  ✗ Skipped line " + String((unsigned long)lineNo));
+      continue;
+    }
+
+    batch.push_back(record);
+    if (batch.size() == IMPORT_BATCH)
+    {
+      ok = submitImport(batch);
+      imported += batch.size();
+      batch.clear();
+    }
+  }
+  fclose(file);
+
+  if (ok && !batch.empty())
+  {
+    ok = submitImport(batch);
+    imported += batch.size();
+  }
+
+  if (!ok)
+  {
+    Serial.println("ERROR: Vehicle import failed");
+    return false;
+  }
+  Serial.println("✓ Imported " + String((unsigned long)imported) + " vehicles");
+  return true;
+}
+
+void logPass(const RfidDetection &detection)
+{
+  PassEntry entry = handleRFIDDetection(detection);
+
+  TagInfo vehicle;
+  bool registered = (entry.flags & PASS_FLAG_REGISTERED) && tagTable.lookup(detection.tag, vehicle);
+
+  char tagHex[TAG_HEX_LENGTH + 1];
+  formatTagHex(detection.tag, tagHex);
+  Serial.printf("PASS seq=%lu tag=%s seenAt=%lu registered=%d plate=%s\n", (unsigned long)entry.seq, tagHex,
+                (unsigned long)detection.seenAt, registered ? 1 : 0, registered ? vehicle.plateNo : "");
+}
+
+void printEnrolled()
+{
+  FingerprintSet enrolled = fingerprint.enrolledTemplates();
+  String ids;
+  size_t count = 0;
+  for (int id = 1; id <= fingerprint.maxId(); id++)
+  {
+    if (!enrolled.has(id))
+      continue;
+    if (count++ > 0)
+      ids += ",";
+    ids += String(id);
+  }
+  Serial.printf("FP list count=%u ids=%s\n", (unsigned)count, ids.c_str());
+}
+
+void runCommand(const char *line)
+{
+  char name[COMMAND_LINE_MAX];
+  int id = 0;
+  int fields = sscanf(line, "%63s %d", name, &id);
+  if (fields < 1)
+    return;
+
+  if (strcmp(name, "list") == 0)
+  {
+    printEnrolled();
+  }
+  else if (strcmp(name, "enroll") == 0 && fields == 2)
+  {
+    if (id < 1 || id > fingerprint.maxId())
+      Serial.printf("FP enroll id=%d out of range 1..%d\n", id, fingerprint.maxId());
+    else if (!fingerprint.startEnrollment(id))
+      Serial.printf("FP enroll id=%d busy\n", id);
+  }
+  else if (strcmp(name, "delete") == 0 && fields == 2)
+  {
+    bool queued = fingerprint.deleteTemplate(id, [id](const FingerprintResult &result)
+                                             { Serial.printf("FP delete id=%d code=0x%02X\n", id, result.code); });
+    if (!queued)
+      Serial.printf("FP delete id=%d busy\n", id);
+  }
+  else if (strcmp(name, "delete-all") == 0)
+  {
+    bool queued = fingerprint.deleteAllTemplates([](const FingerprintResult &result)
+                                                 { Serial.printf("FP delete-all deleted=%d failed=%d code=0x%02X\n",
+                                                                 result.deleted, result.failed, result.code); });
+    if (!queued)
+      Serial.println("FP delete-all busy");
+  }
+  else
+  {
+    Serial.println("ERROR: Unknown command: " + String(line));
+  }
+}
+
+// The console stands in for the web routes; it ends with stdin
+void readCommands()
+{
+  char line[COMMAND_LINE_MAX];
+  while (fgets(line, sizeof(line), stdin) != NULL)
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+    runCommand(line);
+  }
+}
+
+bool beginFingerprint(const char *path)
+{
+  if (!fingerprintPort.begin(path, FINGERPRINT_BAUD))
+  {
+    Serial.println("ERROR: Cannot open fingerprint device " + String(path));
+    return false;
+  }
+
+  if (!finger.verifyPassword())
+  {
+    Serial.println("ERROR: Fingerprint sensor not found on " + String(path));
+    return false;
+  }
+
+  // Printed, and sent to the dashboards as on the device
+  if (!fingerprint.begin(finger, [](const String &message, const char *event)
+                         {
+    Serial.printf("FP %s %s\n", event, message.c_str());
+    eventRing.send(message.c_str(), event); }))
+  {
+    Serial.println("ERROR: Fingerprint task could not be started!");
+    return false;
+  }
+  Serial.println("✓ Fingerprint sensor on " + String(path) + " (IDs 1.." + String(fingerprint.maxId()) + ")");
+
+  std::thread(readCommands).detach();
+  return true;
+}
+
+// A "Name:   1234 kB" line of /proc/self/status, in KiB; 0 if missing
+unsigned long procStatusKiB(const char *name)
+{
+  FILE *file = fopen("/proc/self/status", "r");
+  if (file == NULL)
+    return 0;
+
+  char line[128];
+  unsigned long value = 0;
+  size_t nameLength = strlen(name);
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    if (strncmp(line, name, nameLength) == 0 && line[nameLength] == ':')
+    {
+      value = strtoul(line + nameLength + 1, NULL, 10);
+      break;
+    }
+  }
+  fclose(file);
+  return value;
+}
+
+// /host/stats: what only the host can measure, for load tests
+void sendHostStats(AsyncWebServerRequest *request)
+{
+  StaticJsonDocument<512> doc;
+
+  JsonObject heap = doc.createNestedObject("heap");
+  heap["used"] = ESP.heapUsed();
+  heap["peakUsed"] = ESP.peakHeapUsed();
+  heap["rssKiB"] = procStatusKiB("VmRSS");
+  heap["peakRssKiB"] = procStatusKiB("VmHWM");
+
+  NativeServerStats web = server.stats();
+  JsonObject http = doc.createNestedObject("http");
+  http["requests"] = web.requests;
+  http["connections"] = web.connections;
+  http["peakConnections"] = web.peakConnections;
+  http["refused"] = web.refused;
+  http["bufferedBytes"] = web.bufferedBytes;
+  http["peakBufferedBytes"] = web.peakBufferedBytes;
+
+  String output;
+  serializeJson(doc, output);
+  request->send(200, "application/json", output);
+}
+
+// The device's web server setup, on a local port
+bool beginWeb(uint16_t port)
+{
+  if (!eventRing.begin(events))
+  {
+    Serial.println("ERROR: Event ring could not be created!");
+    return false;
+  }
+
+  server.on("/host/stats", HTTP_GET, sendHostStats);
+  setupServerRoutes();
+  server.addHandler(&events);
+  passChannel.begin(server);
+
+  server.setPort(port);
+  server.begin();
+  if (!server.listening())
+    return false;
+
+  Serial.println("✓ Web server on http://127.0.0.1:" + String((unsigned int)port) + " (" +
+                 String(ESP.getFreeHeap()) + " bytes heap free)");
+  return true;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const char *linkPath = NULL;
+  const char *importPath = NULL;
+  const char *fingerprintPath = NULL;
+  long webPort = 0;
+
+  int option;
+  while ((option = getopt(argc, argv, "d:l:i:f:p:")) != -1)
+  {
+    switch (option)
+    {
+    case 'd':
+      setNativeDataDir(optarg);
+      break;
+    case 'l':
+      linkPath = optarg;
+      break;
+    case 'i':
+      importPath = optarg;
+      break;
+    case 'f':
+      fingerprintPath = optarg;
+      break;
+    case 'p':
+      webPort = strtol(optarg, NULL, 10);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-d data-dir] [-l pty-link] [-i vehicles.csv] [-f fingerprint-device] [-p port]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  if (webPort < 0 || webPort > 0xFFFF)
+  {
+    fprintf(stderr, "ERROR: Port must be 1..65535\n");
+    return 2;
+  }
+
+  if (!LittleFS.begin(true) || !preferences.begin("fingerprints", false))
+  {
+    Serial.println("ERROR: Cannot use data directory " + String(nativeDataDir()));
+    return 1;
+  }
+
+  if (!registry.begin(LittleFS, "/vehicles.db") || !tagTable.load(registry))
+  {
+    Serial.println("ERROR: Vehicle registry could not be opened!");
+    return 1;
+  }
+  Serial.println("✓ Vehicle registry ready (" + String((unsigned long)registry.count()) + " vehicles)");
+
+  if (!passLog.begin(LittleFS, "/passes"))
+  {
+    Serial.println("ERROR: Pass log could not be opened!");
+    return 1;
+  }
+  migrateMillisecondPassLog(LittleFS, "/passlog");
+  startGateClock(passLog.lastTimestamp());
+  if (!passWriter.begin(passLog))
+  {
+    Serial.println("ERROR: Pass writer task could not be started!");
+    return 1;
+  }
+  Serial.println("✓ Pass log ready (" + String((unsigned long)passLog.count()) + " passes)");
+
+  if (!storage.begin(preferences, registry, tagTable))
+  {
+    Serial.println("ERROR: Storage task could not be started!");
+    return 1;
+  }
+
+  if (importPath != NULL && !importVehicles(importPath))
+    return 1;
+
+  if (fingerprintPath != NULL && !beginFingerprint(fingerprintPath))
+    return 1;
+
+  if (webPort > 0 && !beginWeb(webPort))
+    return 1;
+
+  sessionStart = millis();
+  if (!rfidUart.begin(linkPath) || !rfidReader.begin(rfidUart, 1))
+  {
+    Serial.println("ERROR: RFID pty could not be opened!");
+    return 1;
+  }
+  Serial.println("✓ RFID reader on " + String(rfidUart.path()));
+  if (linkPath != NULL)
+    Serial.println("  (linked from " + String(linkPath) + ")");
+
+  while (true)
+  {
+    RfidDetection detection;
+    while (rfidReader.poll(detection))
+      logPass(detection);
+    passChannel.pump();
+
+    if (millis() - lastKeepAlive > KEEP_ALIVE_INTERVAL_MS)
+    {
+      eventRing.keepAlive();
+      lastKeepAlive = millis();
+    }
+    delay(POLL_INTERVAL_MS);
+  }
+}
+
+#endif // PIO_UNIT_TESTING
@@ -0,0 +1,61 @@
+#include "pty_uart.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+PtyUart::~PtyUart()
+{
+  if (_slave >= 0)
+    close(_slave);
+  if (_master >= 0)
+    close(_master);
+}
+
+bool PtyUart::begin(const char *linkPath)
+{
+  _master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (_master < 0 || grantpt(_master) != 0 || unlockpt(_master) != 0)
+    return false;
+
+  const char *name = ptsname(_master);
+  if (name == NULL)
+    return false;
+  strncpy(_path, name, sizeof(_path) - 1);
+  _path[sizeof(_path) - 1] = '\0';
+
+  _slave = open(_path, O_RDWR | O_NOCTTY);
+  if (_slave < 0)
+    return false;
+
+  // Bytes through untouched: no echo, no line editing, no CR/LF mapping
+  struct termios mode;
+  if (tcgetattr(_slave, &mode) != 0)
+    return false;
+  cfmakeraw(&mode);
+  if (tcsetattr(_slave, TCSANOW, &mode) != 0)
+    return false;
+
+  if (linkPath != NULL)
+  {
+    unlink(linkPath);
+    if (symlink(_path, linkPath) != 0)
+      return false;
+  }
+  return true;
+}
+
+int PtyUart::read(uint8_t *buffer, size_t size, uint32_t timeoutMs)
+{
+  struct pollfd ready = {_master, POLLIN, 0};
+  int timeout = timeoutMs == UART_WAIT_FOREVER ? -1 : (int)timeoutMs;
+  if (poll(&ready, 1, timeout) <= 0)
+    return 0;
+
+  ssize_t length = ::read(_master, buffer, size);
+  return length > 0 ? (int)length : 0;
+}
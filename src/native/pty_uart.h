@@ -0,0 +1,29 @@
+#pragma once
+
+#include "uart_port.h"
+
+// ============================================================================
+// PTY UART
+// ============================================================================
+//
+// UartPort for the host build: a pseudo-terminal in raw mode. Whatever a
+// script or serial tool writes to path() arrives as if on the RFID line, so
+// recorded captures and emulated readers can drive the real reader task.
+
+class PtyUart : public UartPort
+{
+public:
+  ~PtyUart();
+
+  // Opens the pty; with linkPath, also points a symlink there at it so the
+  // writer can use a fixed name
+  bool begin(const char *linkPath = NULL);
+  const char *path() const { return _path; }
+
+  int read(uint8_t *buffer, size_t size, uint32_t timeoutMs) override;
+
+private:
+  int _master = -1;
+  int _slave = -1; // held open so the master never sees a hangup
+  char _path[64] = "";
+};
@@ -0,0 +1,108 @@
+#include "tty_stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace
+{
+speed_t speedFor(uint32_t baud)
+{
+  switch (baud)
+  {
+  case 9600:
+    return B9600;
+  case 19200:
+    return B19200;
+  case 38400:
+    return B38400;
+  case 115200:
+    return B115200;
+  default:
+    return B57600;
+  }
+}
+} // namespace
+
+TtyStream::~TtyStream()
+{
+  if (_fd >= 0)
+    close(_fd);
+}
+
+bool TtyStream::begin(const char *path, uint32_t baud)
+{
+  _fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (_fd < 0)
+    return false;
+
+  // Bytes through untouched: no echo, no line editing, no CR/LF mapping
+  struct termios mode;
+  if (tcgetattr(_fd, &mode) != 0)
+    return false;
+  cfmakeraw(&mode);
+  cfsetspeed(&mode, speedFor(baud));
+  return tcsetattr(_fd, TCSANOW, &mode) == 0;
+}
+
+// Tops up the buffer with whatever has arrived, if it is empty
+bool TtyStream::fill()
+{
+  if (_count > 0)
+    return true;
+
+  ssize_t length = ::read(_fd, _buffer, sizeof(_buffer));
+  if (length <= 0)
+    return false;
+  _head = 0;
+  _count = length;
+  return true;
+}
+
+int TtyStream::available()
+{
+  fill();
+  return _count;
+}
+
+int TtyStream::read()
+{
+  if (!fill())
+    return -1;
+
+  _count--;
+  return _buffer[_head++];
+}
+
+int TtyStream::peek()
+{
+  return fill() ? _buffer[_head] : -1;
+}
+
+size_t TtyStream::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t TtyStream::write(const uint8_t *data, size_t len)
+{
+  size_t written = 0;
+  while (written < len)
+  {
+    ssize_t length = ::write(_fd, data + written, len - written);
+    if (length > 0)
+      written += length;
+    else if (errno == EAGAIN)
+    {
+      struct pollfd ready = {_fd, POLLOUT, 0};
+      poll(&ready, 1, -1);
+    }
+    else
+    {
+      break;
+    }
+  }
+  return written;
+}
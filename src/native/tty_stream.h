@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Arduino.h>
+
+// ============================================================================
+// TTY STREAM
+// ============================================================================
+//
+// Stream for the host build over an existing serial device: a USB adapter
+// or the pty of a sensor emulator (tools/fingerprint_emulator.py). Reads
+// never block, as the fingerprint library polls available() between 1 ms
+// delays while it waits for a reply.
+
+class TtyStream : public Stream
+{
+public:
+  ~TtyStream();
+
+  // Opens path in raw mode at baud (ignored by ptys)
+  bool begin(const char *path, uint32_t baud);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *data, size_t len) override;
+
+private:
+  bool fill();
+
+  int _fd = -1;
+  uint8_t _buffer[64];
+  size_t _head = 0;
+  size_t _count = 0;
+};
@@ -0,0 +1,276 @@
+#include "pass_channel.h"
+
+#include <ArduinoJson.h>
+
+#include "tag_id.h"
+
+namespace
+{
+const uint32_t CLEANUP_INTERVAL_MS = 1000;
+const size_t COMMAND_MAX = 128;
+const uint16_t CLOSE_TRY_AGAIN_LATER = 1013;
+
+// ESP32 is little-endian, so the frame fields are plain copies
+void putU16(uint8_t *out, uint16_t value) { memcpy(out, &value, sizeof(value)); }
+void putU32(uint8_t *out, uint32_t value) { memcpy(out, &value, sizeof(value)); }
+} // namespace
+
+void PassChannel::begin(AsyncWebServer &server)
+{
+  _ws.onEvent([this](AsyncWebSocket *ws, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+              { onEvent(client, type, arg, data, len); });
+  server.addHandler(&_ws);
+}
+
+// ============================================================================
+// FAN-OUT
+// ============================================================================
+
+void PassChannel::publish(const PassEntry &entry, const char *plate)
+{
+  Frame frame;
+  size_t plateLength = plate != NULL ? strnlen(plate, PASS_FRAME_MAX - PASS_FRAME_HEADER) : 0;
+
+  frame.data[0] = PASS_FRAME_TYPE;
+  frame.data[1] = plateLength;
+  putU16(frame.data + 2, entry.flags);
+  putU32(frame.data + 4, entry.seq);
+  putU32(frame.data + 8, entry.tag);
+  putU32(frame.data + 12, entry.timestamp);
+  if (plateLength > 0)
+    memcpy(frame.data + PASS_FRAME_HEADER, plate, plateLength);
+  frame.length = PASS_FRAME_HEADER + plateLength;
+
+  portENTER_CRITICAL(&_lock);
+  for (size_t i = 0; i < PASS_CHANNEL_CLIENTS; i++)
+  {
+    Slot &slot = _slots[i];
+    if (!slot.used || !wants(slot, entry))
+      continue;
+
+    // Drop the oldest frame rather than the newest: a dashboard that falls
+    // behind should still show the latest passes
+    if (slot.count == PASS_CHANNEL_QUEUE)
+    {
+      slot.head = (slot.head + 1) % PASS_CHANNEL_QUEUE;
+      slot.count--;
+      _dropped++;
+    }
+    slot.frames[(slot.head + slot.count) % PASS_CHANNEL_QUEUE] = frame;
+    slot.count++;
+  }
+  _published++;
+  portEXIT_CRITICAL(&_lock);
+}
+
+void PassChannel::pump()
+{
+  for (size_t i = 0; i < PASS_CHANNEL_CLIENTS; i++)
+  {
+    while (true)
+    {
+      portENTER_CRITICAL(&_lock);
+      bool pending = _slots[i].used && _slots[i].count > 0;
+      uint32_t clientId = _slots[i].clientId;
+      portEXIT_CRITICAL(&_lock);
+
+      // Leave frames queued while the socket's own queue is full
+      if (!pending || !_ws.availableForWrite(clientId))
+        break;
+
+      Frame frame;
+      portENTER_CRITICAL(&_lock);
+      Slot &slot = _slots[i];
+      pending = slot.used && slot.clientId == clientId && slot.count > 0;
+      if (pending)
+      {
+        frame = slot.frames[slot.head];
+        slot.head = (slot.head + 1) % PASS_CHANNEL_QUEUE;
+        slot.count--;
+      }
+      portEXIT_CRITICAL(&_lock);
+
+      if (!pending)
+        break;
+
+      // Looked up by id, so a client that just went away is simply skipped
+      _ws.binary(clientId, frame.data, frame.length);
+      _sent++;
+    }
+  }
+
+  if (millis() - _lastCleanup > CLEANUP_INTERVAL_MS)
+  {
+    _ws.cleanupClients(PASS_CHANNEL_CLIENTS);
+    _lastCleanup = millis();
+  }
+}
+
+bool PassChannel::wants(const Slot &slot, const PassEntry &entry) const
+{
+  if (!slot.subscribed)
+    return false;
+  if (slot.matchTag && slot.tag != entry.tag)
+    return false;
+
+  bool registered = entry.flags & PASS_FLAG_REGISTERED;
+  switch (slot.filter)
+  {
+  case FILTER_REGISTERED:
+    return registered;
+  case FILTER_UNREGISTERED:
+    return !registered;
+  default:
+    return true;
+  }
+}
+
+PassChannelStats PassChannel::stats()
+{
+  PassChannelStats stats;
+
+  portENTER_CRITICAL(&_lock);
+  stats.clients = 0;
+  for (size_t i = 0; i < PASS_CHANNEL_CLIENTS; i++)
+  {
+    if (_slots[i].used)
+      stats.clients++;
+  }
+  stats.published = _published;
+  stats.dropped = _dropped;
+  portEXIT_CRITICAL(&_lock);
+
+  stats.sent = _sent;
+  stats.rejectedClients = _rejectedClients;
+  return stats;
+}
+
+// ============================================================================
+// CLIENTS
+// ============================================================================
+
+// Runs on the async TCP task
+void PassChannel::onEvent(AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+{
+  if (type == WS_EVT_CONNECT)
+  {
+    Slot *slot = NULL;
+    portENTER_CRITICAL(&_lock);
+    slot = findSlot(0);
+    if (slot != NULL)
+    {
+      slot->used = true;
+      slot->clientId = client->id();
+      slot->subscribed = true;
+      slot->filter = FILTER_ALL;
+      slot->matchTag = false;
+      slot->head = 0;
+      slot->count = 0;
+    }
+    portEXIT_CRITICAL(&_lock);
+
+    if (slot == NULL)
+    {
+      _rejectedClients++;
+      client->close(CLOSE_TRY_AGAIN_LATER, "Too many clients");
+    }
+  }
+  else if (type == WS_EVT_DISCONNECT)
+  {
+    portENTER_CRITICAL(&_lock);
+    Slot *slot = findSlot(client->id());
+    if (slot != NULL)
+      slot->used = false;
+    portEXIT_CRITICAL(&_lock);
+  }
+  else if (type == WS_EVT_DATA)
+  {
+    // Commands are small; only whole, single-frame text messages are taken
+    AwsFrameInfo *info = static_cast<AwsFrameInfo *>(arg);
+    if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT)
+    {
+      client->text("{\"error\":\"Expected a single text frame\"}");
+      return;
+    }
+
+    const char *error = handleCommand(client->id(), data, len);
+    if (error == NULL)
+    {
+      client->text("{\"ok\":true}");
+    }
+    else
+    {
+      String reply = String("{\"error\":\"") + error + "\"}";
+      client->text(reply.c_str());
+    }
+  }
+}
+
+// Returns NULL on success or a message for the client
+const char *PassChannel::handleCommand(uint32_t clientId, const uint8_t *data, size_t len)
+{
+  if (len > COMMAND_MAX)
+    return "Command too long";
+
+  StaticJsonDocument<256> doc;
+  if (deserializeJson(doc, (const char *)data, len))
+    return "Invalid JSON";
+
+  const char *cmd = doc["cmd"] | "";
+  bool subscribed = true;
+  Filter filter = FILTER_ALL;
+  bool matchTag = false;
+  uint32_t tag = 0;
+
+  if (strcmp(cmd, "subscribe") == 0)
+  {
+    const char *name = doc["filter"] | "all";
+    if (strcmp(name, "registered") == 0)
+      filter = FILTER_REGISTERED;
+    else if (strcmp(name, "unregistered") == 0)
+      filter = FILTER_UNREGISTERED;
+    else if (strcmp(name, "all") != 0)
+      return "Unknown filter";
+
+    const char *tagText = doc["tag"];
+    if (tagText != NULL)
+    {
+      if (!parseTagHex(tagText, tag))
+        return "Invalid tag";
+      matchTag = true;
+    }
+  }
+  else if (strcmp(cmd, "unsubscribe") == 0)
+  {
+    subscribed = false;
+  }
+  else
+  {
+    return "Unknown command";
+  }
+
+  portENTER_CRITICAL(&_lock);
+  Slot *slot = findSlot(clientId);
+  if (slot != NULL)
+  {
+    slot->subscribed = subscribed;
+    slot->filter = filter;
+    slot->matchTag = matchTag;
+    slot->tag = tag;
+  }
+  portEXIT_CRITICAL(&_lock);
+
+  return slot != NULL ? NULL : "Not connected";
+}
+
+// Pass 0 to find a free slot. Call with _lock held.
+PassChannel::Slot *PassChannel::findSlot(uint32_t clientId)
+{
+  for (size_t i = 0; i < PASS_CHANNEL_CLIENTS; i++)
+  {
+    Slot &slot = _slots[i];
+    if (clientId == 0 ? !slot.used : slot.used && slot.clientId == clientId)
+      return &slot;
+  }
+  return NULL;
+}
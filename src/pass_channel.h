@@ -0,0 +1,107 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "pass_log.h"
+
+// ============================================================================
+// PASS CHANNEL
+// ============================================================================
+//
+// WebSocket at /ws that pushes every detected pass to the dashboards as a
+// small binary frame, so they no longer parse SSE text and refetch lists.
+//
+// Frame, little-endian:
+//   0  u8   PASS_FRAME_TYPE
+//   1  u8   plate length (0 for unregistered tags)
+//   2  u16  flags (PASS_FLAG_*)
+//   4  u32  seq (0 if the pass could not be queued for the log)
+//   8  u32  tag
+//   12 u32  timestamp, gate clock seconds (gate.h)
+//   16      plate, not NUL-terminated
+//
+// Clients receive every pass until they send a filter as a JSON text
+// message:
+//   {"cmd":"subscribe","filter":"all"|"registered"|"unregistered","tag":"A1B2C3D4"}
+//   {"cmd":"unsubscribe"}
+// Both fields of subscribe are optional. Each command is answered with
+// {"ok":true} or {"error":"..."}.
+//
+// publish() only copies the frame into a bounded queue per client, dropping
+// that client's oldest frame when the queue is full. pump() moves frames to
+// the sockets that can take them, so one slow phone only loses its own
+// backlog and never holds up the TCP task or the other clients.
+
+const size_t PASS_CHANNEL_CLIENTS = 4; // soft AP station limit
+const size_t PASS_CHANNEL_QUEUE = 16;
+const uint8_t PASS_FRAME_TYPE = 1;
+const size_t PASS_FRAME_HEADER = 16;
+const size_t PASS_FRAME_MAX = PASS_FRAME_HEADER + 16;
+
+struct PassChannelStats
+{
+  uint32_t clients;
+  uint32_t published;
+  uint32_t sent;
+  uint32_t dropped;
+  uint32_t rejectedClients;
+};
+
+class PassChannel
+{
+public:
+  PassChannel() : _ws("/ws") {}
+
+  void begin(AsyncWebServer &server);
+
+  // Queues a pass for every subscribed client. plate may be NULL.
+  void publish(const PassEntry &entry, const char *plate);
+
+  // Sends queued frames to clients that can take them. Call from loop().
+  void pump();
+
+  PassChannelStats stats();
+
+private:
+  enum Filter
+  {
+    FILTER_ALL,
+    FILTER_REGISTERED,
+    FILTER_UNREGISTERED
+  };
+
+  struct Frame
+  {
+    uint8_t length;
+    uint8_t data[PASS_FRAME_MAX];
+  };
+
+  struct Slot
+  {
+    bool used;
+    uint32_t clientId;
+    bool subscribed;
+    Filter filter;
+    bool matchTag;
+    uint32_t tag;
+    Frame frames[PASS_CHANNEL_QUEUE];
+    uint8_t head;
+    uint8_t count;
+  };
+
+  void onEvent(AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len);
+  const char *handleCommand(uint32_t clientId, const uint8_t *data, size_t len);
+  Slot *findSlot(uint32_t clientId);
+  bool wants(const Slot &slot, const PassEntry &entry) const;
+
+  AsyncWebSocket _ws;
+  portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+  Slot _slots[PASS_CHANNEL_CLIENTS] = {};
+
+  uint32_t _published = 0;
+  uint32_t _sent = 0;
+  uint32_t _dropped = 0;
+  uint32_t _rejectedClients = 0;
+  uint32_t _lastCleanup = 0;
+};
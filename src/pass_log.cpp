@@ -0,0 +1,418 @@
+#include "pass_log.h"
+
+constexpr RecordField RecordSchema<PassEntry>::fields[];
+
+namespace
+{
+const size_t PATH_SIZE = 40;
+
+class LogLock
+{
+public:
+  explicit LogLock(SemaphoreHandle_t mutex) : _mutex(mutex) { xSemaphoreTakeRecursive(_mutex, portMAX_DELAY); }
+  ~LogLock() { xSemaphoreGiveRecursive(_mutex); }
+
+private:
+  SemaphoreHandle_t _mutex;
+};
+} // namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+PassLog::~PassLog()
+{
+  _active.close();
+  _reader.close();
+  if (_mutex != NULL)
+    vSemaphoreDelete(_mutex);
+}
+
+bool PassLog::begin(fs::FS &fs, const char *dir)
+{
+  _fs = &fs;
+  _dir = dir;
+
+  if (_mutex == NULL)
+    _mutex = xSemaphoreCreateRecursiveMutex();
+  LogLock lock(_mutex);
+
+  if (!_fs->exists(_dir))
+    _fs->mkdir(_dir);
+
+  // Find the oldest and newest segment numbers on disk
+  uint32_t minSegment = 0xFFFFFFFF;
+  uint32_t maxSegment = 0;
+  bool found = false;
+
+  fs::File root = _fs->open(_dir);
+  fs::File file = root.openNextFile();
+  while (file)
+  {
+    char *end;
+    uint32_t segment = strtoul(file.name(), &end, 16);
+    if (end != file.name() && strcmp(end, ".seg") == 0)
+    {
+      found = true;
+      if (segment < minSegment)
+        minSegment = segment;
+      if (segment > maxSegment)
+        maxSegment = segment;
+    }
+    file = root.openNextFile();
+  }
+  root.close();
+
+  if (!found)
+  {
+    _firstSeq = 1;
+    _lastSeq = 0;
+    _nextSeq = 1;
+    _lastTimestamp = 0;
+    _preparedTimestamp = 0;
+    return openSegment(0);
+  }
+
+  char path[PATH_SIZE];
+  segmentPath(maxSegment, path);
+  file = _fs->open(path, "r");
+  size_t size = file ? file.size() : 0;
+  file.close();
+
+  // A reset mid-write can leave a partial or corrupt tail; cut the segment
+  // back to its last intact entry so appends stay aligned.
+  size_t entries = size / sizeof(PassEntry);
+  size_t valid = validEntries(maxSegment, entries);
+  if (valid != entries || size % sizeof(PassEntry) != 0)
+  {
+    Serial.println("⚠ Pass log tail was torn, dropping " + String(entries - valid) + " entries");
+    if (!repairSegment(maxSegment, valid))
+      return false;
+  }
+
+  _firstSeq = minSegment * PASS_SEGMENT_ENTRIES + 1;
+  _lastSeq = maxSegment * PASS_SEGMENT_ENTRIES + valid;
+  _nextSeq = _lastSeq + 1;
+
+  PassEntry last;
+  _lastTimestamp = readLocked(_lastSeq, last) ? last.timestamp : 0;
+  _preparedTimestamp = _lastTimestamp;
+
+  // Rebuild the sparse index; an unreadable sample inherits the one before
+  uint32_t timestamp = 0;
+  for (uint32_t seq = _firstSeq; seq <= _lastSeq; seq += PASS_INDEX_STRIDE)
+  {
+    PassEntry sample;
+    if (readLocked(seq, sample))
+      timestamp = sample.timestamp;
+    indexEntry(seq, timestamp);
+  }
+
+  return openSegment(maxSegment);
+}
+
+PassEntry PassLog::prepare(uint32_t tag, uint32_t timestamp, uint16_t flags)
+{
+  LogLock lock(_mutex);
+
+  if (timestamp < _preparedTimestamp)
+    timestamp = _preparedTimestamp;
+  _preparedTimestamp = timestamp;
+
+  PassEntry entry;
+  entry.seq = _nextSeq++;
+  entry.tag = tag;
+  entry.timestamp = timestamp;
+  entry.flags = flags;
+  entry.crc = checksum(entry);
+  return entry;
+}
+
+void PassLog::rebase(uint32_t timestamp)
+{
+  LogLock lock(_mutex);
+  if (timestamp < _preparedTimestamp)
+    _preparedTimestamp = timestamp;
+}
+
+bool PassLog::write(const PassEntry *entries, size_t count)
+{
+  LogLock lock(_mutex);
+
+  // Entries already on disk from a partly failed earlier attempt are skipped
+  size_t done = 0;
+  while (done < count && entries[done].seq <= _lastSeq)
+    done++;
+
+  while (done < count)
+  {
+    if (entries[done].seq != _lastSeq + 1)
+      return false;
+
+    // Rotate once the active segment is full
+    uint32_t used = _lastSeq - _activeSegment * PASS_SEGMENT_ENTRIES;
+    if (used >= PASS_SEGMENT_ENTRIES)
+    {
+      _active.close();
+      if (!openSegment(_activeSegment + 1))
+        return false;
+      dropOldSegments();
+      used = 0;
+    }
+
+    // Write as much of the batch as fits in this segment in one go
+    size_t run = count - done;
+    if (run > PASS_SEGMENT_ENTRIES - used)
+      run = PASS_SEGMENT_ENTRIES - used;
+
+    size_t bytes = run * sizeof(PassEntry);
+    if (_active.write((const uint8_t *)&entries[done], bytes) != bytes)
+    {
+      // Don't leave a partial entry behind for the next append to misalign
+      _active.close();
+      repairSegment(_activeSegment, used);
+      openSegment(_activeSegment);
+      return false;
+    }
+    _active.flush();
+
+    for (size_t i = done; i < done + run; i++)
+      indexEntry(entries[i].seq, entries[i].timestamp);
+
+    done += run;
+    _lastSeq += run;
+    _lastTimestamp = entries[done - 1].timestamp;
+  }
+  return true;
+}
+
+bool PassLog::append(uint32_t tag, uint32_t timestamp, uint16_t flags, PassEntry *written)
+{
+  LogLock lock(_mutex);
+
+  PassEntry entry = prepare(tag, timestamp, flags);
+  if (!write(&entry, 1))
+  {
+    _nextSeq = _lastSeq + 1;
+    return false;
+  }
+
+  if (written != NULL)
+    *written = entry;
+  return true;
+}
+
+bool PassLog::read(uint32_t seq, PassEntry &entry)
+{
+  LogLock lock(_mutex);
+  return readLocked(seq, entry);
+}
+
+bool PassLog::next(uint32_t &cursor, PassEntry &entry)
+{
+  LogLock lock(_mutex);
+
+  if (cursor < _firstSeq)
+    cursor = _firstSeq;
+
+  while (cursor <= _lastSeq)
+  {
+    if (readLocked(cursor++, entry))
+      return true;
+  }
+  return false;
+}
+
+uint32_t PassLog::seekTimestamp(uint32_t timestamp)
+{
+  LogLock lock(_mutex);
+
+  if (_lastSeq < _firstSeq)
+    return _lastSeq + 1;
+
+  // Binary search for the last sample logged before timestamp; the answer
+  // lies between it and the following sample.
+  uint32_t low = (_firstSeq - 1) / PASS_INDEX_STRIDE;
+  uint32_t high = (_lastSeq - 1) / PASS_INDEX_STRIDE + 1;
+  if (sampleTimestamp(low) >= timestamp)
+    return _firstSeq;
+
+  while (high - low > 1)
+  {
+    uint32_t mid = low + (high - low) / 2;
+    if (sampleTimestamp(mid) < timestamp)
+      low = mid;
+    else
+      high = mid;
+  }
+
+  uint32_t end = high * PASS_INDEX_STRIDE + 1;
+  if (end > _lastSeq + 1)
+    end = _lastSeq + 1;
+
+  PassEntry entry;
+  for (uint32_t seq = low * PASS_INDEX_STRIDE + 2; seq < end; seq++)
+  {
+    if (readLocked(seq, entry) && entry.timestamp >= timestamp)
+      return seq;
+  }
+  return end;
+}
+
+// CRC-16/CCITT over everything but the crc field itself
+uint16_t PassLog::checksum(const PassEntry &entry)
+{
+  const uint8_t *data = (const uint8_t *)&entry;
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < offsetof(PassEntry, crc); i++)
+  {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+bool PassLog::readLocked(uint32_t seq, PassEntry &entry)
+{
+  if (seq < _firstSeq || seq > _lastSeq)
+    return false;
+
+  uint32_t segment = (seq - 1) / PASS_SEGMENT_ENTRIES;
+  uint32_t offset = ((seq - 1) % PASS_SEGMENT_ENTRIES) * sizeof(PassEntry);
+
+  // Reopen when switching segments, or when the cached handle predates the
+  // entry being read from the active segment.
+  for (int attempt = 0; attempt < 2; attempt++)
+  {
+    if (attempt > 0 || segment != _readerSegment || !_reader)
+    {
+      char path[PATH_SIZE];
+      segmentPath(segment, path);
+      _reader.close();
+      _reader = _fs->open(path, "r");
+      _readerSegment = segment;
+      if (!_reader)
+        return false;
+    }
+
+    if (_reader.seek(offset, fs::SeekSet) &&
+        _reader.read((uint8_t *)&entry, sizeof(entry)) == sizeof(entry))
+      return entry.seq == seq && entry.crc == checksum(entry);
+  }
+  return false;
+}
+
+// ============================================================================
+// SEGMENT MANAGEMENT
+// ============================================================================
+
+bool PassLog::openSegment(uint32_t segment)
+{
+  char path[PATH_SIZE];
+  segmentPath(segment, path);
+
+  _active = _fs->open(path, "a");
+  if (!_active)
+  {
+    Serial.println("✗ Failed to open pass log segment " + String(path));
+    return false;
+  }
+
+  _activeSegment = segment;
+  return true;
+}
+
+// Counts the leading entries of a segment whose CRC and sequence number check
+// out; everything after the first bad entry is treated as a torn tail.
+size_t PassLog::validEntries(uint32_t segment, size_t entries)
+{
+  char path[PATH_SIZE];
+  segmentPath(segment, path);
+  fs::File file = _fs->open(path, "r");
+  if (!file)
+    return 0;
+
+  PassEntry buffer[16];
+  uint32_t expectedSeq = segment * PASS_SEGMENT_ENTRIES + 1;
+  size_t valid = 0;
+  while (valid < entries)
+  {
+    size_t chunk = entries - valid < 16 ? entries - valid : 16;
+    if (file.read((uint8_t *)buffer, chunk * sizeof(PassEntry)) != chunk * sizeof(PassEntry))
+      break;
+
+    for (size_t i = 0; i < chunk; i++, valid++, expectedSeq++)
+    {
+      if (buffer[i].seq != expectedSeq || buffer[i].crc != checksum(buffer[i]))
+        return valid;
+    }
+  }
+  return valid;
+}
+
+// Copies the first entries of a segment to a temp file and swaps it in.
+bool PassLog::repairSegment(uint32_t segment, size_t entries)
+{
+  char path[PATH_SIZE];
+  char tempPath[PATH_SIZE];
+  segmentPath(segment, path);
+  snprintf(tempPath, sizeof(tempPath), "%s/repair.tmp", _dir);
+
+  fs::File source = _fs->open(path, "r");
+  fs::File target = _fs->open(tempPath, "w");
+  if (!source || !target)
+    return false;
+
+  uint8_t buffer[16 * sizeof(PassEntry)];
+  size_t remaining = entries * sizeof(PassEntry);
+  while (remaining > 0)
+  {
+    size_t chunk = remaining < sizeof(buffer) ? remaining : sizeof(buffer);
+    if (source.read(buffer, chunk) != chunk || target.write(buffer, chunk) != chunk)
+      return false;
+    remaining -= chunk;
+  }
+
+  source.close();
+  target.close();
+  _fs->remove(path);
+  return _fs->rename(tempPath, path);
+}
+
+// Retention: keep only the newest PASS_MAX_SEGMENTS segments.
+void PassLog::dropOldSegments()
+{
+  if (_activeSegment < PASS_MAX_SEGMENTS)
+    return;
+
+  uint32_t oldestKept = _activeSegment - PASS_MAX_SEGMENTS + 1;
+  uint32_t firstKeptSeq = oldestKept * PASS_SEGMENT_ENTRIES + 1;
+
+  char path[PATH_SIZE];
+  for (uint32_t segment = (_firstSeq - 1) / PASS_SEGMENT_ENTRIES; segment < oldestKept; segment++)
+  {
+    if (segment == _readerSegment)
+    {
+      _reader.close();
+      _readerSegment = 0xFFFFFFFF;
+    }
+    segmentPath(segment, path);
+    _fs->remove(path);
+  }
+
+  if (firstKeptSeq > _firstSeq)
+    _firstSeq = firstKeptSeq;
+}
+
+void PassLog::indexEntry(uint32_t seq, uint32_t timestamp)
+{
+  if ((seq - 1) % PASS_INDEX_STRIDE == 0)
+    _samples[((seq - 1) / PASS_INDEX_STRIDE) % PASS_INDEX_SAMPLES] = timestamp;
+}
+
+void PassLog::segmentPath(uint32_t segment, char *path) const
+{
+  snprintf(path, PATH_SIZE, "%s/%08lx.seg", _dir, (unsigned long)segment);
+}
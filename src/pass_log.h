@@ -0,0 +1,130 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include "record_schema.h"
+
+// ============================================================================
+// PASS LOG
+// ============================================================================
+//
+// Append-only log of vehicle passes. Each pass is one fixed-size binary entry
+// in a segment file under the log directory; segment N holds sequence numbers
+// N * PASS_SEGMENT_ENTRIES + 1 onwards, so any entry is located by arithmetic
+// on its sequence number. Segments rotate when full and only the newest
+// PASS_MAX_SEGMENTS are kept. Logging a pass writes exactly one entry.
+//
+// Every entry carries a CRC. On boot the active segment is checked and cut
+// back to the last entry whose CRC and sequence number are intact, so a reset
+// mid-write costs only the entries that had not been flushed.
+//
+// Timestamps are seconds on the gate clock (gate.h) and never decrease along
+// the log: prepare() holds a timestamp earlier than the one before it at
+// that one's value. The one exception is rebase(), after the clock has been
+// corrected back; a time range across that point may miss or take in a few
+// entries next to it. A sparse RAM index keeps the timestamp of every
+// PASS_INDEX_STRIDE-th entry, so finding where a time range starts is a
+// binary search over the index plus a short scan on flash.
+//
+// All methods take an internal lock and may be called from any task.
+
+const uint32_t PASS_SEGMENT_ENTRIES = 1024; // 16 KB per segment
+const uint32_t PASS_MAX_SEGMENTS = 16;      // keeps the newest ~16k passes
+const uint32_t PASS_INDEX_STRIDE = 64;
+const uint32_t PASS_INDEX_SAMPLES = PASS_MAX_SEGMENTS * PASS_SEGMENT_ENTRIES / PASS_INDEX_STRIDE;
+
+const uint16_t PASS_FLAG_REGISTERED = 0x0001;
+
+struct PassEntry
+{
+  uint32_t seq;
+  uint32_t tag;
+  uint32_t timestamp;
+  uint16_t flags;
+  uint16_t crc;
+};
+
+// A pass as it appears in /rfid/list rows (which add the vehicle details)
+// and, without id, in the old "tag|timestamp" NVS strings
+template <>
+struct RecordSchema<PassEntry>
+{
+  static constexpr RecordField fields[] = {
+      RECORD_UINT(PassEntry, seq, "id"),
+      RECORD_TAG(PassEntry, tag, "tagID"),
+      RECORD_UINT(PassEntry, timestamp, "timestamp"),
+  };
+  static constexpr size_t count = sizeof(fields) / sizeof(fields[0]);
+};
+
+class PassLog
+{
+public:
+  ~PassLog();
+
+  bool begin(fs::FS &fs, const char *dir);
+
+  // Reserves the next sequence number and fills in the CRC; the timestamp is
+  // raised to the previous entry's if it is earlier. The entry only becomes
+  // durable once passed to write(); prepared entries must be written in
+  // order.
+  PassEntry prepare(uint32_t tag, uint32_t timestamp, uint16_t flags);
+
+  // Lets prepare() take timestamps from timestamp on, even though earlier
+  // entries are later than that.
+  void rebase(uint32_t timestamp);
+
+  // Appends prepared entries with one flush per segment touched.
+  bool write(const PassEntry *entries, size_t count);
+
+  // prepare() + write() for a single entry.
+  bool append(uint32_t tag, uint32_t timestamp, uint16_t flags, PassEntry *written = NULL);
+
+  bool read(uint32_t seq, PassEntry &entry);
+
+  // Walks retained entries oldest first, skipping any that fail their CRC.
+  // Start with cursor = firstSeq().
+  bool next(uint32_t &cursor, PassEntry &entry);
+
+  // First retained sequence number logged at or after timestamp, or
+  // lastSeq() + 1 if there is none.
+  uint32_t seekTimestamp(uint32_t timestamp);
+
+  uint32_t firstSeq() const { return _firstSeq; }
+  uint32_t lastSeq() const { return _lastSeq; }
+  uint32_t count() const { return _lastSeq >= _firstSeq ? _lastSeq - _firstSeq + 1 : 0; }
+  uint32_t lastTimestamp() const { return _lastTimestamp; }
+
+  static uint16_t checksum(const PassEntry &entry);
+
+private:
+  bool readLocked(uint32_t seq, PassEntry &entry);
+  bool openSegment(uint32_t segment);
+  size_t validEntries(uint32_t segment, size_t entries);
+  bool repairSegment(uint32_t segment, size_t entries);
+  void dropOldSegments();
+  void segmentPath(uint32_t segment, char *path) const;
+  void indexEntry(uint32_t seq, uint32_t timestamp);
+  uint32_t sampleTimestamp(uint32_t sample) const { return _samples[sample % PASS_INDEX_SAMPLES]; }
+
+  fs::FS *_fs = NULL;
+  const char *_dir = NULL;
+  SemaphoreHandle_t _mutex = NULL;
+
+  fs::File _active;
+  uint32_t _activeSegment = 0;
+
+  fs::File _reader;
+  uint32_t _readerSegment = 0xFFFFFFFF;
+
+  uint32_t _firstSeq = 1;
+  uint32_t _lastSeq = 0;
+  uint32_t _nextSeq = 1;
+  uint32_t _lastTimestamp = 0;
+  uint32_t _preparedTimestamp = 0; // of the newest prepared entry
+
+  // Timestamp of entry sample * PASS_INDEX_STRIDE + 1, stored round-robin;
+  // retention never keeps more than PASS_INDEX_SAMPLES samples.
+  uint32_t _samples[PASS_INDEX_SAMPLES] = {};
+};
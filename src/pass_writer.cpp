@@ -0,0 +1,132 @@
+#include "pass_writer.h"
+
+namespace
+{
+const uint32_t WRITER_STACK_SIZE = 4096;
+const UBaseType_t WRITER_PRIORITY = 2;
+const uint32_t RETRY_DELAY_MS = 500;
+} // namespace
+
+bool PassWriter::begin(PassLog &log)
+{
+  _log = &log;
+
+  _queue = xQueueCreate(PASS_QUEUE_DEPTH, sizeof(PassEntry));
+  if (_queue == NULL)
+    return false;
+
+  return xTaskCreate(taskEntry, "passWriter", WRITER_STACK_SIZE, this,
+                     WRITER_PRIORITY, &_task) == pdPASS;
+}
+
+bool PassWriter::submit(uint32_t tag, uint32_t timestamp, uint16_t flags, PassEntry *queued)
+{
+  // Check for room before reserving a sequence number so a drop never leaves
+  // a gap in the log. Only the detection path submits, so the space cannot
+  // disappear between the check and the send.
+  if (_queue == NULL || uxQueueSpacesAvailable(_queue) == 0)
+  {
+    _dropped++;
+    return false;
+  }
+
+  PassEntry entry = _log->prepare(tag, timestamp, flags);
+  xQueueSend(_queue, &entry, 0);
+  _queued++;
+
+  uint32_t depth = uxQueueMessagesWaiting(_queue);
+  if (depth > _queueHighWater)
+    _queueHighWater = depth;
+
+  if (queued != NULL)
+    *queued = entry;
+  return true;
+}
+
+PassWriterStats PassWriter::stats() const
+{
+  PassWriterStats stats;
+  stats.queued = _queued;
+  stats.dropped = _dropped;
+  stats.flushed = _flushed;
+  stats.flushes = _flushes;
+  stats.failedFlushes = _failedFlushes;
+  stats.queueDepth = _queue != NULL ? uxQueueMessagesWaiting(_queue) : 0;
+  stats.queueHighWater = _queueHighWater;
+  stats.lastFlushMicros = _lastFlushMicros;
+  stats.maxFlushMicros = _maxFlushMicros;
+  stats.avgFlushMicros = _flushes > 0 ? (uint32_t)(_totalFlushMicros / _flushes) : 0;
+  return stats;
+}
+
+// ============================================================================
+// BACKGROUND TASK
+// ============================================================================
+
+void PassWriter::taskEntry(void *param)
+{
+  static_cast<PassWriter *>(param)->run();
+}
+
+void PassWriter::run()
+{
+  PassEntry batch[PASS_FLUSH_BATCH];
+  size_t count = 0;
+  uint32_t oldestQueuedAt = 0;
+
+  while (true)
+  {
+    // Block indefinitely while idle; otherwise only until the oldest waiting
+    // entry is due.
+    TickType_t wait = portMAX_DELAY;
+    if (count > 0)
+    {
+      uint32_t waited = millis() - oldestQueuedAt;
+      wait = waited >= PASS_FLUSH_INTERVAL_MS ? 0 : pdMS_TO_TICKS(PASS_FLUSH_INTERVAL_MS - waited);
+    }
+
+    if (count < PASS_FLUSH_BATCH && xQueueReceive(_queue, &batch[count], wait) == pdTRUE)
+    {
+      if (count == 0)
+        oldestQueuedAt = millis();
+      count++;
+    }
+
+    if (count == 0)
+      continue;
+    if (count < PASS_FLUSH_BATCH && millis() - oldestQueuedAt < PASS_FLUSH_INTERVAL_MS)
+      continue;
+
+    if (flush(batch, count))
+    {
+      count = 0;
+    }
+    else
+    {
+      // Keep the batch and retry; new events back up in the queue meanwhile
+      vTaskDelay(pdMS_TO_TICKS(RETRY_DELAY_MS));
+    }
+  }
+}
+
+bool PassWriter::flush(PassEntry *batch, size_t count)
+{
+  uint32_t start = micros();
+  bool ok = _log->write(batch, count);
+  uint32_t elapsed = micros() - start;
+
+  if (!ok)
+  {
+    _failedFlushes++;
+    Serial.println("✗ Pass log flush failed, will retry");
+    return false;
+  }
+
+  _flushes++;
+  _flushed += count;
+  _lastFlushMicros = elapsed;
+  _totalFlushMicros += elapsed;
+  if (elapsed > _maxFlushMicros)
+    _maxFlushMicros = elapsed;
+  return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "pass_log.h"
+
+// ============================================================================
+// PASS WRITER
+// ============================================================================
+//
+// Write-behind front end for the pass log. The detection path only reserves
+// a sequence number and drops the entry into a bounded queue; a background
+// task drains the queue and writes entries in batches, flushing whenever
+// PASS_FLUSH_BATCH entries are waiting or the oldest one has waited
+// PASS_FLUSH_INTERVAL_MS. A reset loses at most the unflushed batch. When the
+// queue is full new events are dropped and counted rather than blocking.
+
+const size_t PASS_QUEUE_DEPTH = 64;
+const size_t PASS_FLUSH_BATCH = 16;
+const uint32_t PASS_FLUSH_INTERVAL_MS = 1000;
+
+struct PassWriterStats
+{
+  uint32_t queued;
+  uint32_t dropped;
+  uint32_t flushed;
+  uint32_t flushes;
+  uint32_t failedFlushes;
+  uint32_t queueDepth;
+  uint32_t queueHighWater;
+  uint32_t lastFlushMicros;
+  uint32_t maxFlushMicros;
+  uint32_t avgFlushMicros;
+};
+
+class PassWriter
+{
+public:
+  bool begin(PassLog &log);
+
+  // Never blocks. Returns false (and counts a drop) if the queue is full.
+  bool submit(uint32_t tag, uint32_t timestamp, uint16_t flags, PassEntry *queued = NULL);
+
+  PassWriterStats stats() const;
+
+private:
+  static void taskEntry(void *param);
+  void run();
+  bool flush(PassEntry *batch, size_t count);
+
+  PassLog *_log = NULL;
+  QueueHandle_t _queue = NULL;
+  TaskHandle_t _task = NULL;
+
+  volatile uint32_t _queued = 0;
+  volatile uint32_t _dropped = 0;
+  volatile uint32_t _flushed = 0;
+  volatile uint32_t _flushes = 0;
+  volatile uint32_t _failedFlushes = 0;
+  volatile uint32_t _queueHighWater = 0;
+  volatile uint32_t _lastFlushMicros = 0;
+  volatile uint32_t _maxFlushMicros = 0;
+  volatile uint64_t _totalFlushMicros = 0;
+};
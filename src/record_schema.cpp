@@ -0,0 +1,235 @@
+#include "record_schema.h"
+
+#include "tag_id.h"
+
+namespace
+{
+char *fieldAt(void *record, const RecordField &field)
+{
+  return (char *)record + field.offset;
+}
+
+const char *fieldAt(const void *record, const RecordField &field)
+{
+  return (const char *)record + field.offset;
+}
+
+// Digits only, no sign or spaces, and no more than fits in 32 bits
+bool parseUint(const char *text, uint32_t &value)
+{
+  if (*text == '\0')
+    return false;
+
+  uint64_t result = 0;
+  for (const char *c = text; *c != '\0'; c++)
+  {
+    if (*c < '0' || *c > '9')
+      return false;
+    result = result * 10 + (*c - '0');
+    if (result > 0xFFFFFFFF)
+      return false;
+  }
+  value = result;
+  return true;
+}
+
+bool needsQuotes(const char *value, char separator)
+{
+  for (const char *c = value; *c != '\0'; c++)
+  {
+    if (*c == separator || *c == '"' || *c == '\r' || *c == '\n')
+      return true;
+  }
+  return false;
+}
+} // namespace
+
+// ============================================================================
+// FIELDS
+// ============================================================================
+
+bool setRecordValue(void *record, const RecordField &field, const char *text, bool truncate)
+{
+  if (text == NULL)
+    text = "";
+
+  switch (field.type)
+  {
+  case FIELD_TEXT:
+  {
+    char *out = fieldAt(record, field);
+    size_t length = strlen(text);
+    if (length >= field.size)
+    {
+      if (!truncate)
+      {
+        out[0] = '\0';
+        return false;
+      }
+      length = field.size - 1;
+    }
+    memcpy(out, text, length);
+    out[length] = '\0';
+    return true;
+  }
+
+  case FIELD_TAG:
+    return parseTagHex(text, *(uint32_t *)fieldAt(record, field));
+
+  case FIELD_UINT:
+    return parseUint(text, *(uint32_t *)fieldAt(record, field));
+  }
+  return false;
+}
+
+const char *recordValueText(const void *record, const RecordField &field, char *scratch)
+{
+  switch (field.type)
+  {
+  case FIELD_TEXT:
+    return fieldAt(record, field);
+
+  case FIELD_TAG:
+    formatTagHex(*(const uint32_t *)fieldAt(record, field), scratch);
+    return scratch;
+
+  case FIELD_UINT:
+    snprintf(scratch, RECORD_VALUE_SCRATCH, "%lu", (unsigned long)*(const uint32_t *)fieldAt(record, field));
+    return scratch;
+  }
+  scratch[0] = '\0';
+  return scratch;
+}
+
+// ============================================================================
+// JSON
+// ============================================================================
+
+void writeRecordJson(JsonObject obj, const void *record, const RecordField *fields, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    const RecordField &field = fields[i];
+    if (field.type == FIELD_UINT)
+    {
+      obj[field.name] = *(const uint32_t *)fieldAt(record, field);
+      continue;
+    }
+
+    // As char * so the document keeps its own copy; the record and the
+    // scratch buffer are gone before the row is serialized
+    char scratch[RECORD_VALUE_SCRATCH];
+    obj[field.name] = (char *)recordValueText(record, field, scratch);
+  }
+}
+
+const RecordField *readRecordJson(JsonObjectConst obj, void *record, const RecordField *fields, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    const RecordField &field = fields[i];
+    JsonVariantConst value = obj[field.name];
+
+    if (field.type == FIELD_UINT && value.is<uint32_t>())
+    {
+      *(uint32_t *)fieldAt(record, field) = value.as<uint32_t>();
+      continue;
+    }
+
+    if (!setRecordValue(record, field, value.as<const char *>()))
+      return &field;
+  }
+  return NULL;
+}
+
+// ============================================================================
+// DELIMITED LINES
+// ============================================================================
+
+size_t splitRecordLine(char *line, char separator, bool quoted, const char **values, size_t max)
+{
+  size_t count = 0;
+  char *in = line;
+  while (count < max)
+  {
+    char *out = in;
+    values[count++] = out;
+
+    if (quoted && *in == '"')
+    {
+      in++;
+      while (*in != '\0')
+      {
+        if (*in == '"' && in[1] == '"')
+        {
+          *out++ = '"';
+          in += 2;
+        }
+        else if (*in == '"')
+        {
+          in++;
+          break;
+        }
+        else
+        {
+          *out++ = *in++;
+        }
+      }
+    }
+
+    while (*in != '\0' && *in != separator)
+      *out++ = *in++;
+
+    bool more = *in == separator;
+    *out = '\0';
+    if (!more)
+      break;
+    in++;
+  }
+  return count;
+}
+
+const RecordField *readRecordValues(const char *const *values, size_t valueCount, void *record,
+                                    const RecordField *fields, size_t count, size_t first, bool truncate)
+{
+  for (size_t i = first; i < count; i++)
+  {
+    size_t index = i - first;
+    const char *value = index < valueCount ? values[index] : "";
+    if (!setRecordValue(record, fields[i], value, truncate))
+      return &fields[i];
+  }
+  return NULL;
+}
+
+size_t writeRecordLine(const void *record, const RecordField *fields, size_t count,
+                       char separator, bool quoted, char *out, size_t size)
+{
+  size_t length = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    char scratch[RECORD_VALUE_SCRATCH];
+    const char *value = recordValueText(record, fields[i], scratch);
+    bool quote = quoted && needsQuotes(value, separator);
+
+    // Worst case for this field: separator, two quotes, every character
+    // doubled, and the terminator
+    if (length + 2 * strlen(value) + 4 > size)
+      return 0;
+
+    if (i > 0)
+      out[length++] = separator;
+    if (quote)
+      out[length++] = '"';
+    for (const char *c = value; *c != '\0'; c++)
+    {
+      if (quote && *c == '"')
+        out[length++] = '"';
+      out[length++] = *c;
+    }
+    if (quote)
+      out[length++] = '"';
+  }
+  out[length] = '\0';
+  return length;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <stddef.h>
+
+// ============================================================================
+// RECORD SCHEMA
+// ============================================================================
+//
+// Each record type lists its fields once, in a RecordSchema specialization:
+// the external name, how the value is written, and where it sits in the
+// struct. Everything that turns a record into text or back (JSON rows, CSV
+// lines, the '|'-joined Preferences strings) walks that list, so a field
+// added to the schema shows up in every format and is validated the same
+// way everywhere. Values are copied between the record's fixed-width fields
+// and the caller's buffers; nothing allocates.
+//
+//   template <>
+//   struct RecordSchema<Thing>
+//   {
+//     static constexpr RecordField fields[] = {
+//         RECORD_TAG(Thing, tag, "rfid"),
+//         RECORD_TEXT(Thing, name, "name"),
+//     };
+//     static constexpr size_t count = sizeof(fields) / sizeof(fields[0]);
+//   };
+//
+// plus the out-of-line definition C++11 needs, in the record's .cpp file:
+//
+//   constexpr RecordField RecordSchema<Thing>::fields[];
+
+enum RecordFieldType
+{
+  FIELD_TEXT, // char[N], NUL-terminated, at most N - 1 characters
+  FIELD_TAG,  // uint32_t RFID tag as 8 hex characters
+  FIELD_UINT  // uint32_t as decimal (a number in JSON)
+};
+
+struct RecordField
+{
+  const char *name;
+  RecordFieldType type;
+  size_t offset;
+  size_t size;
+};
+
+#define RECORD_TEXT(Record, member, name) {name, FIELD_TEXT, offsetof(Record, member), sizeof(Record::member)}
+#define RECORD_TAG(Record, member, name) {name, FIELD_TAG, offsetof(Record, member), sizeof(Record::member)}
+#define RECORD_UINT(Record, member, name) {name, FIELD_UINT, offsetof(Record, member), sizeof(Record::member)}
+
+template <typename Record>
+struct RecordSchema;
+
+// Longest text form of one field, and of a whole record with every field
+// at its longest (no separators or quoting)
+constexpr size_t recordFieldMaxLength(const RecordField &field)
+{
+  return field.type == FIELD_TEXT ? field.size - 1 : field.type == FIELD_TAG ? 8 : 10;
+}
+
+template <typename Record>
+constexpr size_t recordMaxLength(size_t first = 0)
+{
+  return first >= RecordSchema<Record>::count
+             ? 0
+             : recordFieldMaxLength(RecordSchema<Record>::fields[first]) + recordMaxLength<Record>(first + 1);
+}
+
+// Worst case for writeRecordLine() with quoting: every character doubled,
+// two quotes and a separator per field, and the terminator
+template <typename Record>
+constexpr size_t recordMaxLineLength()
+{
+  return 2 * recordMaxLength<Record>() + 3 * RecordSchema<Record>::count + 1;
+}
+
+// Worst case for one JSON object member once serialized: the quoted name,
+// colon and value, and a comma. ArduinoJson may escape a text character as
+// \u00XX, so text counts six bytes a character.
+constexpr size_t jsonNameLength(const char *name)
+{
+  return *name == '\0' ? 0 : 1 + jsonNameLength(name + 1);
+}
+
+constexpr size_t jsonTextMaxLength(size_t length)
+{
+  return 2 + 6 * length;
+}
+
+constexpr size_t jsonMemberMaxLength(const char *name, size_t valueLength)
+{
+  return jsonNameLength(name) + 4 + valueLength;
+}
+
+constexpr size_t recordFieldMaxJsonLength(const RecordField &field)
+{
+  return jsonMemberMaxLength(field.name, field.type == FIELD_TEXT ? jsonTextMaxLength(field.size - 1)
+                                         : field.type == FIELD_TAG  ? 8 + 2
+                                                                    : 10);
+}
+
+// Worst case for the members recordToJson() adds, serialized
+template <typename Record>
+constexpr size_t recordMaxJsonLength(size_t first = 0)
+{
+  return first >= RecordSchema<Record>::count
+             ? 0
+             : recordFieldMaxJsonLength(RecordSchema<Record>::fields[first]) + recordMaxJsonLength<Record>(first + 1);
+}
+
+// ============================================================================
+// SCHEMA-DRIVEN CODEC
+// ============================================================================
+//
+// The untyped workers take the field list explicitly; the templates below
+// pick it from the record type. Readers return the first field whose value
+// was rejected, or NULL if the whole record was accepted.
+
+const size_t RECORD_VALUE_SCRATCH = 12;
+
+// Stores text (NULL reads as empty) into field. Text that does not fit is
+// rejected, leaving the field empty, unless truncate is set.
+bool setRecordValue(void *record, const RecordField &field, const char *text, bool truncate = false);
+
+// Field as text; numbers are formatted into scratch (RECORD_VALUE_SCRATCH)
+const char *recordValueText(const void *record, const RecordField &field, char *scratch);
+
+void writeRecordJson(JsonObject obj, const void *record, const RecordField *fields, size_t count);
+const RecordField *readRecordJson(JsonObjectConst obj, void *record, const RecordField *fields, size_t count);
+
+// Splits line in place at separator into up to max values. With quoted,
+// a value may be wrapped in double quotes (with "" for a quote inside), as
+// in CSV. Returns the number of values found.
+size_t splitRecordLine(char *line, char separator, bool quoted, const char **values, size_t max);
+
+// Assigns values, in order, to the fields starting at fields[first]. Fields
+// left without a value are set as if from empty text.
+const RecordField *readRecordValues(const char *const *values, size_t valueCount, void *record,
+                                    const RecordField *fields, size_t count, size_t first, bool truncate);
+
+// Joins the fields with separator, quoting values that need it when quoted
+// is set. Returns the length written (without the terminator), or 0 if the
+// line does not fit in size.
+size_t writeRecordLine(const void *record, const RecordField *fields, size_t count,
+                       char separator, bool quoted, char *out, size_t size);
+
+template <typename Record>
+void recordToJson(JsonObject obj, const Record &record)
+{
+  writeRecordJson(obj, &record, RecordSchema<Record>::fields, RecordSchema<Record>::count);
+}
+
+template <typename Record>
+const RecordField *recordFromJson(JsonObjectConst obj, Record &record)
+{
+  record = Record();
+  return readRecordJson(obj, &record, RecordSchema<Record>::fields, RecordSchema<Record>::count);
+}
+
+template <typename Record>
+const RecordField *recordFromValues(const char *const *values, size_t valueCount, Record &record,
+                                    size_t first = 0, bool truncate = false)
+{
+  return readRecordValues(values, valueCount, &record, RecordSchema<Record>::fields,
+                          RecordSchema<Record>::count, first, truncate);
+}
+
+// Splits line (modified in place) into the fields from fields[first] on;
+// the ones before first are left as they are
+template <typename Record>
+const RecordField *recordFromLine(char *line, char separator, bool quoted, Record &record,
+                                  size_t first = 0, bool truncate = false)
+{
+  const char *values[RecordSchema<Record>::count];
+  size_t valueCount = splitRecordLine(line, separator, quoted, values, RecordSchema<Record>::count - first);
+  return recordFromValues(values, valueCount, record, first, truncate);
+}
+
+template <typename Record>
+size_t recordToLine(const Record &record, char separator, bool quoted, char *out, size_t size)
+{
+  return writeRecordLine(&record, RecordSchema<Record>::fields, RecordSchema<Record>::count,
+                         separator, quoted, out, size);
+}
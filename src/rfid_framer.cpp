@@ -0,0 +1,107 @@
+#include "rfid_framer.h"
+
+#include "tag_id.h"
+
+// All-zero / all-ones frames are line noise; 00000001 is the reader's
+// idle response.
+bool isValidTag(uint32_t tag)
+{
+  return tag != 0x00000000 && tag != 0xFFFFFFFF && tag != 0x00000001;
+}
+
+void RfidFramer::feed(const uint8_t *data, size_t length, unsigned long now)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    if (_frameIndex < EXPECTED_BYTES)
+    {
+      _frame[_frameIndex++] = data[i];
+      _lastByteTime = now;
+    }
+    // else: discard extra bytes
+  }
+}
+
+// Frame decode, validation and dedupe work on the packed tag only.
+bool RfidFramer::update(unsigned long now, uint32_t &tag)
+{
+  bool confirmed = false;
+
+  if (_frameIndex == EXPECTED_BYTES && now - _lastByteTime > FRAME_GAP_MS)
+  {
+    _frames++;
+    tag = packTag(_frame);
+    if (!isValidTag(tag))
+      _invalidFrames++;
+    else
+      confirmed = confirmRead(tag, now);
+    _frameIndex = 0;
+  }
+
+  if (_frameIndex > 0 && now - _lastByteTime > PARTIAL_FRAME_MS)
+  {
+    _frameIndex = 0;
+  }
+
+  if (_currentRead.count > 0 && now - _currentRead.firstSeen > READ_STREAK_MS)
+  {
+    _currentRead.count = 0;
+  }
+
+  return confirmed;
+}
+
+// Counts consecutive reads of the same tag and reports a pass once it has
+// been seen MIN_CONSECUTIVE_READS times, unless the same tag already passed
+// within DUPLICATE_WINDOW.
+bool RfidFramer::confirmRead(uint32_t tag, unsigned long now)
+{
+  if (_currentRead.count > 0 && tag == _currentRead.tag)
+  {
+    _currentRead.count++;
+  }
+  else
+  {
+    _currentRead.tag = tag;
+    _currentRead.count = 1;
+    _currentRead.firstSeen = now;
+  }
+
+  if (_currentRead.count < MIN_CONSECUTIVE_READS)
+    return false;
+
+  _currentRead.count = 0;
+
+  if (_hasProcessedTag && tag == _lastProcessedTag && now - _lastProcessedTime <= DUPLICATE_WINDOW)
+    return false;
+
+  _lastProcessedTag = tag;
+  _lastProcessedTime = now;
+  _hasProcessedTag = true;
+  return true;
+}
+
+// Until the next framing/streak timeout is due; with none pending, until the
+// next byte arrives.
+uint32_t RfidFramer::idleTimeout(unsigned long now) const
+{
+  unsigned long deadline = 0;
+  bool pending = false;
+
+  if (_frameIndex > 0)
+  {
+    deadline = _lastByteTime + (_frameIndex == EXPECTED_BYTES ? FRAME_GAP_MS : PARTIAL_FRAME_MS) + 1;
+    pending = true;
+  }
+  else if (_currentRead.count > 0)
+  {
+    deadline = _currentRead.firstSeen + READ_STREAK_MS + 1;
+    pending = true;
+  }
+
+  if (!pending)
+    return UART_WAIT_FOREVER;
+  if ((long)(deadline - now) <= 0)
+    return 0;
+  return deadline - now;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "uart_port.h"
+
+// ============================================================================
+// RFID FRAMER
+// ============================================================================
+//
+// Turns the reader module's byte stream into confirmed passes: bytes are
+// grouped into 4-byte frames ended by a short silence, noise frames are
+// dropped, and a tag counts once it has been read MIN_CONSECUTIVE_READS times
+// in a row and has not passed within DUPLICATE_WINDOW. Nothing here reads a
+// clock or a port; the caller feeds bytes with their arrival time and calls
+// update() whenever a timeout may have run out, so the same logic runs on the
+// reader task and on the host.
+
+// RFID Configuration
+const unsigned long DUPLICATE_WINDOW = 5000;
+const int EXPECTED_BYTES = 4;
+const int MIN_CONSECUTIVE_READS = 3;
+
+const unsigned long FRAME_GAP_MS = 100;       // silence that ends a frame
+const unsigned long PARTIAL_FRAME_MS = 500;   // drop an incomplete frame after this
+const unsigned long READ_STREAK_MS = 2000;    // forget a streak of reads after this
+
+class RfidFramer
+{
+public:
+  // Bytes received at now; bytes past a full frame are discarded
+  void feed(const uint8_t *data, size_t length, unsigned long now);
+
+  // Applies whatever timeouts have run out by now. Returns true, with tag
+  // set, when that completed a frame which confirmed a pass.
+  bool update(unsigned long now, uint32_t &tag);
+
+  // Milliseconds until update() next has work, or UART_WAIT_FOREVER, for use
+  // as the UartPort::read() timeout
+  uint32_t idleTimeout(unsigned long now) const;
+
+  // Drops a partly received frame, e.g. after the UART lost bytes
+  void reset() { _frameIndex = 0; }
+
+  uint32_t frames() const { return _frames; }
+  uint32_t invalidFrames() const { return _invalidFrames; }
+
+private:
+  bool confirmRead(uint32_t tag, unsigned long now);
+
+  struct ReadBuffer
+  {
+    uint32_t tag;
+    int count;
+    unsigned long firstSeen;
+  };
+
+  uint8_t _frame[EXPECTED_BYTES];
+  int _frameIndex = 0;
+  unsigned long _lastByteTime = 0;
+  ReadBuffer _currentRead = {0, 0, 0};
+  uint32_t _lastProcessedTag = 0;
+  bool _hasProcessedTag = false;
+  unsigned long _lastProcessedTime = 0;
+
+  // Read by other tasks for /stats
+  volatile uint32_t _frames = 0;
+  volatile uint32_t _invalidFrames = 0;
+};
+
+bool isValidTag(uint32_t tag);
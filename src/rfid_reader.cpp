@@ -0,0 +1,81 @@
+#include "rfid_reader.h"
+
+#include "alloc_audit.h"
+
+namespace
+{
+const size_t READ_CHUNK = 256;
+
+const uint32_t READER_STACK_SIZE = 3072;
+const UBaseType_t READER_PRIORITY = 10; // above loop() and the web server
+} // namespace
+
+bool RfidReader::begin(UartPort &uart, BaseType_t core)
+{
+  _uart = &uart;
+
+  return xTaskCreatePinnedToCore(taskEntry, "rfid", READER_STACK_SIZE, this,
+                                 READER_PRIORITY, &_task, core) == pdPASS;
+}
+
+RfidReaderStats RfidReader::stats() const
+{
+  RfidReaderStats stats;
+  stats.frames = _framer.frames();
+  stats.invalidFrames = _framer.invalidFrames();
+  stats.detections = _detectionCount;
+  stats.ringDrops = _ringDrops;
+  stats.uartOverflows = _uartOverflows;
+  stats.frameAllocs = _frameAllocs;
+  return stats;
+}
+
+// ============================================================================
+// READER TASK
+// ============================================================================
+
+void RfidReader::taskEntry(void *param)
+{
+  static_cast<RfidReader *>(param)->run();
+}
+
+void RfidReader::run()
+{
+  uint8_t data[READ_CHUNK];
+
+  while (true)
+  {
+    int read = _uart->read(data, sizeof(data), _framer.idleTimeout(millis()));
+    if (read > 0)
+    {
+      _framer.feed(data, read, millis());
+    }
+    else if (read == UART_READ_OVERFLOW)
+    {
+      // Whatever is buffered is no longer frame-aligned; start clean
+      _uartOverflows++;
+      _framer.reset();
+    }
+
+    onTimeouts(millis());
+  }
+}
+
+// A completed frame is decoded, deduped and handed over here, so this is
+// the stretch the allocation audit watches.
+void RfidReader::onTimeouts(unsigned long now)
+{
+  allocAuditArm();
+
+  uint32_t tag;
+  if (_framer.update(now, tag))
+  {
+    RfidDetection detection = {tag, (uint32_t)now};
+    if (_detections.push(detection))
+      _detectionCount++;
+    else
+      _ringDrops++;
+  }
+
+  _frameAllocs += allocAuditDisarm();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "rfid_framer.h"
+#include "spsc_ring.h"
+#include "uart_port.h"
+
+// ============================================================================
+// RFID READER
+// ============================================================================
+//
+// Reads the RFID UART and runs the framer (rfid_framer.h) in a dedicated
+// high-priority task pinned to one core. The task sleeps in
+// UartPort::read(), so bytes are drained as soon as they arrive instead of
+// whenever loop() comes round. Confirmed passes are handed to the consumer
+// through a lock-free ring; the consumer calls poll().
+
+struct RfidDetection
+{
+  uint32_t tag;
+  uint32_t seenAt; // millis() when the pass was confirmed
+};
+
+struct RfidReaderStats
+{
+  uint32_t frames;
+  uint32_t invalidFrames;
+  uint32_t detections;
+  uint32_t ringDrops;
+  uint32_t uartOverflows;
+  uint32_t frameAllocs;
+};
+
+class RfidReader
+{
+public:
+  // uart must already be open and outlive the reader
+  bool begin(UartPort &uart, BaseType_t core);
+
+  // Consumer side: takes the next confirmed pass, if any.
+  bool poll(RfidDetection &detection) { return _detections.pop(detection); }
+
+  RfidReaderStats stats() const;
+
+private:
+  static void taskEntry(void *param);
+  void run();
+  void onTimeouts(unsigned long now);
+
+  UartPort *_uart = NULL;
+  TaskHandle_t _task = NULL;
+  SpscRing<RfidDetection, 16> _detections;
+
+  // Touched only by the reader task
+  RfidFramer _framer;
+
+  volatile uint32_t _detectionCount = 0;
+  volatile uint32_t _ringDrops = 0;
+  volatile uint32_t _uartOverflows = 0;
+  volatile uint32_t _frameAllocs = 0;
+};
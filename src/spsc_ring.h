@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// ============================================================================
+// SPSC RING
+// ============================================================================
+//
+// Lock-free single-producer / single-consumer ring buffer. One task may call
+// push() and one other task may call pop(); neither ever blocks. N must be a
+// power of two.
+
+template <typename T, size_t N>
+class SpscRing
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+  bool push(const T &item)
+  {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) >= N)
+      return false;
+
+    _items[head & (N - 1)] = item;
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &item)
+  {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire))
+      return false;
+
+    item = _items[tail & (N - 1)];
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const
+  {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+  }
+
+  static size_t capacity() { return N; }
+
+private:
+  T _items[N];
+  std::atomic<uint32_t> _head{0};
+  std::atomic<uint32_t> _tail{0};
+};
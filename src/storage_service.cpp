@@ -0,0 +1,435 @@
+#include "storage_service.h"
+
+constexpr RecordField RecordSchema<FingerprintMeta>::fields[];
+
+namespace
+{
+const uint32_t STORAGE_STACK_SIZE = 4096;
+const UBaseType_t STORAGE_PRIORITY = 2;   // below the web server and RFID tasks
+
+// Room for "owner|role" with both fields quoted; older, longer values read
+// as missing
+const size_t FP_META_VALUE_SIZE = recordMaxLineLength<FingerprintMeta>();
+
+class StorageLock
+{
+public:
+  explicit StorageLock(SemaphoreHandle_t mutex) : _mutex(mutex) { xSemaphoreTake(_mutex, portMAX_DELAY); }
+  ~StorageLock() { xSemaphoreGive(_mutex); }
+
+private:
+  SemaphoreHandle_t _mutex;
+};
+} // namespace
+
+bool StorageService::begin(Preferences &preferences, VehicleRegistry &registry, TagTable &tagTable)
+{
+  _preferences = &preferences;
+  _registry = &registry;
+  _tagTable = &tagTable;
+
+  _vehiclesGeneration = esp_random();
+  _changesSince = _vehiclesGeneration;
+
+  _queue = xQueueCreate(STORAGE_QUEUE_DEPTH, sizeof(Op *));
+  _mutex = xSemaphoreCreateMutex();
+  _changeMutex = xSemaphoreCreateMutex();
+  if (_queue == NULL || _mutex == NULL || _changeMutex == NULL)
+    return false;
+
+  return xTaskCreate(taskEntry, "storage", STORAGE_STACK_SIZE, this,
+                     STORAGE_PRIORITY, &_task) == pdPASS;
+}
+
+// ============================================================================
+// REQUESTS
+// ============================================================================
+
+bool StorageService::saveVehicle(const VehicleRecord &record, StorageCallback done)
+{
+  Op *op = new Op();
+  op->type = OP_SAVE_VEHICLE;
+  op->record = record;
+  op->done = done;
+  return submit(op);
+}
+
+bool StorageService::removeVehicle(uint32_t tag, StorageCallback done)
+{
+  Op *op = new Op();
+  op->type = OP_REMOVE_VEHICLE;
+  op->record.tag = tag;
+  op->done = done;
+  return submit(op);
+}
+
+bool StorageService::clearVehicles(StorageCallback done)
+{
+  Op *op = new Op();
+  op->type = OP_CLEAR_VEHICLES;
+  op->done = done;
+  return submit(op);
+}
+
+bool StorageService::importVehicles(const VehicleRecord *records, size_t count, StorageCallback done, TickType_t wait)
+{
+  Op *op = new Op();
+  op->type = OP_IMPORT_VEHICLES;
+  op->records.assign(records, records + count);
+  op->done = done;
+  return submit(op, wait);
+}
+
+bool StorageService::saveFingerprintMeta(int id, const FingerprintMeta &meta, StorageCallback done)
+{
+  if (id < 0 || id >= FINGERPRINT_MAX_SLOTS)
+    return false;
+
+  Op *op = new Op();
+  op->type = OP_SAVE_FP_META;
+  op->fingerprints.add(id);
+  op->meta = meta;
+  op->done = done;
+  return submit(op);
+}
+
+bool StorageService::removeFingerprintMeta(int id, StorageCallback done)
+{
+  if (id < 0 || id >= FINGERPRINT_MAX_SLOTS)
+    return false;
+
+  FingerprintSet ids = {};
+  ids.add(id);
+  return removeFingerprintMeta(ids, done);
+}
+
+bool StorageService::removeFingerprintMeta(const FingerprintSet &ids, StorageCallback done)
+{
+  Op *op = new Op();
+  op->type = OP_REMOVE_FP_META;
+  op->fingerprints = ids;
+  op->done = done;
+  return submit(op);
+}
+
+StorageRead StorageService::nextVehicle(uint16_t &cursor, VehicleRecord &record)
+{
+  if (!tryReadLock())
+    return STORAGE_READ_BUSY;
+
+  bool found = _registry->next(cursor, record);
+  xSemaphoreGive(_mutex);
+  return found ? STORAGE_READ_OK : STORAGE_READ_END;
+}
+
+bool StorageService::vehicleChangesSince(uint32_t since, VehicleChange *changes, size_t &count)
+{
+  StorageLock lock(_changeMutex);
+
+  // Unsigned distances, so the counter may wrap
+  uint32_t current = _vehiclesGeneration;
+  if (current - since > current - _changesSince)
+    return false;
+
+  count = 0;
+  for (size_t i = 0; i < _changeCount; i++)
+  {
+    const VehicleChange &change = _changes[(_changeHead + STORAGE_CHANGE_LOG - _changeCount + i) % STORAGE_CHANGE_LOG];
+    if (change.generation - since - 1 < current - since)
+      changes[count++] = change;
+  }
+  return true;
+}
+
+StorageRead StorageService::fingerprintMeta(int id, FingerprintMeta &meta)
+{
+  char value[FP_META_VALUE_SIZE];
+  if (!tryReadLock())
+    return STORAGE_READ_BUSY;
+  size_t length = _preferences->getString(fingerprintKey(id).c_str(), value, sizeof(value));
+  xSemaphoreGive(_mutex);
+
+  if (length == 0)
+    strcpy(value, "Unknown|Unknown");
+
+  meta = FingerprintMeta();
+  recordFromLine(value, '|', true, meta, 0, true);
+  return STORAGE_READ_OK;
+}
+
+StorageStats StorageService::stats() const
+{
+  StorageStats stats;
+  stats.ops = _ops;
+  stats.commits = _commits;
+  stats.failedCommits = _failedCommits;
+  stats.rejected = _rejected;
+  stats.queueDepth = _queue != NULL ? uxQueueMessagesWaiting(_queue) : 0;
+  stats.queueHighWater = _queueHighWater;
+  stats.lastCommitMicros = _lastCommitMicros;
+  stats.maxCommitMicros = _maxCommitMicros;
+  return stats;
+}
+
+bool StorageService::submit(Op *op, TickType_t wait)
+{
+  if (_queue == NULL || xQueueSend(_queue, &op, wait) != pdTRUE)
+  {
+    _rejected++;
+    delete op;
+    return false;
+  }
+
+  uint32_t depth = uxQueueMessagesWaiting(_queue);
+  if (depth > _queueHighWater)
+    _queueHighWater = depth;
+  return true;
+}
+
+// Takes the storage lock only if no run holds it; the caller gives it back
+bool StorageService::tryReadLock()
+{
+  if (xSemaphoreTake(_mutex, 0) == pdTRUE)
+    return true;
+  _readerWaiting = true;
+  return false;
+}
+
+// ============================================================================
+// STORAGE TASK
+// ============================================================================
+
+void StorageService::taskEntry(void *param)
+{
+  static_cast<StorageService *>(param)->run();
+}
+
+void StorageService::run()
+{
+  Op *batch[STORAGE_COMMIT_BATCH];
+
+  while (true)
+  {
+    // Sleep until there is work, then take whatever else is already waiting
+    // so it shares the commit.
+    size_t count = 0;
+    if (xQueueReceive(_queue, &batch[count], portMAX_DELAY) != pdTRUE)
+      continue;
+    count++;
+    while (count < STORAGE_COMMIT_BATCH && xQueueReceive(_queue, &batch[count], 0) == pdTRUE)
+      count++;
+
+    uint32_t start = micros();
+    bool committed = true;
+    {
+      StorageLock lock(_mutex);
+
+      bool dirty = false;
+      for (size_t i = 0; i < count; i++)
+        dirty |= apply(*batch[i]);
+
+      // The tag table and change log only hear about writes that reached
+      // flash; sync() also reports a write in the run that failed part-way.
+      if (!dirty || _registry->sync())
+      {
+        for (size_t i = 0; i < count; i++)
+        {
+          if (batch[i]->result.ok)
+            publish(*batch[i]);
+        }
+      }
+      else
+      {
+        committed = false;
+        recover(batch, count);
+      }
+    }
+    uint32_t elapsed = micros() - start;
+
+    _ops += count;
+    if (committed)
+      _commits++;
+    else
+      _failedCommits++;
+    _lastCommitMicros = elapsed;
+    if (elapsed > _maxCommitMicros)
+      _maxCommitMicros = elapsed;
+
+    // Only report completion once the run is on flash
+    for (size_t i = 0; i < count; i++)
+    {
+      if (batch[i]->done)
+        batch[i]->done(batch[i]->result);
+      delete batch[i];
+    }
+
+    // Back-to-back runs, as in an import, would otherwise leave a reader
+    // retrying no gap to get in through
+    if (_readerWaiting)
+    {
+      _readerWaiting = false;
+      vTaskDelay(1);
+    }
+  }
+}
+
+// Applies one operation under the storage lock. Returns true if it left
+// registry writes that still need a sync(); a failed write counts, so the
+// sync() can report it.
+bool StorageService::apply(Op &op)
+{
+  StorageResult &result = op.result;
+
+  switch (op.type)
+  {
+  case OP_SAVE_VEHICLE:
+    result.ok = _registry->put(op.record, &result.created);
+    return true;
+
+  case OP_REMOVE_VEHICLE:
+    result.ok = _registry->remove(op.record.tag);
+    return true;
+
+  case OP_IMPORT_VEHICLES:
+  {
+    // Keep only the records that were stored, for publish()
+    size_t stored = 0;
+    for (size_t i = 0; i < op.records.size(); i++)
+    {
+      if (_registry->put(op.records[i]))
+        op.records[stored++] = op.records[i];
+    }
+    result.count = stored;
+    result.ok = stored == op.records.size();
+    op.records.resize(stored);
+    return true;
+  }
+
+  case OP_CLEAR_VEHICLES:
+  {
+    uint16_t removed = 0;
+    result.ok = _registry->clear(&removed);
+    result.count = removed;
+    return true;
+  }
+
+  case OP_SAVE_FP_META:
+    for (int id = 0; id < FINGERPRINT_MAX_SLOTS; id++)
+    {
+      if (op.fingerprints.has(id))
+      {
+        char value[FP_META_VALUE_SIZE];
+        recordToLine(op.meta, '|', true, value, sizeof(value));
+        result.ok = _preferences->putString(fingerprintKey(id).c_str(), value) > 0;
+      }
+    }
+    return false;
+
+  case OP_REMOVE_FP_META:
+    for (int id = 0; id < FINGERPRINT_MAX_SLOTS; id++)
+    {
+      if (op.fingerprints.has(id))
+      {
+        _preferences->remove(fingerprintKey(id).c_str());
+        result.count++;
+      }
+    }
+    result.ok = true;
+    return false;
+  }
+  return false;
+}
+
+// Passes a committed operation on to the tag table and the change log.
+void StorageService::publish(const Op &op)
+{
+  switch (op.type)
+  {
+  case OP_SAVE_VEHICLE:
+    _tagTable->put(op.record);
+    recordChange(op.record, false);
+    break;
+
+  case OP_REMOVE_VEHICLE:
+    _tagTable->remove(op.record.tag);
+    recordChange(op.record, true);
+    break;
+
+  case OP_IMPORT_VEHICLES:
+    for (size_t i = 0; i < op.records.size(); i++)
+    {
+      _tagTable->put(op.records[i]);
+      recordChange(op.records[i], false);
+    }
+    break;
+
+  case OP_CLEAR_VEHICLES:
+    _tagTable->clear();
+    resetChanges();
+    break;
+
+  default:
+    break;
+  }
+}
+
+// A registry write in this run failed, so none of the run's vehicle writes
+// can be reported as committed. Reopening the registry repairs whatever part
+// of them reached the file; the tag table is reloaded to match it, and since
+// which records changed is no longer known, dashboards have to reload.
+void StorageService::recover(Op **batch, size_t count)
+{
+  Serial.println("✗ Registry write failed, reopening");
+
+  for (size_t i = 0; i < count; i++)
+  {
+    OpType type = batch[i]->type;
+    if (type == OP_SAVE_VEHICLE || type == OP_REMOVE_VEHICLE ||
+        type == OP_IMPORT_VEHICLES || type == OP_CLEAR_VEHICLES)
+      batch[i]->result.ok = false;
+  }
+
+  if (!_registry->reopen() || !_tagTable->load(*_registry))
+    Serial.println("✗ Failed to reload vehicle registry");
+  resetChanges();
+}
+
+void StorageService::recordChange(const VehicleRecord &record, bool removed)
+{
+  StorageLock lock(_changeMutex);
+  VehicleChange &change = _changes[_changeHead];
+
+  // The oldest change is about to be overwritten; deltas can now only start
+  // from its generation onwards
+  if (_changeCount == STORAGE_CHANGE_LOG)
+    _changesSince = change.generation;
+  else
+    _changeCount++;
+
+  change.generation = ++_vehiclesGeneration;
+  change.removed = removed;
+  if (removed)
+  {
+    change.record = VehicleRecord();
+    change.record.tag = record.tag;
+  }
+  else
+  {
+    change.record = record;
+  }
+  _changeHead = (_changeHead + 1) % STORAGE_CHANGE_LOG;
+}
+
+// Nothing before this point can be replayed as a delta
+void StorageService::resetChanges()
+{
+  StorageLock lock(_changeMutex);
+  _vehiclesGeneration++;
+  _changesSince = _vehiclesGeneration;
+  _changeCount = 0;
+}
+
+String StorageService::fingerprintKey(int id)
+{
+  return "fp_" + String(id);
+}
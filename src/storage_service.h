@@ -0,0 +1,194 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <functional>
+#include <vector>
+
+#include "fingerprint_set.h"
+#include "tag_table.h"
+#include "vehicle_registry.h"
+
+// ============================================================================
+// STORAGE SERVICE
+// ============================================================================
+//
+// Single owner of the persistent settings: the vehicle registry, the RAM tag
+// table that mirrors it and the fingerprint metadata in Preferences. Web
+// handlers never touch them directly; they submit typed operations to a
+// queue and get a completion callback once the change is durable. The
+// callback runs on the storage task, so handlers pause the request and send
+// the response from there.
+//
+// Operations that arrive together are applied as one run and the registry is
+// flushed once at the end, so a burst of edits costs one flash commit rather
+// than one per request. The run holds the storage lock throughout, and reads
+// take it too, so they never see a half-applied run and always see every
+// write already acknowledged. Reads come from the web server task, which
+// must not wait out a flash commit, so they only try the lock: while a run
+// is in progress they return STORAGE_READ_BUSY and the list responses ask
+// the server to call them again. The change log has a lock of its own and
+// keeps each change's record in RAM, so /sync never reads flash.
+//
+// Submissions never block: when the queue is full they return false and the
+// caller should answer 503.
+//
+// Every vehicle change bumps a generation number and is remembered in a short
+// change log, so dashboards can ask for what changed since the generation
+// they last saw instead of reloading the list. The generation starts from a
+// random value at boot, so a generation from before a reboot reads as stale.
+
+const size_t STORAGE_QUEUE_DEPTH = 16;
+const size_t STORAGE_COMMIT_BATCH = 8;
+const size_t STORAGE_CHANGE_LOG = 32;
+
+struct StorageResult
+{
+  bool ok;
+  bool created;   // save: the vehicle was new
+  uint32_t count; // clear: records removed
+};
+
+typedef std::function<void(const StorageResult &)> StorageCallback;
+
+// Who a fingerprint belongs to, kept in Preferences as "owner|role"
+struct FingerprintMeta
+{
+  char owner[48];
+  char role[16];
+};
+
+template <>
+struct RecordSchema<FingerprintMeta>
+{
+  static constexpr RecordField fields[] = {
+      RECORD_TEXT(FingerprintMeta, owner, "owner"),
+      RECORD_TEXT(FingerprintMeta, role, "role"),
+  };
+  static constexpr size_t count = sizeof(fields) / sizeof(fields[0]);
+};
+
+struct VehicleChange
+{
+  uint32_t generation;
+  bool removed;
+  VehicleRecord record; // as saved; only the tag for a removal
+};
+
+enum StorageRead
+{
+  STORAGE_READ_OK,
+  STORAGE_READ_END,  // nextVehicle(): no more records
+  STORAGE_READ_BUSY  // a commit is running; try again later
+};
+
+struct StorageStats
+{
+  uint32_t ops;
+  uint32_t commits;
+  uint32_t failedCommits;
+  uint32_t rejected;
+  uint32_t queueDepth;
+  uint32_t queueHighWater;
+  uint32_t lastCommitMicros;
+  uint32_t maxCommitMicros;
+};
+
+class StorageService
+{
+public:
+  bool begin(Preferences &preferences, VehicleRegistry &registry, TagTable &tagTable);
+
+  bool saveVehicle(const VehicleRecord &record, StorageCallback done);
+  bool removeVehicle(uint32_t tag, StorageCallback done);
+  bool clearVehicles(StorageCallback done);
+
+  // Writes a batch of vehicles as one commit; result.count is how many were
+  // stored. Unlike the other requests this may wait up to wait ticks for
+  // room in the queue, so a bulk import slows its sender down instead of
+  // failing.
+  bool importVehicles(const VehicleRecord *records, size_t count, StorageCallback done, TickType_t wait);
+
+  bool saveFingerprintMeta(int id, const FingerprintMeta &meta, StorageCallback done);
+  bool removeFingerprintMeta(int id, StorageCallback done);
+  bool removeFingerprintMeta(const FingerprintSet &ids, StorageCallback done);
+
+  // Reads for the list endpoints, which stream rows as the web server asks
+  // for them. They never wait for a commit (see above). nextVehicle() walks
+  // like VehicleRegistry::next() and leaves cursor alone when busy.
+  StorageRead nextVehicle(uint16_t &cursor, VehicleRecord &record);
+  StorageRead fingerprintMeta(int id, FingerprintMeta &meta);
+
+  uint32_t vehiclesGeneration() const { return _vehiclesGeneration; }
+
+  // Copies the changes made after generation since, oldest first, into
+  // changes (room for STORAGE_CHANGE_LOG). Returns false if since is older
+  // than the change log reaches back, and the caller must reload everything.
+  // Only waits for the change log, never for a commit.
+  bool vehicleChangesSince(uint32_t since, VehicleChange *changes, size_t &count);
+
+  StorageStats stats() const;
+
+private:
+  enum OpType
+  {
+    OP_SAVE_VEHICLE,
+    OP_REMOVE_VEHICLE,
+    OP_CLEAR_VEHICLES,
+    OP_IMPORT_VEHICLES,
+    OP_SAVE_FP_META,
+    OP_REMOVE_FP_META
+  };
+
+  struct Op
+  {
+    OpType type;
+    VehicleRecord record;
+    std::vector<VehicleRecord> records; // import
+    FingerprintSet fingerprints;
+    FingerprintMeta meta;
+    StorageCallback done;
+    StorageResult result;
+  };
+
+  bool submit(Op *op, TickType_t wait = 0);
+  bool tryReadLock();
+  static void taskEntry(void *param);
+  void run();
+  bool apply(Op &op);
+  void publish(const Op &op);
+  void recover(Op **batch, size_t count);
+  void recordChange(const VehicleRecord &record, bool removed);
+  void resetChanges();
+
+  static String fingerprintKey(int id);
+
+  Preferences *_preferences = NULL;
+  VehicleRegistry *_registry = NULL;
+  TagTable *_tagTable = NULL;
+
+  QueueHandle_t _queue = NULL;
+  SemaphoreHandle_t _mutex = NULL;
+  SemaphoreHandle_t _changeMutex = NULL;
+  TaskHandle_t _task = NULL;
+
+  // Set by a read turned away by a run; the storage task then lets the
+  // readers in before starting the next one
+  volatile bool _readerWaiting = false;
+
+  // Ring of the latest vehicle changes. Every change after _changesSince is
+  // in it; guarded by _changeMutex.
+  VehicleChange _changes[STORAGE_CHANGE_LOG];
+  size_t _changeHead = 0;
+  size_t _changeCount = 0;
+  uint32_t _changesSince = 0;
+  volatile uint32_t _vehiclesGeneration = 0;
+
+  volatile uint32_t _ops = 0;
+  volatile uint32_t _commits = 0;
+  volatile uint32_t _failedCommits = 0;
+  volatile uint32_t _rejected = 0;
+  volatile uint32_t _queueHighWater = 0;
+  volatile uint32_t _lastCommitMicros = 0;
+  volatile uint32_t _maxCommitMicros = 0;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================================================
+// RFID TAG IDS
+// ============================================================================
+
+// Tags are 4 raw bytes off the reader, packed big-endian into a uint32_t so
+// that the 8-character hex form matches what the dashboard has always shown.
+const size_t TAG_HEX_LENGTH = 8;
+
+inline bool parseTagHex(const char *text, uint32_t &tag)
+{
+  if (text == NULL)
+    return false;
+
+  uint32_t value = 0;
+  size_t i = 0;
+  for (; text[i] != '\0'; i++)
+  {
+    if (i >= TAG_HEX_LENGTH)
+      return false;
+
+    char c = text[i];
+    uint8_t nibble;
+    if (c >= '0' && c <= '9')
+      nibble = c - '0';
+    else if (c >= 'A' && c <= 'F')
+      nibble = c - 'A' + 10;
+    else if (c >= 'a' && c <= 'f')
+      nibble = c - 'a' + 10;
+    else
+      return false;
+
+    value = (value << 4) | nibble;
+  }
+
+  if (i != TAG_HEX_LENGTH)
+    return false;
+
+  tag = value;
+  return true;
+}
+
+// Packs a raw reader frame (most significant byte first).
+inline uint32_t packTag(const uint8_t *bytes)
+{
+  return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) |
+         ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+// Two hex digits per byte value, so formatting is four table copies.
+static const char TAG_HEX_PAIRS[] =
+    "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+// Writes the uppercase hex form plus a terminator; out must hold 9 chars.
+inline void formatTagHex(uint32_t tag, char *out)
+{
+  for (int i = 3; i >= 0; i--)
+  {
+    const char *pair = &TAG_HEX_PAIRS[(tag & 0xFF) * 2];
+    out[i * 2] = pair[0];
+    out[i * 2 + 1] = pair[1];
+    tag >>= 8;
+  }
+  out[TAG_HEX_LENGTH] = '\0';
+}
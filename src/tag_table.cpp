@@ -0,0 +1,238 @@
+#include "tag_table.h"
+
+namespace
+{
+const uint16_t ENTRY_EMPTY = 0xFFFF;
+const uint16_t MIN_CAPACITY = 16;
+
+void fillInfo(TagInfo &info, const VehicleRecord &record)
+{
+  memcpy(info.plateNo, record.plateNo, sizeof(info.plateNo));
+  memcpy(info.owner, record.owner, sizeof(info.owner));
+  memcpy(info.role, record.role, sizeof(info.role));
+}
+} // namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+bool TagTable::load(VehicleRegistry &registry)
+{
+  clear();
+  if (!reserve(registry.count()))
+    return false;
+
+  VehicleRecord record;
+  uint16_t cursor = 0;
+  while (registry.next(cursor, record))
+  {
+    if (!put(record))
+      return false;
+  }
+  return true;
+}
+
+bool TagTable::put(const VehicleRecord &record)
+{
+  portENTER_CRITICAL(&_lock);
+  int32_t bucket = findBucket(record.tag);
+  if (bucket >= 0)
+  {
+    fillInfo(_entries[_buckets[bucket].entry], record);
+    portEXIT_CRITICAL(&_lock);
+    return true;
+  }
+  portEXIT_CRITICAL(&_lock);
+
+  // Allocation happens outside the critical section
+  if (!reserve(_count + 1))
+    return false;
+
+  portENTER_CRITICAL(&_lock);
+  uint16_t entry = _count++;
+  _entryTags[entry] = record.tag;
+  fillInfo(_entries[entry], record);
+
+  const uint16_t mask = (1 << _bucketBits) - 1;
+  uint16_t index = homeBucket(record.tag);
+  while (_buckets[index].entry != ENTRY_EMPTY)
+    index = (index + 1) & mask;
+  _buckets[index].tag = record.tag;
+  _buckets[index].entry = entry;
+  portEXIT_CRITICAL(&_lock);
+  return true;
+}
+
+bool TagTable::remove(uint32_t tag)
+{
+  portENTER_CRITICAL(&_lock);
+  int32_t bucket = findBucket(tag);
+  if (bucket < 0)
+  {
+    portEXIT_CRITICAL(&_lock);
+    return false;
+  }
+
+  uint16_t entry = _buckets[bucket].entry;
+  eraseBucket(bucket);
+
+  // Keep entries dense: move the last one into the hole and repoint its bucket
+  uint16_t last = _count - 1;
+  if (entry != last)
+  {
+    _entries[entry] = _entries[last];
+    _entryTags[entry] = _entryTags[last];
+    _buckets[findBucket(_entryTags[last])].entry = entry;
+  }
+  _count--;
+  portEXIT_CRITICAL(&_lock);
+  return true;
+}
+
+void TagTable::clear()
+{
+  portENTER_CRITICAL(&_lock);
+  if (_buckets != NULL)
+  {
+    for (uint32_t i = 0; i < (1u << _bucketBits); i++)
+      _buckets[i].entry = ENTRY_EMPTY;
+  }
+  _count = 0;
+  portEXIT_CRITICAL(&_lock);
+}
+
+bool TagTable::lookup(uint32_t tag, TagInfo &info)
+{
+  portENTER_CRITICAL(&_lock);
+  int32_t bucket = _buckets != NULL ? findBucket(tag) : -1;
+  if (bucket >= 0)
+    info = _entries[_buckets[bucket].entry];
+  portEXIT_CRITICAL(&_lock);
+  return bucket >= 0;
+}
+
+size_t TagTable::memoryUsage() const
+{
+  size_t buckets = _buckets != NULL ? ((size_t)1 << _bucketBits) : 0;
+  return sizeof(*this) + buckets * sizeof(Bucket) +
+         (size_t)_capacity * (sizeof(TagInfo) + sizeof(uint32_t));
+}
+
+// ============================================================================
+// INTERNALS
+// ============================================================================
+
+// Grows entries and index together so the index stays at most half full.
+// New arrays are built first and swapped in under the lock.
+bool TagTable::reserve(uint16_t entries)
+{
+  if (entries <= _capacity)
+    return true;
+  if (entries > REGISTRY_MAX_VEHICLES)
+    return false;
+
+  uint16_t capacity = _capacity > 0 ? _capacity : MIN_CAPACITY;
+  while (capacity < entries)
+    capacity *= 2;
+  if (capacity > REGISTRY_MAX_VEHICLES)
+    capacity = REGISTRY_MAX_VEHICLES;
+
+  uint8_t bits = 1;
+  while ((1u << bits) < 2u * capacity)
+    bits++;
+
+  TagInfo *newEntries = (TagInfo *)malloc(capacity * sizeof(TagInfo));
+  uint32_t *newTags = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+  Bucket *newBuckets = (Bucket *)malloc((1u << bits) * sizeof(Bucket));
+  if (newEntries == NULL || newTags == NULL || newBuckets == NULL)
+  {
+    free(newEntries);
+    free(newTags);
+    free(newBuckets);
+    return false;
+  }
+
+  const uint16_t mask = (1 << bits) - 1;
+  for (uint32_t i = 0; i < (1u << bits); i++)
+    newBuckets[i].entry = ENTRY_EMPTY;
+
+  portENTER_CRITICAL(&_lock);
+  if (_count > 0)
+  {
+    memcpy(newEntries, _entries, _count * sizeof(TagInfo));
+    memcpy(newTags, _entryTags, _count * sizeof(uint32_t));
+  }
+  for (uint16_t entry = 0; entry < _count; entry++)
+  {
+    uint16_t index = (uint16_t)((newTags[entry] * 2654435761u) >> (32 - bits));
+    while (newBuckets[index].entry != ENTRY_EMPTY)
+      index = (index + 1) & mask;
+    newBuckets[index].tag = newTags[entry];
+    newBuckets[index].entry = entry;
+  }
+
+  TagInfo *oldEntries = _entries;
+  uint32_t *oldTags = _entryTags;
+  Bucket *oldBuckets = _buckets;
+  _entries = newEntries;
+  _entryTags = newTags;
+  _buckets = newBuckets;
+  _bucketBits = bits;
+  _capacity = capacity;
+  portEXIT_CRITICAL(&_lock);
+
+  free(oldEntries);
+  free(oldTags);
+  free(oldBuckets);
+  return true;
+}
+
+int32_t TagTable::findBucket(uint32_t tag) const
+{
+  if (_buckets == NULL)
+    return -1;
+
+  const uint16_t mask = (1 << _bucketBits) - 1;
+  uint16_t index = homeBucket(tag);
+  while (_buckets[index].entry != ENTRY_EMPTY)
+  {
+    if (_buckets[index].tag == tag)
+      return index;
+    index = (index + 1) & mask;
+  }
+  return -1;
+}
+
+uint16_t TagTable::homeBucket(uint32_t tag) const
+{
+  return (uint16_t)((tag * 2654435761u) >> (32 - _bucketBits));
+}
+
+// Backward-shift deletion: pull later members of the probe run into the gap
+// so lookups never need tombstones.
+void TagTable::eraseBucket(uint16_t bucket)
+{
+  const uint16_t mask = (1 << _bucketBits) - 1;
+  uint16_t hole = bucket;
+  uint16_t index = bucket;
+
+  while (true)
+  {
+    index = (index + 1) & mask;
+    if (_buckets[index].entry == ENTRY_EMPTY)
+      break;
+
+    // Leave the bucket alone if its home lies cyclically in (hole, index]
+    uint16_t home = homeBucket(_buckets[index].tag);
+    bool stays = hole <= index ? (hole < home && home <= index)
+                               : (hole < home || home <= index);
+    if (stays)
+      continue;
+
+    _buckets[hole] = _buckets[index];
+    hole = index;
+  }
+
+  _buckets[hole].entry = ENTRY_EMPTY;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "vehicle_registry.h"
+
+// ============================================================================
+// TAG LOOKUP TABLE
+// ============================================================================
+//
+// RAM copy of the fields the detection path needs, keyed by the 32-bit tag.
+// Loaded from the registry at boot and kept in step by the vehicle handlers,
+// so resolving a detected tag is a hash probe and a short copy with no flash
+// access. Entries are stored densely and the index is a linear-probing table
+// at most half full; both grow by doubling as vehicles are registered.
+
+struct TagInfo
+{
+  char plateNo[sizeof(VehicleRecord::plateNo)];
+  char owner[sizeof(VehicleRecord::owner)];
+  char role[sizeof(VehicleRecord::role)];
+};
+
+class TagTable
+{
+public:
+  bool load(VehicleRegistry &registry);
+
+  // Mutators are meant to be called from one task at a time; lookup() is safe
+  // to call concurrently with them.
+  bool put(const VehicleRecord &record);
+  bool remove(uint32_t tag);
+  void clear();
+
+  bool lookup(uint32_t tag, TagInfo &info);
+
+  uint16_t count() const { return _count; }
+  uint16_t capacity() const { return _capacity; }
+  size_t memoryUsage() const;
+
+private:
+  struct Bucket
+  {
+    uint32_t tag;
+    uint16_t entry;
+  };
+
+  bool reserve(uint16_t entries);
+  int32_t findBucket(uint32_t tag) const;
+  uint16_t homeBucket(uint32_t tag) const;
+  void eraseBucket(uint16_t bucket);
+
+  Bucket *_buckets = NULL;
+  uint8_t _bucketBits = 0;
+  TagInfo *_entries = NULL;
+  uint32_t *_entryTags = NULL;
+  uint16_t _capacity = 0;
+  uint16_t _count = 0;
+  portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// UART PORT
+// ============================================================================
+//
+// Receive side of a serial line, as the RFID reader task sees it: block until
+// bytes arrive or a timeout runs out. The firmware reads through the ESP-IDF
+// UART driver (esp32_uart.h); the host build reads a pseudo-terminal, so a
+// script can play the reader module.
+
+const uint32_t UART_WAIT_FOREVER = 0xFFFFFFFF;
+
+// read() result when the receiver dropped bytes; whatever was buffered is
+// discarded, so the next byte may be in the middle of a frame
+const int UART_READ_OVERFLOW = -1;
+
+class UartPort
+{
+public:
+  virtual ~UartPort() {}
+
+  // Waits up to timeoutMs (UART_WAIT_FOREVER for no limit) and returns the
+  // number of bytes read, 0 on timeout, or UART_READ_OVERFLOW
+  virtual int read(uint8_t *buffer, size_t size, uint32_t timeoutMs) = 0;
+};
@@ -0,0 +1,475 @@
+#include "vehicle_registry.h"
+
+constexpr RecordField RecordSchema<VehicleRecord>::fields[];
+
+namespace
+{
+const uint32_t REGISTRY_MAGIC = 0x47455256; // "VREG"
+const uint16_t REGISTRY_VERSION = 1;
+
+const uint32_t EMPTY_TAG = 0xFFFFFFFF;
+const uint16_t SLOT_EMPTY = 0xFFFF;
+const uint16_t SLOT_TOMBSTONE = 0xFFFE;
+const uint16_t SLOT_NONE = 0xFFFF;
+
+const uint32_t SLOT_LIVE = 0x4556494C; // "LIVE"
+const uint32_t SLOT_FREE = 0x45455246; // "FREE"
+
+// Rehash once a quarter of the buckets are tombstones so probe chains for
+// missing tags stay short.
+const uint16_t MAX_TOMBSTONES = REGISTRY_BUCKETS / 4;
+} // namespace
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+bool VehicleRegistry::begin(fs::FS &fs, const char *path)
+{
+  _fs = &fs;
+  _path = path;
+  _writeFailed = false;
+
+  if (_fs->exists(_path))
+  {
+    _file = _fs->open(_path, "r+");
+    if (_file && readAt(0, &_header, sizeof(_header)) &&
+        _header.magic == REGISTRY_MAGIC &&
+        _header.version == REGISTRY_VERSION &&
+        _header.buckets == REGISTRY_BUCKETS)
+    {
+      if (consistent())
+        return true;
+
+      Serial.println("⚠ Registry index out of step with its records, repairing");
+      if (repair())
+        return true;
+    }
+
+    if (_file)
+      _file.close();
+    Serial.println("⚠ Registry file invalid, recreating");
+  }
+
+  return format();
+}
+
+bool VehicleRegistry::get(uint32_t tag, VehicleRecord &record)
+{
+  uint16_t bucket, slot;
+  if (!findBucket(tag, bucket, slot))
+    return false;
+
+  return readAt(slotOffset(slot) + sizeof(SlotHeader), &record, sizeof(record));
+}
+
+bool VehicleRegistry::contains(uint32_t tag)
+{
+  uint16_t bucket, slot;
+  return findBucket(tag, bucket, slot);
+}
+
+bool VehicleRegistry::put(const VehicleRecord &record, bool *created)
+{
+  uint16_t bucket, slot;
+  bool exists = findBucket(record.tag, bucket, slot);
+
+  if (created != NULL)
+    *created = !exists;
+
+  // Update in place: one slot write, index untouched
+  if (exists)
+    return writeAt(slotOffset(slot) + sizeof(SlotHeader), &record, sizeof(record));
+
+  if (_header.count >= REGISTRY_MAX_VEHICLES)
+    return false;
+
+  // Take a slot from the free list, or grow the file by one
+  SlotHeader slotHeader;
+  if (_header.freeHead != SLOT_NONE)
+  {
+    slot = _header.freeHead;
+    if (!readAt(slotOffset(slot), &slotHeader, sizeof(slotHeader)))
+      return false;
+    _header.freeHead = slotHeader.nextFree;
+  }
+  else
+  {
+    slot = _header.highWater++;
+  }
+
+  slotHeader.state = SLOT_LIVE;
+  slotHeader.nextFree = SLOT_NONE;
+  slotHeader.reserved = 0;
+
+  // Slot, index, header. LittleFS only commits the file at sync(), so a
+  // reset loses the whole batch; but a write that fails part-way here is
+  // committed by the next sync() as it stands, with a live slot the index
+  // cannot reach or a stale header. begin() checks for that and repairs it.
+  if (!writeAt(slotOffset(slot), &slotHeader, sizeof(slotHeader)) ||
+      !writeAt(slotOffset(slot) + sizeof(SlotHeader), &record, sizeof(record)))
+    return false;
+
+  Bucket entry;
+  if (!readAt(bucketOffset(bucket), &entry, sizeof(entry)))
+    return false;
+  if (entry.slot == SLOT_TOMBSTONE)
+    _header.tombstones--;
+
+  entry.tag = record.tag;
+  entry.slot = slot;
+  entry.reserved = 0;
+  if (!writeAt(bucketOffset(bucket), &entry, sizeof(entry)))
+    return false;
+
+  _header.count++;
+  return writeHeader();
+}
+
+bool VehicleRegistry::remove(uint32_t tag)
+{
+  uint16_t bucket, slot;
+  if (!findBucket(tag, bucket, slot))
+    return false;
+
+  Bucket entry = {EMPTY_TAG, SLOT_TOMBSTONE, 0};
+  if (!writeAt(bucketOffset(bucket), &entry, sizeof(entry)))
+    return false;
+
+  SlotHeader slotHeader = {SLOT_FREE, _header.freeHead, 0};
+  if (!writeAt(slotOffset(slot), &slotHeader, sizeof(slotHeader)))
+    return false;
+
+  _header.freeHead = slot;
+  _header.count--;
+  _header.tombstones++;
+
+  bool ok = writeHeader();
+  if (ok && _header.tombstones > MAX_TOMBSTONES)
+    ok = rebuildIndex();
+  return ok;
+}
+
+bool VehicleRegistry::sync()
+{
+  if (_file)
+    _file.flush();
+
+  bool ok = _file && !_writeFailed;
+  _writeFailed = false;
+  return ok;
+}
+
+bool VehicleRegistry::reopen()
+{
+  if (_file)
+    _file.close();
+  return begin(*_fs, _path);
+}
+
+bool VehicleRegistry::clear(uint16_t *removed)
+{
+  if (removed != NULL)
+    *removed = _header.count;
+  if (_file)
+    _file.close();
+  _fs->remove(_path);
+  return format();
+}
+
+bool VehicleRegistry::next(uint16_t &cursor, VehicleRecord &record)
+{
+  SlotHeader slotHeader;
+  while (cursor < _header.highWater)
+  {
+    uint16_t slot = cursor++;
+    if (!readAt(slotOffset(slot), &slotHeader, sizeof(slotHeader)))
+      return false;
+    if (slotHeader.state != SLOT_LIVE)
+      continue;
+    return readAt(slotOffset(slot) + sizeof(SlotHeader), &record, sizeof(record));
+  }
+  return false;
+}
+
+// ============================================================================
+// INDEX MAINTENANCE
+// ============================================================================
+
+bool VehicleRegistry::format()
+{
+  _file = _fs->open(_path, "w");
+  if (!_file)
+  {
+    Serial.println("✗ Failed to create registry file");
+    return false;
+  }
+
+  _header.magic = REGISTRY_MAGIC;
+  _header.version = REGISTRY_VERSION;
+  _header.buckets = REGISTRY_BUCKETS;
+  _header.count = 0;
+  _header.tombstones = 0;
+  _header.freeHead = SLOT_NONE;
+  _header.highWater = 0;
+  bool written = _file.write((const uint8_t *)&_header, sizeof(_header)) == sizeof(_header);
+
+  Bucket empty[64];
+  for (size_t i = 0; i < 64; i++)
+    empty[i] = {EMPTY_TAG, SLOT_EMPTY, 0};
+  for (uint16_t i = 0; i < REGISTRY_BUCKETS && written; i += 64)
+    written = _file.write((const uint8_t *)empty, sizeof(empty)) == sizeof(empty);
+
+  _file.close();
+  if (!written)
+  {
+    Serial.println("✗ Failed to write empty registry");
+    _writeFailed = true;
+    return false;
+  }
+
+  _file = _fs->open(_path, "r+");
+  return (bool)_file;
+}
+
+bool VehicleRegistry::clearIndex()
+{
+  Bucket empty[64];
+  for (size_t i = 0; i < 64; i++)
+    empty[i] = {EMPTY_TAG, SLOT_EMPTY, 0};
+  for (uint16_t i = 0; i < REGISTRY_BUCKETS; i += 64)
+  {
+    if (!writeAt(bucketOffset(i), empty, sizeof(empty)))
+      return false;
+  }
+  return true;
+}
+
+bool VehicleRegistry::rebuildIndex()
+{
+  if (!clearIndex())
+    return false;
+
+  SlotHeader slotHeader;
+  uint32_t tag;
+  for (uint16_t slot = 0; slot < _header.highWater; slot++)
+  {
+    if (!readAt(slotOffset(slot), &slotHeader, sizeof(slotHeader)))
+      return false;
+    if (slotHeader.state != SLOT_LIVE)
+      continue;
+    if (!readAt(slotOffset(slot) + sizeof(SlotHeader), &tag, sizeof(tag)) ||
+        !insertBucket(tag, slot))
+      return false;
+  }
+
+  _header.tombstones = 0;
+  return writeHeader();
+}
+
+// True if the header, the slots and the index agree: every slot in the
+// file is counted by highWater, every live slot is reachable through the
+// index and the index holds nothing else.
+bool VehicleRegistry::consistent()
+{
+  if (slotsInFile() != _header.highWater)
+    return false;
+
+  SlotHeader slotHeader;
+  uint32_t tag;
+  uint16_t live = 0;
+  for (uint16_t slot = 0; slot < _header.highWater; slot++)
+  {
+    if (!readAt(slotOffset(slot), &slotHeader, sizeof(slotHeader)))
+      return false;
+    if (slotHeader.state != SLOT_LIVE)
+      continue;
+
+    uint16_t bucket, found;
+    if (!readAt(slotOffset(slot) + sizeof(SlotHeader), &tag, sizeof(tag)) ||
+        !findBucket(tag, bucket, found) || found != slot)
+      return false;
+    live++;
+  }
+
+  Bucket entries[64];
+  uint16_t indexed = 0;
+  uint16_t tombstones = 0;
+  for (uint16_t i = 0; i < REGISTRY_BUCKETS; i += 64)
+  {
+    if (!readAt(bucketOffset(i), entries, sizeof(entries)))
+      return false;
+    for (size_t j = 0; j < 64; j++)
+    {
+      if (entries[j].slot == SLOT_TOMBSTONE)
+        tombstones++;
+      else if (entries[j].slot != SLOT_EMPTY)
+        indexed++;
+    }
+  }
+
+  return live == _header.count && indexed == live && tombstones == _header.tombstones;
+}
+
+// Rebuilds the header, the free list and the index from the slots alone.
+// A tag live in two slots keeps the first.
+bool VehicleRegistry::repair()
+{
+  _header.highWater = slotsInFile();
+  _header.count = 0;
+  _header.tombstones = 0;
+  _header.freeHead = SLOT_NONE;
+  if (!clearIndex())
+    return false;
+
+  SlotHeader slotHeader;
+  uint32_t tag;
+  for (uint16_t slot = 0; slot < _header.highWater; slot++)
+  {
+    if (!readAt(slotOffset(slot), &slotHeader, sizeof(slotHeader)))
+      return false;
+
+    if (slotHeader.state == SLOT_LIVE)
+    {
+      uint16_t bucket, found;
+      if (!readAt(slotOffset(slot) + sizeof(SlotHeader), &tag, sizeof(tag)))
+        return false;
+      if (!findBucket(tag, bucket, found))
+      {
+        if (!insertBucket(tag, slot))
+          return false;
+        _header.count++;
+        continue;
+      }
+    }
+
+    slotHeader = {SLOT_FREE, _header.freeHead, 0};
+    if (!writeAt(slotOffset(slot), &slotHeader, sizeof(slotHeader)))
+      return false;
+    _header.freeHead = slot;
+  }
+
+  if (!writeHeader())
+    return false;
+  sync();
+  return true;
+}
+
+// Whole slots only: a slot cut short by a failed write is reused by the
+// next insert
+uint16_t VehicleRegistry::slotsInFile()
+{
+  size_t size = _file.size();
+  uint32_t start = slotOffset(0);
+  if (size <= start)
+    return 0;
+  size_t slots = (size - start) / (sizeof(SlotHeader) + sizeof(VehicleRecord));
+  return slots < REGISTRY_MAX_VEHICLES ? (uint16_t)slots : REGISTRY_MAX_VEHICLES;
+}
+
+// Linear probe from the tag's home bucket. On a hit, bucket/slot locate the
+// entry; on a miss, bucket is where the tag should be inserted (the first
+// tombstone seen, or the empty bucket that ended the chain).
+bool VehicleRegistry::findBucket(uint32_t tag, uint16_t &bucket, uint16_t &slot)
+{
+  const uint16_t mask = REGISTRY_BUCKETS - 1;
+  uint16_t home = hashTag(tag);
+  int32_t firstTombstone = -1;
+  Bucket entry;
+
+  for (uint16_t probe = 0; probe < REGISTRY_BUCKETS; probe++)
+  {
+    uint16_t index = (home + probe) & mask;
+    if (!readAt(bucketOffset(index), &entry, sizeof(entry)))
+      break;
+
+    if (entry.slot == SLOT_EMPTY)
+    {
+      bucket = firstTombstone >= 0 ? (uint16_t)firstTombstone : index;
+      return false;
+    }
+
+    if (entry.slot == SLOT_TOMBSTONE)
+    {
+      if (firstTombstone < 0)
+        firstTombstone = index;
+      continue;
+    }
+
+    if (entry.tag == tag)
+    {
+      bucket = index;
+      slot = entry.slot;
+      return true;
+    }
+  }
+
+  bucket = firstTombstone >= 0 ? (uint16_t)firstTombstone : home;
+  return false;
+}
+
+bool VehicleRegistry::insertBucket(uint32_t tag, uint16_t slot)
+{
+  const uint16_t mask = REGISTRY_BUCKETS - 1;
+  uint16_t home = hashTag(tag);
+  Bucket entry;
+
+  for (uint16_t probe = 0; probe < REGISTRY_BUCKETS; probe++)
+  {
+    uint16_t index = (home + probe) & mask;
+    if (!readAt(bucketOffset(index), &entry, sizeof(entry)))
+      return false;
+    if (entry.slot != SLOT_EMPTY)
+      continue;
+
+    entry.tag = tag;
+    entry.slot = slot;
+    entry.reserved = 0;
+    return writeAt(bucketOffset(index), &entry, sizeof(entry));
+  }
+  return false;
+}
+
+// ============================================================================
+// FILE ACCESS
+// ============================================================================
+
+bool VehicleRegistry::readAt(uint32_t offset, void *data, size_t length)
+{
+  if (!_file.seek(offset, fs::SeekSet))
+    return false;
+  return _file.read((uint8_t *)data, length) == length;
+}
+
+bool VehicleRegistry::writeAt(uint32_t offset, const void *data, size_t length)
+{
+  if (_file.seek(offset, fs::SeekSet) &&
+      _file.write((const uint8_t *)data, length) == length)
+    return true;
+
+  _writeFailed = true;
+  return false;
+}
+
+bool VehicleRegistry::writeHeader()
+{
+  return writeAt(0, &_header, sizeof(_header));
+}
+
+// Fibonacci hashing: tags from one batch of cards often differ only in the
+// low bytes, so take the well-mixed high bits of the product.
+uint16_t VehicleRegistry::hashTag(uint32_t tag)
+{
+  return (uint16_t)((tag * 2654435761u) >> (32 - REGISTRY_BUCKET_BITS));
+}
+
+uint32_t VehicleRegistry::bucketOffset(uint16_t bucket)
+{
+  return sizeof(Header) + (uint32_t)bucket * sizeof(Bucket);
+}
+
+uint32_t VehicleRegistry::slotOffset(uint16_t slot)
+{
+  return sizeof(Header) + (uint32_t)REGISTRY_BUCKETS * sizeof(Bucket) +
+         (uint32_t)slot * (sizeof(SlotHeader) + sizeof(VehicleRecord));
+}
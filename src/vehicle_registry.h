@@ -0,0 +1,141 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include "record_schema.h"
+
+// ============================================================================
+// VEHICLE REGISTRY
+// ============================================================================
+//
+// Registered vehicles live in one LittleFS file made of fixed-width binary
+// records, addressed through a persistent open-addressing hash index keyed by
+// the 32-bit RFID tag:
+//
+//   [ header | index buckets | record slots ... ]
+//
+// Lookup, insert, update and delete probe a handful of buckets and touch a
+// single slot, so their cost does not grow with the fleet. Deleted slots are
+// chained into a free list and reused before the file grows. begin() checks
+// the index against the slots and rebuilds it if a failed write left them
+// out of step.
+
+const uint16_t REGISTRY_MAX_VEHICLES = 1024;
+const uint16_t REGISTRY_BUCKET_BITS = 11;
+const uint16_t REGISTRY_BUCKETS = 1 << REGISTRY_BUCKET_BITS; // 2x capacity keeps probes short
+
+struct VehicleRecord
+{
+  uint32_t tag;
+  char plateNo[16];
+  char type[16];
+  char owner[48];
+  char role[16];
+  char year[16];
+  char section[16];
+  char course[32];
+};
+
+// rfid first, then the text fields in the order of the CSV columns and the
+// old '|'-joined NVS strings
+template <>
+struct RecordSchema<VehicleRecord>
+{
+  static constexpr RecordField fields[] = {
+      RECORD_TAG(VehicleRecord, tag, "rfid"),
+      RECORD_TEXT(VehicleRecord, plateNo, "plateNo"),
+      RECORD_TEXT(VehicleRecord, type, "type"),
+      RECORD_TEXT(VehicleRecord, owner, "owner"),
+      RECORD_TEXT(VehicleRecord, role, "role"),
+      RECORD_TEXT(VehicleRecord, year, "year"),
+      RECORD_TEXT(VehicleRecord, section, "section"),
+      RECORD_TEXT(VehicleRecord, course, "course"),
+  };
+  static constexpr size_t count = sizeof(fields) / sizeof(fields[0]);
+};
+
+class VehicleRegistry
+{
+public:
+  // Opens the registry file, creating an empty one if it is missing or was
+  // written by an incompatible version.
+  bool begin(fs::FS &fs, const char *path);
+
+  bool get(uint32_t tag, VehicleRecord &record);
+  bool contains(uint32_t tag);
+
+  // Inserts or overwrites the record for record.tag. created reports which.
+  bool put(const VehicleRecord &record, bool *created = NULL);
+
+  // Returns false if the tag was not registered.
+  bool remove(uint32_t tag);
+
+  // put() and remove() leave their writes buffered so several can share one
+  // commit; sync() makes them durable. Returns false if a write since the
+  // last sync() failed, in which case the file may hold part of it and the
+  // registry should be reopened.
+  bool sync();
+
+  // Closes the registry and opens it again, which checks it against its
+  // index and repairs it.
+  bool reopen();
+
+  // Drops every record; removed reports how many there were.
+  bool clear(uint16_t *removed = NULL);
+
+  // Walks live records in slot order. Start with cursor = 0 and call until it
+  // returns false.
+  bool next(uint16_t &cursor, VehicleRecord &record);
+
+  uint16_t count() const { return _header.count; }
+
+private:
+  struct Header
+  {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t buckets;
+    uint16_t count;
+    uint16_t tombstones;
+    uint16_t freeHead;
+    uint16_t highWater;
+  };
+
+  struct Bucket
+  {
+    uint32_t tag;
+    uint16_t slot;
+    uint16_t reserved;
+  };
+
+  struct SlotHeader
+  {
+    uint32_t state;
+    uint16_t nextFree;
+    uint16_t reserved;
+  };
+
+  bool format();
+  bool clearIndex();
+  bool rebuildIndex();
+  bool consistent();
+  bool repair();
+  uint16_t slotsInFile();
+  bool findBucket(uint32_t tag, uint16_t &bucket, uint16_t &slot);
+  bool insertBucket(uint32_t tag, uint16_t slot);
+
+  bool readAt(uint32_t offset, void *data, size_t length);
+  bool writeAt(uint32_t offset, const void *data, size_t length);
+  bool writeHeader();
+
+  static uint16_t hashTag(uint32_t tag);
+  static uint32_t bucketOffset(uint16_t bucket);
+  static uint32_t slotOffset(uint16_t slot);
+
+  fs::FS *_fs = NULL;
+  const char *_path = NULL;
+  fs::File _file;
+  Header _header = {};
+  bool _writeFailed = false;
+};
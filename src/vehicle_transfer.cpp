@@ -0,0 +1,474 @@
+#include "vehicle_transfer.h"
+
+#include <ArduinoJson.h>
+#include <deque>
+#include <memory>
+
+#include "wire_response.h"
+
+namespace
+{
+const char *CSV_HEADER = "rfid,plateNo,type,owner,role,year,section,course\n";
+
+// A CSV line with every character escaped, plus its newline
+static_assert(recordMaxLineLength<VehicleRecord>() + 1 <= VEHICLE_IMPORT_LINE_MAX,
+              "VEHICLE_IMPORT_LINE_MAX cannot hold the longest vehicle line");
+
+// A list row with every character escaped, and its braces
+static_assert(recordMaxJsonLength<VehicleRecord>() + 2 <= JSON_STREAM_TEXT_SIZE,
+              "JSON_STREAM_TEXT_SIZE cannot hold the longest vehicle row");
+
+class ImportLock
+{
+public:
+  explicit ImportLock(SemaphoreHandle_t mutex) : _mutex(mutex) { xSemaphoreTake(_mutex, portMAX_DELAY); }
+  ~ImportLock() { xSemaphoreGive(_mutex); }
+
+private:
+  SemaphoreHandle_t _mutex;
+};
+} // namespace
+
+struct VehicleImporter::Job
+{
+  struct Batch
+  {
+    std::vector<VehicleRecord> records;
+    bool last;
+  };
+
+  Job() : mutex(xSemaphoreCreateMutex()) {}
+  ~Job() { vSemaphoreDelete(mutex); }
+
+  StorageService *storage = NULL;
+  AsyncWebServerRequestPtr request; // set once the body is complete
+
+  // Parse results, only touched by the body handler
+  uint32_t lines = 0;
+  uint32_t invalid = 0;
+  uint32_t firstInvalidLine = 0;
+
+  // Everything below is shared with the storage task and guarded by mutex
+  SemaphoreHandle_t mutex;
+  std::deque<Batch> pending; // not yet on the storage queue, oldest first
+  size_t queued = 0;         // on the storage queue, not yet committed
+  bool finished = false;     // no more batches will be added
+  bool overflowed = false;   // rows were dropped for lack of room
+  uint32_t stored = 0;
+  uint32_t failed = 0;
+};
+
+// ============================================================================
+// ROW FORMAT
+// ============================================================================
+
+void fillVehicleRow(JsonObject obj, const VehicleRecord &record)
+{
+  recordToJson(obj, record);
+}
+
+const char *readVehicleRow(JsonObjectConst obj, VehicleRecord &record)
+{
+  const RecordField *invalid = recordFromJson(obj, record);
+  if (invalid == NULL)
+    return NULL;
+  return invalid->type == FIELD_TAG ? "RFID must be 8 hex characters" : "Field too long";
+}
+
+bool parseVehicleFormat(AsyncWebServerRequest *request, VehicleFormat &format, bool allowMsgPack)
+{
+  String name;
+  if (request->hasParam("format"))
+    name = request->getParam("format")->value();
+  else if (allowMsgPack && negotiateWireFormat(request) == WIRE_FORMAT_MSGPACK)
+    name = "msgpack";
+  else if (request->contentType().indexOf("json") >= 0)
+    name = "ndjson";
+  else
+    name = "csv";
+
+  if (name == "csv")
+    format = VEHICLE_FORMAT_CSV;
+  else if (name == "ndjson")
+    format = VEHICLE_FORMAT_NDJSON;
+  else if (allowMsgPack && name == "msgpack")
+    format = VEHICLE_FORMAT_MSGPACK;
+  else
+    return false;
+  return true;
+}
+
+// ============================================================================
+// IMPORT
+// ============================================================================
+
+bool VehicleImporter::begin(AsyncWebServerRequest *request, VehicleFormat format, StorageService &storage)
+{
+  if (_request != NULL)
+    return false;
+
+  _request = request;
+  _storage = &storage;
+  _format = format;
+  _lineLength = 0;
+  _lineTooLong = false;
+  _batchCount = 0;
+  _job.reset(new Job());
+  _job->storage = &storage;
+
+  // A client that gives up mid-upload frees the importer; batches already
+  // accepted still commit
+  request->onDisconnect([this, request]()
+                        {
+    if (owns(request))
+      release(); });
+  return true;
+}
+
+void VehicleImporter::feed(const uint8_t *data, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    char c = data[i];
+    if (c == '\n')
+    {
+      takeLine();
+    }
+    else if (_lineLength < sizeof(_line) - 1)
+    {
+      _line[_lineLength++] = c;
+    }
+    else
+    {
+      _lineTooLong = true;
+    }
+  }
+
+  // Room may have opened up since the last chunk
+  drain(_job);
+}
+
+void VehicleImporter::finish(AsyncWebServerRequest *request)
+{
+  // Last line without a trailing newline
+  if (_lineLength > 0 || _lineTooLong)
+    takeLine();
+
+  // Submitted even when empty: the storage task runs operations in order, so
+  // once this one is done every earlier batch has committed too
+  _job->request = request->pause();
+  submitBatch(true);
+  drain(_job);
+
+  // Parsing is done; the next import can start while this one commits
+  release();
+}
+
+void VehicleImporter::takeLine()
+{
+  bool tooLong = _lineTooLong;
+  if (_lineLength > 0 && _line[_lineLength - 1] == '\r')
+    _lineLength--;
+  _line[_lineLength] = '\0';
+  _lineLength = 0;
+  _lineTooLong = false;
+
+  Job &job = *_job;
+  job.lines++;
+  if (_line[0] == '\0' && !tooLong)
+    return;
+
+  // Header row
+  if (_format == VEHICLE_FORMAT_CSV && job.lines == 1 && strncmp(_line, "rfid,", 5) == 0)
+    return;
+
+  VehicleRecord &record = _batch[_batchCount];
+  if (tooLong || !parseLine(record))
+  {
+    if (job.invalid++ == 0)
+      job.firstInvalidLine = job.lines;
+    return;
+  }
+
+  if (++_batchCount == VEHICLE_IMPORT_BATCH)
+    submitBatch(false);
+}
+
+// Adds the parsed rows to the pending list. The last batch is always taken,
+// so the answer waits for every earlier one; any other batch is dropped and
+// counted as failed once VEHICLE_IMPORT_PENDING are already waiting.
+bool VehicleImporter::submitBatch(bool last)
+{
+  Job &job = *_job;
+  ImportLock lock(job.mutex);
+
+  size_t count = _batchCount;
+  _batchCount = 0;
+  if (job.overflowed || (!last && job.pending.size() >= VEHICLE_IMPORT_PENDING))
+  {
+    job.overflowed = true;
+    job.failed += count;
+    count = 0;
+    if (!last)
+      return false;
+  }
+
+  Job::Batch batch;
+  batch.records.assign(_batch, _batch + count);
+  batch.last = last;
+  job.pending.push_back(batch);
+  if (last)
+    job.finished = true;
+  return true;
+}
+
+// Moves pending batches onto the storage queue, oldest first, while it has
+// room. Runs on async_tcp as the body arrives and on the storage task as
+// batches commit; neither waits.
+void VehicleImporter::drain(const std::shared_ptr<Job> &job)
+{
+  bool stranded = false;
+  {
+    ImportLock lock(job->mutex);
+    while (!job->pending.empty())
+    {
+      const Job::Batch &batch = job->pending.front();
+      size_t count = batch.records.size();
+      bool last = batch.last;
+      bool queued = job->storage->importVehicles(batch.records.data(), count, [job, count, last](const StorageResult &result)
+                                                 { committed(job, result, count, last); },
+                                                 0);
+      if (!queued)
+        break;
+      job->pending.pop_front();
+      job->queued++;
+    }
+
+    // Nothing of this import is left on the queue to drain the rest when it
+    // commits, and no more body is coming to try again
+    if (!job->pending.empty() && job->queued == 0 && job->finished)
+    {
+      for (size_t i = 0; i < job->pending.size(); i++)
+        job->failed += job->pending[i].records.size();
+      job->pending.clear();
+      job->overflowed = true;
+      stranded = true;
+    }
+  }
+
+  if (stranded)
+    answer(job);
+}
+
+void VehicleImporter::committed(const std::shared_ptr<Job> &job, const StorageResult &result, size_t count, bool last)
+{
+  {
+    ImportLock lock(job->mutex);
+    job->queued--;
+    job->stored += result.count;
+    job->failed += count - result.count;
+  }
+
+  if (last)
+    answer(job);
+  else
+    drain(job);
+}
+
+void VehicleImporter::answer(const std::shared_ptr<Job> &job)
+{
+  StaticJsonDocument<192> summary;
+  bool overflowed;
+  {
+    ImportLock lock(job->mutex);
+    overflowed = job->overflowed;
+    summary["ok"] = job->invalid == 0 && job->failed == 0;
+    summary["lines"] = job->lines;
+    summary["imported"] = job->stored;
+    summary["invalid"] = job->invalid;
+    summary["firstInvalidLine"] = job->firstInvalidLine;
+    summary["failed"] = job->failed;
+  }
+
+  if (overflowed)
+    Serial.println("⚠ Import outran storage; imported " + String(summary["imported"].as<uint32_t>()) +
+                   ", dropped " + String(summary["failed"].as<uint32_t>()));
+  else
+    Serial.println("✓ Imported " + String(summary["imported"].as<uint32_t>()) + " vehicles (" +
+                   String(summary["invalid"].as<uint32_t>()) + " invalid, " + String(summary["failed"].as<uint32_t>()) + " failed)");
+
+  auto request = job->request.lock();
+  if (!request)
+    return;
+
+  // 503 asks the client to send again later. Rows are saved by tag, so the
+  // whole file can be resent; the summary says how many made it this time.
+  String output;
+  serializeJson(summary, output);
+  request->send(overflowed ? 503 : 200, "application/json", output);
+}
+
+bool VehicleImporter::parseLine(VehicleRecord &record)
+{
+  return _format == VEHICLE_FORMAT_CSV ? parseCsvLine(record) : parseJsonLine(record);
+}
+
+// Columns in schema order; quoted fields may hold commas and quotes
+bool VehicleImporter::parseCsvLine(VehicleRecord &record)
+{
+  record = VehicleRecord();
+  return recordFromLine(_line, ',', true, record) == NULL;
+}
+
+bool VehicleImporter::parseJsonLine(VehicleRecord &record)
+{
+  StaticJsonDocument<VEHICLE_IMPORT_LINE_MAX + 256> doc;
+  if (deserializeJson(doc, _line))
+    return false;
+
+  return readVehicleRow(doc.as<JsonObjectConst>(), record) == NULL;
+}
+
+void VehicleImporter::release()
+{
+  // Whatever is still pending keeps draining as earlier batches commit
+  if (_job)
+  {
+    {
+      ImportLock lock(_job->mutex);
+      _job->finished = true;
+    }
+    drain(_job);
+  }
+
+  _request = NULL;
+  _job.reset();
+  _batchCount = 0;
+}
+
+// ============================================================================
+// EXPORT
+// ============================================================================
+
+namespace
+{
+// One line of output at a time into whatever chunk size the server asks for
+class VehicleExportStream
+{
+public:
+  VehicleExportStream(VehicleFormat format, StorageService &storage) : _format(format), _storage(storage) {}
+
+  size_t fill(uint8_t *buffer, size_t maxLen)
+  {
+    size_t written = 0;
+    while (written < maxLen)
+    {
+      if (_pendingSent == _pendingLength)
+      {
+        JsonRowStatus status = refill();
+        if (status == JSON_ROW_BUSY && written == 0)
+          return JSON_STREAM_BUSY;
+        if (status != JSON_ROW_READY)
+          break;
+      }
+
+      size_t chunk = _pendingLength - _pendingSent;
+      if (chunk > maxLen - written)
+        chunk = maxLen - written;
+      memcpy(buffer + written, _pending + _pendingSent, chunk);
+      _pendingSent += chunk;
+      written += chunk;
+    }
+    return written;
+  }
+
+private:
+  // Busy leaves the cursor alone, so the same record is tried on the next poll
+  JsonRowStatus refill()
+  {
+    _pendingLength = 0;
+    _pendingSent = 0;
+
+    if (!_started)
+    {
+      _started = true;
+      if (_format == VEHICLE_FORMAT_CSV)
+      {
+        _pendingLength = strlen(CSV_HEADER);
+        memcpy(_pending, CSV_HEADER, _pendingLength);
+        return JSON_ROW_READY;
+      }
+    }
+
+    VehicleRecord record;
+    StorageRead read = _storage.nextVehicle(_cursor, record);
+    if (read != STORAGE_READ_OK)
+      return read == STORAGE_READ_BUSY ? JSON_ROW_BUSY : JSON_ROW_END;
+
+    if (_format == VEHICLE_FORMAT_MSGPACK)
+    {
+      StaticJsonDocument<VEHICLE_IMPORT_LINE_MAX> row;
+      fillVehicleRow(row.to<JsonObject>(), record);
+      JsonObjectConst fields = row.as<JsonObjectConst>();
+
+      BufferPrint out((uint8_t *)_pending, sizeof(_pending));
+      MsgPackWriter writer(out);
+      if (_rows++ == 0)
+      {
+        _shape = rowShape(fields);
+        writer.columns(fields);
+      }
+      writer.row(fields, _shape);
+      _pendingLength = out.length();
+      return JSON_ROW_READY;
+    }
+
+    if (_format == VEHICLE_FORMAT_CSV)
+    {
+      _pendingLength = recordToLine(record, ',', true, _pending, sizeof(_pending) - 1);
+    }
+    else
+    {
+      StaticJsonDocument<VEHICLE_IMPORT_LINE_MAX> row;
+      fillVehicleRow(row.to<JsonObject>(), record);
+      _pendingLength = serializeJson(row, _pending, sizeof(_pending) - 1);
+    }
+    _pending[_pendingLength++] = '\n';
+    return JSON_ROW_READY;
+  }
+
+  VehicleFormat _format;
+  StorageService &_storage;
+  uint16_t _cursor = 0;
+  bool _started = false;
+  uint32_t _rows = 0;
+  uint32_t _shape = 0;
+
+  // Lines are kept short enough to import again (see the static_assert)
+  char _pending[VEHICLE_IMPORT_LINE_MAX];
+  size_t _pendingLength = 0;
+  size_t _pendingSent = 0;
+};
+} // namespace
+
+AsyncWebServerResponse *beginVehicleExport(AsyncWebServerRequest *request, VehicleFormat format, StorageService &storage)
+{
+  std::shared_ptr<VehicleExportStream> stream(new VehicleExportStream(format, storage));
+  const char *contentType = "text/csv";
+  const char *disposition = "attachment; filename=\"vehicles.csv\"";
+  if (format == VEHICLE_FORMAT_NDJSON)
+  {
+    contentType = "application/x-ndjson";
+    disposition = "attachment; filename=\"vehicles.ndjson\"";
+  }
+  else if (format == VEHICLE_FORMAT_MSGPACK)
+  {
+    contentType = wireContentType(WIRE_FORMAT_MSGPACK);
+    disposition = "attachment; filename=\"vehicles.msgpack\"";
+  }
+
+  AsyncWebServerResponse *response = request->beginChunkedResponse(contentType, [stream](uint8_t *buffer, size_t maxLen, size_t index)
+                                                                   { return wireFillResult(stream->fill(buffer, maxLen)); });
+  response->addHeader("Content-Disposition", disposition);
+  return response;
+}
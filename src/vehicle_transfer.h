@@ -0,0 +1,102 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <memory>
+
+#include "storage_service.h"
+
+// ============================================================================
+// VEHICLE IMPORT / EXPORT
+// ============================================================================
+//
+// Bulk provisioning in two line-based formats:
+//
+//   csv     header row, then rfid,plateNo,type,owner,role,year,section,course
+//           (fields containing commas or quotes are double-quoted; a quoted
+//           field cannot span lines)
+//   ndjson  one /vehicle/list row object per line
+//
+// Export can also send the rows as a MessagePack sequence (see
+// wire_format.h); that is a format for clients, not for import.
+//
+// The importer parses the request body as it arrives, one line at a time,
+// so the upload can be any size. Parsed vehicles are handed to the storage
+// task in batches of VEHICLE_IMPORT_BATCH that each commit once. The body
+// arrives on the async_tcp task, so nothing here waits for the storage
+// queue: a batch it has no room for is kept, up to VEHICLE_IMPORT_PENDING of
+// them, and submitted as earlier ones commit. A sender that gets further
+// ahead than that has the rest of its rows dropped and is answered 503.
+//
+// One import runs at a time; a second one is answered 409 until the first
+// finishes or its client disconnects.
+
+const size_t VEHICLE_IMPORT_BATCH = 16;
+const size_t VEHICLE_IMPORT_LINE_MAX = 512;
+const size_t VEHICLE_IMPORT_PENDING = 4;
+
+enum VehicleFormat
+{
+  VEHICLE_FORMAT_CSV,
+  VEHICLE_FORMAT_NDJSON,
+  VEHICLE_FORMAT_MSGPACK
+};
+
+// A vehicle as a /vehicle/list row, and back. readVehicleRow() returns NULL
+// or what is wrong with the row.
+void fillVehicleRow(JsonObject obj, const VehicleRecord &record);
+const char *readVehicleRow(JsonObjectConst obj, VehicleRecord &record);
+
+// Reads ?format=csv|ndjson, defaulting from the Content-Type. With
+// allowMsgPack, ?format=msgpack and the wire format negotiation are honoured
+// too. Returns false for an unknown format.
+bool parseVehicleFormat(AsyncWebServerRequest *request, VehicleFormat &format, bool allowMsgPack = false);
+
+class VehicleImporter
+{
+public:
+  // Claims the importer for request. Returns false if another import is
+  // running.
+  bool begin(AsyncWebServerRequest *request, VehicleFormat format, StorageService &storage);
+  bool owns(AsyncWebServerRequest *request) const { return _request != NULL && _request == request; }
+  bool busy() const { return _request != NULL; }
+
+  // Body chunks, in order
+  void feed(const uint8_t *data, size_t len);
+
+  // Call from the request handler once the body is complete: submits the
+  // last batch and answers with a JSON summary after it has committed.
+  void finish(AsyncWebServerRequest *request);
+
+private:
+  struct Job;
+
+  void takeLine();
+  bool parseLine(VehicleRecord &record);
+  bool parseCsvLine(VehicleRecord &record);
+  bool parseJsonLine(VehicleRecord &record);
+  bool submitBatch(bool last);
+  void release();
+
+  static void drain(const std::shared_ptr<Job> &job);
+  static void committed(const std::shared_ptr<Job> &job, const StorageResult &result, size_t count, bool last);
+  static void answer(const std::shared_ptr<Job> &job);
+
+  AsyncWebServerRequest *_request = NULL;
+  StorageService *_storage = NULL;
+  VehicleFormat _format = VEHICLE_FORMAT_CSV;
+
+  char _line[VEHICLE_IMPORT_LINE_MAX];
+  size_t _lineLength = 0;
+  bool _lineTooLong = false;
+
+  VehicleRecord _batch[VEHICLE_IMPORT_BATCH];
+  size_t _batchCount = 0;
+
+  // Shared with the storage callbacks, which may outlive the request
+  std::shared_ptr<Job> _job;
+};
+
+// Chunked response streaming every registered vehicle in format
+AsyncWebServerResponse *beginVehicleExport(AsyncWebServerRequest *request, VehicleFormat format, StorageService &storage);
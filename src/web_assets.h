@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Arduino.h>
+
+// ============================================================================
+// EMBEDDED WEB ASSETS
+// ============================================================================
+//
+// Route table for the dashboard files compiled into the firmware. The table
+// and the gzipped file bodies it points at are generated into web_assets.cpp
+// by tools/build_assets.py on every build; being const, both stay in flash.
+
+struct WebAsset
+{
+  const char *url;
+  const char *contentType;
+  const char *etag;        // quoted, ready for the ETag header
+  const uint8_t *body;     // gzip
+  size_t length;
+  bool immutable;          // URL carries a content hash
+};
+
+extern const WebAsset WEB_ASSETS[];
+extern const size_t WEB_ASSET_COUNT;
@@ -0,0 +1,1018 @@
+#include <ArduinoJson.h>
+#include <memory>
+#include <vector>
+
+#include "alloc_audit.h"
+#include "gate.h"
+#include "json_stream.h"
+#include "tag_id.h"
+#include "wire_format.h"
+#include "wire_response.h"
+
+namespace
+{
+// Pass log paging
+const uint32_t PASS_PAGE_MAX = 500;
+const uint32_t SYNC_PASS_LIMIT = 100;
+
+// /bench/wire reads the streams in chunks of this size, like the server
+const size_t WIRE_BENCH_CHUNK = 1024;
+
+// Single vehicle JSON; bulk uploads go through /vehicle/import
+const size_t VEHICLE_SAVE_BODY_MAX = 1024;
+static_assert(recordMaxJsonLength<VehicleRecord>() + 2 <= VEHICLE_SAVE_BODY_MAX,
+              "VEHICLE_SAVE_BODY_MAX cannot hold the longest compact vehicle body");
+
+// fillPassRow() and fingerprintRows() at their longest, braces included
+static_assert(recordMaxJsonLength<PassEntry>() +
+                      jsonMemberMaxLength("plateNo", jsonTextMaxLength(sizeof(TagInfo::plateNo) - 1)) +
+                      jsonMemberMaxLength("owner", jsonTextMaxLength(sizeof(TagInfo::owner) - 1)) +
+                      jsonMemberMaxLength("registered", 5) + 2 <=
+                  JSON_STREAM_TEXT_SIZE,
+              "JSON_STREAM_TEXT_SIZE cannot hold the longest pass row");
+static_assert(jsonMemberMaxLength("id", 10) + recordMaxJsonLength<FingerprintMeta>() + 2 <= JSON_STREAM_TEXT_SIZE,
+              "JSON_STREAM_TEXT_SIZE cannot hold the longest fingerprint row");
+} // namespace
+
+JsonRowSource fingerprintRows(const FingerprintSet &enrolled);
+JsonRowSource vehicleRows();
+JsonRowSource passRows(uint32_t firstSeq, uint32_t lastSeq);
+void fillPassRow(JsonObject obj, const PassEntry &entry);
+bool notModified(AsyncWebServerRequest *request, const String &etag);
+void sendSync(AsyncWebServerRequest *request);
+void sendWireBenchmark(AsyncWebServerRequest *request);
+
+// ============================================================================
+// WEB SERVER ROUTES
+// ============================================================================
+
+void setupServerRoutes()
+{
+
+  // Web UI, compiled into the firmware by tools/build_assets.py
+  server.addHandler(&assets);
+
+  // Get list of enrolled fingerprints
+  server.on("/fp/list", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    // Occupancy comes from the RAM index, so this never waits on the sensor
+    AsyncWebServerResponse *response = beginJsonArrayResponse(request, fingerprintRows(fingerprint.enrolledTemplates()));
+    response->addHeader("X-Fingerprint-Max-Id", String(fingerprint.maxId()));
+    request->send(response); });
+
+  // Start fingerprint enrollment
+  server.on("/fp/enroll", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    if (!request->hasParam("id")) {
+      request->send(400, "text/plain", "Missing 'id' parameter");
+      return;
+    }
+
+    int id = request->getParam("id")->value().toInt();
+    
+    if (id < 1 || id > fingerprint.maxId()) {
+      request->send(400, "text/plain", "ID must be between 1 and " + String(fingerprint.maxId()));
+      return;
+    }
+
+    if (fingerprint.enrolling()) {
+      request->send(409, "text/plain", "Enrollment already in progress");
+      return;
+    }
+
+    if (!fingerprint.startEnrollment(id)) {
+      request->send(503, "text/plain", "Fingerprint sensor busy, try again");
+      return;
+    }
+
+    request->send(200, "text/plain", "Enrollment started for ID " + String(id)); });
+
+  // Save fingerprint metadata
+  server.on("/fp/save", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+            {
+      
+      StaticJsonDocument<512> doc;
+      DeserializationError error = deserializeJson(doc, data);
+      
+      if (error) {
+        request->send(400, "text/plain", "Invalid JSON");
+        return;
+      }
+
+      int id = doc["id"];
+
+      if (id < 1 || id > fingerprint.maxId()) {
+        request->send(400, "text/plain", "ID must be between 1 and " + String(fingerprint.maxId()));
+        return;
+      }
+
+      FingerprintMeta meta;
+      if (recordFromJson(doc.as<JsonObjectConst>(), meta) != NULL) {
+        request->send(400, "text/plain", "Field too long");
+        return;
+      }
+
+      // Save to Preferences via the storage task
+      AsyncWebServerRequestPtr pending = request->pause();
+      bool queued = storage.saveFingerprintMeta(id, meta, [pending, id, meta](const StorageResult &result) {
+        if (result.ok) {
+          Serial.println("✓ Metadata saved:");
+          Serial.println("  ID: " + String(id));
+          Serial.print("  Owner: ");
+          Serial.println(meta.owner);
+          Serial.print("  Role: ");
+          Serial.println(meta.role);
+        } else {
+          Serial.println("✗ Failed to save metadata for ID " + String(id));
+        }
+
+        if (auto request = pending.lock()) {
+          if (result.ok) {
+            request->send(200, "application/json", "{\"success\":true}");
+          } else {
+            request->send(500, "text/plain", "Failed to save metadata");
+          }
+        }
+      });
+
+      if (!queued) {
+        request->send(503, "text/plain", "Storage busy, try again");
+      } });
+
+  // Delete fingerprint
+  server.on("/fp/delete", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    if (!request->hasParam("id")) {
+      request->send(400, "text/plain", "Missing 'id' parameter");
+      return;
+    }
+
+    int id = request->getParam("id")->value().toInt();
+
+    // Delete from sensor, then drop the metadata
+    AsyncWebServerRequestPtr pending = request->pause();
+    bool queued = fingerprint.deleteTemplate(id, [pending, id](const FingerprintResult &result) {
+      if (result.code != FINGERPRINT_OK) {
+        if (auto request = pending.lock()) {
+          request->send(500, "text/plain", "Failed to delete fingerprint");
+        }
+        return;
+      }
+
+      bool metaQueued = storage.removeFingerprintMeta(id, [pending, id](const StorageResult &result) {
+        Serial.println("✓ Fingerprint " + String(id) + " deleted");
+        if (auto request = pending.lock()) {
+          request->send(200, "text/plain", "Fingerprint deleted");
+        }
+      });
+
+      if (!metaQueued) {
+        if (auto request = pending.lock()) {
+          request->send(503, "text/plain", "Fingerprint deleted, metadata cleanup deferred: storage busy");
+        }
+      }
+    });
+
+    if (!queued) {
+      request->send(503, "text/plain", "Fingerprint sensor busy, try again");
+    } });
+
+  // Delete ALL fingerprints
+  server.on("/fp/deleteall", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+  Serial.println("\n--- Deleting ALL fingerprints ---");
+
+  AsyncWebServerRequestPtr pending = request->pause();
+  bool queued = fingerprint.deleteAllTemplates([pending](const FingerprintResult &result) {
+    int deletedCount = result.deleted;
+    int failedCount = result.failed;
+
+    Serial.println("--- Delete All Complete ---");
+    Serial.println("  Deleted: " + String(deletedCount));
+    Serial.println("  Failed: " + String(failedCount));
+    Serial.println("---------------------------\n");
+
+    // Drop the metadata of every deleted template in one storage operation
+    bool metaQueued = storage.removeFingerprintMeta(result.ids, [pending, deletedCount, failedCount](const StorageResult &result) {
+      auto request = pending.lock();
+      if (!request) {
+        return;
+      }
+
+      if (failedCount == 0) {
+        request->send(200, "text/plain", "All fingerprints deleted (" + String(deletedCount) + " removed)");
+      } else {
+        request->send(500, "text/plain", "Partially completed. " + String(deletedCount) + " deleted, " + String(failedCount) + " failed");
+      }
+    });
+
+    if (!metaQueued) {
+      if (auto request = pending.lock()) {
+        request->send(503, "text/plain", "Fingerprints deleted, metadata cleanup deferred: storage busy");
+      }
+    }
+  });
+
+  if (!queued) {
+    request->send(503, "text/plain", "Fingerprint sensor busy, try again");
+  } });
+
+  // Get RFID vehicle log
+  server.on("/rfid/list", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    // The log only grows at the end and shrinks at the start, so its two
+    // ends identify its content
+    WireFormat format = negotiateWireFormat(request);
+    String etag = "\"p" + String(passLog.firstSeq()) + "-" + String(passLog.lastSeq()) + wireEtagSuffix(format) + "\"";
+    if (notModified(request, etag)) {
+      return;
+    }
+
+    // Optional filters: after=<seq>&limit=N pages by sequence number,
+    // from=<t>&to=<t> selects a timestamp range (inclusive). Timestamps are
+    // gate clock seconds: Unix time since a dashboard set the clock (see
+    // /clock), before that seconds of operation; they never decrease along
+    // the log. With no filter the whole retained log is streamed.
+    uint32_t firstSeq = passLog.firstSeq();
+    uint32_t lastSeq = passLog.lastSeq();
+
+    if (request->hasParam("from")) {
+      uint32_t from = strtoul(request->getParam("from")->value().c_str(), NULL, 10);
+      uint32_t seq = passLog.seekTimestamp(from);
+      if (seq > firstSeq) {
+        firstSeq = seq;
+      }
+    }
+    if (request->hasParam("to")) {
+      uint32_t to = strtoul(request->getParam("to")->value().c_str(), NULL, 10);
+      uint32_t seq = to < 0xFFFFFFFF ? passLog.seekTimestamp(to + 1) - 1 : lastSeq;
+      if (seq < lastSeq) {
+        lastSeq = seq;
+      }
+    }
+    if (request->hasParam("after")) {
+      uint32_t after = strtoul(request->getParam("after")->value().c_str(), NULL, 10);
+      if (after >= firstSeq) {
+        firstSeq = after + 1;
+      }
+    }
+    if (request->hasParam("limit")) {
+      uint32_t limit = strtoul(request->getParam("limit")->value().c_str(), NULL, 10);
+      if (limit < 1 || limit > PASS_PAGE_MAX) {
+        limit = PASS_PAGE_MAX;
+      }
+      if (firstSeq <= lastSeq && lastSeq - firstSeq >= limit) {
+        lastSeq = firstSeq + limit - 1;
+      }
+    }
+
+    // Clients page by passing X-Next-After back as after=
+    uint32_t nextAfter = firstSeq <= lastSeq ? lastSeq : firstSeq - 1;
+    AsyncWebServerResponse *response = beginJsonArrayResponse(request, passRows(firstSeq, lastSeq), format);
+    response->addHeader("X-Next-After", String(nextAfter));
+    response->addHeader("X-Last-Seq", String(passLog.lastSeq()));
+    response->addHeader("ETag", etag);
+    response->addHeader("Vary", "Accept");
+    request->send(response); });
+
+  // Get vehicle count
+  server.on("/rfid/count", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    String json = "{\"count\":" + String(vehicleCount) + "}";
+    request->send(200, "application/json", json); });
+
+  // Save vehicle data
+  server.on("/vehicle/save", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+            {
+    if (total > VEHICLE_SAVE_BODY_MAX) {
+      if (index == 0) {
+        request->send(413, "text/plain", "Body too large");
+      }
+      return;
+    }
+
+    // The body may arrive in several chunks; collect it in the request's
+    // scratch buffer, which the server frees with the request
+    if (len < total) {
+      if (index == 0) {
+        request->_tempObject = malloc(total);
+      }
+      if (request->_tempObject == NULL) {
+        if (index == 0) {
+          request->send(500, "text/plain", "Out of memory");
+        }
+        return;
+      }
+      memcpy((uint8_t *)request->_tempObject + index, data, len);
+      if (index + len < total) {
+        return;
+      }
+      data = (uint8_t *)request->_tempObject;
+    }
+
+    StaticJsonDocument<512> doc;
+    DeserializationError error = deserializeJson(doc, data, total);
+    
+    if (error) {
+      Serial.println("JSON deserialization error!");
+      request->send(400, "text/plain", "Invalid JSON");
+      return;
+    }
+
+    VehicleRecord record;
+    const char *invalid = readVehicleRow(doc.as<JsonObjectConst>(), record);
+    if (invalid != NULL) {
+      request->send(400, "text/plain", invalid);
+      return;
+    }
+
+    char tagHex[TAG_HEX_LENGTH + 1];
+    formatTagHex(record.tag, tagHex);
+
+    Serial.println("\n--- Saving Vehicle ---");
+    Serial.println("RFID: " + String(tagHex));
+    Serial.println("Plate: " + String(record.plateNo));
+    Serial.println("Owner: " + String(record.owner));
+
+    uint32_t tag = record.tag;
+    AsyncWebServerRequestPtr pending = request->pause();
+    bool queued = storage.saveVehicle(record, [pending, tag](const StorageResult &result) {
+      char tagHex[TAG_HEX_LENGTH + 1];
+      formatTagHex(tag, tagHex);
+
+      auto request = pending.lock();
+      if (!result.ok) {
+        Serial.println("✗ Failed to save vehicle data");
+        if (request) {
+          request->send(500, "text/plain", "Failed to save vehicle data");
+        }
+        return;
+      }
+
+      Serial.println(result.created ? "✓ Vehicle registered: " + String(tagHex)
+                                    : "✓ Vehicle updated: " + String(tagHex));
+      if (!request) {
+        return;
+      }
+
+      // Return success response
+      StaticJsonDocument<200> response;
+      response["success"] = true;
+      response["rfid"] = tagHex;
+      response["message"] = "Vehicle saved successfully";
+
+      String output;
+      serializeJson(response, output);
+      request->send(200, "application/json", output);
+    });
+
+    if (!queued) {
+      request->send(503, "text/plain", "Storage busy, try again");
+    } else {
+      vehicleListCache.invalidate();
+    } });
+
+  // Get all vehicles
+  server.on("/vehicle/list", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+  // Rows changed while this streams carry newer generations, so a client
+  // that syncs from X-Vehicles-Gen afterwards catches up
+  uint32_t generation = storage.vehiclesGeneration();
+  WireFormat format = negotiateWireFormat(request);
+  String etag = "\"v" + String(generation) + wireEtagSuffix(format) + "\"";
+  if (notModified(request, etag)) {
+    return;
+  }
+
+  // Served from RAM while the generation is unchanged
+  AsyncWebServerResponse *response = vehicleListCache.respond(request, generation, format, vehicleRows(), []()
+                                                              { return storage.vehiclesGeneration(); });
+  response->addHeader("X-Vehicles-Gen", String(generation));
+  response->addHeader("ETag", etag);
+  response->addHeader("Vary", "Accept");
+  request->send(response); });
+
+  // Changes since a vehicles generation and/or pass sequence number
+  server.on("/sync", HTTP_GET, [](AsyncWebServerRequest *request)
+            { sendSync(request); });
+
+  // JSON against MessagePack on the current data
+  server.on("/bench/wire", HTTP_GET, [](AsyncWebServerRequest *request)
+            { sendWireBenchmark(request); });
+
+  // Delete vehicle
+  server.on("/vehicle/delete", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+  if (!request->hasParam("rfid")) {
+    request->send(400, "text/plain", "Missing 'rfid' parameter");
+    return;
+  }
+
+  String rfid = request->getParam("rfid")->value();
+  uint32_t tag;
+  if (!parseTagHex(rfid.c_str(), tag)) {
+    request->send(400, "text/plain", "RFID must be 8 hex characters");
+    return;
+  }
+
+  AsyncWebServerRequestPtr pending = request->pause();
+  bool queued = storage.removeVehicle(tag, [pending, rfid](const StorageResult &result) {
+    if (result.ok) {
+      Serial.println("✓ Vehicle " + rfid + " deleted");
+    }
+
+    if (auto request = pending.lock()) {
+      if (result.ok) {
+        request->send(200, "text/plain", "Vehicle deleted");
+      } else {
+        request->send(404, "text/plain", "Vehicle not found");
+      }
+    }
+  });
+
+  if (!queued) {
+    request->send(503, "text/plain", "Storage busy, try again");
+  } else {
+    vehicleListCache.invalidate();
+  } });
+
+  // Bulk upload as CSV or NDJSON, parsed as the body streams in
+  server.on("/vehicle/import", HTTP_POST, [](AsyncWebServerRequest *request)
+            {
+    VehicleFormat format;
+    if (!parseVehicleFormat(request, format)) {
+      request->send(400, "text/plain", "Format must be csv or ndjson");
+      return;
+    }
+
+    // An empty body never reached the body handler
+    if (!vehicleImporter.owns(request) && !vehicleImporter.begin(request, format, storage)) {
+      request->send(409, "text/plain", "Another import is running");
+      return;
+    }
+
+    vehicleListCache.invalidate();
+    vehicleImporter.finish(request); }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+            {
+    VehicleFormat format;
+    if (index == 0 && parseVehicleFormat(request, format)) {
+      vehicleImporter.begin(request, format, storage);
+    }
+
+    if (vehicleImporter.owns(request)) {
+      vehicleImporter.feed(data, len);
+    } });
+
+  // Every vehicle in the import format
+  server.on("/vehicle/export", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    VehicleFormat format;
+    if (!parseVehicleFormat(request, format, true)) {
+      request->send(400, "text/plain", "Format must be csv, ndjson or msgpack");
+      return;
+    }
+
+    request->send(beginVehicleExport(request, format, storage)); });
+
+  // Delete all vehicles
+  server.on("/vehicle/deleteall", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+  Serial.println("\n--- Deleting ALL vehicles ---");
+  
+  AsyncWebServerRequestPtr pending = request->pause();
+  bool queued = storage.clearVehicles([pending](const StorageResult &result) {
+    Serial.println("✓ Deleted " + String(result.count) + " vehicles");
+    if (auto request = pending.lock()) {
+      request->send(200, "text/plain", "All vehicles deleted (" + String(result.count) + " removed)");
+    }
+  });
+
+  if (!queued) {
+    request->send(503, "text/plain", "Storage busy, try again");
+  } else {
+    vehicleListCache.invalidate();
+  } });
+
+  // The gate clock that timestamps passes. ?set=<Unix seconds> moves it
+  // forward to the caller's time; every dashboard sends its own on load. A
+  // time the gate refuses (see setGateClock()) is answered 409 with the
+  // gate's own. ?set=<Unix seconds>&correct=1 sets it either way, to undo a
+  // bad set.
+  server.on("/clock", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    bool accepted = true;
+    if (request->hasParam("set")) {
+      uint32_t unixTime = strtoul(request->getParam("set")->value().c_str(), NULL, 10);
+      bool correct = request->hasParam("correct") && request->getParam("correct")->value() == "1";
+      accepted = correct ? correctGateClock(unixTime) : setGateClock(unixTime);
+    }
+    String json = "{\"now\":" + String(gateTime()) + ",\"synced\":" + String(gateClockSynced() ? "true" : "false") + "}";
+    request->send(accepted ? 200 : 409, "application/json", json); });
+
+  // Runtime counters
+  server.on("/stats", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    StaticJsonDocument<2048> doc;
+
+    doc["uptime"] = millis();
+    doc["freeHeap"] = ESP.getFreeHeap();
+    doc["minFreeHeap"] = ESP.getMinFreeHeap();
+    doc["vehicles"] = registry.count();
+    doc["passes"] = passLog.count();
+    doc["lastPassSeq"] = passLog.lastSeq();
+
+    JsonObject table = doc.createNestedObject("tagTable");
+    table["entries"] = tagTable.count();
+    table["capacity"] = tagTable.capacity();
+    table["bytes"] = tagTable.memoryUsage();
+    table["lookups"] = tagLookups;
+    table["avgLookupCycles"] = tagLookups > 0 ? tagLookupCycles / tagLookups : 0;
+    table["maxLookupCycles"] = tagLookupMaxCycles;
+
+    RfidReaderStats reader = rfidReader.stats();
+    JsonObject rfid = doc.createNestedObject("rfid");
+    rfid["frames"] = reader.frames;
+    rfid["invalidFrames"] = reader.invalidFrames;
+    rfid["detections"] = reader.detections;
+    rfid["ringDrops"] = reader.ringDrops;
+    rfid["uartOverflows"] = reader.uartOverflows;
+    rfid["passes"] = vehicleCount;
+    rfid["allocAudit"] = allocAuditEnabled();
+    if (allocAuditEnabled()) {
+      rfid["frameAllocs"] = reader.frameAllocs;
+    }
+
+    PassWriterStats writer = passWriter.stats();
+    JsonObject queue = doc.createNestedObject("passQueue");
+    queue["depth"] = writer.queueDepth;
+    queue["highWater"] = writer.queueHighWater;
+    queue["queued"] = writer.queued;
+    queue["dropped"] = writer.dropped;
+    queue["flushed"] = writer.flushed;
+    queue["flushes"] = writer.flushes;
+    queue["failedFlushes"] = writer.failedFlushes;
+    queue["lastFlushMicros"] = writer.lastFlushMicros;
+    queue["avgFlushMicros"] = writer.avgFlushMicros;
+    queue["maxFlushMicros"] = writer.maxFlushMicros;
+
+    StorageStats store = storage.stats();
+    JsonObject storageStats = doc.createNestedObject("storage");
+    storageStats["ops"] = store.ops;
+    storageStats["commits"] = store.commits;
+    storageStats["failedCommits"] = store.failedCommits;
+    storageStats["rejected"] = store.rejected;
+    storageStats["depth"] = store.queueDepth;
+    storageStats["highWater"] = store.queueHighWater;
+    storageStats["lastCommitMicros"] = store.lastCommitMicros;
+    storageStats["maxCommitMicros"] = store.maxCommitMicros;
+
+    ListCacheStats cache = vehicleListCache.stats();
+    JsonObject listCache = doc.createNestedObject("vehicleListCache");
+    listCache["hits"] = cache.hits;
+    listCache["misses"] = cache.misses;
+    listCache["builds"] = cache.builds;
+    listCache["oversize"] = cache.oversize;
+    listCache["bytes"] = cache.bytes;
+    listCache["maxBytes"] = VEHICLE_LIST_CACHE_BYTES;
+
+    EventRingStats ring = eventRing.stats();
+    JsonObject sse = doc.createNestedObject("sse");
+    sse["clients"] = events.count();
+    sse["lastId"] = ring.lastId;
+    sse["sent"] = ring.sent;
+    sse["replayed"] = ring.replayed;
+    sse["resyncs"] = ring.resyncs;
+
+    PassChannelStats channel = passChannel.stats();
+    JsonObject ws = doc.createNestedObject("ws");
+    ws["clients"] = channel.clients;
+    ws["published"] = channel.published;
+    ws["sent"] = channel.sent;
+    ws["dropped"] = channel.dropped;
+    ws["rejectedClients"] = channel.rejectedClients;
+
+    String output;
+    serializeJson(doc, output);
+    request->send(200, "application/json", output); });
+
+  // Start RFID scan
+  server.on("/rfid/startscan", HTTP_GET, [](AsyncWebServerRequest *request)
+            {
+    eventRing.send("Waiting for RFID tag...", "rfid_status");
+    request->send(200, "text/plain", "RFID scan started"); });
+
+  // 404 handler
+  server.onNotFound([](AsyncWebServerRequest *request)
+                    { request->send(404, "text/plain", "Not Found"); });
+}
+
+// ============================================================================
+// VEHICLE FUNCTIONS
+// ============================================================================
+
+// Rows for /vehicle/list, read through the storage lock one at a time. A
+// commit in progress leaves the cursor where it is for the next poll.
+JsonRowSource vehicleRows()
+{
+  uint16_t cursor = 0;
+  return [cursor](JsonObject obj) mutable
+  {
+    VehicleRecord record;
+    StorageRead read = storage.nextVehicle(cursor, record);
+    if (read != STORAGE_READ_OK)
+      return read == STORAGE_READ_BUSY ? JSON_ROW_BUSY : JSON_ROW_END;
+
+    fillVehicleRow(obj, record);
+    return JSON_ROW_READY;
+  };
+}
+
+// ============================================================================
+// FINGERPRINT FUNCTIONS
+// ============================================================================
+
+// Rows for /fp/list: the occupied sensor slots joined with their stored
+// metadata. Both are in RAM or NVS, so no sensor traffic is involved.
+JsonRowSource fingerprintRows(const FingerprintSet &enrolled)
+{
+  int id = 0;
+  return [enrolled, id](JsonObject obj) mutable
+  {
+    // id is the slot last sent, or the one still waiting on a busy read
+    int next = id + 1;
+    while (next <= fingerprint.maxId() && !enrolled.has(next))
+      next++;
+    if (next > fingerprint.maxId())
+      return JSON_ROW_END;
+
+    FingerprintMeta meta;
+    if (storage.fingerprintMeta(next, meta) == STORAGE_READ_BUSY)
+    {
+      id = next - 1;
+      return JSON_ROW_BUSY;
+    }
+    id = next;
+
+    obj["id"] = id;
+    recordToJson(obj, meta);
+    return JSON_ROW_READY;
+  };
+}
+
+// ============================================================================
+// PASS FUNCTIONS
+// ============================================================================
+
+// ===============================
+// PASS LIST ROWS
+// ===============================
+// Rows for /rfid/list between two sequence numbers, oldest first. Each row
+// is one direct read, so a page costs the same wherever it is in the log.
+JsonRowSource passRows(uint32_t firstSeq, uint32_t lastSeq)
+{
+  uint32_t cursor = firstSeq;
+  return [cursor, lastSeq](JsonObject obj) mutable
+  {
+    PassEntry entry;
+    if (cursor > lastSeq || !passLog.next(cursor, entry) || entry.seq > lastSeq)
+      return JSON_ROW_END;
+
+    fillPassRow(obj, entry);
+    return JSON_ROW_READY;
+  };
+}
+
+void fillPassRow(JsonObject obj, const PassEntry &entry)
+{
+  recordToJson(obj, entry);
+
+  // Add vehicle info if registered
+  TagInfo vehicle;
+
+  if (tagTable.lookup(entry.tag, vehicle))
+  {
+    obj["plateNo"] = vehicle.plateNo;
+    obj["owner"] = vehicle.owner;
+    obj["registered"] = true;
+  }
+  else
+  {
+    obj["plateNo"] = "Unregistered";
+    obj["owner"] = "Unknown";
+    obj["registered"] = false;
+  }
+}
+
+// ============================================================================
+// DELTA SYNC
+// ============================================================================
+
+// Answers 304 when the client already holds this version
+bool notModified(AsyncWebServerRequest *request, const String &etag)
+{
+  if (!request->hasHeader("If-None-Match") || request->getHeader("If-None-Match")->value() != etag)
+    return false;
+
+  AsyncWebServerResponse *response = request->beginResponse(304);
+  response->addHeader("ETag", etag);
+  request->send(response);
+  return true;
+}
+
+// What one /sync answer carries, gathered first so that both encodings
+// report the same rows
+struct SyncDelta
+{
+  bool vehicles = false;
+  uint32_t generation = 0;
+  bool vehiclesReset = false;
+  std::vector<VehicleRecord> changed;
+  std::vector<uint32_t> removed;
+
+  bool passes = false;
+  uint32_t lastSeq = 0;
+  bool passesReset = false;
+  bool more = false;
+  std::vector<PassEntry> items;
+};
+
+void writeSyncJson(Print &out, const SyncDelta &delta)
+{
+  StaticJsonDocument<JSON_STREAM_ROW_SIZE> row;
+  out.print("{");
+
+  if (delta.vehicles)
+  {
+    out.print("\"vehicles\":{\"gen\":");
+    out.print(delta.generation);
+    out.print(delta.vehiclesReset ? ",\"reset\":true" : ",\"reset\":false");
+
+    out.print(",\"changed\":[");
+    for (size_t i = 0; i < delta.changed.size(); i++)
+    {
+      row.clear();
+      fillVehicleRow(row.to<JsonObject>(), delta.changed[i]);
+      if (i > 0)
+        out.print(",");
+      serializeJson(row, out);
+    }
+
+    out.print("],\"removed\":[");
+    for (size_t i = 0; i < delta.removed.size(); i++)
+    {
+      char tagHex[TAG_HEX_LENGTH + 1];
+      formatTagHex(delta.removed[i], tagHex);
+      out.print(i > 0 ? ",\"" : "\"");
+      out.print(tagHex);
+      out.print("\"");
+    }
+    out.print("]}");
+  }
+
+  if (delta.passes)
+  {
+    if (delta.vehicles)
+      out.print(",");
+    out.print("\"passes\":{\"lastSeq\":");
+    out.print(delta.lastSeq);
+    out.print(delta.passesReset ? ",\"reset\":true" : ",\"reset\":false");
+    out.print(delta.more ? ",\"more\":true" : ",\"more\":false");
+
+    out.print(",\"items\":[");
+    for (size_t i = 0; i < delta.items.size(); i++)
+    {
+      row.clear();
+      fillPassRow(row.to<JsonObject>(), delta.items[i]);
+      if (i > 0)
+        out.print(",");
+      serializeJson(row, out);
+    }
+    out.print("]}");
+  }
+
+  out.print("}");
+}
+
+// "columns" from the first row, then name: one value array per row
+template <typename T>
+void writeSyncRows(MsgPackWriter &writer, const char *name, const std::vector<T> &rows,
+                   void (*fill)(JsonObject, const T &))
+{
+  StaticJsonDocument<JSON_STREAM_ROW_SIZE> row;
+  uint32_t shape = 0;
+
+  writer.string("columns");
+  if (rows.empty())
+  {
+    writer.array(0);
+  }
+  else
+  {
+    fill(row.to<JsonObject>(), rows[0]);
+    shape = rowShape(row.as<JsonObjectConst>());
+    writer.columns(row.as<JsonObjectConst>());
+  }
+
+  writer.string(name);
+  writer.array(rows.size());
+  for (size_t i = 0; i < rows.size(); i++)
+  {
+    row.clear();
+    fill(row.to<JsonObject>(), rows[i]);
+    writer.row(row.as<JsonObjectConst>(), shape);
+  }
+}
+
+void writeSyncMsgPack(Print &out, const SyncDelta &delta)
+{
+  MsgPackWriter writer(out);
+  writer.map((delta.vehicles ? 1 : 0) + (delta.passes ? 1 : 0));
+
+  if (delta.vehicles)
+  {
+    writer.string("vehicles");
+    writer.map(5);
+    writer.string("gen");
+    writer.integer(delta.generation);
+    writer.string("reset");
+    writer.boolean(delta.vehiclesReset);
+    writeSyncRows(writer, "changed", delta.changed, fillVehicleRow);
+
+    writer.string("removed");
+    writer.array(delta.removed.size());
+    for (size_t i = 0; i < delta.removed.size(); i++)
+    {
+      char tagHex[TAG_HEX_LENGTH + 1];
+      formatTagHex(delta.removed[i], tagHex);
+      writer.string(tagHex);
+    }
+  }
+
+  if (delta.passes)
+  {
+    writer.string("passes");
+    writer.map(5);
+    writer.string("lastSeq");
+    writer.integer(delta.lastSeq);
+    writer.string("reset");
+    writer.boolean(delta.passesReset);
+    writer.string("more");
+    writer.boolean(delta.more);
+    writeSyncRows(writer, "items", delta.items, fillPassRow);
+  }
+}
+
+// /sync?vehicles_gen=X&passes_seq=Y
+//
+// Returns only what changed since the given vehicles generation and pass
+// sequence number; either may be left out. "reset" tells the client its
+// position is too old, or not one this device has reached, and it must
+// reload the full list instead.
+void sendSync(AsyncWebServerRequest *request)
+{
+  SyncDelta delta;
+  delta.vehicles = request->hasParam("vehicles_gen");
+  delta.passes = request->hasParam("passes_seq");
+  uint32_t since = delta.vehicles ? strtoul(request->getParam("vehicles_gen")->value().c_str(), NULL, 10) : 0;
+  uint32_t afterSeq = delta.passes ? strtoul(request->getParam("passes_seq")->value().c_str(), NULL, 10) : 0;
+  WireFormat format = negotiateWireFormat(request);
+
+  uint32_t generation = storage.vehiclesGeneration();
+  uint32_t lastSeq = passLog.lastSeq();
+  if ((!delta.vehicles || since == generation) && (!delta.passes || afterSeq == lastSeq))
+  {
+    String etag = "\"v" + String(generation) + "-p" + String(lastSeq) + wireEtagSuffix(format) + "\"";
+    if (notModified(request, etag))
+      return;
+  }
+
+  if (delta.vehicles)
+  {
+    std::vector<VehicleChange> changes(STORAGE_CHANGE_LOG);
+    size_t count = 0;
+    delta.vehiclesReset = !storage.vehicleChangesSince(since, changes.data(), count);
+    delta.generation = !delta.vehiclesReset && count > 0 ? changes[count - 1].generation : generation;
+
+    // Only the last change to each tag counts. The log carries the records,
+    // so nothing here waits on a commit.
+    delta.changed.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+      bool superseded = false;
+      for (size_t j = i + 1; j < count && !superseded; j++)
+        superseded = changes[j].record.tag == changes[i].record.tag;
+      if (superseded)
+        continue;
+
+      if (changes[i].removed)
+        delta.removed.push_back(changes[i].record.tag);
+      else
+        delta.changed.push_back(changes[i].record);
+    }
+  }
+
+  if (delta.passes)
+  {
+    // Passes dropped by retention cannot be replayed. A position past the
+    // end comes from a log that has since been cleared or lost, and the
+    // client would otherwise skip every pass until the log caught up.
+    delta.passesReset = afterSeq + 1 < passLog.firstSeq() || afterSeq > lastSeq;
+    uint32_t firstSeq = delta.passesReset ? passLog.firstSeq() : afterSeq + 1;
+    uint32_t endSeq = lastSeq;
+    if (firstSeq <= endSeq && endSeq - firstSeq >= SYNC_PASS_LIMIT)
+      endSeq = firstSeq + SYNC_PASS_LIMIT - 1;
+    delta.lastSeq = firstSeq <= endSeq ? endSeq : lastSeq;
+    delta.more = endSeq < lastSeq;
+
+    PassEntry entry;
+    uint32_t cursor = firstSeq;
+    delta.items.reserve(firstSeq <= endSeq ? endSeq - firstSeq + 1 : 0);
+    while (cursor <= endSeq && passLog.next(cursor, entry) && entry.seq <= endSeq)
+      delta.items.push_back(entry);
+  }
+
+  AsyncResponseStream *response = request->beginResponseStream(wireContentType(format));
+  if (format == WIRE_FORMAT_MSGPACK)
+    writeSyncMsgPack(*response, delta);
+  else
+    writeSyncJson(*response, delta);
+  response->addHeader("Vary", "Accept");
+  request->send(response);
+}
+
+// Streams every row into a scratch buffer as a response would and returns
+// how long that took; bytes gets the body size. A commit in progress ends
+// the run early rather than holding the web server task.
+uint32_t timeWireStream(JsonRowSource rows, WireFormat format, uint32_t &bytes)
+{
+  std::unique_ptr<JsonArrayStream> stream(new JsonArrayStream(rows, format));
+  uint8_t chunk[WIRE_BENCH_CHUNK];
+  bytes = 0;
+
+  uint32_t start = micros();
+  size_t written;
+  while ((written = stream->fill(chunk, sizeof(chunk))) > 0 && written != JSON_STREAM_BUSY)
+    bytes += written;
+  return micros() - start;
+}
+
+// One list measured in both encodings. Reading the rows costs the same
+// either way, so it is timed on its own and taken out of the serialize time.
+void benchmarkWireRows(JsonObject out, std::function<JsonRowSource()> makeRows)
+{
+  StaticJsonDocument<JSON_STREAM_ROW_SIZE> row;
+  JsonRowSource rows = makeRows();
+  uint32_t count = 0;
+  uint32_t start = micros();
+  JsonRowStatus status;
+  while (true)
+  {
+    row.clear();
+    status = rows(row.to<JsonObject>());
+    if (status != JSON_ROW_READY)
+      break;
+    count++;
+  }
+  uint32_t readMicros = micros() - start;
+
+  out["rows"] = count;
+  out["readMicros"] = readMicros;
+  if (status == JSON_ROW_BUSY)
+    out["partial"] = true;
+
+  const WireFormat formats[] = {WIRE_FORMAT_JSON, WIRE_FORMAT_MSGPACK};
+  const char *names[] = {"json", "msgpack"};
+  for (size_t i = 0; i < 2; i++)
+  {
+    uint32_t bytes = 0;
+    uint32_t elapsed = timeWireStream(makeRows(), formats[i], bytes);
+
+    JsonObject result = out.createNestedObject(names[i]);
+    result["bytes"] = bytes;
+    result["serializeMicros"] = elapsed > readMicros ? elapsed - readMicros : 0;
+  }
+}
+
+// /bench/wire
+//
+// Serializes the vehicle list and the newest page of passes in JSON and in
+// MessagePack without sending them, and reports bytes and time for each.
+// Runs on the web server task, so other requests wait while it does.
+void sendWireBenchmark(AsyncWebServerRequest *request)
+{
+  StaticJsonDocument<512> doc;
+
+  benchmarkWireRows(doc.createNestedObject("vehicles"), []()
+                    { return vehicleRows(); });
+
+  uint32_t lastSeq = passLog.lastSeq();
+  uint32_t firstSeq = passLog.firstSeq();
+  if (lastSeq >= firstSeq && lastSeq - firstSeq >= PASS_PAGE_MAX)
+    firstSeq = lastSeq - PASS_PAGE_MAX + 1;
+  benchmarkWireRows(doc.createNestedObject("passes"), [firstSeq, lastSeq]()
+                    { return passRows(firstSeq, lastSeq); });
+
+  String output;
+  serializeJson(doc, output);
+  request->send(200, "application/json", output);
+}
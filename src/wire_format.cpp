@@ -0,0 +1,266 @@
+#include "wire_format.h"
+
+namespace
+{
+const char *MSGPACK_CONTENT_TYPE = "application/msgpack";
+
+// FNV-1a
+const uint32_t SHAPE_SEED = 2166136261u;
+const uint32_t SHAPE_PRIME = 16777619u;
+} // namespace
+
+const char *wireContentType(WireFormat format)
+{
+  return format == WIRE_FORMAT_MSGPACK ? MSGPACK_CONTENT_TYPE : "application/json";
+}
+
+const char *wireEtagSuffix(WireFormat format)
+{
+  return format == WIRE_FORMAT_MSGPACK ? "-m" : "";
+}
+
+uint32_t rowShape(JsonObjectConst row)
+{
+  uint32_t hash = SHAPE_SEED;
+  for (JsonPairConst field : row)
+  {
+    for (const char *c = field.key().c_str(); *c != '\0'; c++)
+      hash = (hash ^ (uint8_t)*c) * SHAPE_PRIME;
+    hash *= SHAPE_PRIME; // name separator
+  }
+  return hash;
+}
+
+// ============================================================================
+// MSGPACK WRITER
+// ============================================================================
+
+void MsgPackWriter::array(size_t count)
+{
+  header(0x90, 0xDC, count);
+}
+
+void MsgPackWriter::map(size_t count)
+{
+  header(0x80, 0xDE, count);
+}
+
+void MsgPackWriter::string(const char *value)
+{
+  size_t length = strlen(value);
+  if (length < 32)
+  {
+    _out.write((uint8_t)(0xA0 | length));
+  }
+  else if (length < 0x100)
+  {
+    _out.write((uint8_t)0xD9);
+    _out.write((uint8_t)length);
+  }
+  else
+  {
+    _out.write((uint8_t)0xDA);
+    big16(length);
+  }
+  _out.write((const uint8_t *)value, length);
+}
+
+void MsgPackWriter::integer(uint32_t value)
+{
+  if (value < 0x80)
+  {
+    _out.write((uint8_t)value);
+  }
+  else if (value < 0x100)
+  {
+    _out.write((uint8_t)0xCC);
+    _out.write((uint8_t)value);
+  }
+  else if (value < 0x10000)
+  {
+    _out.write((uint8_t)0xCD);
+    big16(value);
+  }
+  else
+  {
+    _out.write((uint8_t)0xCE);
+    big32(value);
+  }
+}
+
+void MsgPackWriter::boolean(bool value)
+{
+  _out.write((uint8_t)(value ? 0xC3 : 0xC2));
+}
+
+void MsgPackWriter::columns(JsonObjectConst row)
+{
+  array(row.size());
+  for (JsonPairConst field : row)
+    string(field.key().c_str());
+}
+
+void MsgPackWriter::row(JsonObjectConst row, uint32_t shape)
+{
+  if (rowShape(row) != shape)
+  {
+    serializeMsgPack(row, _out);
+    return;
+  }
+
+  array(row.size());
+  for (JsonPairConst field : row)
+    serializeMsgPack(field.value(), _out);
+}
+
+// Rows and sync sections are far below 64k entries, so 16-bit counts do
+void MsgPackWriter::header(uint8_t fix, uint8_t code16, size_t count)
+{
+  if (count < 16)
+  {
+    _out.write((uint8_t)(fix | count));
+  }
+  else
+  {
+    _out.write(code16);
+    big16(count);
+  }
+}
+
+void MsgPackWriter::big16(uint16_t value)
+{
+  _out.write((uint8_t)(value >> 8));
+  _out.write((uint8_t)value);
+}
+
+void MsgPackWriter::big32(uint32_t value)
+{
+  big16(value >> 16);
+  big16(value);
+}
+
+// ============================================================================
+// MSGPACK READER
+// ============================================================================
+
+bool MsgPackReader::next(MsgPackToken &token)
+{
+  if (atEnd())
+    return false;
+
+  size_t start = _offset;
+  uint8_t code = _data[_offset++];
+  token.text = NULL;
+  bool ok = true;
+
+  if (code < 0x80)
+  {
+    token.type = MSGPACK_UINT;
+    token.value = code;
+  }
+  else if (code >= 0xA0 && code <= 0xBF)
+  {
+    token.type = MSGPACK_STRING;
+    token.value = code & 0x1F;
+  }
+  else if (code >= 0x90 && code <= 0x9F)
+  {
+    token.type = MSGPACK_ARRAY;
+    token.value = code & 0x0F;
+  }
+  else if (code >= 0x80 && code <= 0x8F)
+  {
+    token.type = MSGPACK_MAP;
+    token.value = code & 0x0F;
+  }
+  else
+  {
+    switch (code)
+    {
+    case 0xC0:
+      token.type = MSGPACK_NIL;
+      token.value = 0;
+      break;
+    case 0xC2:
+    case 0xC3:
+      token.type = MSGPACK_BOOL;
+      token.value = code == 0xC3;
+      break;
+    case 0xCC:
+    case 0xCD:
+    case 0xCE:
+      token.type = MSGPACK_UINT;
+      ok = take((size_t)1 << (code - 0xCC), token.value);
+      break;
+    case 0xD9:
+    case 0xDA:
+    case 0xDB:
+      token.type = MSGPACK_STRING;
+      ok = take((size_t)1 << (code - 0xD9), token.value);
+      break;
+    case 0xDC:
+    case 0xDD:
+      token.type = MSGPACK_ARRAY;
+      ok = take((size_t)2 << (code - 0xDC), token.value);
+      break;
+    case 0xDE:
+    case 0xDF:
+      token.type = MSGPACK_MAP;
+      ok = take((size_t)2 << (code - 0xDE), token.value);
+      break;
+    default:
+      ok = false;
+      break;
+    }
+  }
+
+  if (ok && token.type == MSGPACK_STRING)
+  {
+    if (token.value > _length - _offset)
+    {
+      ok = false;
+    }
+    else
+    {
+      token.text = (const char *)_data + _offset;
+      _offset += token.value;
+    }
+  }
+
+  if (!ok)
+    _offset = start;
+  return ok;
+}
+
+// Big-endian integer of count bytes
+bool MsgPackReader::take(size_t count, uint32_t &value)
+{
+  if (count > _length - _offset)
+    return false;
+
+  value = 0;
+  for (size_t i = 0; i < count; i++)
+    value = (value << 8) | _data[_offset++];
+  return true;
+}
+
+// ============================================================================
+// BUFFER PRINT
+// ============================================================================
+
+size_t BufferPrint::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t BufferPrint::write(const uint8_t *data, size_t len)
+{
+  if (len > _size - _length)
+  {
+    _overflowed = true;
+    len = _size - _length;
+  }
+  memcpy(_buffer + _length, data, len);
+  _length += len;
+  return len;
+}
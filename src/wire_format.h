@@ -0,0 +1,123 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// ============================================================================
+// WIRE FORMAT
+// ============================================================================
+//
+// The list, sync and export endpoints answer in JSON or, when the client asks
+// with ?fmt=msgpack or Accept: application/msgpack, in MessagePack. A list in
+// MessagePack is a sequence of values rather than one array, so it can be
+// streamed without knowing the row count up front:
+//
+//   ["rfid", "plateNo", ...]      column names, taken from the first row
+//   ["0A1B2C3D", "ABC 123", ...]  one array of values per row, in that order
+//
+// so the field names go over the wire once instead of on every row. A row
+// whose fields differ from the first one is sent as a map. /sync sends one
+// map shaped like its JSON, with a "columns" array next to each row list.
+//
+// Choosing the format for a request lives in wire_response.h, so the
+// encoders build without the web server.
+
+enum WireFormat
+{
+  WIRE_FORMAT_JSON,
+  WIRE_FORMAT_MSGPACK,
+  WIRE_FORMAT_COUNT
+};
+
+const char *wireContentType(WireFormat format);
+
+// Appended inside ETags so the two encodings of one version never match
+const char *wireEtagSuffix(WireFormat format);
+
+// Identifies a row's field names and their order
+uint32_t rowShape(JsonObjectConst row);
+
+// Writes the MessagePack framing ArduinoJson has no call for: headers of
+// arrays and maps built piecewise, and rows split into names and values
+class MsgPackWriter
+{
+public:
+  explicit MsgPackWriter(Print &out) : _out(out) {}
+
+  void array(size_t count);
+  void map(size_t count);
+  void string(const char *value);
+  void integer(uint32_t value);
+  void boolean(bool value);
+
+  void columns(JsonObjectConst row);
+  // The values alone when the row matches shape, the whole map otherwise
+  void row(JsonObjectConst row, uint32_t shape);
+
+private:
+  void header(uint8_t fix, uint8_t code16, size_t count);
+  void big16(uint16_t value);
+  void big32(uint32_t value);
+
+  Print &_out;
+};
+
+enum MsgPackType
+{
+  MSGPACK_NIL,
+  MSGPACK_BOOL,
+  MSGPACK_UINT,
+  MSGPACK_STRING,
+  MSGPACK_ARRAY,
+  MSGPACK_MAP
+};
+
+// One value as read; value holds the boolean, the integer, the string length
+// or the array or map count. A string's text points into the input and is
+// not terminated; an array's or map's members follow as tokens of their own.
+struct MsgPackToken
+{
+  MsgPackType type;
+  uint32_t value;
+  const char *text;
+};
+
+// Reads back what MsgPackWriter and serializeMsgPack() write for rows:
+// arrays and maps, strings, unsigned integers, booleans and nil
+class MsgPackReader
+{
+public:
+  MsgPackReader(const uint8_t *data, size_t length) : _data(data), _length(length) {}
+
+  bool atEnd() const { return _offset >= _length; }
+
+  // False at the end of the input, or on a type or length it does not
+  // know; the reader is then stuck at that value
+  bool next(MsgPackToken &token);
+
+private:
+  bool take(size_t count, uint32_t &value);
+
+  const uint8_t *_data;
+  size_t _length;
+  size_t _offset = 0;
+};
+
+// Print over a fixed buffer; writes past the end are dropped and counted
+class BufferPrint : public Print
+{
+public:
+  BufferPrint(uint8_t *buffer, size_t size) : _buffer(buffer), _size(size) {}
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *data, size_t len) override;
+
+  size_t length() const { return _length; }
+  bool overflowed() const { return _overflowed; }
+
+private:
+  uint8_t *_buffer;
+  size_t _size;
+  size_t _length = 0;
+  bool _overflowed = false;
+};
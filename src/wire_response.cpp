@@ -0,0 +1,25 @@
+#include "wire_response.h"
+
+#include <memory>
+
+WireFormat negotiateWireFormat(AsyncWebServerRequest *request)
+{
+  if (request->hasParam("fmt"))
+    return request->getParam("fmt")->value() == "msgpack" ? WIRE_FORMAT_MSGPACK : WIRE_FORMAT_JSON;
+
+  if (request->hasHeader("Accept") && request->getHeader("Accept")->value().indexOf("msgpack") >= 0)
+    return WIRE_FORMAT_MSGPACK;
+  return WIRE_FORMAT_JSON;
+}
+
+AsyncWebServerResponse *beginJsonArrayResponse(AsyncWebServerRequest *request, JsonRowSource next, WireFormat format)
+{
+  std::shared_ptr<JsonArrayStream> stream(new JsonArrayStream(next, format));
+  return request->beginChunkedResponse(wireContentType(format), [stream](uint8_t *buffer, size_t maxLen, size_t index)
+                                       { return wireFillResult(stream->fill(buffer, maxLen)); });
+}
+
+size_t wireFillResult(size_t written)
+{
+  return written == JSON_STREAM_BUSY ? RESPONSE_TRY_AGAIN : written;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "json_stream.h"
+#include "wire_format.h"
+
+// ============================================================================
+// WIRE RESPONSES
+// ============================================================================
+//
+// The web server's side of wire_format.h and json_stream.h: which encoding a
+// request asked for, and list responses streamed in it.
+
+// ?fmt= wins over Accept; anything unrecognised gets JSON
+WireFormat negotiateWireFormat(AsyncWebServerRequest *request);
+
+// Chunked response driven by next
+AsyncWebServerResponse *beginJsonArrayResponse(AsyncWebServerRequest *request, JsonRowSource next,
+                                               WireFormat format = WIRE_FORMAT_JSON);
+
+// A stream's fill() result as a response filler returns it: JSON_STREAM_BUSY
+// becomes RESPONSE_TRY_AGAIN, so the server calls again instead of waiting
+size_t wireFillResult(size_t written);
@@ -0,0 +1,185 @@
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unity.h>
+
+#include "gate.h"
+
+// ============================================================================
+// SSE REPLAY RING
+// ============================================================================
+//
+// /events on a local port. The host event source calls the connect handler
+// under its client lock as the library does, so a lock order that can
+// deadlock on the device hangs here too.
+
+namespace
+{
+uint16_t port = 0;
+
+uint16_t freePort()
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if (bind(fd, (sockaddr *)&address, sizeof(address)) != 0 ||
+      getsockname(fd, (sockaddr *)&address, &length) != 0)
+  {
+    close(fd);
+    return 0;
+  }
+  close(fd);
+  return ntohs(address.sin_port);
+}
+
+// Opens /events, resuming after lastId when it is not 0
+int openEvents(uint32_t lastId)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+
+  timeval timeout = {2, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  std::string request = "GET /events HTTP/1.1\r\nHost: 127.0.0.1\r\n";
+  if (lastId != 0)
+    request += "Last-Event-ID: " + std::to_string(lastId) + "\r\n";
+  request += "\r\n";
+  send(fd, request.data(), request.size(), 0);
+  return fd;
+}
+
+// Reads until text holds count occurrences of needle, or the read times out
+std::string readUntil(int fd, const char *needle, size_t count)
+{
+  std::string text;
+  char buffer[1024];
+  while (true)
+  {
+    size_t found = 0;
+    for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1))
+      found++;
+    if (found >= count)
+      break;
+
+    ssize_t got = recv(fd, buffer, sizeof(buffer), 0);
+    if (got <= 0)
+      break;
+    text.append(buffer, got);
+  }
+  return text;
+}
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================================================
+// TESTS
+// ============================================================================
+
+void test_reconnect_replays_missed_events()
+{
+  uint32_t start = eventRing.stats().lastId;
+  eventRing.send("one", "status");
+  eventRing.send("two", "status");
+  eventRing.send("three", "done");
+
+  int fd = openEvents(start + 1);
+  TEST_ASSERT_TRUE(fd >= 0);
+  std::string text = readUntil(fd, "data: ", 2);
+  close(fd);
+
+  TEST_ASSERT_TRUE(text.find("data: one") == std::string::npos);
+  size_t two = text.find("id: " + std::to_string(start + 2) + "\r\nevent: status\r\ndata: two");
+  size_t three = text.find("id: " + std::to_string(start + 3) + "\r\nevent: done\r\ndata: three");
+  TEST_ASSERT_TRUE(two != std::string::npos);
+  TEST_ASSERT_TRUE(three != std::string::npos);
+  TEST_ASSERT_TRUE(two < three);
+}
+
+void test_reconnect_past_ring_resyncs()
+{
+  uint32_t start = eventRing.stats().lastId;
+  for (size_t i = 0; i < EVENT_RING_SIZE + 1; i++)
+    eventRing.send("filler", "status");
+
+  uint32_t resyncs = eventRing.stats().resyncs;
+  int fd = openEvents(start);
+  TEST_ASSERT_TRUE(fd >= 0);
+  std::string text = readUntil(fd, "event: resync", 1);
+  close(fd);
+
+  TEST_ASSERT_TRUE(text.find("id: " + std::to_string(eventRing.stats().lastId) + "\r\nevent: resync") !=
+                   std::string::npos);
+  TEST_ASSERT_EQUAL_UINT32(resyncs + 1, eventRing.stats().resyncs);
+}
+
+// Events sent from another task while browsers keep reconnecting
+void test_send_during_reconnects()
+{
+  std::atomic<bool> stop(false);
+  std::atomic<uint32_t> sent(0);
+  std::thread sender([&]()
+                     {
+    while (!stop)
+    {
+      eventRing.send("pass", "rfid");
+      sent++;
+    } });
+
+  for (int i = 0; i < 40; i++)
+  {
+    uint32_t since = eventRing.stats().lastId - 4;
+    int fd = openEvents(since);
+    TEST_ASSERT_TRUE(fd >= 0);
+    std::string text = readUntil(fd, "data: pass", 4);
+    close(fd);
+    TEST_ASSERT_TRUE(text.find("data: pass") != std::string::npos);
+  }
+
+  stop = true;
+  sender.join();
+  TEST_ASSERT_TRUE(sent > 0);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  port = freePort();
+  if (port == 0 || !eventRing.begin(events))
+  {
+    printf("event ring test setup failed\n");
+    return 1;
+  }
+  server.addHandler(&events);
+  server.setPort(port);
+  server.begin();
+  if (!server.listening())
+  {
+    printf("event ring test could not listen\n");
+    return 1;
+  }
+
+  RUN_TEST(test_reconnect_replays_missed_events);
+  RUN_TEST(test_reconnect_past_ring_resyncs);
+  RUN_TEST(test_send_during_reconnects);
+  int failures = UNITY_END();
+  server.end();
+  return failures;
+}
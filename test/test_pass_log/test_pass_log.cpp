@@ -0,0 +1,290 @@
+#include <Arduino.h>
+#include <FS.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+#include <vector>
+
+#include "pass_log.h"
+
+// ============================================================================
+// PASS LOG
+// ============================================================================
+//
+// Each test gets a fresh directory standing in for the flash partition.
+
+namespace
+{
+char root[] = "/tmp/pass_log_test.XXXXXX";
+fs::FS *flash = NULL;
+
+// Host path of a file on the test partition
+std::string hostPath(const char *path)
+{
+  return std::string(root) + path;
+}
+
+size_t fileSize(const char *path)
+{
+  FILE *file = fopen(hostPath(path).c_str(), "rb");
+  if (file == NULL)
+    return 0;
+  fseek(file, 0, SEEK_END);
+  size_t size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+void appendBytes(const char *path, const void *data, size_t length)
+{
+  FILE *file = fopen(hostPath(path).c_str(), "ab");
+  TEST_ASSERT_NOT_NULL(file);
+  TEST_ASSERT_EQUAL(length, fwrite(data, 1, length, file));
+  fclose(file);
+}
+
+// count entries from seq 1 on, timestamps from timestampOf, in batches
+void fill(PassLog &log, uint32_t count, uint32_t (*timestampOf)(uint32_t))
+{
+  std::vector<PassEntry> batch;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    uint32_t seq = log.lastSeq() + batch.size() + 1;
+    batch.push_back(log.prepare(0x10000000 + seq, timestampOf(seq), 0));
+    if (batch.size() == 256 || i + 1 == count)
+    {
+      TEST_ASSERT_TRUE(log.write(batch.data(), batch.size()));
+      batch.clear();
+    }
+  }
+}
+
+uint32_t tenPerSecond(uint32_t seq)
+{
+  return 1000 + seq / 10;
+}
+
+// Runs of equal times with gaps between them
+uint32_t bursty(uint32_t seq)
+{
+  return 5000 + (seq / 7) * 3 + (seq % 97 == 0 ? 40 : 0) + seq / 500 * 100;
+}
+
+std::vector<PassEntry> retained(PassLog &log)
+{
+  std::vector<PassEntry> entries;
+  PassEntry entry;
+  uint32_t cursor = log.firstSeq();
+  while (log.next(cursor, entry))
+    entries.push_back(entry);
+  return entries;
+}
+
+// What seekTimestamp() promises, by looking at every entry
+uint32_t bruteForceSeek(const std::vector<PassEntry> &entries, uint32_t timestamp, uint32_t lastSeq)
+{
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    if (entries[i].timestamp >= timestamp)
+      return entries[i].seq;
+  }
+  return lastSeq + 1;
+}
+} // namespace
+
+void setUp()
+{
+  strcpy(root, "/tmp/pass_log_test.XXXXXX");
+  TEST_ASSERT_NOT_NULL(mkdtemp(root));
+  flash = new fs::FS(root);
+}
+
+void tearDown()
+{
+  delete flash;
+  flash = NULL;
+  std::string command = std::string("rm -rf ") + root;
+  system(command.c_str());
+}
+
+// ============================================================================
+// TESTS
+// ============================================================================
+
+void test_append_and_reopen()
+{
+  {
+    PassLog log;
+    TEST_ASSERT_TRUE(log.begin(*flash, "/passes"));
+    for (uint32_t i = 0; i < 10; i++)
+      TEST_ASSERT_TRUE(log.append(0x0A0B0C00 + i, 100 + i, PASS_FLAG_REGISTERED));
+  }
+
+  PassLog log;
+  TEST_ASSERT_TRUE(log.begin(*flash, "/passes"));
+  TEST_ASSERT_EQUAL_UINT32(1, log.firstSeq());
+  TEST_ASSERT_EQUAL_UINT32(10, log.lastSeq());
+  TEST_ASSERT_EQUAL_UINT32(109, log.lastTimestamp());
+
+  PassEntry entry;
+  TEST_ASSERT_TRUE(log.read(4, entry));
+  TEST_ASSERT_EQUAL_HEX32(0x0A0B0C03, entry.tag);
+  TEST_ASSERT_EQUAL_UINT32(103, entry.timestamp);
+  TEST_ASSERT_EQUAL_UINT16(PASS_FLAG_REGISTERED, entry.flags);
+}
+
+// A reset mid-write leaves part of an entry at the end of the segment
+void test_torn_tail_is_cut_back()
+{
+  {
+    PassLog log;
+    TEST_ASSERT_TRUE(log.begin(*flash, "/passes"));
+    for (uint32_t i = 0; i < 10; i++)
+      TEST_ASSERT_TRUE(log.append(0x0A0B0C00 + i, 100 + i, 0));
+  }
+  const uint8_t torn[7] = {11, 0, 0, 0, 0xDE, 0xAD, 0xBE};
+  appendBytes("/passes/00000000.seg", torn, sizeof(torn));
+
+  PassLog log;
+  TEST_ASSERT_TRUE(log.begin(*flash, "/passes"));
+  TEST_ASSERT_EQUAL_UINT32(10, log.lastSeq());
+  TEST_ASSERT_EQUAL(10 * sizeof(PassEntry), fileSize("/passes/00000000.seg"));
+
+  // The next entry lands where the torn one started
+  PassEntry written;
+  TEST_ASSERT_TRUE(log.append(0x0A0B0CFF, 200, 0, &written));
+  TEST_ASSERT_EQUAL_UINT32(11, written.seq);
+
+  PassEntry entry;
+  TEST_ASSERT_TRUE(log.read(11, entry));
+  TEST_ASSERT_EQUAL_HEX32(0x0A0B0CFF, entry.tag);
+  TEST_ASSERT_EQUAL(11 * sizeof(PassEntry), fileSize("/passes/00000000.seg"));
+}
+
+// A whole entry that was only partly written fails its CRC and goes too
+void test_corrupt_last_entry_is_dropped()
+{
+  {
+    PassLog log;
+    TEST_ASSERT_TRUE(log.begin(*flash, "/passes"));
+    for (uint32_t i = 0; i < 5; i++)
+      TEST_ASSERT_TRUE(log.append(0x0A0B0C00 + i, 100 + i, 0));
+  }
+  PassEntry bad = {6, 0x0A0B0C05, 105, 0, 0};
+  bad.crc = PassLog::checksum(bad) ^ 0x0100;
+  appendBytes("/passes/00000000.seg", &bad, sizeof(bad));
+
+  PassLog log;
+  TEST_ASSERT_TRUE(log.begin(*flash, "/passes"));
+  TEST_ASSERT_EQUAL_UINT32(5, log.lastSeq());
+  TEST_ASSERT_EQUAL(5 * sizeof(PassEntry), fileSize("/passes/00000000.seg"));
+}
+
+void test_rotation_drops_oldest_segment()
+{
+  const uint32_t total = PASS_MAX_SEGMENTS * PASS_SEGMENT_ENTRIES + 10;
+  {
+    PassLog log;
+    TEST_ASSERT_TRUE(log.begin(*flash, "/passes"));
+    fill(log, total, tenPerSecond);
+
+    TEST_ASSERT_EQUAL_UINT32(total, log.lastSeq());
+    TEST_ASSERT_EQUAL_UINT32(PASS_SEGMENT_ENTRIES + 1, log.firstSeq());
+    TEST_ASSERT_FALSE(flash->exists("/passes/00000000.seg"));
+    TEST_ASSERT_TRUE(flash->exists("/passes/00000001.seg"));
+  }
+
+  PassLog log;
+  TEST_ASSERT_TRUE(log.begin(*flash, "/passes"));
+  TEST_ASSERT_EQUAL_UINT32(PASS_SEGMENT_ENTRIES + 1, log.firstSeq());
+  TEST_ASSERT_EQUAL_UINT32(total, log.lastSeq());
+
+  PassEntry entry;
+  TEST_ASSERT_FALSE(log.read(PASS_SEGMENT_ENTRIES, entry));
+  TEST_ASSERT_TRUE(log.read(PASS_SEGMENT_ENTRIES + 1, entry));
+  TEST_ASSERT_TRUE(log.read(total, entry));
+  TEST_ASSERT_EQUAL_UINT32(tenPerSecond(total), entry.timestamp);
+
+  uint32_t cursor = log.firstSeq();
+  uint32_t walked = 0;
+  while (log.next(cursor, entry))
+    walked++;
+  TEST_ASSERT_EQUAL_UINT32(log.count(), walked);
+}
+
+void test_timestamps_never_decrease()
+{
+  PassLog log;
+  TEST_ASSERT_TRUE(log.begin(*flash, "/passes"));
+  TEST_ASSERT_TRUE(log.append(0x0A0B0C01, 500, 0));
+
+  PassEntry written;
+  TEST_ASSERT_TRUE(log.append(0x0A0B0C02, 200, 0, &written));
+  TEST_ASSERT_EQUAL_UINT32(500, written.timestamp);
+  TEST_ASSERT_EQUAL_UINT32(500, log.lastTimestamp());
+}
+
+// After a clock correction the log carries on from the corrected time
+void test_rebase_takes_earlier_timestamps()
+{
+  PassLog log;
+  TEST_ASSERT_TRUE(log.begin(*flash, "/passes"));
+  TEST_ASSERT_TRUE(log.append(0x0A0B0C01, 900, 0));
+
+  log.rebase(300);
+  PassEntry written;
+  TEST_ASSERT_TRUE(log.append(0x0A0B0C02, 300, 0, &written));
+  TEST_ASSERT_EQUAL_UINT32(300, written.timestamp);
+  TEST_ASSERT_TRUE(log.append(0x0A0B0C03, 250, 0, &written));
+  TEST_ASSERT_EQUAL_UINT32(300, written.timestamp);
+
+  // Never raises the floor
+  log.rebase(1000);
+  TEST_ASSERT_TRUE(log.append(0x0A0B0C04, 310, 0, &written));
+  TEST_ASSERT_EQUAL_UINT32(310, written.timestamp);
+}
+
+void test_seek_timestamp_matches_scan()
+{
+  PassLog log;
+  TEST_ASSERT_TRUE(log.begin(*flash, "/passes"));
+  TEST_ASSERT_EQUAL_UINT32(1, log.seekTimestamp(0));
+
+  fill(log, 3 * PASS_SEGMENT_ENTRIES + 77, bursty);
+  std::vector<PassEntry> entries = retained(log);
+  TEST_ASSERT_EQUAL(log.count(), entries.size());
+  for (uint32_t t = 0; t <= log.lastTimestamp() + 2; t++)
+    TEST_ASSERT_EQUAL_UINT32(bruteForceSeek(entries, t, log.lastSeq()), log.seekTimestamp(t));
+}
+
+// The RAM index is round-robin; after rotation it must still only answer
+// from retained entries
+void test_seek_timestamp_after_rotation()
+{
+  PassLog log;
+  TEST_ASSERT_TRUE(log.begin(*flash, "/passes"));
+  fill(log, (PASS_MAX_SEGMENTS + 2) * PASS_SEGMENT_ENTRIES + 33, tenPerSecond);
+
+  PassEntry first;
+  TEST_ASSERT_TRUE(log.read(log.firstSeq(), first));
+  TEST_ASSERT_EQUAL_UINT32(log.firstSeq(), log.seekTimestamp(0));
+  TEST_ASSERT_EQUAL_UINT32(log.firstSeq(), log.seekTimestamp(first.timestamp));
+  TEST_ASSERT_EQUAL_UINT32(log.lastSeq() + 1, log.seekTimestamp(log.lastTimestamp() + 1));
+  std::vector<PassEntry> entries = retained(log);
+  for (uint32_t t = first.timestamp; t <= log.lastTimestamp() + 1; t++)
+    TEST_ASSERT_EQUAL_UINT32(bruteForceSeek(entries, t, log.lastSeq()), log.seekTimestamp(t));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_append_and_reopen);
+  RUN_TEST(test_torn_tail_is_cut_back);
+  RUN_TEST(test_corrupt_last_entry_is_dropped);
+  RUN_TEST(test_rotation_drops_oldest_segment);
+  RUN_TEST(test_timestamps_never_decrease);
+  RUN_TEST(test_rebase_takes_earlier_timestamps);
+  RUN_TEST(test_seek_timestamp_matches_scan);
+  RUN_TEST(test_seek_timestamp_after_rotation);
+  return UNITY_END();
+}
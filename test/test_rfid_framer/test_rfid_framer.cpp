@@ -0,0 +1,186 @@
+#include <unity.h>
+
+#include "rfid_framer.h"
+
+// ============================================================================
+// RFID FRAMER
+// ============================================================================
+//
+// The framer never reads a clock, so the tests drive time by hand.
+
+namespace
+{
+RfidFramer *framer = NULL;
+unsigned long now = 0;
+
+const uint8_t TAG_A[4] = {0x12, 0x34, 0x56, 0x78};
+const uint8_t TAG_B[4] = {0x9A, 0xBC, 0xDE, 0xF0};
+const uint8_t NOISE[4] = {0x00, 0x00, 0x00, 0x00};
+const uint8_t IDLE[4] = {0x00, 0x00, 0x00, 0x01};
+
+// One frame, then the silence that ends it. True if it confirmed a pass.
+bool read(const uint8_t *bytes, unsigned long after = 150)
+{
+  uint32_t tag = 0;
+  framer->feed(bytes, 4, now);
+  now += after;
+  bool confirmed = framer->update(now, tag);
+  if (confirmed)
+    TEST_ASSERT_EQUAL_HEX32(((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3], tag);
+  return confirmed;
+}
+
+// Reads of one tag until it passes, or limit reads go by without a pass
+int readsToPass(const uint8_t *bytes, int limit = 10)
+{
+  for (int i = 1; i <= limit; i++)
+  {
+    if (read(bytes))
+      return i;
+  }
+  return 0;
+}
+} // namespace
+
+void setUp()
+{
+  framer = new RfidFramer();
+  now = 100000;
+}
+
+void tearDown()
+{
+  delete framer;
+  framer = NULL;
+}
+
+// ============================================================================
+// TESTS
+// ============================================================================
+
+void test_pass_needs_consecutive_reads()
+{
+  TEST_ASSERT_FALSE(read(TAG_A));
+  TEST_ASSERT_FALSE(read(TAG_A));
+  TEST_ASSERT_TRUE(read(TAG_A));
+  TEST_ASSERT_EQUAL_UINT32(3, framer->frames());
+}
+
+void test_frame_waits_for_gap()
+{
+  uint32_t tag;
+  framer->feed(TAG_A, 4, now);
+  TEST_ASSERT_FALSE(framer->update(now + FRAME_GAP_MS, tag));
+  TEST_ASSERT_EQUAL_UINT32(0, framer->frames());
+  TEST_ASSERT_FALSE(framer->update(now + FRAME_GAP_MS + 1, tag));
+  TEST_ASSERT_EQUAL_UINT32(1, framer->frames());
+}
+
+void test_same_tag_is_deduped_within_window()
+{
+  TEST_ASSERT_EQUAL(MIN_CONSECUTIVE_READS, readsToPass(TAG_A));
+  unsigned long passed = now;
+
+  // The tag sits in front of the reader: no second pass inside the window
+  while (now - passed < DUPLICATE_WINDOW - 500)
+    TEST_ASSERT_FALSE(read(TAG_A));
+
+  now = passed + DUPLICATE_WINDOW + 1;
+  TEST_ASSERT_EQUAL(MIN_CONSECUTIVE_READS, readsToPass(TAG_A));
+}
+
+void test_other_tag_passes_inside_window()
+{
+  TEST_ASSERT_EQUAL(MIN_CONSECUTIVE_READS, readsToPass(TAG_A));
+  TEST_ASSERT_EQUAL(MIN_CONSECUTIVE_READS, readsToPass(TAG_B));
+
+  // Only the last tag to pass is remembered
+  TEST_ASSERT_EQUAL(MIN_CONSECUTIVE_READS, readsToPass(TAG_A));
+}
+
+void test_interleaved_reads_restart_streak()
+{
+  TEST_ASSERT_FALSE(read(TAG_A));
+  TEST_ASSERT_FALSE(read(TAG_A));
+  TEST_ASSERT_FALSE(read(TAG_B));
+  TEST_ASSERT_FALSE(read(TAG_A));
+  TEST_ASSERT_FALSE(read(TAG_A));
+  TEST_ASSERT_TRUE(read(TAG_A));
+}
+
+void test_noise_frames_are_counted_not_read()
+{
+  TEST_ASSERT_FALSE(read(NOISE));
+  TEST_ASSERT_FALSE(read(IDLE));
+  const uint8_t ones[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+  TEST_ASSERT_FALSE(read(ones));
+  TEST_ASSERT_EQUAL_UINT32(3, framer->invalidFrames());
+
+  TEST_ASSERT_EQUAL(MIN_CONSECUTIVE_READS, readsToPass(TAG_A));
+  TEST_ASSERT_EQUAL_UINT32(3, framer->invalidFrames());
+}
+
+// Two reads, then nothing until the streak is forgotten
+void test_streak_expires()
+{
+  uint32_t tag;
+  TEST_ASSERT_FALSE(read(TAG_A));
+  TEST_ASSERT_FALSE(read(TAG_A));
+  now += READ_STREAK_MS;
+  TEST_ASSERT_FALSE(framer->update(now, tag));
+
+  TEST_ASSERT_FALSE(read(TAG_A));
+  TEST_ASSERT_FALSE(read(TAG_A));
+  TEST_ASSERT_TRUE(read(TAG_A));
+}
+
+void test_partial_frame_is_dropped()
+{
+  uint32_t tag;
+  framer->feed(TAG_A, 2, now);
+  TEST_ASSERT_FALSE(framer->update(now + PARTIAL_FRAME_MS + 1, tag));
+  now += PARTIAL_FRAME_MS + 1;
+
+  // Had the two bytes stayed, this frame would be 12 34 9A BC
+  TEST_ASSERT_FALSE(read(TAG_B));
+  TEST_ASSERT_FALSE(read(TAG_B));
+  TEST_ASSERT_TRUE(read(TAG_B));
+}
+
+void test_extra_bytes_are_discarded()
+{
+  const uint8_t longFrame[6] = {0x12, 0x34, 0x56, 0x78, 0xAA, 0xBB};
+  uint32_t tag;
+  for (int i = 0; i < MIN_CONSECUTIVE_READS; i++)
+  {
+    framer->feed(longFrame, sizeof(longFrame), now);
+    now += 150;
+    bool confirmed = framer->update(now, tag);
+    TEST_ASSERT_EQUAL(i == MIN_CONSECUTIVE_READS - 1, confirmed);
+  }
+  TEST_ASSERT_EQUAL_HEX32(0x12345678, tag);
+}
+
+void test_idle_timeout()
+{
+  TEST_ASSERT_EQUAL_UINT32(UART_WAIT_FOREVER, framer->idleTimeout(now));
+  framer->feed(TAG_A, 4, now);
+  TEST_ASSERT_EQUAL_UINT32(FRAME_GAP_MS + 1, framer->idleTimeout(now));
+  TEST_ASSERT_EQUAL_UINT32(0, framer->idleTimeout(now + FRAME_GAP_MS + 5));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_pass_needs_consecutive_reads);
+  RUN_TEST(test_frame_waits_for_gap);
+  RUN_TEST(test_same_tag_is_deduped_within_window);
+  RUN_TEST(test_other_tag_passes_inside_window);
+  RUN_TEST(test_interleaved_reads_restart_streak);
+  RUN_TEST(test_noise_frames_are_counted_not_read);
+  RUN_TEST(test_streak_expires);
+  RUN_TEST(test_partial_frame_is_dropped);
+  RUN_TEST(test_extra_bytes_are_discarded);
+  RUN_TEST(test_idle_timeout);
+  return UNITY_END();
+}
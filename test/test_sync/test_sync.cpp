@@ -0,0 +1,362 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unity.h>
+
+#include "gate.h"
+
+// ============================================================================
+// /sync
+// ============================================================================
+//
+// The routes of setupServerRoutes() on a local port over a scratch data
+// directory, with the storage task running as on the device. Requests go
+// over a plain socket.
+
+namespace
+{
+char dataDir[] = "/tmp/sync_test.XXXXXX";
+Preferences preferences;
+uint16_t port = 0;
+
+struct HttpResponse
+{
+  int status = 0;
+  std::string head;
+  std::string body;
+};
+
+// A port nothing listens on right now
+uint16_t freePort()
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if (bind(fd, (sockaddr *)&address, sizeof(address)) != 0 ||
+      getsockname(fd, (sockaddr *)&address, &length) != 0)
+  {
+    close(fd);
+    return 0;
+  }
+  close(fd);
+  return ntohs(address.sin_port);
+}
+
+std::string dechunk(const std::string &body)
+{
+  std::string out;
+  size_t at = 0;
+  while (at < body.size())
+  {
+    size_t lineEnd = body.find("\r\n", at);
+    if (lineEnd == std::string::npos)
+      break;
+    size_t size = strtoul(body.substr(at, lineEnd - at).c_str(), NULL, 16);
+    if (size == 0)
+      break;
+    out.append(body, lineEnd + 2, size);
+    at = lineEnd + 2 + size + 2;
+  }
+  return out;
+}
+
+// One GET; the server closes the connection after each response
+HttpResponse get(const std::string &path, const char *extraHeaders = "")
+{
+  HttpResponse response;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+  {
+    close(fd);
+    return response;
+  }
+
+  std::string request = "GET " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\n" + extraHeaders + "\r\n";
+  send(fd, request.data(), request.size(), 0);
+
+  std::string raw;
+  char buffer[4096];
+  ssize_t got;
+  while ((got = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+    raw.append(buffer, got);
+  close(fd);
+
+  size_t headEnd = raw.find("\r\n\r\n");
+  if (headEnd == std::string::npos)
+    return response;
+  response.head = raw.substr(0, headEnd);
+  response.body = raw.substr(headEnd + 4);
+  response.status = atoi(raw.c_str() + 9); // "HTTP/1.1 200"
+  if (response.head.find("Transfer-Encoding: chunked") != std::string::npos)
+    response.body = dechunk(response.body);
+  return response;
+}
+
+std::string header(const HttpResponse &response, const char *name)
+{
+  std::string key = std::string("\r\n") + name + ": ";
+  size_t at = response.head.find(key);
+  if (at == std::string::npos)
+    return "";
+  at += key.size();
+  return response.head.substr(at, response.head.find("\r\n", at) - at);
+}
+
+VehicleRecord makeRecord(uint32_t tag, const char *plate)
+{
+  VehicleRecord record = {};
+  record.tag = tag;
+  strncpy(record.plateNo, plate, sizeof(record.plateNo) - 1);
+  strcpy(record.type, "Car");
+  return record;
+}
+
+// Storage requests complete on the storage task; these wait for that
+bool waitFor(std::function<bool(StorageCallback)> submit)
+{
+  QueueHandle_t done = xQueueCreate(1, sizeof(bool));
+  bool ok = false;
+  if (submit([done](const StorageResult &result)
+             { xQueueSend(done, &result.ok, portMAX_DELAY); }))
+    xQueueReceive(done, &ok, portMAX_DELAY);
+  vQueueDelete(done);
+  return ok;
+}
+
+bool save(uint32_t tag, const char *plate)
+{
+  VehicleRecord record = makeRecord(tag, plate);
+  return waitFor([&](StorageCallback done)
+                 { return storage.saveVehicle(record, done); });
+}
+
+bool removeVehicle(uint32_t tag)
+{
+  return waitFor([&](StorageCallback done)
+                 { return storage.removeVehicle(tag, done); });
+}
+
+DynamicJsonDocument doc(16384);
+
+// A 200 answer, into doc
+void parse(const HttpResponse &response)
+{
+  TEST_ASSERT_EQUAL(200, response.status);
+  doc.clear();
+  TEST_ASSERT_TRUE(deserializeJson(doc, response.body.c_str()) == DeserializationError::Ok);
+}
+
+std::string syncPath(const char *param, uint32_t value)
+{
+  return std::string("/sync?") + param + "=" + std::to_string(value);
+}
+
+bool begin()
+{
+  if (mkdtemp(dataDir) == NULL)
+    return false;
+  setNativeDataDir(dataDir);
+  port = freePort();
+  if (port == 0 || !LittleFS.begin(true) || !preferences.begin("fingerprints", false) ||
+      !registry.begin(LittleFS, "/vehicles.db") || !tagTable.load(registry) ||
+      !passLog.begin(LittleFS, "/passes") ||
+      !storage.begin(preferences, registry, tagTable))
+    return false;
+
+  setupServerRoutes();
+  server.setPort(port);
+  server.begin();
+  return server.listening();
+}
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================================================
+// TESTS
+// ============================================================================
+
+void test_vehicle_changes_since_generation()
+{
+  uint32_t before = storage.vehiclesGeneration();
+  TEST_ASSERT_TRUE(save(0x0A000001, "AAA 111"));
+  TEST_ASSERT_TRUE(save(0x0A000002, "BBB 222"));
+  TEST_ASSERT_TRUE(save(0x0A000003, "CCC 333"));
+  TEST_ASSERT_TRUE(removeVehicle(0x0A000002));
+  TEST_ASSERT_TRUE(save(0x0A000001, "AAA 999"));
+
+  parse(get(syncPath("vehicles_gen", before)));
+  JsonObject vehicles = doc["vehicles"];
+  TEST_ASSERT_FALSE(vehicles["reset"].as<bool>());
+  TEST_ASSERT_EQUAL_UINT32(storage.vehiclesGeneration(), vehicles["gen"].as<uint32_t>());
+
+  // One row per tag, as its last change left it
+  JsonArray changed = vehicles["changed"];
+  JsonArray removed = vehicles["removed"];
+  TEST_ASSERT_EQUAL(2, changed.size());
+  TEST_ASSERT_EQUAL_STRING("0A000003", changed[0]["rfid"].as<const char *>());
+  TEST_ASSERT_EQUAL_STRING("0A000001", changed[1]["rfid"].as<const char *>());
+  TEST_ASSERT_EQUAL_STRING("AAA 999", changed[1]["plateNo"].as<const char *>());
+  TEST_ASSERT_EQUAL(1, removed.size());
+  TEST_ASSERT_EQUAL_STRING("0A000002", removed[0].as<const char *>());
+}
+
+void test_current_generation_is_not_modified()
+{
+  uint32_t generation = storage.vehiclesGeneration();
+  HttpResponse first = get(syncPath("vehicles_gen", generation));
+  parse(first);
+  TEST_ASSERT_EQUAL(0, doc["vehicles"]["changed"].as<JsonArray>().size());
+  TEST_ASSERT_EQUAL(0, doc["vehicles"]["removed"].as<JsonArray>().size());
+
+  // The version a client holds once it is up to date
+  std::string etag = "\"v" + std::to_string(generation) + "-p" + std::to_string(passLog.lastSeq()) + "\"";
+  std::string ifNoneMatch = "If-None-Match: " + etag + "\r\n";
+  HttpResponse cached = get(syncPath("vehicles_gen", generation), ifNoneMatch.c_str());
+  TEST_ASSERT_EQUAL(304, cached.status);
+  std::string cachedEtag = header(cached, "ETag");
+  TEST_ASSERT_EQUAL_STRING(etag.c_str(), cachedEtag.c_str());
+
+  TEST_ASSERT_TRUE(save(0x0A000004, "DDD 444"));
+  TEST_ASSERT_EQUAL(200, get(syncPath("vehicles_gen", generation), ifNoneMatch.c_str()).status);
+}
+
+// More changes than the log holds: a client that far behind must reload
+void test_old_generation_resets()
+{
+  uint32_t before = storage.vehiclesGeneration();
+  for (uint32_t i = 0; i < STORAGE_CHANGE_LOG + 4; i++)
+    TEST_ASSERT_TRUE(save(0x0B000000 + i, "FLEET"));
+
+  parse(get(syncPath("vehicles_gen", before)));
+  TEST_ASSERT_TRUE(doc["vehicles"]["reset"].as<bool>());
+  TEST_ASSERT_EQUAL(0, doc["vehicles"]["changed"].as<JsonArray>().size());
+  TEST_ASSERT_EQUAL_UINT32(storage.vehiclesGeneration(), doc["vehicles"]["gen"].as<uint32_t>());
+
+  // From a generation still in the log, just the newer changes
+  uint32_t recent = storage.vehiclesGeneration() - 2;
+  parse(get(syncPath("vehicles_gen", recent)));
+  TEST_ASSERT_FALSE(doc["vehicles"]["reset"].as<bool>());
+  TEST_ASSERT_EQUAL(2, doc["vehicles"]["changed"].as<JsonArray>().size());
+  TEST_ASSERT_EQUAL_STRING("0B000023", doc["vehicles"]["changed"][1]["rfid"].as<const char *>());
+}
+
+// Clearing every vehicle cannot be told as a list of changes
+void test_clear_resets_change_log()
+{
+  uint32_t before = storage.vehiclesGeneration();
+  TEST_ASSERT_TRUE(waitFor([](StorageCallback done)
+                           { return storage.clearVehicles(done); }));
+
+  parse(get(syncPath("vehicles_gen", before)));
+  TEST_ASSERT_TRUE(doc["vehicles"]["reset"].as<bool>());
+
+  TEST_ASSERT_TRUE(save(0x0C000001, "AFTER"));
+  parse(get(syncPath("vehicles_gen", storage.vehiclesGeneration() - 1)));
+  TEST_ASSERT_FALSE(doc["vehicles"]["reset"].as<bool>());
+  TEST_ASSERT_EQUAL(1, doc["vehicles"]["changed"].as<JsonArray>().size());
+}
+
+void test_passes_after_seq()
+{
+  uint32_t first = passLog.lastSeq();
+  for (uint32_t i = 0; i < 5; i++)
+    TEST_ASSERT_TRUE(passLog.append(0x0D000000 + i, 1000 + i, 0));
+
+  parse(get(syncPath("passes_seq", first + 2)));
+  JsonObject passes = doc["passes"];
+  TEST_ASSERT_FALSE(passes["reset"].as<bool>());
+  TEST_ASSERT_FALSE(passes["more"].as<bool>());
+  TEST_ASSERT_EQUAL_UINT32(first + 5, passes["lastSeq"].as<uint32_t>());
+  TEST_ASSERT_EQUAL(3, passes["items"].as<JsonArray>().size());
+  TEST_ASSERT_EQUAL_UINT32(first + 3, passes["items"][0]["id"].as<uint32_t>());
+  TEST_ASSERT_TRUE(doc["vehicles"].isNull());
+}
+
+// A client ahead of the log, as after the log is cleared, starts over from
+// the oldest pass rather than waiting for the sequence to catch up
+void test_passes_ahead_of_log_resets()
+{
+  uint32_t first = passLog.firstSeq();
+  uint32_t last = passLog.lastSeq();
+  TEST_ASSERT_TRUE(last >= first);
+
+  parse(get(syncPath("passes_seq", last + 100)));
+  JsonObject passes = doc["passes"];
+  TEST_ASSERT_TRUE(passes["reset"].as<bool>());
+  TEST_ASSERT_EQUAL_UINT32(last, passes["lastSeq"].as<uint32_t>());
+  TEST_ASSERT_EQUAL(last - first + 1, passes["items"].as<JsonArray>().size());
+  TEST_ASSERT_EQUAL_UINT32(first, passes["items"][0]["id"].as<uint32_t>());
+}
+
+// The MessagePack answer decodes as the same map as the JSON one, with the
+// column names sent once next to the value arrays
+void test_passes_msgpack()
+{
+  uint32_t first = passLog.lastSeq();
+  for (uint32_t i = 0; i < 3; i++)
+    TEST_ASSERT_TRUE(passLog.append(0x0E000000 + i, 2000 + i, 0));
+
+  HttpResponse response = get(syncPath("passes_seq", first), "Accept: application/msgpack\r\n");
+  TEST_ASSERT_EQUAL(200, response.status);
+  std::string contentType = header(response, "Content-Type");
+  TEST_ASSERT_EQUAL_STRING("application/msgpack", contentType.c_str());
+
+  doc.clear();
+  TEST_ASSERT_TRUE(deserializeMsgPack(doc, response.body.data(), response.body.size()) == DeserializationError::Ok);
+  JsonObject passes = doc["passes"];
+  TEST_ASSERT_EQUAL(5, passes.size());
+  TEST_ASSERT_EQUAL_UINT32(first + 3, passes["lastSeq"].as<uint32_t>());
+  TEST_ASSERT_FALSE(passes["reset"].as<bool>());
+  TEST_ASSERT_FALSE(passes["more"].as<bool>());
+
+  JsonArray columns = passes["columns"];
+  JsonArray items = passes["items"];
+  TEST_ASSERT_EQUAL_STRING("id", columns[0].as<const char *>());
+  TEST_ASSERT_EQUAL_STRING("tagID", columns[1].as<const char *>());
+  TEST_ASSERT_EQUAL(3, items.size());
+  for (size_t i = 0; i < 3; i++)
+  {
+    JsonArray item = items[i];
+    TEST_ASSERT_EQUAL(columns.size(), item.size());
+    TEST_ASSERT_EQUAL_UINT32(first + 1 + i, item[0].as<uint32_t>());
+  }
+  TEST_ASSERT_EQUAL_STRING("0E000002", items[2][1].as<const char *>());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  if (!begin())
+  {
+    printf("sync test setup failed in %s\n", dataDir);
+    return 1;
+  }
+  RUN_TEST(test_vehicle_changes_since_generation);
+  RUN_TEST(test_current_generation_is_not_modified);
+  RUN_TEST(test_old_generation_resets);
+  RUN_TEST(test_clear_resets_change_log);
+  RUN_TEST(test_passes_after_seq);
+  RUN_TEST(test_passes_ahead_of_log_resets);
+  RUN_TEST(test_passes_msgpack);
+  int failures = UNITY_END();
+
+  server.end();
+  std::string command = std::string("rm -rf ") + dataDir;
+  system(command.c_str());
+  return failures;
+}
@@ -0,0 +1,178 @@
+#include <Arduino.h>
+#include <map>
+#include <stdio.h>
+#include <string>
+#include <unity.h>
+
+#include "tag_table.h"
+
+// ============================================================================
+// TAG TABLE
+// ============================================================================
+
+namespace
+{
+VehicleRecord makeRecord(uint32_t tag)
+{
+  VehicleRecord record = {};
+  record.tag = tag;
+  snprintf(record.plateNo, sizeof(record.plateNo), "P%08X", (unsigned)tag);
+  snprintf(record.owner, sizeof(record.owner), "Owner %u", (unsigned)tag);
+  strcpy(record.role, "Staff");
+  return record;
+}
+
+// Home bucket of tag in a table of 1 << bits buckets, as TagTable hashes it
+uint16_t homeOf(uint32_t tag, uint8_t bits)
+{
+  return (uint16_t)((tag * 2654435761u) >> (32 - bits));
+}
+
+// The next tag after from whose home bucket is bucket
+uint32_t tagWithHome(uint32_t from, uint16_t bucket, uint8_t bits)
+{
+  uint32_t tag = from + 1;
+  while (homeOf(tag, bits) != bucket)
+    tag++;
+  return tag;
+}
+
+bool holds(TagTable &table, uint32_t tag)
+{
+  TagInfo info;
+  if (!table.lookup(tag, info))
+    return false;
+  VehicleRecord expected = makeRecord(tag);
+  TEST_ASSERT_EQUAL_STRING(expected.plateNo, info.plateNo);
+  TEST_ASSERT_EQUAL_STRING(expected.owner, info.owner);
+  return true;
+}
+
+uint32_t lcg = 12345;
+uint32_t random32()
+{
+  lcg = lcg * 1664525u + 1013904223u;
+  return lcg;
+}
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================================================
+// TESTS
+// ============================================================================
+
+void test_put_lookup_update()
+{
+  TagTable table;
+  TEST_ASSERT_TRUE(table.put(makeRecord(0x11223344)));
+  TEST_ASSERT_TRUE(holds(table, 0x11223344));
+  TEST_ASSERT_FALSE(holds(table, 0x11223345));
+
+  VehicleRecord changed = makeRecord(0x11223344);
+  strcpy(changed.plateNo, "NEW 123");
+  TEST_ASSERT_TRUE(table.put(changed));
+  TEST_ASSERT_EQUAL(1, table.count());
+
+  TagInfo info;
+  TEST_ASSERT_TRUE(table.lookup(0x11223344, info));
+  TEST_ASSERT_EQUAL_STRING("NEW 123", info.plateNo);
+}
+
+// A chain that starts in the last bucket and wraps to the front. Erasing
+// from the middle of it must pull later members back, including one whose
+// home is past the hole, or lookups stop at the hole.
+void test_erase_shifts_wrapped_chain_back()
+{
+  TagTable table;
+  TEST_ASSERT_TRUE(table.put(makeRecord(1000)));
+  TEST_ASSERT_EQUAL(16, table.capacity());
+  TEST_ASSERT_TRUE(table.remove(1000));
+  const uint8_t bits = 5; // 32 buckets for 16 entries
+
+  uint32_t chain[4];
+  chain[0] = tagWithHome(0x100, 31, bits);
+  for (int i = 1; i < 4; i++)
+    chain[i] = tagWithHome(chain[i - 1], 31, bits);
+  uint32_t front = tagWithHome(0x100, 0, bits);
+  uint32_t second = tagWithHome(0x100, 1, bits);
+
+  // Buckets 31, 0, 1, 2 hold the chain; front and second probe on past it
+  for (int i = 0; i < 4; i++)
+    TEST_ASSERT_TRUE(table.put(makeRecord(chain[i])));
+  TEST_ASSERT_TRUE(table.put(makeRecord(front)));
+  TEST_ASSERT_TRUE(table.put(makeRecord(second)));
+  TEST_ASSERT_EQUAL(16, table.capacity());
+
+  TEST_ASSERT_TRUE(table.remove(chain[0]));
+  TEST_ASSERT_FALSE(holds(table, chain[0]));
+  for (int i = 1; i < 4; i++)
+    TEST_ASSERT_TRUE(holds(table, chain[i]));
+  TEST_ASSERT_TRUE(holds(table, front));
+  TEST_ASSERT_TRUE(holds(table, second));
+
+  TEST_ASSERT_TRUE(table.remove(chain[2]));
+  TEST_ASSERT_TRUE(table.remove(front));
+  TEST_ASSERT_TRUE(holds(table, chain[1]));
+  TEST_ASSERT_TRUE(holds(table, chain[3]));
+  TEST_ASSERT_TRUE(holds(table, second));
+  TEST_ASSERT_FALSE(table.remove(front));
+  TEST_ASSERT_EQUAL(3, table.count());
+}
+
+// Random puts and removes against std::map, through several grows
+void test_matches_map_under_churn()
+{
+  TagTable table;
+  std::map<uint32_t, bool> expected;
+  uint32_t pool[700];
+  for (size_t i = 0; i < 700; i++)
+    pool[i] = random32() | 0x10; // never 0
+
+  for (int op = 0; op < 20000; op++)
+  {
+    uint32_t tag = pool[random32() % 700];
+    if (random32() % 3 == 0)
+    {
+      TEST_ASSERT_EQUAL(expected.erase(tag) == 1, table.remove(tag));
+    }
+    else
+    {
+      TEST_ASSERT_TRUE(table.put(makeRecord(tag)));
+      expected[tag] = true;
+    }
+    TEST_ASSERT_EQUAL(expected.size(), table.count());
+
+    if (op % 1000 == 999)
+    {
+      for (size_t i = 0; i < 700; i++)
+        TEST_ASSERT_EQUAL(expected.count(pool[i]) == 1, holds(table, pool[i]));
+    }
+  }
+}
+
+void test_clear_keeps_capacity()
+{
+  TagTable table;
+  for (uint32_t tag = 1; tag <= 40; tag++)
+    TEST_ASSERT_TRUE(table.put(makeRecord(tag + 100)));
+  uint16_t capacity = table.capacity();
+
+  table.clear();
+  TEST_ASSERT_EQUAL(0, table.count());
+  TEST_ASSERT_EQUAL(capacity, table.capacity());
+  TEST_ASSERT_FALSE(holds(table, 101));
+  TEST_ASSERT_TRUE(table.put(makeRecord(101)));
+  TEST_ASSERT_TRUE(holds(table, 101));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_put_lookup_update);
+  RUN_TEST(test_erase_shifts_wrapped_chain_back);
+  RUN_TEST(test_matches_map_under_churn);
+  RUN_TEST(test_clear_keeps_capacity);
+  return UNITY_END();
+}
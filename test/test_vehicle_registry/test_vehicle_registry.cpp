@@ -0,0 +1,258 @@
+#include <Arduino.h>
+#include <FS.h>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "vehicle_registry.h"
+
+// ============================================================================
+// VEHICLE REGISTRY
+// ============================================================================
+//
+// Each test gets a fresh directory standing in for the flash partition.
+
+namespace
+{
+char root[] = "/tmp/registry_test.XXXXXX";
+fs::FS *flash = NULL;
+
+const char *REGISTRY_PATH = "/vehicles.bin";
+
+// Header layout on disk, as VehicleRegistry writes it
+const long HEADER_COUNT_OFFSET = 8;
+const long HEADER_TOMBSTONES_OFFSET = 10;
+
+std::string hostPath(const char *path)
+{
+  return std::string(root) + path;
+}
+
+size_t fileSize(const char *path)
+{
+  FILE *file = fopen(hostPath(path).c_str(), "rb");
+  if (file == NULL)
+    return 0;
+  fseek(file, 0, SEEK_END);
+  size_t size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+uint16_t readHeaderField(long offset)
+{
+  uint16_t value = 0;
+  FILE *file = fopen(hostPath(REGISTRY_PATH).c_str(), "rb");
+  TEST_ASSERT_NOT_NULL(file);
+  fseek(file, offset, SEEK_SET);
+  TEST_ASSERT_EQUAL(1, fread(&value, sizeof(value), 1, file));
+  fclose(file);
+  return value;
+}
+
+void writeHeaderField(long offset, uint16_t value)
+{
+  FILE *file = fopen(hostPath(REGISTRY_PATH).c_str(), "r+b");
+  TEST_ASSERT_NOT_NULL(file);
+  fseek(file, offset, SEEK_SET);
+  TEST_ASSERT_EQUAL(1, fwrite(&value, sizeof(value), 1, file));
+  fclose(file);
+}
+
+VehicleRecord makeRecord(uint32_t tag)
+{
+  VehicleRecord record = {};
+  record.tag = tag;
+  snprintf(record.plateNo, sizeof(record.plateNo), "P%08X", (unsigned)tag);
+  strcpy(record.type, "Car");
+  return record;
+}
+
+bool holds(VehicleRegistry &registry, uint32_t tag)
+{
+  VehicleRecord record;
+  if (!registry.get(tag, record))
+    return false;
+  VehicleRecord expected = makeRecord(tag);
+  TEST_ASSERT_EQUAL_HEX32(tag, record.tag);
+  TEST_ASSERT_EQUAL_STRING(expected.plateNo, record.plateNo);
+  return true;
+}
+
+std::vector<uint32_t> walk(VehicleRegistry &registry)
+{
+  std::vector<uint32_t> tags;
+  VehicleRecord record;
+  uint16_t cursor = 0;
+  while (registry.next(cursor, record))
+    tags.push_back(record.tag);
+  return tags;
+}
+} // namespace
+
+void setUp()
+{
+  strcpy(root, "/tmp/registry_test.XXXXXX");
+  TEST_ASSERT_NOT_NULL(mkdtemp(root));
+  flash = new fs::FS(root);
+}
+
+void tearDown()
+{
+  delete flash;
+  flash = NULL;
+  std::string command = std::string("rm -rf ") + root;
+  system(command.c_str());
+}
+
+// ============================================================================
+// TESTS
+// ============================================================================
+
+void test_put_get_remove()
+{
+  VehicleRegistry registry;
+  TEST_ASSERT_TRUE(registry.begin(*flash, REGISTRY_PATH));
+
+  bool created = false;
+  TEST_ASSERT_TRUE(registry.put(makeRecord(0xA1), &created));
+  TEST_ASSERT_TRUE(created);
+  TEST_ASSERT_TRUE(registry.put(makeRecord(0xA1), &created));
+  TEST_ASSERT_FALSE(created);
+  TEST_ASSERT_EQUAL(1, registry.count());
+
+  TEST_ASSERT_TRUE(holds(registry, 0xA1));
+  TEST_ASSERT_TRUE(registry.remove(0xA1));
+  TEST_ASSERT_FALSE(registry.remove(0xA1));
+  TEST_ASSERT_FALSE(registry.contains(0xA1));
+  TEST_ASSERT_TRUE(registry.sync());
+}
+
+// A removed slot is the next one filled, so the file does not grow
+void test_free_slot_is_reused()
+{
+  VehicleRegistry registry;
+  TEST_ASSERT_TRUE(registry.begin(*flash, REGISTRY_PATH));
+  TEST_ASSERT_TRUE(registry.put(makeRecord(0xA)));
+  TEST_ASSERT_TRUE(registry.put(makeRecord(0xB)));
+  TEST_ASSERT_TRUE(registry.put(makeRecord(0xC)));
+  TEST_ASSERT_TRUE(registry.sync());
+  size_t size = fileSize(REGISTRY_PATH);
+
+  TEST_ASSERT_TRUE(registry.remove(0xB));
+  TEST_ASSERT_TRUE(registry.put(makeRecord(0xD)));
+  TEST_ASSERT_TRUE(registry.sync());
+  TEST_ASSERT_EQUAL(size, fileSize(REGISTRY_PATH));
+
+  std::vector<uint32_t> order = walk(registry);
+  TEST_ASSERT_EQUAL(3, order.size());
+  TEST_ASSERT_EQUAL_HEX32(0xA, order[0]);
+  TEST_ASSERT_EQUAL_HEX32(0xD, order[1]);
+  TEST_ASSERT_EQUAL_HEX32(0xC, order[2]);
+}
+
+// Enough removes to pass the tombstone limit rehash the index; everything
+// still resolves, before and after reopening
+void test_tombstones_trigger_rebuild()
+{
+  std::set<uint32_t> expected;
+  {
+    VehicleRegistry registry;
+    TEST_ASSERT_TRUE(registry.begin(*flash, REGISTRY_PATH));
+
+    uint32_t next = 1;
+    for (int round = 0; round < 6; round++)
+    {
+      while (expected.size() < 900)
+      {
+        uint32_t tag = 0x5000 + next++ * 7;
+        TEST_ASSERT_TRUE(registry.put(makeRecord(tag)));
+        expected.insert(tag);
+      }
+      // Drop every other tag still registered
+      bool drop = true;
+      for (std::set<uint32_t>::iterator it = expected.begin(); it != expected.end();)
+      {
+        if (drop)
+        {
+          TEST_ASSERT_TRUE(registry.remove(*it));
+          expected.erase(it++);
+        }
+        else
+        {
+          ++it;
+        }
+        drop = !drop;
+      }
+      TEST_ASSERT_TRUE(registry.sync());
+      TEST_ASSERT_TRUE(readHeaderField(HEADER_TOMBSTONES_OFFSET) <= REGISTRY_BUCKETS / 4);
+    }
+
+    TEST_ASSERT_EQUAL(expected.size(), registry.count());
+    for (std::set<uint32_t>::iterator it = expected.begin(); it != expected.end(); ++it)
+      TEST_ASSERT_TRUE(holds(registry, *it));
+    TEST_ASSERT_FALSE(registry.contains(0x5000 + 7));
+  }
+
+  VehicleRegistry registry;
+  TEST_ASSERT_TRUE(registry.begin(*flash, REGISTRY_PATH));
+  TEST_ASSERT_EQUAL(expected.size(), registry.count());
+  TEST_ASSERT_EQUAL(expected.size(), walk(registry).size());
+  for (std::set<uint32_t>::iterator it = expected.begin(); it != expected.end(); ++it)
+    TEST_ASSERT_TRUE(holds(registry, *it));
+}
+
+// A header left stale by a failed write is rebuilt from the slots
+void test_stale_header_is_repaired()
+{
+  {
+    VehicleRegistry registry;
+    TEST_ASSERT_TRUE(registry.begin(*flash, REGISTRY_PATH));
+    for (uint32_t tag = 1; tag <= 20; tag++)
+      TEST_ASSERT_TRUE(registry.put(makeRecord(tag * 11)));
+    TEST_ASSERT_TRUE(registry.remove(5 * 11));
+    TEST_ASSERT_TRUE(registry.sync());
+  }
+  writeHeaderField(HEADER_COUNT_OFFSET, 3);
+
+  VehicleRegistry registry;
+  TEST_ASSERT_TRUE(registry.begin(*flash, REGISTRY_PATH));
+  TEST_ASSERT_EQUAL(19, registry.count());
+  TEST_ASSERT_EQUAL(19, readHeaderField(HEADER_COUNT_OFFSET));
+  for (uint32_t tag = 1; tag <= 20; tag++)
+    TEST_ASSERT_EQUAL(tag != 5, holds(registry, tag * 11));
+
+  // The freed slot is still on the free list
+  size_t size = fileSize(REGISTRY_PATH);
+  TEST_ASSERT_TRUE(registry.put(makeRecord(0xFEED)));
+  TEST_ASSERT_TRUE(registry.sync());
+  TEST_ASSERT_EQUAL(size, fileSize(REGISTRY_PATH));
+}
+
+void test_clear_empties_file()
+{
+  VehicleRegistry registry;
+  TEST_ASSERT_TRUE(registry.begin(*flash, REGISTRY_PATH));
+  for (uint32_t tag = 1; tag <= 5; tag++)
+    TEST_ASSERT_TRUE(registry.put(makeRecord(tag)));
+
+  uint16_t removed = 0;
+  TEST_ASSERT_TRUE(registry.clear(&removed));
+  TEST_ASSERT_EQUAL(5, removed);
+  TEST_ASSERT_EQUAL(0, registry.count());
+  TEST_ASSERT_EQUAL(0, walk(registry).size());
+  TEST_ASSERT_TRUE(registry.put(makeRecord(3)));
+  TEST_ASSERT_TRUE(holds(registry, 3));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_put_get_remove);
+  RUN_TEST(test_free_slot_is_reused);
+  RUN_TEST(test_tombstones_trigger_rebuild);
+  RUN_TEST(test_stale_header_is_repaired);
+  RUN_TEST(test_clear_empties_file);
+  return UNITY_END();
+}
@@ -0,0 +1,272 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <string>
+#include <unity.h>
+#include <vector>
+
+#include "json_stream.h"
+#include "wire_format.h"
+
+// ============================================================================
+// WIRE FORMAT
+// ============================================================================
+
+namespace
+{
+class VectorPrint : public Print
+{
+public:
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *data, size_t len) override
+  {
+    bytes.insert(bytes.end(), data, data + len);
+    return len;
+  }
+
+  std::vector<uint8_t> bytes;
+};
+
+void assertBytes(const std::vector<uint8_t> &expected, const std::vector<uint8_t> &actual)
+{
+  TEST_ASSERT_EQUAL(expected.size(), actual.size());
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected.data(), actual.data(), expected.size());
+}
+
+// Everything a stream writes, pulled in small chunks the way the server does
+std::string drain(JsonArrayStream &stream)
+{
+  std::string out;
+  uint8_t chunk[37];
+  size_t written;
+  while ((written = stream.fill(chunk, sizeof(chunk))) > 0)
+    out.append((const char *)chunk, written);
+  return out;
+}
+
+// Two rows of one shape, then one of another
+JsonRowSource threeRows()
+{
+  int *index = new int(0);
+  return [index](JsonObject row)
+  {
+    switch ((*index)++)
+    {
+    case 0:
+      row["rfid"] = "0A1B2C3D";
+      row["plateNo"] = "ABC 123";
+      return JSON_ROW_READY;
+    case 1:
+      row["rfid"] = "0A1B2C3E";
+      row["plateNo"] = "Say \"hi\"";
+      return JSON_ROW_READY;
+    case 2:
+      row["rfid"] = "0A1B2C3F";
+      row["seq"] = 300;
+      return JSON_ROW_READY;
+    default:
+      delete index;
+      return JSON_ROW_END;
+    }
+  };
+}
+
+void expectString(MsgPackReader &reader, const char *text)
+{
+  MsgPackToken token;
+  TEST_ASSERT_TRUE(reader.next(token));
+  TEST_ASSERT_EQUAL(MSGPACK_STRING, token.type);
+  TEST_ASSERT_EQUAL(strlen(text), token.value);
+  TEST_ASSERT_EQUAL_MEMORY(text, token.text, token.value);
+}
+
+void expectToken(MsgPackReader &reader, MsgPackType type, uint32_t value)
+{
+  MsgPackToken token;
+  TEST_ASSERT_TRUE(reader.next(token));
+  TEST_ASSERT_EQUAL(type, token.type);
+  TEST_ASSERT_EQUAL_UINT32(value, token.value);
+}
+} // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================================================
+// TESTS
+// ============================================================================
+
+void test_integers_use_smallest_form()
+{
+  VectorPrint out;
+  MsgPackWriter writer(out);
+  writer.integer(0x7F);
+  writer.integer(0x80);
+  writer.integer(0xFFFF);
+  writer.integer(0x10000);
+  assertBytes({0x7F,
+               0xCC, 0x80,
+               0xCD, 0xFF, 0xFF,
+               0xCE, 0x00, 0x01, 0x00, 0x00},
+              out.bytes);
+}
+
+void test_string_headers()
+{
+  VectorPrint out;
+  MsgPackWriter writer(out);
+  std::string s31(31, 'a'), s32(32, 'b'), s256(256, 'c');
+  writer.string("");
+  writer.string(s31.c_str());
+  writer.string(s32.c_str());
+  writer.string(s256.c_str());
+
+  TEST_ASSERT_EQUAL(1 + (1 + 31) + (2 + 32) + (3 + 256), out.bytes.size());
+  TEST_ASSERT_EQUAL_HEX8(0xA0, out.bytes[0]);
+  TEST_ASSERT_EQUAL_HEX8(0xBF, out.bytes[1]);
+  TEST_ASSERT_EQUAL_HEX8(0xD9, out.bytes[33]);
+  TEST_ASSERT_EQUAL_HEX8(32, out.bytes[34]);
+  TEST_ASSERT_EQUAL_HEX8(0xDA, out.bytes[67]);
+  TEST_ASSERT_EQUAL_HEX8(0x01, out.bytes[68]);
+  TEST_ASSERT_EQUAL_HEX8(0x00, out.bytes[69]);
+}
+
+void test_container_headers()
+{
+  VectorPrint out;
+  MsgPackWriter writer(out);
+  writer.array(15);
+  writer.array(16);
+  writer.map(5);
+  writer.map(300);
+  writer.boolean(true);
+  writer.boolean(false);
+  assertBytes({0x9F,
+               0xDC, 0x00, 0x10,
+               0x85,
+               0xDE, 0x01, 0x2C,
+               0xC3, 0xC2},
+              out.bytes);
+}
+
+void test_reader_round_trip()
+{
+  VectorPrint out;
+  MsgPackWriter writer(out);
+  std::string s40(40, 'x');
+  writer.map(2);
+  writer.string("n");
+  writer.integer(70000);
+  writer.string(s40.c_str());
+  writer.array(2);
+  writer.boolean(true);
+  out.write((uint8_t)0xC0);
+
+  MsgPackReader reader(out.bytes.data(), out.bytes.size());
+  expectToken(reader, MSGPACK_MAP, 2);
+  expectString(reader, "n");
+  expectToken(reader, MSGPACK_UINT, 70000);
+  expectString(reader, s40.c_str());
+  expectToken(reader, MSGPACK_ARRAY, 2);
+  expectToken(reader, MSGPACK_BOOL, 1);
+  expectToken(reader, MSGPACK_NIL, 0);
+  TEST_ASSERT_TRUE(reader.atEnd());
+}
+
+// A value cut short is not read, and the reader stays on it
+void test_reader_stops_at_truncated_value()
+{
+  const uint8_t data[] = {0x01, 0xA5, 'a', 'b', 'c'};
+  MsgPackReader reader(data, sizeof(data));
+  MsgPackToken token;
+  expectToken(reader, MSGPACK_UINT, 1);
+  TEST_ASSERT_FALSE(reader.next(token));
+  TEST_ASSERT_FALSE(reader.next(token));
+  TEST_ASSERT_FALSE(reader.atEnd());
+
+  const uint8_t shortInt[] = {0xCD, 0x01};
+  MsgPackReader intReader(shortInt, sizeof(shortInt));
+  TEST_ASSERT_FALSE(intReader.next(token));
+
+  const uint8_t unknown[] = {0xCA, 0, 0, 0, 0}; // float32
+  MsgPackReader floatReader(unknown, sizeof(unknown));
+  TEST_ASSERT_FALSE(floatReader.next(token));
+}
+
+void test_stream_json()
+{
+  JsonArrayStream stream(threeRows());
+  std::string body = drain(stream);
+  TEST_ASSERT_EQUAL_STRING("[{\"rfid\":\"0A1B2C3D\",\"plateNo\":\"ABC 123\"},"
+                           "{\"rfid\":\"0A1B2C3E\",\"plateNo\":\"Say \\\"hi\\\"\"},"
+                           "{\"rfid\":\"0A1B2C3F\",\"seq\":300}]",
+                           body.c_str());
+}
+
+void test_stream_empty_list()
+{
+  JsonArrayStream json([](JsonObject row)
+                       { return JSON_ROW_END; });
+  std::string body = drain(json);
+  TEST_ASSERT_EQUAL_STRING("[]", body.c_str());
+
+  JsonArrayStream msgpack([](JsonObject row)
+                          { return JSON_ROW_END; },
+                          WIRE_FORMAT_MSGPACK);
+  TEST_ASSERT_EQUAL(0, drain(msgpack).size());
+}
+
+// Column names once, then values; a row of another shape goes as a map
+void test_stream_msgpack()
+{
+  JsonArrayStream stream(threeRows(), WIRE_FORMAT_MSGPACK);
+  std::string body = drain(stream);
+  MsgPackReader reader((const uint8_t *)body.data(), body.size());
+
+  expectToken(reader, MSGPACK_ARRAY, 2);
+  expectString(reader, "rfid");
+  expectString(reader, "plateNo");
+
+  expectToken(reader, MSGPACK_ARRAY, 2);
+  expectString(reader, "0A1B2C3D");
+  expectString(reader, "ABC 123");
+
+  expectToken(reader, MSGPACK_ARRAY, 2);
+  expectString(reader, "0A1B2C3E");
+  expectString(reader, "Say \"hi\"");
+
+  expectToken(reader, MSGPACK_MAP, 2);
+  expectString(reader, "rfid");
+  expectString(reader, "0A1B2C3F");
+  expectString(reader, "seq");
+  expectToken(reader, MSGPACK_UINT, 300);
+
+  TEST_ASSERT_TRUE(reader.atEnd());
+}
+
+void test_row_shape_follows_names_and_order()
+{
+  StaticJsonDocument<256> a, b, c;
+  a["rfid"] = "1";
+  a["plateNo"] = "2";
+  b["rfid"] = "x";
+  b["plateNo"] = "y";
+  c["plateNo"] = "2";
+  c["rfid"] = "1";
+  TEST_ASSERT_EQUAL_HEX32(rowShape(a.as<JsonObjectConst>()), rowShape(b.as<JsonObjectConst>()));
+  TEST_ASSERT_TRUE(rowShape(a.as<JsonObjectConst>()) != rowShape(c.as<JsonObjectConst>()));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_integers_use_smallest_form);
+  RUN_TEST(test_string_headers);
+  RUN_TEST(test_container_headers);
+  RUN_TEST(test_reader_round_trip);
+  RUN_TEST(test_reader_stops_at_truncated_value);
+  RUN_TEST(test_stream_json);
+  RUN_TEST(test_stream_empty_list);
+  RUN_TEST(test_stream_msgpack);
+  RUN_TEST(test_row_shape_follows_names_and_order);
+  return UNITY_END();
+}
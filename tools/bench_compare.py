@@ -0,0 +1,97 @@
+"""Compares two runs of the benchmark suite.
+
+Each run is the suite's output saved to a file: the host program's stdout
+(env:native-bench) or a serial capture from the device (env:esp32dev-bench).
+Lines that are not result objects, such as boot messages, are ignored.
+
+Results are matched on benchmark name and size and compared on the fastest
+round (minNsPerOp), which is the figure least disturbed by whatever else the
+machine was doing; --metric picks another field, e.g. cyclesPerOp for two
+device runs. A result more than --threshold percent slower than the baseline
+is a regression, and the exit status is 1 if there is any.
+
+    python tools/bench_compare.py baseline.jsonl current.jsonl [--threshold 10] [--metric nsPerOp]
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    header = {}
+    results = {}
+    with open(path, "r", errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith("{"):
+                continue
+            try:
+                entry = json.loads(line)
+            except ValueError:
+                continue
+            if "suite" in entry:
+                header = entry
+            elif "bench" in entry:
+                results[(entry["bench"], entry.get("n", 0))] = entry
+    return header, results
+
+
+def cost(entry, metric):
+    return entry.get(metric)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two benchmark runs")
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="percent slowdown counted as a regression (default 10)")
+    parser.add_argument("--metric", default="minNsPerOp",
+                        choices=["minNsPerOp", "nsPerOp", "cyclesPerOp"],
+                        help="result field to compare (default minNsPerOp)")
+    args = parser.parse_args()
+
+    base_header, base = load(args.baseline)
+    current_header, current = load(args.current)
+    if not base or not current:
+        sys.exit("bench_compare: no results in %s" % (args.baseline if not base else args.current))
+
+    print("baseline: %s on %s" % (base_header.get("version", "?"), base_header.get("platform", "?")))
+    print("current:  %s on %s" % (current_header.get("version", "?"), current_header.get("platform", "?")))
+    print()
+    print("%-20s %6s %14s %14s %9s" % ("bench", "n", "baseline", "current", "change"))
+
+    regressions = 0
+    for key in sorted(set(base) | set(current)):
+        name, n = key
+        old = base.get(key)
+        new = current.get(key)
+        if old is None or new is None:
+            print("%-20s %6d %s" % (name, n, "only in " + ("current" if old is None else "baseline")))
+            continue
+
+        old_cost = cost(old, args.metric)
+        new_cost = cost(new, args.metric)
+        if old_cost is None or new_cost is None:
+            print("%-20s %6d %s" % (name, n, "skipped" if "skipped" in old or "skipped" in new
+                                    else "no " + args.metric))
+            continue
+
+        change = (new_cost - old_cost) * 100.0 / old_cost if old_cost > 0 else 0.0
+        unit = "cyc" if args.metric == "cyclesPerOp" else "ns"
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print("%-20s %6d %10.1f %-3s %10.1f %-3s %+8.1f%%%s"
+              % (name, n, old_cost, unit, new_cost, unit, change, flag))
+
+    if regressions:
+        print()
+        print("%d regression(s) over %.0f%%" % (regressions, args.threshold))
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,25 @@
+"""Stamps benchmark builds with the source revision.
+
+Runs as a PlatformIO pre-build script for the bench environments (see
+extra_scripts in platformio.ini) and defines BENCH_VERSION as the output of
+`git describe --always --dirty`. The suite prints it in its first line, so a
+saved run says which firmware it measured.
+"""
+
+import subprocess
+
+
+def describe(root):
+    try:
+        output = subprocess.check_output(
+            ["git", "describe", "--always", "--dirty"],
+            cwd=root, stderr=subprocess.DEVNULL)
+        return output.decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+Import("env")  # noqa: F821 (provided by PlatformIO)
+
+version = describe(env.subst("$PROJECT_DIR"))  # noqa: F821
+env.Append(CPPDEFINES=[("BENCH_VERSION", env.StringifyMacro(version))])  # noqa: F821
@@ -0,0 +1,147 @@
+"""Compiles the web UI in data/ into the firmware.
+
+Runs as a PlatformIO pre-build script (see extra_scripts in platformio.ini)
+and writes src/web_assets.cpp: every file gzipped and stored as a const
+byte array, plus the route table AssetHandler serves from. The arrays
+stay in flash and are sent from there, so the dashboard needs no filesystem
+image at all.
+
+Sources are not minified. Whitespace costs little once gzipped, and
+stripping lines as text breaks multi-line template literals.
+
+Stylesheets, scripts and icons get a content hash in their URL, and the
+pages' references to them are rewritten to match, so a changed file gets a
+new URL and the old one can be cached forever.
+
+The filesystem image is left empty; LittleFS only holds the registry and
+the pass log, which the firmware creates itself.
+
+Can also be run by hand: python tools/build_assets.py data src/web_assets.cpp
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import shutil
+import sys
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".svg": "image/svg+xml",
+}
+HASHED = (".css", ".js", ".svg")
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()[:8]
+
+
+def compress(data):
+    # Fixed mtime so unchanged sources give byte-identical output
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def rewrite_references(page, renames):
+    for name, hashed in renames.items():
+        pattern = r'((?:href|src)=")/?' + re.escape(name) + '"'
+        page = re.sub(pattern, r"\g<1>/" + hashed + '"', page)
+    return page
+
+
+def symbol(name):
+    return re.sub(r"[^A-Z0-9]", "_", name.upper())
+
+
+def byte_array(name, data):
+    rows = []
+    for i in range(0, len(data), 16):
+        rows.append("  " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "const uint8_t %s[] = {\n%s\n};\n" % (name, "\n".join(rows))
+
+
+def build(src, dst):
+    sources = {}
+    for name in sorted(os.listdir(src)):
+        ext = os.path.splitext(name)[1]
+        if ext not in CONTENT_TYPES:
+            print("build_assets: skipping %s" % name)
+            continue
+        with open(os.path.join(src, name), "r", encoding="utf-8") as f:
+            sources[name] = f.read()
+
+    # Hashed files first, so the pages can point at their new names
+    renames = {}
+    for name, text in sources.items():
+        stem, ext = os.path.splitext(name)
+        if ext in HASHED:
+            renames[name] = "%s.%s%s" % (stem, content_hash(text.encode("utf-8")), ext)
+
+    arrays = []
+    routes = []
+    raw = packed = 0
+    for name, text in sources.items():
+        ext = os.path.splitext(name)[1]
+        if ext == ".html":
+            text = rewrite_references(text, renames)
+        data = text.encode("utf-8")
+        body = compress(data)
+        raw += len(data)
+        packed += len(body)
+
+        served = renames.get(name, name)
+        array = symbol(served)
+        arrays.append(byte_array(array, body))
+
+        route = '  {"%%s", "%s", "\\"%s\\"", %s, sizeof(%s), %s},' % (
+            CONTENT_TYPES[ext], content_hash(data), array, array,
+            "true" if name in renames else "false")
+        routes.append(route % ("/" + served))
+        if name == "index.html":
+            routes.append(route % "/")
+
+    source = (
+        "// Generated by tools/build_assets.py from data/. Do not edit.\n"
+        "\n"
+        '#include "web_assets.h"\n'
+        "\n"
+        "namespace\n"
+        "{\n"
+        + "\n".join(arrays)
+        + "} // namespace\n"
+        "\n"
+        "const WebAsset WEB_ASSETS[] = {\n"
+        + "\n".join(routes)
+        + "\n};\n"
+        "const size_t WEB_ASSET_COUNT = sizeof(WEB_ASSETS) / sizeof(WEB_ASSETS[0]);\n"
+    )
+
+    # Leave the file alone when nothing changed, so it is not recompiled
+    current = None
+    if os.path.exists(dst):
+        with open(dst, "r") as f:
+            current = f.read()
+    if source != current:
+        with open(dst, "w") as f:
+            f.write(source)
+
+    print("build_assets: %d files, %d -> %d bytes" % (len(sources), raw, packed))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        sys.exit("usage: build_assets.py <data dir> <output .cpp>")
+    build(sys.argv[1], sys.argv[2])
+else:
+    Import("env")  # noqa: F821 (provided by PlatformIO)
+
+    build(env.subst("$PROJECT_DATA_DIR"),  # noqa: F821
+          os.path.join(env.subst("$PROJECT_SRC_DIR"), "web_assets.cpp"))  # noqa: F821
+
+    # Nothing from data/ belongs in the filesystem image any more
+    empty = os.path.join(env.subst("$BUILD_DIR"), "data")  # noqa: F821
+    shutil.rmtree(empty, ignore_errors=True)
+    os.makedirs(empty)
+    env.Replace(PROJECT_DATA_DIR=empty)  # noqa: F821
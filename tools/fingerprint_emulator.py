@@ -0,0 +1,486 @@
+"""Emulates an R30x fingerprint sensor on a serial line, for testing off-hardware.
+
+Speaks the sensor's packet protocol (what Adafruit_Fingerprint sends) on a
+pseudo-terminal, or on a real serial port such as a USB adapter wired to
+the gate's sensor pins. The host build connects with -f:
+
+    python tools/fingerprint_emulator.py --link /tmp/fingerprint
+    .pio/build/native/program -f /tmp/fingerprint
+
+Templates live in --templates (a JSON file), so enrollments survive a
+restart, and --enrolled fills a new library so /fp/list has something to
+list. Every command waits for its --latency before answering, to match a
+real module or to push it past the library's 1 s reply timeout. --fail
+makes a command answer with an error code, or not at all, at a given rate.
+
+The finger is simulated: once the firmware starts polling for an image, a
+finger lands after --place-delay ms, stays --hold ms after the first good
+image and is lifted again, which is what an enrollment expects. Each
+placement is one of --fingers different fingers; the same finger returns
+until a template is stored or searched for, then the next "person" steps
+up.
+
+On exit (Ctrl-C) a table of commands served, injected failures and
+latencies is printed.
+
+    --latency getImage=150 --latency image2Tz=400
+    --fail createModel=0.1:0x0A --fail storeModel=0.05 --fail all=0.01:drop
+"""
+
+import argparse
+import json
+import os
+import random
+import select
+import signal
+import sys
+import termios
+import time
+import tty
+
+START_CODE = b"\xEF\x01"
+COMMAND_PACKET = 0x01
+ACK_PACKET = 0x07
+
+OK = 0x00
+PACKET_ERROR = 0x01
+NO_FINGER = 0x02
+IMAGE_FAIL = 0x03
+IMAGE_MESSY = 0x06
+NO_MATCH = 0x08
+NOT_FOUND = 0x09
+ENROLL_MISMATCH = 0x0A
+BAD_LOCATION = 0x0B
+READ_TEMPLATE_ERROR = 0x0C
+DELETE_FAIL = 0x10
+CLEAR_FAIL = 0x11
+WRONG_PASSWORD = 0x13
+FLASH_ERROR = 0x18
+
+# Instruction code: (Adafruit_Fingerprint method, default latency ms, default failure code)
+COMMANDS = {
+    0x01: ("getImage", 100, IMAGE_FAIL),
+    0x02: ("image2Tz", 300, IMAGE_MESSY),
+    0x03: ("match", 50, NO_MATCH),
+    0x04: ("fingerSearch", 150, NOT_FOUND),
+    0x05: ("createModel", 100, ENROLL_MISMATCH),
+    0x06: ("storeModel", 60, FLASH_ERROR),
+    0x07: ("loadModel", 40, READ_TEMPLATE_ERROR),
+    0x0C: ("deleteModel", 60, DELETE_FAIL),
+    0x0D: ("emptyDatabase", 200, CLEAR_FAIL),
+    0x0F: ("getParameters", 10, PACKET_ERROR),
+    0x13: ("verifyPassword", 10, WRONG_PASSWORD),
+    0x1B: ("fingerFastSearch", 100, NOT_FOUND),
+    0x1D: ("getTemplateCount", 10, PACKET_ERROR),
+    0x1F: ("readIndexTable", 20, PACKET_ERROR),
+}
+COMMAND_CODES = {name: code for code, (name, _, _) in COMMANDS.items()}
+
+INDEX_PAGE_SLOTS = 256
+BAUD_RATES = {9600: termios.B9600, 19200: termios.B19200, 38400: termios.B38400,
+              57600: termios.B57600, 115200: termios.B115200}
+
+
+# ============================================================================
+# SENSOR
+# ============================================================================
+
+class Finger:
+    """The simulated finger: lands when polled for, lifts after an image."""
+
+    def __init__(self, args, rng):
+        self.place_delay = args.place_delay / 1000.0
+        self.hold = args.hold / 1000.0
+        self.population = args.fingers
+        self.rng = rng
+        self.identity = rng.randrange(self.population)
+        self.present = False
+        self.waiting_since = None
+        self.captured_at = None
+
+    def poll(self):
+        """Called for every getImage; returns True while a finger is on."""
+        now = time.monotonic()
+        if self.present:
+            if now - self.captured_at >= self.hold:
+                self.present = False
+                self.captured_at = None
+                self.waiting_since = now
+                return False
+            return True
+
+        if self.waiting_since is None:
+            self.waiting_since = now
+        if now - self.waiting_since >= self.place_delay:
+            self.present = True
+            self.waiting_since = None
+            self.captured_at = now
+            return True
+        return False
+
+    def next_person(self):
+        self.identity = self.rng.randrange(self.population)
+
+
+class Sensor:
+    def __init__(self, args):
+        self.args = args
+        self.rng = random.Random(args.seed)
+        self.finger = Finger(args, self.rng)
+        self.capacity = args.capacity
+        self.password = args.password
+        self.image = None
+        self.buffers = {1: None, 2: None}
+        self.templates = self.load_templates()
+
+        self.latency = {code: default for code, (_, default, _) in COMMANDS.items()}
+        for code, ms in args.latency:
+            for target in self.targets(code):
+                self.latency[target] = ms
+        self.failures = {}
+        for code, rate, result in args.fail:
+            for target in self.targets(code):
+                self.failures[target] = (rate, result)
+
+        self.stats = {}
+
+    @staticmethod
+    def targets(code):
+        return list(COMMANDS) if code is None else [code]
+
+    # Templates: slot -> finger identity, kept in a JSON file
+    def load_templates(self):
+        path = self.args.templates
+        if path and os.path.exists(path):
+            with open(path, "r") as f:
+                return {int(slot): finger for slot, finger in json.load(f).items()}
+
+        templates = {}
+        for slot in range(1, min(self.args.enrolled, self.capacity - 1) + 1):
+            templates[slot] = self.rng.randrange(self.args.fingers)
+        return templates
+
+    def save_templates(self):
+        path = self.args.templates
+        if not path:
+            return
+        temp = path + ".tmp"
+        with open(temp, "w") as f:
+            json.dump({str(slot): finger for slot, finger in sorted(self.templates.items())}, f)
+        os.replace(temp, path)
+
+    def handle(self, code, params):
+        """Returns (confirmation code, extra reply bytes), or None for no reply."""
+        name = COMMANDS[code][0] if code in COMMANDS else "0x%02X" % code
+        entry = self.stats.setdefault(name, {"count": 0, "failed": 0, "injected": 0, "ms": 0.0})
+        entry["count"] += 1
+        started = time.monotonic()
+
+        time.sleep(self.latency.get(code, 0) / 1000.0)
+
+        rate, result = self.failures.get(code, (0.0, None))
+        if rate > 0 and self.rng.random() < rate:
+            entry["injected"] += 1
+            reply = None if result == "drop" else (COMMANDS[code][2] if result is None else result, b"")
+        else:
+            handler = getattr(self, "cmd_" + name, None)
+            reply = handler(params) if handler is not None else (PACKET_ERROR, b"")
+
+        # No finger is the normal answer while waiting, not an error
+        if reply is None or reply[0] not in (OK, NO_FINGER):
+            entry["failed"] += 1
+        entry["ms"] += (time.monotonic() - started) * 1000.0
+        if self.args.verbose:
+            print("  %-16s %s" % (name, "no reply" if reply is None else "-> 0x%02X" % reply[0]))
+        return reply
+
+    # -- commands ------------------------------------------------------------
+
+    def cmd_verifyPassword(self, params):
+        if len(params) < 4 or int.from_bytes(params[:4], "big") != self.password:
+            return WRONG_PASSWORD, b""
+        return OK, b""
+
+    def cmd_getParameters(self, params):
+        return OK, b"".join([
+            (0).to_bytes(2, "big"),              # status register
+            (0x0009).to_bytes(2, "big"),         # system identifier
+            self.capacity.to_bytes(2, "big"),
+            (3).to_bytes(2, "big"),              # security level
+            (0xFFFFFFFF).to_bytes(4, "big"),     # device address
+            (2).to_bytes(2, "big"),              # packet size: 128 bytes
+            (self.args.baud // 9600).to_bytes(2, "big"),
+        ])
+
+    def cmd_getTemplateCount(self, params):
+        return OK, len(self.templates).to_bytes(2, "big")
+
+    def cmd_readIndexTable(self, params):
+        page = params[0] if params else 0
+        table = bytearray(INDEX_PAGE_SLOTS // 8)
+        for slot in self.templates:
+            offset = slot - page * INDEX_PAGE_SLOTS
+            if 0 <= offset < INDEX_PAGE_SLOTS:
+                table[offset >> 3] |= 1 << (offset & 7)
+        return OK, bytes(table)
+
+    def cmd_getImage(self, params):
+        if not self.finger.poll():
+            return NO_FINGER, b""
+        self.image = self.finger.identity
+        return OK, b""
+
+    def cmd_image2Tz(self, params):
+        slot = params[0] if params else 1
+        if self.image is None or slot not in self.buffers:
+            return IMAGE_MESSY, b""
+        self.buffers[slot] = self.image
+        return OK, b""
+
+    def cmd_createModel(self, params):
+        if self.buffers[1] is None or self.buffers[1] != self.buffers[2]:
+            return ENROLL_MISMATCH, b""
+        return OK, b""
+
+    def cmd_match(self, params):
+        if self.buffers[1] is None or self.buffers[1] != self.buffers[2]:
+            return NO_MATCH, (0).to_bytes(2, "big")
+        return OK, self.rng.randint(50, 250).to_bytes(2, "big")
+
+    def cmd_storeModel(self, params):
+        slot, location = params[0], int.from_bytes(params[1:3], "big")
+        if location >= self.capacity:
+            return BAD_LOCATION, b""
+        if self.buffers.get(slot) is None:
+            return FLASH_ERROR, b""
+        self.templates[location] = self.buffers[slot]
+        self.save_templates()
+        self.finger.next_person()
+        return OK, b""
+
+    def cmd_loadModel(self, params):
+        slot, location = params[0], int.from_bytes(params[1:3], "big")
+        if location >= self.capacity:
+            return BAD_LOCATION, b""
+        if location not in self.templates or slot not in self.buffers:
+            return READ_TEMPLATE_ERROR, b""
+        self.buffers[slot] = self.templates[location]
+        return OK, b""
+
+    def cmd_deleteModel(self, params):
+        location, count = int.from_bytes(params[0:2], "big"), int.from_bytes(params[2:4], "big")
+        if location + count > self.capacity:
+            return DELETE_FAIL, b""
+        for slot in range(location, location + count):
+            self.templates.pop(slot, None)
+        self.save_templates()
+        return OK, b""
+
+    def cmd_emptyDatabase(self, params):
+        self.templates.clear()
+        self.save_templates()
+        return OK, b""
+
+    def cmd_fingerSearch(self, params):
+        slot = params[0] if params else 1
+        start = int.from_bytes(params[1:3], "big") if len(params) >= 3 else 0
+        count = int.from_bytes(params[3:5], "big") if len(params) >= 5 else self.capacity
+        wanted = self.buffers.get(slot)
+        self.finger.next_person()
+        for location in sorted(self.templates):
+            if start <= location < start + count and self.templates[location] == wanted:
+                return OK, location.to_bytes(2, "big") + self.rng.randint(50, 250).to_bytes(2, "big")
+        return NOT_FOUND, (0).to_bytes(4, "big")
+
+    cmd_fingerFastSearch = cmd_fingerSearch
+
+
+# ============================================================================
+# PACKETS
+# ============================================================================
+
+def checksum(data):
+    return sum(data) & 0xFFFF
+
+
+def ack(address, code, extra):
+    body = bytes([code]) + extra
+    length = (len(body) + 2).to_bytes(2, "big")
+    header = bytes([ACK_PACKET]) + length
+    return START_CODE + address + header + body + checksum(header + body).to_bytes(2, "big")
+
+
+class PacketReader:
+    """Splits the byte stream into (address, type, payload, checksum ok)."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+
+    def feed(self, data):
+        self.buffer += data
+        while True:
+            start = self.buffer.find(START_CODE)
+            if start < 0:
+                del self.buffer[:-1]
+                return
+            del self.buffer[:start]
+            if len(self.buffer) < 9:
+                return
+            length = int.from_bytes(self.buffer[7:9], "big")
+            if len(self.buffer) < 9 + length:
+                return
+
+            address = bytes(self.buffer[2:6])
+            packet_type = self.buffer[6]
+            payload = bytes(self.buffer[9:7 + length])
+            sent = int.from_bytes(self.buffer[7 + length:9 + length], "big")
+            valid = length >= 2 and sent == checksum(self.buffer[6:7 + length])
+            del self.buffer[:9 + length]
+            yield address, packet_type, payload, valid
+
+
+# ============================================================================
+# SERIAL LINE
+# ============================================================================
+
+def open_line(args):
+    """Returns (fd to serve on, path for the firmware, fds to close)."""
+    if args.port:
+        fd = os.open(args.port, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(fd)
+        mode = termios.tcgetattr(fd)
+        speed = BAUD_RATES[args.baud]
+        mode[4] = mode[5] = speed
+        termios.tcsetattr(fd, termios.TCSANOW, mode)
+        return fd, args.port, [fd]
+
+    master, slave = os.openpty()
+    tty.setraw(slave)
+    path = os.ttyname(slave)
+    if args.link:
+        if os.path.lexists(args.link):
+            os.unlink(args.link)
+        os.symlink(path, args.link)
+    # The slave stays open here too, so the master survives the firmware
+    # closing and reopening it
+    return master, args.link or path, [master, slave]
+
+
+def print_stats(sensor):
+    print()
+    print("%-18s %7s %7s %9s %9s" % ("command", "count", "failed", "injected", "avg ms"))
+    for name, entry in sorted(sensor.stats.items()):
+        print("%-18s %7d %7d %9d %9.1f" % (name, entry["count"], entry["failed"], entry["injected"],
+                                          entry["ms"] / entry["count"]))
+    print("%d templates stored" % len(sensor.templates))
+
+
+def serve(args):
+    sensor = Sensor(args)
+    fd, path, fds = open_line(args)
+    reader = PacketReader()
+    address = args.address.to_bytes(4, "big")
+    print("Fingerprint sensor on %s (capacity %d, %d templates)" % (path, sensor.capacity, len(sensor.templates)))
+    sys.stdout.flush()
+
+    stop = []
+    signal.signal(signal.SIGTERM, lambda *_: stop.append(True))
+    try:
+        while not stop:
+            ready, _, _ = select.select([fd], [], [], 0.2)
+            if not ready:
+                continue
+            try:
+                data = os.read(fd, 256)
+            except OSError:
+                continue
+            for packet_address, packet_type, payload, valid in reader.feed(data):
+                if packet_address != address or packet_type != COMMAND_PACKET or not payload:
+                    continue
+                reply = (PACKET_ERROR, b"") if not valid else sensor.handle(payload[0], payload[1:])
+                if reply is not None:
+                    os.write(fd, ack(address, *reply))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        for each in fds:
+            os.close(each)
+        if args.link and not args.port:
+            os.unlink(args.link)
+        print_stats(sensor)
+
+
+# ============================================================================
+# OPTIONS
+# ============================================================================
+
+def command_code(name):
+    if name == "all":
+        return None
+    if name not in COMMAND_CODES:
+        raise argparse.ArgumentTypeError("unknown command %r (one of: all, %s)" % (name, ", ".join(sorted(COMMAND_CODES))))
+    return COMMAND_CODES[name]
+
+
+def parse_latency(text):
+    name, _, ms = text.partition("=")
+    try:
+        return command_code(name), float(ms)
+    except ValueError:
+        raise argparse.ArgumentTypeError("expected COMMAND=MS, e.g. getImage=150")
+
+
+def parse_failure(text):
+    # COMMAND=RATE[:CODE|drop]
+    name, _, spec = text.partition("=")
+    rate, _, result = spec.partition(":")
+    try:
+        rate = float(rate)
+        if result == "drop":
+            pass
+        elif result:
+            result = int(result, 0)
+        else:
+            result = None
+    except ValueError:
+        raise argparse.ArgumentTypeError("expected COMMAND=RATE[:CODE|drop], e.g. storeModel=0.05:0x18")
+    if not 0 <= rate <= 1:
+        raise argparse.ArgumentTypeError("rate must be between 0 and 1")
+    return command_code(name), rate, result
+
+
+def main():
+    parser = argparse.ArgumentParser(description="R30x fingerprint sensor emulator on a pty or serial port")
+    line = parser.add_mutually_exclusive_group()
+    line.add_argument("--link", default="/tmp/fingerprint",
+                      help="symlink to the emulator's pty (default /tmp/fingerprint)")
+    line.add_argument("--port", help="serve on this serial device instead of a pty")
+    parser.add_argument("--baud", type=int, choices=sorted(BAUD_RATES), default=57600,
+                        help="line speed for --port, and the one reported (default 57600)")
+    parser.add_argument("--address", type=lambda text: int(text, 0), default=0xFFFFFFFF,
+                        help="module address (default 0xFFFFFFFF)")
+    parser.add_argument("--password", type=lambda text: int(text, 0), default=0, help="module password (default 0)")
+    parser.add_argument("--capacity", type=int, default=128, help="template slots (default 128)")
+    parser.add_argument("--templates", help="JSON file the templates are kept in (default: memory only)")
+    parser.add_argument("--enrolled", type=int, default=0,
+                        help="fill slots 1..N when starting without a templates file")
+    parser.add_argument("--fingers", type=int, default=8, help="different fingers presented (default 8)")
+    parser.add_argument("--place-delay", type=float, default=800.0,
+                        help="ms from the first image poll to the finger landing (default 800)")
+    parser.add_argument("--hold", type=float, default=500.0,
+                        help="ms the finger stays after a good image (default 500)")
+    parser.add_argument("--latency", type=parse_latency, action="append", default=[],
+                        help="COMMAND=MS reply delay; repeatable, 'all' for every command")
+    parser.add_argument("--fail", type=parse_failure, action="append", default=[],
+                        help="COMMAND=RATE[:CODE|drop] injected failures; repeatable, 'all' for every command")
+    parser.add_argument("--seed", type=int, help="random seed, for repeatable runs")
+    parser.add_argument("--verbose", action="store_true", help="print every command served")
+    args = parser.parse_args()
+    if args.port:
+        args.link = None
+
+    serve(args)
+
+
+if __name__ == "__main__":
+    main()
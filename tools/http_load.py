@@ -0,0 +1,480 @@
+"""Load-tests the dashboard's web server, for how many tablets a gate takes.
+
+Simulated dashboards run against either the host build (pio run -e
+native), started here with -p, or any running gate given with --url. Each
+dashboard loops over a weighted mix of what the pages do:
+
+  page    GET / and every local script, style and icon it links
+  list    GET /vehicle/list
+  passes  GET /rfid/list?limit=100
+  sync    GET /sync
+  stats   GET /stats
+  save    POST /vehicle/save of a vehicle of its own
+  delete  GET /vehicle/delete of one it saved earlier
+
+pausing --think seconds (exponentially distributed) between operations.
+Like the dashboard's fetch(), a request that takes longer than
+REQUEST_TIMEOUT_S is abandoned and counted as a timeout. Alongside, --sse
+subscribers hold /events open; the gate sends at least a keep-alive ping
+every second, so a subscriber that hears nothing for --stall seconds counts
+a stall. With the host build, --pass-rate vehicles a minute drive through
+the RFID pty, so subscribers also see pass events.
+
+The report gives, per operation, the count, errors, timeouts, throughput
+and p50/p99/max latency, then the SSE gaps and the memory high-water marks
+from /stats (and /host/stats on the host build). With several --clients
+values the runs are repeated per value against the same server.
+
+    python tools/http_load.py --clients 1,4,8,16 --duration 30
+    python tools/http_load.py --url http://192.168.4.1 --clients 4 --sse 4
+"""
+
+import argparse
+import asyncio
+import json
+import os
+import random
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+from urllib.parse import urlsplit
+
+DEFAULT_HOST = os.path.join(".pio", "build", "native", "program")
+DEFAULT_PORT = 8080
+STARTUP_TIMEOUT_S = 10
+REQUEST_TIMEOUT_S = 5.0  # the dashboard's fetch abort
+DEFAULT_MIX = "page=1,list=4,passes=3,sync=2,stats=2,save=1,delete=1"
+
+# Mirrors rfid_framer.h
+FRAME_BYTES = 4
+MIN_CONSECUTIVE_READS = 3
+READ_INTERVAL_S = 0.15  # more than FRAME_GAP_MS apart
+
+ASSET_PATTERN = re.compile(r'(?:src|href)="(/?[^"/:][^":]*\.(?:js|css|svg))"')
+
+
+# ============================================================================
+# HOST PROGRAM
+# ============================================================================
+
+class Host:
+    """The native build serving the dashboard on a loopback port."""
+
+    def __init__(self, program, port, vehicles, verbose):
+        self.data_dir = tempfile.mkdtemp(prefix="tollgate-")
+        self.pty = os.path.join(self.data_dir, "rfid")
+        self.verbose = verbose
+        self.ready = threading.Event()
+        self.failed = None
+
+        command = [program, "-d", self.data_dir, "-l", self.pty, "-p", str(port)]
+        if vehicles:
+            command += ["-i", write_vehicle_csv(self.data_dir, vehicles)]
+        self.process = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        self.reader = threading.Thread(target=self.collect, daemon=True)
+        self.reader.start()
+
+        if not self.ready.wait(STARTUP_TIMEOUT_S):
+            self.stop()
+            sys.exit("http_load: %s did not start its web server%s" % (
+                program, ": " + self.failed if self.failed else ""))
+
+    def collect(self):
+        for raw in self.process.stdout:
+            line = raw.decode("utf-8", "replace").rstrip()
+            if self.verbose:
+                print("  host: " + line)
+            if line.startswith("✓ RFID reader on"):
+                self.ready.set()
+            elif line.startswith("ERROR:"):
+                self.failed = line
+
+    def stop(self):
+        self.process.terminate()
+        try:
+            self.process.wait(5)
+        except subprocess.TimeoutExpired:
+            self.process.kill()
+        shutil.rmtree(self.data_dir, ignore_errors=True)
+
+
+def write_vehicle_csv(directory, count):
+    path = os.path.join(directory, "vehicles.csv")
+    with open(path, "w") as f:
+        f.write("rfid,plateNo,type,owner,role,year,section,course\n")
+        for tag in preloaded_tags(count):
+            f.write("%08X,LD-%05d,Car,Load Driver %d,Student,3,B,Engineering\n" % (tag, tag & 0xFFFF, tag))
+    return path
+
+
+def preloaded_tags(count):
+    return [0x10000000 + n for n in range(count)]
+
+
+def drive_passes(pty_path, rate, tags, stop):
+    """Writes MIN_CONSECUTIVE_READS reads of a random tag per arrival."""
+    fd = os.open(pty_path, os.O_WRONLY | os.O_NOCTTY)
+    rng = random.Random()
+    try:
+        while not stop.wait(rng.expovariate(rate / 60.0)):
+            tag = rng.choice(tags) if tags else rng.getrandbits(31) | 0x40000000
+            frame = tag.to_bytes(FRAME_BYTES, "big")
+            for _ in range(MIN_CONSECUTIVE_READS):
+                os.write(fd, frame)
+                if stop.wait(READ_INTERVAL_S):
+                    return
+    finally:
+        os.close(fd)
+
+
+# ============================================================================
+# HTTP
+# ============================================================================
+
+class HttpError(Exception):
+    pass
+
+
+async def http(host, port, method, path, body=None, content_type=None):
+    """One request on its own connection, as the gate closes every response.
+    Returns (status, body bytes)."""
+    reader, writer = await asyncio.open_connection(host, port)
+    try:
+        head = "%s %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n" % (method, path, host)
+        if body is not None:
+            head += "Content-Type: %s\r\nContent-Length: %d\r\n" % (content_type, len(body))
+        writer.write(head.encode() + b"\r\n" + (body or b""))
+        await writer.drain()
+        response = await reader.read()
+    finally:
+        writer.close()
+
+    head, _, payload = response.partition(b"\r\n\r\n")
+    status_line = head.split(b"\r\n", 1)[0].split()
+    if len(status_line) < 2 or not status_line[1].isdigit():
+        raise HttpError("bad response")
+    headers = head.lower()
+    if b"transfer-encoding: chunked" in headers:
+        payload = dechunk(payload)
+    return int(status_line[1]), payload
+
+
+def dechunk(payload):
+    body = b""
+    while payload:
+        size_line, _, rest = payload.partition(b"\r\n")
+        size = int(size_line.split(b";")[0] or b"0", 16)
+        if size == 0:
+            break
+        body += rest[:size]
+        payload = rest[size + 2:]
+    return body
+
+
+# ============================================================================
+# DASHBOARDS
+# ============================================================================
+
+class Results:
+    def __init__(self):
+        self.latency = {}  # operation -> [seconds]
+        self.errors = {}
+        self.timeouts = {}
+        self.bytes = 0
+
+    def record(self, op, seconds=None, error=False, timeout=False):
+        self.latency.setdefault(op, [])
+        self.errors.setdefault(op, 0)
+        self.timeouts.setdefault(op, 0)
+        if seconds is not None:
+            self.latency[op].append(seconds)
+        if error:
+            self.errors[op] += 1
+        if timeout:
+            self.timeouts[op] += 1
+
+
+class Dashboard:
+    def __init__(self, number, args, target, results):
+        self.number = number
+        self.args = args
+        self.host, self.port = target
+        self.results = results
+        self.rng = random.Random()
+        self.saved = []
+        self.next_tag = 0x20000000 + (number << 16)
+
+    async def get(self, path):
+        status, body = await http(self.host, self.port, "GET", path)
+        self.results.bytes += len(body)
+        if status != 200:
+            raise HttpError("%s answered %d" % (path, status))
+        return body
+
+    async def page(self):
+        html = (await self.get("/")).decode("utf-8", "replace")
+        for asset in sorted(set(ASSET_PATTERN.findall(html))):
+            await self.get("/" + asset.lstrip("/"))
+
+    async def save(self):
+        tag = self.next_tag
+        self.next_tag += 1
+        vehicle = {"rfid": "%08X" % tag, "plateNo": "LT-%d" % (tag & 0xFFFFFF), "type": "Car",
+                   "owner": "Load Tablet %d" % self.number, "role": "Staff", "year": "1",
+                   "section": "A", "course": "Testing"}
+        status, body = await http(self.host, self.port, "POST", "/vehicle/save",
+                                  json.dumps(vehicle).encode(), "application/json")
+        if status != 200:
+            raise HttpError("/vehicle/save answered %d: %s" % (status, body[:80]))
+        self.saved.append(tag)
+
+    async def delete(self):
+        if not self.saved:
+            return await self.save()
+        tag = self.saved.pop(self.rng.randrange(len(self.saved)))
+        await self.get("/vehicle/delete?rfid=%08X" % tag)
+
+    def operation(self, op):
+        return {
+            "page": self.page,
+            "list": lambda: self.get("/vehicle/list"),
+            "passes": lambda: self.get("/rfid/list?limit=100"),
+            "sync": lambda: self.get("/sync"),
+            "stats": lambda: self.get("/stats"),
+            "save": self.save,
+            "delete": self.delete,
+        }[op]
+
+    async def run(self, mix, deadline):
+        ops, weights = zip(*mix)
+        while time.monotonic() < deadline:
+            op = self.rng.choices(ops, weights)[0]
+            start = time.monotonic()
+            try:
+                await asyncio.wait_for(self.operation(op)(), REQUEST_TIMEOUT_S)
+                self.results.record(op, time.monotonic() - start)
+            except asyncio.TimeoutError:
+                self.results.record(op, timeout=True)
+            except (OSError, HttpError, ValueError) as e:
+                if self.args.verbose:
+                    print("  dashboard %d %s: %s" % (self.number, op, e))
+                self.results.record(op, error=True)
+                await asyncio.sleep(0.1)  # refused; don't spin
+            if self.args.think > 0:
+                pause = self.rng.expovariate(1.0 / self.args.think)
+                await asyncio.sleep(max(0.0, min(pause, deadline - time.monotonic())))
+
+
+class Subscriber:
+    """Holds /events open and times the gaps between messages."""
+
+    def __init__(self, target, stall):
+        self.host, self.port = target
+        self.stall = stall
+        self.messages = 0
+        self.passes = 0
+        self.max_gap = 0.0
+        self.stalls = 0
+        self.reconnects = 0
+
+    async def run(self, deadline):
+        while time.monotonic() < deadline:
+            try:
+                await self.listen(deadline)
+            except (OSError, asyncio.IncompleteReadError):
+                pass
+            if time.monotonic() < deadline:
+                self.reconnects += 1
+                await asyncio.sleep(0.5)
+
+    async def listen(self, deadline):
+        reader, writer = await asyncio.open_connection(self.host, self.port)
+        try:
+            writer.write(("GET /events HTTP/1.1\r\nHost: %s\r\nAccept: text/event-stream\r\n\r\n"
+                          % self.host).encode())
+            await writer.drain()
+            last = time.monotonic()
+            stalled = False
+            while True:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    return
+                try:
+                    line = await asyncio.wait_for(reader.readline(), min(remaining, self.stall))
+                except asyncio.TimeoutError:
+                    if not stalled and time.monotonic() < deadline:
+                        self.stalls += 1
+                        stalled = True
+                    continue
+                if not line:
+                    return
+                if line.startswith(b"event: rfid"):
+                    self.passes += 1
+                if line in (b"\r\n", b"\n"):
+                    now = time.monotonic()
+                    self.max_gap = max(self.max_gap, now - last)
+                    last = now
+                    stalled = False
+                    self.messages += 1
+        finally:
+            writer.close()
+
+
+# ============================================================================
+# REPORT
+# ============================================================================
+
+def percentile(values, fraction):
+    if not values:
+        return float("nan")
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+async def memory(target, host_build):
+    """The gate's heap and, on the host build, the process and server peaks."""
+    report = {}
+    try:
+        status, body = await asyncio.wait_for(http(target[0], target[1], "GET", "/stats"), REQUEST_TIMEOUT_S)
+        stats = json.loads(body)
+        report["freeHeap"] = stats.get("freeHeap")
+        report["minFreeHeap"] = stats.get("minFreeHeap")
+        if host_build:
+            status, body = await asyncio.wait_for(
+                http(target[0], target[1], "GET", "/host/stats"), REQUEST_TIMEOUT_S)
+            host = json.loads(body)
+            report.update(host["heap"])
+            report.update(host["http"])
+    except (OSError, asyncio.TimeoutError, HttpError, ValueError, KeyError) as e:
+        report["error"] = str(e) or type(e).__name__
+    return report
+
+
+def print_level(clients, seconds, results, subscribers, mem):
+    print()
+    print("== %d dashboards, %d SSE subscribers, %.0f s" % (clients, len(subscribers), seconds))
+    print("%-8s %8s %7s %8s %8s %9s %9s %9s" % (
+        "op", "count", "errors", "timeouts", "req/s", "p50 ms", "p99 ms", "max ms"))
+    total = 0
+    for op in sorted(results.latency):
+        latency = results.latency[op]
+        total += len(latency)
+        print("%-8s %8d %7d %8d %8.1f %9.1f %9.1f %9.1f" % (
+            op, len(latency), results.errors[op], results.timeouts[op], len(latency) / seconds,
+            percentile(latency, 0.5) * 1000.0, percentile(latency, 0.99) * 1000.0,
+            max(latency) * 1000.0 if latency else float("nan")))
+    print("%-8s %8d %7d %8d %8.1f   (%.1f KiB/s received)" % (
+        "total", total, sum(results.errors.values()), sum(results.timeouts.values()), total / seconds,
+        results.bytes / 1024.0 / seconds))
+
+    if subscribers:
+        print("sse      messages %d, passes %d, max gap %.0f ms, stalls %d, reconnects %d" % (
+            sum(s.messages for s in subscribers), sum(s.passes for s in subscribers),
+            max(s.max_gap for s in subscribers) * 1000.0, sum(s.stalls for s in subscribers),
+            sum(s.reconnects for s in subscribers)))
+
+    if "error" in mem:
+        print("memory   unavailable (%s)" % mem["error"])
+        return
+    print("memory   freeHeap %s, minFreeHeap %s" % (mem.get("freeHeap"), mem.get("minFreeHeap")))
+    if "peakUsed" in mem:
+        print("host     heap peak %d B, RSS peak %d KiB, connections peak %d (refused %d), "
+              "buffered peak %d B" % (mem["peakUsed"], mem["peakRssKiB"], mem["peakConnections"],
+                                      mem["refused"], mem["peakBufferedBytes"]))
+
+
+async def run_level(args, target, clients, host_build):
+    results = Results()
+    deadline = time.monotonic() + args.duration
+    dashboards = [Dashboard(n, args, target, results) for n in range(clients)]
+    subscribers = [Subscriber(target, args.stall) for _ in range(args.sse)]
+    start = time.monotonic()
+    await asyncio.gather(*([d.run(args.mix, deadline) for d in dashboards] +
+                           [s.run(deadline) for s in subscribers]))
+    elapsed = time.monotonic() - start
+    print_level(clients, elapsed, results, subscribers, await memory(target, host_build))
+
+
+# ============================================================================
+# MAIN
+# ============================================================================
+
+def parse_counts(text):
+    try:
+        counts = [int(part) for part in text.split(",")]
+    except ValueError:
+        counts = []
+    if not counts or min(counts) < 1:
+        raise argparse.ArgumentTypeError("expected positive counts, e.g. 1,4,8")
+    return counts
+
+
+def parse_mix(text):
+    mix = []
+    for item in text.split(","):
+        op, _, weight = item.partition("=")
+        if op not in ("page", "list", "passes", "sync", "stats", "save", "delete"):
+            raise argparse.ArgumentTypeError("unknown operation %r" % op)
+        try:
+            mix.append((op, float(weight or 1)))
+        except ValueError:
+            raise argparse.ArgumentTypeError("bad weight %r" % weight)
+    if sum(weight for _, weight in mix) <= 0:
+        raise argparse.ArgumentTypeError("every weight is 0")
+    return mix
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Load-test the dashboard's web server")
+    parser.add_argument("--host", default=DEFAULT_HOST, help="native program (default %s)" % DEFAULT_HOST)
+    parser.add_argument("--url", help="test a running gate instead of starting the host build")
+    parser.add_argument("--port", type=int, default=DEFAULT_PORT,
+                        help="port for the host build (default %d)" % DEFAULT_PORT)
+    parser.add_argument("--clients", type=parse_counts, default=[4],
+                        help="simultaneous dashboards; a comma-separated list runs each (default 4)")
+    parser.add_argument("--sse", type=int, default=2, help="/events subscribers (default 2)")
+    parser.add_argument("--duration", type=float, default=30.0, help="seconds per run (default 30)")
+    parser.add_argument("--think", type=float, default=0.5,
+                        help="mean seconds between a dashboard's operations (default 0.5)")
+    parser.add_argument("--mix", type=parse_mix, default=parse_mix(DEFAULT_MIX),
+                        help="operation weights (default %s)" % DEFAULT_MIX)
+    parser.add_argument("--vehicles", type=int, default=200,
+                        help="vehicles imported into the host build first (default 200)")
+    parser.add_argument("--pass-rate", type=float, default=30.0,
+                        help="vehicles per minute through the host build's RFID pty (default 30)")
+    parser.add_argument("--stall", type=float, default=REQUEST_TIMEOUT_S,
+                        help="seconds of SSE silence that count as a stall (default %g)" % REQUEST_TIMEOUT_S)
+    parser.add_argument("--verbose", action="store_true", help="echo the host program's output and errors")
+    args = parser.parse_args()
+
+    host = None
+    stop = threading.Event()
+    if args.url:
+        parts = urlsplit(args.url)
+        target = (parts.hostname, parts.port or 80)
+    else:
+        if not os.path.exists(args.host):
+            sys.exit("http_load: %s not found; build it with: pio run -e native" % args.host)
+        host = Host(args.host, args.port, args.vehicles, args.verbose)
+        target = ("127.0.0.1", args.port)
+        if args.pass_rate > 0:
+            threading.Thread(target=drive_passes, daemon=True,
+                             args=(host.pty, args.pass_rate, preloaded_tags(args.vehicles), stop)).start()
+
+    try:
+        for clients in args.clients:
+            asyncio.run(run_level(args, target, clients, host is not None))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        stop.set()
+        if host is not None:
+            host.stop()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,348 @@
+"""Emulates the RFID reader against the host build, for lane throughput.
+
+Starts the native program (pio run -e native), writes reader traffic into
+its RFID pty and reads the PASS lines it prints, so the real framing,
+MIN_CONSECUTIVE_READS confirmation and DUPLICATE_WINDOW logic see the
+bytes. Two kinds of traffic:
+
+  synthetic  vehicles arrive as a Poisson process at --rate per minute.
+             While in the antenna field a vehicle's tag is read --reads
+             times, --read-interval ms apart (plus jitter), so busy lanes
+             interleave several vehicles' frames. --noise adds stray bytes
+             and --truncate cuts reads short.
+  replay     a capture file, one read per line: "<ms> <hex bytes>", with
+             the time relative to the start and '#' starting a comment.
+             --record writes synthetic traffic in this form, so a run can
+             be repeated exactly.
+
+For synthetic traffic every arrival is expected to produce exactly one
+pass. The report gives missed passes, double counts and detection latency:
+the time from writing the read that should confirm the pass (the
+MIN_CONSECUTIVE_READS-th intact one) to the PASS line arriving. The
+FRAME_GAP_MS of silence the framer waits for is part of that latency.
+With several --rate values the runs are repeated per rate and the highest
+rate whose miss rate stays within --max-miss is reported as the lane's
+throughput.
+
+    python tools/rfid_emulator.py --rate 10,30,60,120 --duration 60
+    python tools/rfid_emulator.py --replay capture.txt
+"""
+
+import argparse
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+# Mirrors rfid_framer.h
+FRAME_BYTES = 4
+MIN_CONSECUTIVE_READS = 3
+FRAME_GAP_MS = 100
+
+DEFAULT_HOST = os.path.join(".pio", "build", "native", "program")
+STARTUP_TIMEOUT_S = 10
+DRAIN_S = 1.0  # after the last byte, for the final frames to be confirmed
+
+
+class Read:
+    """Bytes written at one moment, and which arrival they belong to."""
+
+    def __init__(self, at_ms, data, arrival=None, intact=False):
+        self.at_ms = at_ms
+        self.data = data
+        self.arrival = arrival
+        self.intact = intact
+        self.written = None  # monotonic time once sent
+
+
+class Arrival:
+    def __init__(self, tag, start_ms):
+        self.tag = tag
+        self.start_ms = start_ms
+        self.reads = []
+        self.detections = []
+
+    def confirming_read(self):
+        intact = [read for read in self.reads if read.intact]
+        if len(intact) < MIN_CONSECUTIVE_READS:
+            return None
+        return intact[MIN_CONSECUTIVE_READS - 1]
+
+
+def random_tag(rng, used):
+    # Never one of the values the reader firmware treats as noise
+    while True:
+        tag = rng.getrandbits(32)
+        if tag not in (0x00000000, 0x00000001, 0xFFFFFFFF) and tag not in used:
+            used.add(tag)
+            return tag
+
+
+def synthetic_traffic(args, rate, rng):
+    arrivals = []
+    reads = []
+    used = set()
+    duration_ms = args.duration * 1000.0
+
+    t = rng.expovariate(rate / 60000.0)
+    while t < duration_ms:
+        arrival = Arrival(random_tag(rng, used), t)
+        frame = arrival.tag.to_bytes(FRAME_BYTES, "big")
+        for k in range(args.reads):
+            at = t + k * args.read_interval + rng.uniform(-args.jitter, args.jitter)
+            if rng.random() < args.truncate:
+                read = Read(at, frame[:rng.randint(1, FRAME_BYTES - 1)], arrival)
+            else:
+                read = Read(at, frame, arrival, intact=True)
+            arrival.reads.append(read)
+            reads.append(read)
+        arrivals.append(arrival)
+        t += rng.expovariate(rate / 60000.0)
+
+    if args.noise > 0:
+        t = rng.expovariate(args.noise / 1000.0)
+        while t < duration_ms:
+            reads.append(Read(t, bytes(rng.getrandbits(8) for _ in range(rng.randint(1, 3)))))
+            t += rng.expovariate(args.noise / 1000.0)
+
+    reads.sort(key=lambda read: read.at_ms)
+    return arrivals, reads
+
+
+def load_capture(path):
+    reads = []
+    with open(path, "r") as f:
+        for number, line in enumerate(f, 1):
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+            try:
+                at, data = line.split(None, 1)
+                reads.append(Read(float(at), bytes.fromhex(data)))
+            except ValueError:
+                sys.exit("rfid_emulator: %s:%d: expected '<ms> <hex bytes>'" % (path, number))
+    reads.sort(key=lambda read: read.at_ms)
+    return reads
+
+
+def save_capture(path, reads):
+    with open(path, "w") as f:
+        f.write("# rfid_emulator capture: <ms> <hex bytes>\n")
+        for read in reads:
+            f.write("%.1f %s\n" % (read.at_ms, read.data.hex().upper()))
+
+
+# ============================================================================
+# HOST PROGRAM
+# ============================================================================
+
+class Host:
+    """The native build, with its PASS lines collected as they arrive."""
+
+    def __init__(self, program, verbose):
+        self.data_dir = tempfile.mkdtemp(prefix="tollgate-")
+        self.pty = os.path.join(self.data_dir, "rfid")
+        self.verbose = verbose
+        self.passes = []  # (monotonic time, tag)
+        self.lock = threading.Lock()
+        self.ready = threading.Event()
+
+        self.process = subprocess.Popen(
+            [program, "-d", self.data_dir, "-l", self.pty],
+            stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        self.reader = threading.Thread(target=self.collect, daemon=True)
+        self.reader.start()
+
+        if not self.ready.wait(STARTUP_TIMEOUT_S):
+            self.stop()
+            sys.exit("rfid_emulator: %s did not open its RFID pty" % program)
+
+    def collect(self):
+        for raw in self.process.stdout:
+            now = time.monotonic()
+            line = raw.decode("utf-8", "replace").rstrip()
+            if self.verbose:
+                print("  host: " + line)
+            if line.startswith("✓ RFID reader on"):
+                self.ready.set()
+            elif line.startswith("PASS "):
+                fields = dict(item.split("=", 1) for item in line.split()[1:] if "=" in item)
+                with self.lock:
+                    self.passes.append((now, int(fields["tag"], 16)))
+
+    def take_passes(self):
+        with self.lock:
+            passes, self.passes = self.passes, []
+        return passes
+
+    def stop(self):
+        self.process.terminate()
+        try:
+            self.process.wait(5)
+        except subprocess.TimeoutExpired:
+            self.process.kill()
+        shutil.rmtree(self.data_dir, ignore_errors=True)
+
+
+def send(pty_path, reads):
+    """Writes every read at its time; returns the monotonic start time."""
+    fd = os.open(pty_path, os.O_WRONLY | os.O_NOCTTY)
+    try:
+        start = time.monotonic()
+        for read in reads:
+            delay = start + read.at_ms / 1000.0 - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+            os.write(fd, read.data)
+            read.written = time.monotonic()
+        return start
+    finally:
+        os.close(fd)
+
+
+# ============================================================================
+# REPORT
+# ============================================================================
+
+def percentile(values, fraction):
+    if not values:
+        return float("nan")
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def score(arrivals, passes):
+    """Matches each pass to the latest arrival of its tag that began before it."""
+    by_tag = {arrival.tag: arrival for arrival in arrivals}
+    unmatched = 0
+    for at, tag in passes:
+        arrival = by_tag.get(tag)
+        if arrival is None or arrival.reads[0].written is None or arrival.reads[0].written > at:
+            unmatched += 1
+            continue
+        arrival.detections.append(at)
+
+    latencies = []
+    for arrival in arrivals:
+        confirming = arrival.confirming_read()
+        if arrival.detections and confirming is not None:
+            latencies.append((arrival.detections[0] - confirming.written) * 1000.0)
+
+    return {
+        "vehicles": len(arrivals),
+        "detected": sum(1 for arrival in arrivals if arrival.detections),
+        "missed": sum(1 for arrival in arrivals if not arrival.detections),
+        "doubles": sum(max(0, len(arrival.detections) - 1) for arrival in arrivals),
+        "unmatched": unmatched,
+        "unreadable": sum(1 for arrival in arrivals if arrival.confirming_read() is None),
+        "latency": latencies,
+    }
+
+
+def print_result(rate, result):
+    vehicles = result["vehicles"]
+    miss_rate = 100.0 * result["missed"] / vehicles if vehicles else 0.0
+    latency = result["latency"]
+    print("%8.1f %8d %8d %7d %6.1f%% %7d %9d %8.0f %8.0f %8.0f" % (
+        rate, vehicles, result["detected"], result["missed"], miss_rate, result["doubles"],
+        result["unmatched"], percentile(latency, 0.5), percentile(latency, 0.95),
+        max(latency) if latency else float("nan")))
+
+
+def run_synthetic(args, rates):
+    rng = random.Random(args.seed)
+    print("%8s %8s %8s %7s %7s %7s %9s %8s %8s %8s" % (
+        "veh/min", "vehicles", "detected", "missed", "miss", "doubles", "unmatched",
+        "p50 ms", "p95 ms", "max ms"))
+
+    best = None
+    for rate in rates:
+        arrivals, reads = synthetic_traffic(args, rate, rng)
+        if args.record:
+            save_capture(args.record if len(rates) == 1 else "%s.%g" % (args.record, rate), reads)
+
+        host = Host(args.host, args.verbose)
+        try:
+            send(host.pty, reads)
+            time.sleep(DRAIN_S)
+            result = score(arrivals, host.take_passes())
+        finally:
+            host.stop()
+
+        print_result(rate, result)
+        if result["vehicles"] and result["missed"] <= args.max_miss / 100.0 * result["vehicles"]:
+            best = rate if best is None else max(best, rate)
+        if result["unreadable"]:
+            print("%8s %d vehicle(s) never had %d intact reads" % ("", result["unreadable"],
+                                                                 MIN_CONSECUTIVE_READS))
+
+    print()
+    if best is None:
+        print("No rate kept the miss rate within %.1f%%" % args.max_miss)
+    else:
+        print("Lane throughput: %g vehicles/min with at most %.1f%% missed" % (best, args.max_miss))
+
+
+def run_replay(args):
+    reads = load_capture(args.replay)
+    host = Host(args.host, args.verbose)
+    try:
+        start = send(host.pty, reads)
+        time.sleep(DRAIN_S)
+        passes = host.take_passes()
+    finally:
+        host.stop()
+
+    print("%d reads replayed, %d passes" % (len(reads), len(passes)))
+    for at, tag in passes:
+        print("  %9.1f ms  %08X" % ((at - start) * 1000.0, tag))
+
+
+def parse_rates(text):
+    try:
+        rates = [float(value) for value in text.split(",")]
+    except ValueError:
+        rates = []
+    if not rates or any(rate <= 0 for rate in rates):
+        raise argparse.ArgumentTypeError("expected positive rates, e.g. 10,30,60")
+    return rates
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Drive the host build's RFID pty and measure detections")
+    parser.add_argument("--host", default=DEFAULT_HOST, help="native program (default %s)" % DEFAULT_HOST)
+    parser.add_argument("--replay", help="capture file to replay instead of synthetic traffic")
+    parser.add_argument("--record", help="save the synthetic traffic as a capture file")
+    parser.add_argument("--rate", type=parse_rates, default=[30.0],
+                        help="vehicles per minute; a comma-separated list runs each (default 30)")
+    parser.add_argument("--duration", type=float, default=60.0, help="seconds of traffic per rate (default 60)")
+    parser.add_argument("--reads", type=int, default=5, help="reads per vehicle in the field (default 5)")
+    parser.add_argument("--read-interval", type=float, default=150.0,
+                        help="ms between reads of one vehicle (default 150)")
+    parser.add_argument("--jitter", type=float, default=20.0, help="+/- ms on each read (default 20)")
+    parser.add_argument("--noise", type=float, default=0.0, help="stray byte bursts per second (default 0)")
+    parser.add_argument("--truncate", type=float, default=0.0,
+                        help="fraction of reads cut short (default 0)")
+    parser.add_argument("--max-miss", type=float, default=1.0,
+                        help="miss rate, in percent, a rate may have to count as sustained (default 1)")
+    parser.add_argument("--seed", type=int, help="random seed, for repeatable traffic")
+    parser.add_argument("--verbose", action="store_true", help="echo the host program's output")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.host):
+        sys.exit("rfid_emulator: %s not found; build it with: pio run -e native" % args.host)
+    if args.read_interval <= FRAME_GAP_MS + args.jitter:
+        print("warning: reads closer than FRAME_GAP_MS (%d ms) run together into one frame" % FRAME_GAP_MS)
+
+    if args.replay:
+        run_replay(args)
+    else:
+        run_synthetic(args, args.rate)
+
+
+if __name__ == "__main__":
+    main()